@@ -1,8 +1,13 @@
 #include "PHCalibration.hh"
 
 #include <iostream>
+#include <algorithm>
 #include <TMath.h>
 #include <TH1.h>
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
@@ -94,6 +99,7 @@ double PHCalibration::phErr(int iroc, int icol, int irow, double vcal) {
 // ----------------------------------------------------------------------
 void PHCalibration::setPHParameters(std::vector<std::vector<gainPedestalParameters> >v) {
   fParameters = v; 
+  clearLookupTable(); 
 } 
 
 // ----------------------------------------------------------------------
@@ -102,3 +108,77 @@ string PHCalibration::getParameters(int iroc, int icol, int irow) {
   return Form("%2d/%2d/%2d: %e %e %e %e", iroc, icol, irow, 
 	      fParameters[iroc][idx].p0, fParameters[iroc][idx].p1, fParameters[iroc][idx].p2, fParameters[iroc][idx].p3);
 }
+
+// ----------------------------------------------------------------------
+void* PHCalibration::tableFill(void *arg) {
+  tableJob *job = reinterpret_cast<tableJob*>(arg); 
+  PHCalibration *cal = job->cal; 
+  for (unsigned int iroc = job->first; iroc < cal->fParameters.size(); iroc += job->step) {
+    for (int icol = 0; icol < 52; ++icol) {
+      for (int irow = 0; irow < 80; ++irow) {
+	float *t = &cal->fTable[(static_cast<size_t>(iroc)*4160 + icol*80 + irow)*256]; 
+	for (int ph = 0; ph < 256; ++ph) t[ph] = static_cast<float>(cal->vcal(iroc, icol, irow, ph)); 
+      }
+    }
+  }
+  return 0; 
+}
+
+// ----------------------------------------------------------------------
+void PHCalibration::buildLookupTable(int nthreads) {
+  fTable.clear(); 
+  int nrocs = static_cast<int>(fParameters.size()); 
+  for (int iroc = 0; iroc < nrocs; ++iroc) {
+    if (fParameters[iroc].size() < 4160) return; 
+  }
+  fTable.resize(static_cast<size_t>(nrocs)*4160*256); 
+  if (fTable.empty()) return; 
+
+#ifndef WIN32
+  if (nthreads < 1) nthreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)); 
+#else
+  nthreads = 1; 
+#endif
+  nthreads = max(1, min(nthreads, nrocs)); 
+
+  // -- every thread fills the table of its own ROCs
+  vector<tableJob> jobs(nthreads); 
+  for (int t = 0; t < nthreads; ++t) {
+    jobs[t].cal = this; 
+    jobs[t].first = t; 
+    jobs[t].step = nthreads; 
+  }
+#ifndef WIN32
+  vector<pthread_t> threads(nthreads); 
+  for (int t = 0; t < nthreads; ++t) pthread_create(&threads[t], 0, PHCalibration::tableFill, &jobs[t]); 
+  for (int t = 0; t < nthreads; ++t) pthread_join(threads[t], 0); 
+#else
+  tableFill(&jobs[0]); 
+#endif
+}
+
+// ----------------------------------------------------------------------
+void PHCalibration::clearLookupTable() {
+  vector<float>().swap(fTable); 
+}
+
+// ----------------------------------------------------------------------
+void PHCalibration::vcal(const vector<pxar::pixel> &pixels, vector<double> &q) {
+  q.resize(pixels.size()); 
+  unsigned int nrocs = fParameters.size(); 
+  for (unsigned int ipix = 0; ipix < pixels.size(); ++ipix) {
+    pxar::pixel px(pixels[ipix]); 
+    unsigned int iroc = px.roc(); 
+    if (iroc >= nrocs || px.column() > 51 || px.row() > 79) {
+      q[ipix] = 0.; 
+      continue; 
+    }
+    double ph = px.value(); 
+    int iph = static_cast<int>(ph); 
+    if (!fTable.empty() && iph == ph && iph >= 0 && iph < 256) {
+      q[ipix] = fTable[(static_cast<size_t>(iroc)*4160 + px.column()*80 + px.row())*256 + iph]; 
+    } else {
+      q[ipix] = vcal(iroc, px.column(), px.row(), ph); 
+    }
+  }
+}
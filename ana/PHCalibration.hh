@@ -13,7 +13,7 @@ public:
   /// 0 = error function
   /// 1 = tanH
   PHCalibration(int mode = 0); 
-  void setMode(int mode = 0) {fMode = mode;}
+  void setMode(int mode = 0) {fMode = mode; clearLookupTable();}
   int getMode() {return fMode; }
 
   ~PHCalibration(); 
@@ -31,9 +31,26 @@ public:
   bool initialized() {return (fParameters.size() > 0);}
   std::string getParameters(int iroc, int icol, int irow); 
 
+  /// precompute vcal() for all pixels and the 256 pulse height values (nthreads = 0: one per CPU).
+  /// Needs 4 bytes per value, 4160 x 256 x 4 B = 4.3 MB per ROC
+  void buildLookupTable(int nthreads = 0); 
+  void clearLookupTable(); 
+  bool hasLookupTable() {return (fTable.size() > 0);}
+  /// vcal() of all pixels of an event, from the lookup table if there is one. The pixel's
+  /// ROC ID is used as ROC index (as in the callers of vcal()), unknown ROCs return 0
+  void vcal(const std::vector<pxar::pixel> &pixels, std::vector<double> &q); 
+
  private: 
   int fMode; 
   std::vector<std::vector<gainPedestalParameters> > fParameters;
+  /// vcal for pixel idx = iroc*4160 + icol*80 + irow at fTable[idx*256 + ph]
+  std::vector<float> fTable; 
+
+  struct tableJob {
+    PHCalibration *cal; 
+    int first, step; 
+  };
+  static void* tableFill(void *arg); 
   
 };
 
@@ -0,0 +1,314 @@
+#include "PixGainPedestalFit.hh"
+
+#include <cmath>
+#include <algorithm>
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+  const int NPAR = 4;
+
+  // -- solve a*x = b for x (returned in b), false if a is singular
+  bool solve(double a[NPAR][NPAR], double *b) {
+    for (int i = 0; i < NPAR; ++i) {
+      int ipiv = i;
+      for (int j = i+1; j < NPAR; ++j) if (fabs(a[j][i]) > fabs(a[ipiv][i])) ipiv = j;
+      if (a[ipiv][i] == 0.) return false;
+      if (ipiv != i) {
+        for (int k = 0; k < NPAR; ++k) swap(a[i][k], a[ipiv][k]);
+        swap(b[i], b[ipiv]);
+      }
+      for (int j = i+1; j < NPAR; ++j) {
+        double f = a[j][i]/a[i][i];
+        for (int k = i; k < NPAR; ++k) a[j][k] -= f*a[i][k];
+        b[j] -= f*b[i];
+      }
+    }
+    for (int i = NPAR-1; i >= 0; --i) {
+      for (int k = i+1; k < NPAR; ++k) b[i] -= a[i][k]*b[k];
+      b[i] /= a[i][i];
+    }
+    return true;
+  }
+
+  // -- log(cosh(z)) without overflow
+  double lncosh(double z) {
+    z = fabs(z);
+    return z + log1p(exp(-2.*z)) - log(2.);
+  }
+}
+
+// ----------------------------------------------------------------------
+PixGainPedestalFit::PixGainPedestalFit(int mode): fMode(mode), fMaxIterations(200) {
+
+}
+
+// ----------------------------------------------------------------------
+PixGainPedestalFit::~PixGainPedestalFit() {
+
+}
+
+// ----------------------------------------------------------------------
+double PixGainPedestalFit::eval(const double *par, double x) const {
+  if (0 == fMode) {
+    return par[3]*(erf((x-par[0])/par[1]) + par[2]);
+  } else {
+    return par[3] + par[2]*tanh(par[0]*x - par[1]);
+  }
+}
+
+// ----------------------------------------------------------------------
+void PixGainPedestalFit::gradient(const double *par, double x, double *df) const {
+  if (0 == fMode) {
+    double u = (x-par[0])/par[1];
+    double g = 2./sqrt(M_PI)*exp(-u*u);
+    df[0] = -par[3]*g/par[1];
+    df[1] = -par[3]*g*u/par[1];
+    df[2] = par[3];
+    df[3] = erf(u) + par[2];
+  } else {
+    double t = tanh(par[0]*x - par[1]);
+    double s = 1. - t*t;
+    df[0] = par[2]*s*x;
+    df[1] = -par[2]*s;
+    df[2] = t;
+    df[3] = 1.;
+  }
+}
+
+// ----------------------------------------------------------------------
+double PixGainPedestalFit::integral(const double *par, double a, double b) const {
+  if (0 == fMode) {
+    // -- the antiderivative of erf(u) is u*erf(u) + exp(-u^2)/sqrt(pi)
+    double ua = (a-par[0])/par[1], ub = (b-par[0])/par[1];
+    double fa = (a-par[0])*erf(ua) + par[1]/sqrt(M_PI)*exp(-ua*ua) + par[2]*a;
+    double fb = (b-par[0])*erf(ub) + par[1]/sqrt(M_PI)*exp(-ub*ub) + par[2]*b;
+    return par[3]*(fb - fa);
+  } else {
+    if (par[0] == 0.) return (par[3] + par[2]*tanh(-par[1]))*(b - a);
+    return par[3]*(b - a) + par[2]/par[0]*(lncosh(par[0]*b - par[1]) - lncosh(par[0]*a - par[1]));
+  }
+}
+
+// ----------------------------------------------------------------------
+void PixGainPedestalFit::init(int n, const double *x, const double *y, double *par, double *parlo, double *parhi) const {
+  double hmax(0.), hmin(0.);
+  for (int i = 0; i < n; ++i) {
+    if (y[i] > hmax) hmax = y[i];
+    if (y[i] < hmin) hmin = y[i];
+  }
+  for (int i = 0; i < NPAR; ++i) {
+    parlo[i] = -HUGE_VAL;
+    parhi[i] = HUGE_VAL;
+  }
+
+  // -- as PixInitFunc::gpErr and PixInitFunc::gpTanH
+  if (0 == fMode) {
+    double xhalf(HUGE_VAL);
+    for (int i = 0; i < n; ++i) if (y[i] > 0.5*hmax && x[i] < xhalf) xhalf = x[i];
+    par[0] = (xhalf < HUGE_VAL ? xhalf : 0.);  // half-point
+    par[1] = 250.;                              // slope
+    par[2] = 1.;
+    par[3] = 0.5*hmax;                          // half plateau
+    parlo[1] = 50.;
+    parhi[1] = 1000.;
+  } else {
+    // -- the histograms of the ROOT fits always have empty bins, their minimum is at most 0
+    double middle = hmax - hmin;
+    par[0] = 1.4e-3;
+    par[1] = 0.8;
+    par[2] = middle;
+    par[3] = hmax - middle;
+    parlo[0] = 1.e-3;
+    parhi[0] = 2.e-3;
+    parlo[1] = 0.;
+    parhi[1] = 20.;
+    parlo[2] = 0.;
+    parhi[2] = 2*middle;
+  }
+}
+
+// ----------------------------------------------------------------------
+void PixGainPedestalFit::linear(int n, const double *x, const double *y, const double *w,
+                                double *par, const double *parlo, const double *parhi) const {
+  // -- both models are a*g(x) + b with g depending on p0 and p1 only: weighted least squares for a and b
+  double sw(0.), sg(0.), sgg(0.), sy(0.), sgy(0.);
+  for (int i = 0; i < n; ++i) {
+    double g = (0 == fMode ? erf((x[i]-par[0])/par[1]) : tanh(par[0]*x[i] - par[1]));
+    sw  += w[i];
+    sg  += w[i]*g;
+    sgg += w[i]*g*g;
+    sy  += w[i]*y[i];
+    sgy += w[i]*g*y[i];
+  }
+  double det = sw*sgg - sg*sg;
+  if (det <= 0. || sw <= 0.) return;
+  double a = (sw*sgy - sg*sy)/det;
+  if (1 == fMode) a = min(parhi[2], max(parlo[2], a));
+  double b = (sy - a*sg)/sw;
+  if (0 == fMode) {
+    if (a == 0.) return;
+    par[3] = a;
+    par[2] = b/a;
+  } else {
+    par[2] = a;
+    par[3] = b;
+  }
+}
+
+// ----------------------------------------------------------------------
+PixGainPedestalFit::result PixGainPedestalFit::fit(int n, const double *x, const double *y, double fracErr) const {
+  result r;
+  for (int i = 0; i < NPAR; ++i) r.par[i] = r.err[i] = 0.;
+  r.chi2 = 0.;
+  r.ndf = 0;
+  r.ok = false;
+
+  // -- points without content have no error and do not enter the chi2 (as in TH1::Fit)
+  vector<double> xs, ys, ws;
+  double sum(0.);
+  for (int i = 0; i < n; ++i) {
+    sum += y[i];
+    double e = fracErr*fabs(y[i]);
+    if (e <= 0.) continue;
+    xs.push_back(x[i]);
+    ys.push_back(y[i]);
+    ws.push_back(1./(e*e));
+  }
+  if (sum < 1.) return r;
+  r.ok = true;
+  int np = static_cast<int>(xs.size());
+  r.ndf = np - NPAR;
+
+  double parlo[NPAR], parhi[NPAR];
+  init(np, &xs[0], &ys[0], r.par, parlo, parhi);
+  linear(np, &xs[0], &ys[0], &ws[0], r.par, parlo, parhi);
+
+  double chi2(0.);
+  for (int i = 0; i < np; ++i) {
+    double d = ys[i] - eval(r.par, xs[i]);
+    chi2 += ws[i]*d*d;
+  }
+
+  // -- Levenberg-Marquardt, steps are clipped to the parameter limits
+  double lambda(1.e-3);
+  double jtj[NPAR][NPAR], jtr[NPAR], df[NPAR];
+  for (int iter = 0; iter < fMaxIterations; ++iter) {
+    for (int k = 0; k < NPAR; ++k) {
+      jtr[k] = 0.;
+      for (int l = 0; l < NPAR; ++l) jtj[k][l] = 0.;
+    }
+    for (int i = 0; i < np; ++i) {
+      gradient(r.par, xs[i], df);
+      double d = ys[i] - eval(r.par, xs[i]);
+      for (int k = 0; k < NPAR; ++k) {
+        jtr[k] += ws[i]*df[k]*d;
+        for (int l = 0; l <= k; ++l) jtj[k][l] += ws[i]*df[k]*df[l];
+      }
+    }
+    for (int k = 0; k < NPAR; ++k) for (int l = k+1; l < NPAR; ++l) jtj[k][l] = jtj[l][k];
+
+    bool improved(false);
+    double trial[NPAR], chi2t(0.);
+    while (lambda < 1.e10) {
+      double a[NPAR][NPAR], dp[NPAR];
+      for (int k = 0; k < NPAR; ++k) {
+        for (int l = 0; l < NPAR; ++l) a[k][l] = jtj[k][l];
+        a[k][k] = (jtj[k][k] > 0. ? jtj[k][k]*(1. + lambda) : 1.);
+        dp[k] = (jtj[k][k] > 0. ? jtr[k] : 0.);
+      }
+      if (!solve(a, dp)) {
+        lambda *= 10.;
+        continue;
+      }
+      for (int k = 0; k < NPAR; ++k) trial[k] = min(parhi[k], max(parlo[k], r.par[k] + dp[k]));
+      // -- keep the linear parameters at their optimum, otherwise the steps crawl along a narrow valley
+      linear(np, &xs[0], &ys[0], &ws[0], trial, parlo, parhi);
+      chi2t = 0.;
+      for (int i = 0; i < np; ++i) {
+        double d = ys[i] - eval(trial, xs[i]);
+        chi2t += ws[i]*d*d;
+      }
+      if (chi2t < chi2) {
+        improved = true;
+        lambda = max(1.e-12, 0.1*lambda);
+        break;
+      }
+      lambda *= 10.;
+    }
+    if (!improved) break;
+
+    bool converged = (chi2 - chi2t < 1.e-9*chi2 + 1.e-12) && (lambda < 1.e-2);
+    for (int k = 0; k < NPAR; ++k) r.par[k] = trial[k];
+    chi2 = chi2t;
+    if (converged) break;
+  }
+  r.chi2 = chi2;
+
+  // -- parameter errors from the diagonal of the inverted curvature matrix at the minimum
+  double curv[NPAR][NPAR];
+  for (int k = 0; k < NPAR; ++k) for (int l = 0; l < NPAR; ++l) curv[k][l] = 0.;
+  for (int i = 0; i < np; ++i) {
+    gradient(r.par, xs[i], df);
+    for (int k = 0; k < NPAR; ++k) for (int l = 0; l < NPAR; ++l) curv[k][l] += ws[i]*df[k]*df[l];
+  }
+  for (int k = 0; k < NPAR; ++k) {
+    double a[NPAR][NPAR], col[NPAR];
+    for (int i = 0; i < NPAR; ++i) {
+      for (int l = 0; l < NPAR; ++l) a[i][l] = curv[i][l];
+      col[i] = (i == k ? 1. : 0.);
+    }
+    if (solve(a, col) && col[k] > 0.) r.err[k] = sqrt(col[k]);
+  }
+  return r;
+}
+
+// ----------------------------------------------------------------------
+void* PixGainPedestalFit::fitJob(void *arg) {
+  job *j = reinterpret_cast<job*>(arg);
+  const vector<double> &x = *j->x;
+  for (unsigned int i = j->first; i < j->y->size(); i += j->step) {
+    const vector<double> &y = (*j->y)[i];
+    int n = static_cast<int>(min(x.size(), y.size()));
+    (*j->results)[i] = j->fitter->fit(n, (n > 0 ? &x[0] : 0), (n > 0 ? &y[0] : 0), j->fracErr);
+  }
+  return 0;
+}
+
+// ----------------------------------------------------------------------
+void PixGainPedestalFit::fit(const vector<double> &x, const vector<vector<double> > &y,
+                             vector<result> &results, double fracErr, int nthreads) {
+  results.resize(y.size());
+#ifndef WIN32
+  if (nthreads < 1) nthreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+#else
+  nthreads = 1;
+#endif
+  nthreads = max(1, min(nthreads, static_cast<int>(y.size())));
+
+  // -- every thread writes the results of its own pixels, no locking needed
+  vector<job> jobs(nthreads);
+  for (int t = 0; t < nthreads; ++t) {
+    jobs[t].fitter = this;
+    jobs[t].x = &x;
+    jobs[t].y = &y;
+    jobs[t].results = &results;
+    jobs[t].fracErr = fracErr;
+    jobs[t].first = t;
+    jobs[t].step = nthreads;
+  }
+  if (nthreads == 1) {
+    fitJob(&jobs[0]);
+    return;
+  }
+
+#ifndef WIN32
+  vector<pthread_t> threads(nthreads);
+  for (int t = 0; t < nthreads; ++t) pthread_create(&threads[t], 0, PixGainPedestalFit::fitJob, &jobs[t]);
+  for (int t = 0; t < nthreads; ++t) pthread_join(threads[t], 0);
+#endif
+}
@@ -0,0 +1,60 @@
+#ifndef PIXGAINPEDESTALFIT_H
+#define PIXGAINPEDESTALFIT_H
+
+#include "pxardllexport.h"
+
+#include <vector>
+
+// ----------------------------------------------------------------------
+// ROOT-free fits of the gain/pedestal curves of many pixels at once. The
+// models are those of PixInitFunc (and PHCalibration):
+//   mode 0: p3*(erf((x-p0)/p1) + p2)      (PixInitFunc::gpErr)
+//   mode 1: p3 + p2*tanh(p0*x - p1)       (PixInitFunc::gpTanH)
+// with the same starting values and parameter limits. The chi2 is
+// minimized with Levenberg-Marquardt, the pixels are distributed over a
+// pool of threads. Every pixel is fitted independently, so the results do
+// not depend on the number of threads.
+// ----------------------------------------------------------------------
+class DLLEXPORT PixGainPedestalFit {
+public:
+  struct result {
+    double par[4], err[4];
+    double chi2;
+    int    ndf;
+    bool   ok;   ///< false if the pixel has no data
+  };
+
+  PixGainPedestalFit(int mode = 0);
+  ~PixGainPedestalFit();
+
+  /// x: VCAL values (low range units) of the points, shared by all pixels.
+  /// y: per pixel the pulse heights at x, relative error fracErr, points with y == 0 are ignored
+  void fit(const std::vector<double> &x, const std::vector<std::vector<double> > &y,
+           std::vector<result> &results, double fracErr = 0.05, int nthreads = 0);
+  /// fit a single pixel, n points
+  result fit(int n, const double *x, const double *y, double fracErr = 0.05) const;
+
+  double eval(const double *par, double x) const;
+  double integral(const double *par, double a, double b) const;
+
+private:
+  void   gradient(const double *par, double x, double *df) const;
+  void   init(int n, const double *x, const double *y, double *par, double *parlo, double *parhi) const;
+  void   linear(int n, const double *x, const double *y, const double *w,
+                double *par, const double *parlo, const double *parhi) const;
+
+  int    fMode;
+  int    fMaxIterations;
+
+  struct job {
+    const PixGainPedestalFit *fitter;
+    const std::vector<double> *x;
+    const std::vector<std::vector<double> > *y;
+    std::vector<result> *results;
+    double fracErr;
+    int first, step;
+  };
+  static void* fitJob(void *arg);
+};
+
+#endif
@@ -8,7 +8,10 @@
 #include "timer.h"
 #include "helper.h"
 #include "dictionaries.h"
+#include "scancache.h"
+#include "repack.h"
 #include <algorithm>
+#include <set>
 #include <fstream>
 #include <cmath>
 #include "constants.h"
@@ -17,9 +20,14 @@
 using namespace pxar;
 
 pxarCore::pxarCore(std::string usbId, std::string logLevel) : 
+  _cache_lastscan(0),
+  _cache_repeat(0),
+  _statistics(),
   _daq_running(false), 
   _daq_buffersize(DTB_SOURCE_BUFFER_SIZE),
-  _daq_startstop_warning(false)
+  _daq_startstop_warning(false),
+  _nios_i2caddresses(),
+  _nios_generation()
 {
 
   LOG(logQUIET) << "Instanciating API for " << PACKAGE_STRING;
@@ -33,9 +41,13 @@ pxarCore::pxarCore(std::string usbId, std::string logLevel) :
 
   // Get the DUT up and running:
   _dut = new dut();
+
+  // Scan result cache, disabled until a budget is set:
+  _cache = new scanCache();
 }
 
 pxarCore::~pxarCore() {
+  delete _cache;
   delete _dut;
   delete _hal;
 }
@@ -425,6 +437,14 @@ bool pxarCore::programDUT() {
   // First thing to do: startup DUT power if not yet done
   _hal->Pon();
 
+  // Forget about the trim configuration stored in the NIOS, it will be
+  // transmitted again before the next test:
+  _nios_i2caddresses.clear();
+  _nios_generation.clear();
+
+  // Results of scans before (re-)programming are not valid anymore:
+  _cache->clear();
+
   // Start programming the devices here!
 
   std::vector<tbmConfig> enabledTbms = _dut->getEnabledTbms();
@@ -561,14 +581,17 @@ double pxarCore::getTBvd() {
 
 void pxarCore::HVoff() {
   _hal->HVoff();
+  _cache->clear();
 }
 
 void pxarCore::HVon() {
   _hal->HVon();
+  _cache->clear();
 }
 
 void pxarCore::Poff() {
   _hal->Poff();
+  _cache->clear();
   // Reset the programmed state of the DUT (lost by turning off power)
   _dut->_programmed = false;
 }
@@ -663,8 +686,37 @@ std::vector<uint16_t> pxarCore::daqADC(std::string signalName, uint8_t gain, uin
 
 statistics pxarCore::getStatistics() {
   LOG(logDEBUG) << "Fetched DAQ statistics. Counters are being reset now.";
-  // Return the accumulated number of decoding errors:
-  return _hal->daqStatistics();
+  // Return the accumulated number of decoding errors, including those of scans from the cache:
+  statistics errors = _hal->daqStatistics();
+  errors += _statistics;
+  _statistics = statistics();
+  return errors;
+}
+
+timingStatistics pxarCore::getTiming() {
+  // Combine the HAL phases with the repacking time:
+  timingStatistics timing = _hal->daqTiming();
+  timing += _timing;
+  _timing.clear();
+  return timing;
+}
+
+void pxarCore::setScanCache(uint32_t memoryMB, std::string directory, uint32_t diskMB) {
+  _cache->setBudget(static_cast<size_t>(memoryMB) << 20, directory, static_cast<size_t>(diskMB) << 20);
+  if(memoryMB > 0) {
+    LOG(logINFO) << "Scan cache enabled: " << memoryMB << " MB memory"
+		 << (diskMB > 0 && !directory.empty() ? ", overflow to " + directory : "") << ".";
+  }
+  else { LOG(logDEBUGAPI) << "Scan cache disabled."; }
+}
+
+void pxarCore::clearScanCache() {
+  if(_cache->enabled()) {
+    LOG(logDEBUGAPI) << "Clearing scan cache (" << _cache->hits() << " hits, " << _cache->misses() << " misses so far).";
+  }
+  _cache->clear();
+  _cache_lastscan = 0;
+  _cache_repeat = 0;
 }
 
   
@@ -867,7 +919,9 @@ std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getPulseheightV
   // check if the flags indicate that the user explicitly asks for serial execution of test:
   std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, false, flags);
   // repack data into the expected return format
+  timer trepack;
   std::vector< std::pair<uint8_t, std::vector<pixel> > > result = repackDacScanData(data,dacStep,dacMin,dacMax,flags);
+  _timing.m_repack += trepack.getMicroseconds();
 
   // Reset the original value for the scanned DAC:
   std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
@@ -923,7 +977,9 @@ std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getEfficiencyVs
   // check if the flags indicate that the user explicitly asks for serial execution of test:
   std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, true, flags);
   // repack data into the expected return format
+  timer trepack;
   std::vector< std::pair<uint8_t, std::vector<pixel> > > result = repackDacScanData(data,dacStep,dacMin,dacMax,flags);
+  _timing.m_repack += trepack.getMicroseconds();
 
   // Reset the original value for the scanned DAC:
   std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
@@ -1008,7 +1064,9 @@ std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::getThresholdVsD
   // check if the flags indicate that the user explicitly asks for serial execution of test:
   std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, true, flags);
   // repack data into the expected return format
+  timer trepack;
   std::vector< std::pair<uint8_t, std::vector<pixel> > > result = repackThresholdDacScanData(data,dac1step,dac1min,dac1max,dac2step,dac2min,dac2max,threshold,nTriggers,flags);
+  _timing.m_repack += trepack.getMicroseconds();
 
   // Reset the original value for the scanned DAC:
   std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
@@ -1082,7 +1140,9 @@ std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxar
   // check if the flags indicate that the user explicitly asks for serial execution of test:
   std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, false, flags);
   // repack data into the expected return format
+  timer trepack;
   std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > result = repackDacDacScanData(data,dac1step,dac1min,dac1max,dac2step,dac2min,dac2max,flags);
+  _timing.m_repack += trepack.getMicroseconds();
 
   // Reset the original value for the scanned DAC:
   std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
@@ -1155,7 +1215,9 @@ std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxar
   // check if the flags indicate that the user explicitly asks for serial execution of test:
   std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, true, flags);
   // repack data into the expected return format
+  timer trepack;
   std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > result = repackDacDacScanData(data,dac1step,dac1min,dac1max,dac2step,dac2min,dac2max,flags);
+  _timing.m_repack += trepack.getMicroseconds();
 
   // Reset the original value for the scanned DAC:
   std::vector<rocConfig> enabledRocs = _dut->getEnabledRocs();
@@ -1171,6 +1233,233 @@ std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxar
   return result;
 }
 
+namespace {
+  // Measured points of an adaptive DAC-DAC scan, keyed by (DAC1, DAC2):
+  typedef std::map<std::pair<uint8_t, uint8_t>, std::vector<pixel> > dacDacSamples;
+
+  // Cell of an adaptive DAC-DAC scan, all four corners are measured:
+  struct dacDacCell {
+    dacDacCell(int xlo, int xhi, int ylo, int yhi) : x0(xlo), x1(xhi), y0(ylo), y1(yhi) {}
+    int x0, x1, y0, y1;
+  };
+
+  // Pixel values at the corners (x0,y0), (x1,y0), (x0,y1), (x1,y1) of a cell,
+  // keyed by ROC/column/row. Pixels without entry at a corner have value 0.
+  std::map<uint32_t, std::vector<double> > dacDacCornerValues(const dacDacSamples &samples, const dacDacCell &cell) {
+    std::map<uint32_t, std::vector<double> > values;
+    int x[4] = {cell.x0, cell.x1, cell.x0, cell.x1};
+    int y[4] = {cell.y0, cell.y0, cell.y1, cell.y1};
+    for(size_t i = 0; i < 4; i++) {
+      dacDacSamples::const_iterator point = samples.find(std::make_pair(static_cast<uint8_t>(x[i]), static_cast<uint8_t>(y[i])));
+      if(point == samples.end()) continue;
+      for(std::vector<pixel>::const_iterator px = point->second.begin(); px != point->second.end(); ++px) {
+	pixel p = *px;
+	std::vector<double> &v = values[(static_cast<uint32_t>(p.roc()) << 16) | (static_cast<uint32_t>(p.column()) << 8) | p.row()];
+	if(v.empty()) v.resize(4, 0.);
+	v[i] += p.value();
+      }
+    }
+    return values;
+  }
+
+  // DAC-DAC points of an adaptive scan which still have to be measured:
+  typedef std::set<std::pair<int, int> > dacDacPoints;
+
+  // Split the sorted values into runs of equal spacing, as (first, last, step):
+  std::vector<std::pair<std::pair<int, int>, int> > dacDacRuns(const std::vector<int> &values) {
+    std::vector<std::pair<std::pair<int, int>, int> > runs;
+    for(size_t i = 0; i < values.size(); ) {
+      size_t j = i + 1;
+      int step = (j < values.size() ? values[j] - values[i] : 1);
+      while(j < values.size() && values[j] - values[j-1] == step) { j++; }
+      runs.push_back(std::make_pair(std::make_pair(values[i], values[j-1]), step));
+      i = j;
+    }
+    return runs;
+  }
+
+  // Measure all points which are not known yet with as few stepped DAC-DAC scans
+  // as possible, without measuring any point twice: the DAC2 values of every DAC1
+  // value are split into runs of equal spacing, equal runs at equally spaced DAC1
+  // values are measured in one scan. Returns the number of scans.
+  size_t dacDacScan(pxarCore *api, bool efficiency, std::string dac1name, std::string dac2name,
+		    const dacDacPoints &points, uint16_t flags, uint16_t nTriggers, dacDacSamples &samples) {
+
+    std::map<int, std::vector<int> > columns;
+    for(dacDacPoints::const_iterator p = points.begin(); p != points.end(); ++p) {
+      if(samples.find(std::make_pair(static_cast<uint8_t>(p->first), static_cast<uint8_t>(p->second))) != samples.end()) continue;
+      columns[p->first].push_back(p->second);
+    }
+
+    std::map<std::pair<std::pair<int, int>, int>, std::vector<int> > rows;
+    for(std::map<int, std::vector<int> >::iterator col = columns.begin(); col != columns.end(); ++col) {
+      std::vector<std::pair<std::pair<int, int>, int> > runs = dacDacRuns(col->second);
+      for(size_t i = 0; i < runs.size(); i++) { rows[runs[i]].push_back(col->first); }
+    }
+
+    size_t nscans = 0;
+    for(std::map<std::pair<std::pair<int, int>, int>, std::vector<int> >::iterator row = rows.begin(); row != rows.end(); ++row) {
+      std::vector<std::pair<std::pair<int, int>, int> > runs = dacDacRuns(row->second);
+      for(size_t i = 0; i < runs.size(); i++) {
+	uint8_t dac1min = static_cast<uint8_t>(runs[i].first.first), dac1max = static_cast<uint8_t>(runs[i].first.second), dac1step = static_cast<uint8_t>(runs[i].second);
+	uint8_t dac2min = static_cast<uint8_t>(row->first.first.first), dac2max = static_cast<uint8_t>(row->first.first.second), dac2step = static_cast<uint8_t>(row->first.second);
+	std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > data;
+	if(efficiency) { data = api->getEfficiencyVsDACDAC(dac1name, dac1step, dac1min, dac1max, dac2name, dac2step, dac2min, dac2max, flags, nTriggers); }
+	else { data = api->getPulseheightVsDACDAC(dac1name, dac1step, dac1min, dac1max, dac2name, dac2step, dac2min, dac2max, flags, nTriggers); }
+	for(std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > >::iterator point = data.begin(); point != data.end(); ++point) {
+	  samples[std::make_pair(point->first, point->second.first)] = point->second.second;
+	}
+	nscans++;
+      }
+    }
+    return nscans;
+  }
+}
+
+std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxarCore::getPulseheightVsDACDACAdaptive(std::string dac1name, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2min, uint8_t dac2max, uint8_t coarseStep, uint16_t threshold, uint16_t flags, uint16_t nTriggers, std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > *dense) {
+  return adaptiveDacDacScan(false, dac1name, dac1min, dac1max, dac2name, dac2min, dac2max, coarseStep, threshold, flags, nTriggers, dense);
+}
+
+std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxarCore::getEfficiencyVsDACDACAdaptive(std::string dac1name, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2min, uint8_t dac2max, uint8_t coarseStep, uint16_t threshold, uint16_t flags, uint16_t nTriggers, std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > *dense) {
+  return adaptiveDacDacScan(true, dac1name, dac1min, dac1max, dac2name, dac2min, dac2max, coarseStep, threshold, flags, nTriggers, dense);
+}
+
+std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxarCore::adaptiveDacDacScan(bool efficiency, std::string dac1name, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2min, uint8_t dac2max, uint8_t coarseStep, uint16_t threshold, uint16_t flags, uint16_t nTriggers, std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > *dense) {
+
+  std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > result;
+  if(dense) { dense->clear(); }
+  if(!status()) {return result;}
+
+  // Check DAC ranges
+  if(dac1min > dac1max) {
+    // Swapping the range:
+    LOG(logWARNING) << "Swapping upper and lower bound.";
+    uint8_t temp = dac1min;
+    dac1min = dac1max;
+    dac1max = temp;
+  }
+  if(dac2min > dac2max) {
+    // Swapping the range:
+    LOG(logWARNING) << "Swapping upper and lower bound.";
+    uint8_t temp = dac2min;
+    dac2min = dac2max;
+    dac2max = temp;
+  }
+
+  // Get the register number and check the range from dictionary:
+  uint8_t dac1register, dac2register;
+  if(!verifyRegister(dac1name, dac1register, dac1max, ROC_REG)) { return result; }
+  if(!verifyRegister(dac2name, dac2register, dac2max, ROC_REG)) { return result; }
+  if(coarseStep < 1) { coarseStep = 1; }
+
+  dacDacSamples samples;
+  size_t nscans = 0;
+
+  // Coarse grid: every coarseStep DAC values plus the upper end of the ranges:
+  std::vector<int> grid1, grid2;
+  for(int dac = dac1min; dac <= dac1max; dac += coarseStep) { grid1.push_back(dac); }
+  for(int dac = dac2min; dac <= dac2max; dac += coarseStep) { grid2.push_back(dac); }
+  if(grid1.back() < dac1max) { grid1.push_back(dac1max); }
+  if(grid2.back() < dac2max) { grid2.push_back(dac2max); }
+  dacDacPoints points;
+  for(size_t i = 0; i < grid1.size(); i++) {
+    for(size_t j = 0; j < grid2.size(); j++) { points.insert(std::make_pair(grid1[i], grid2[j])); }
+  }
+  nscans += dacDacScan(this, efficiency, dac1name, dac2name, points, flags, nTriggers, samples);
+
+  std::vector<dacDacCell> cells, leaves;
+  for(size_t i = 0; i+1 < std::max(grid1.size(), static_cast<size_t>(2)); i++) {
+    for(size_t j = 0; j+1 < std::max(grid2.size(), static_cast<size_t>(2)); j++) {
+      cells.push_back(dacDacCell(grid1[i], grid1[std::min(i+1, grid1.size()-1)], grid2[j], grid2[std::min(j+1, grid2.size()-1)]));
+    }
+  }
+
+  // Split all cells in which any pixel changes by more than the threshold, level by level.
+  // The new corners of all cells of a level are measured together:
+  while(!cells.empty()) {
+    std::vector<dacDacCell> next;
+    points.clear();
+    for(std::vector<dacDacCell>::iterator cell = cells.begin(); cell != cells.end(); ++cell) {
+      int w1 = cell->x1 - cell->x0, w2 = cell->y1 - cell->y0;
+      bool split = false;
+      if(w1 > 1 || w2 > 1) {
+	std::map<uint32_t, std::vector<double> > values = dacDacCornerValues(samples, *cell);
+	for(std::map<uint32_t, std::vector<double> >::iterator v = values.begin(); v != values.end(); ++v) {
+	  if(*std::max_element(v->second.begin(), v->second.end()) - *std::min_element(v->second.begin(), v->second.end()) > threshold) {
+	    split = true;
+	    break;
+	  }
+	}
+      }
+      if(!split) {
+	leaves.push_back(*cell);
+	continue;
+      }
+
+      // Split at the middle, cells of odd width into two unequal halves:
+      std::vector<int> x, y;
+      x.push_back(cell->x0);
+      if(w1 > 1) { x.push_back(cell->x0 + w1/2); }
+      x.push_back(cell->x1);
+      y.push_back(cell->y0);
+      if(w2 > 1) { y.push_back(cell->y0 + w2/2); }
+      y.push_back(cell->y1);
+      for(size_t i = 0; i < x.size(); i++) {
+	for(size_t j = 0; j < y.size(); j++) { points.insert(std::make_pair(x[i], y[j])); }
+      }
+      for(size_t i = 0; i+1 < x.size(); i++) {
+	for(size_t j = 0; j+1 < y.size(); j++) { next.push_back(dacDacCell(x[i], x[i+1], y[j], y[j+1])); }
+      }
+    }
+    nscans += dacDacScan(this, efficiency, dac1name, dac2name, points, flags, nTriggers, samples);
+    cells.swap(next);
+  }
+
+  size_t nPoints = static_cast<size_t>(dac1max - dac1min + 1)*(dac2max - dac2min + 1);
+  LOG(logDEBUGAPI) << "Adaptive DAC-DAC scan measured " << samples.size() << " of " << nPoints
+		   << " points in " << nscans << " scans, " << leaves.size() << " cells.";
+
+  for(dacDacSamples::iterator point = samples.begin(); point != samples.end(); ++point) {
+    result.push_back(std::make_pair(point->first.first, std::make_pair(point->first.second, point->second)));
+  }
+  if(!dense) { return result; }
+
+  // Dense view: measured points as they are, all others interpolated from the corners of their cell:
+  size_t n2 = static_cast<size_t>(dac2max - dac2min + 1);
+  std::vector< std::vector<pixel> > plane(nPoints);
+  std::vector<bool> filled(nPoints, false);
+  for(dacDacSamples::iterator point = samples.begin(); point != samples.end(); ++point) {
+    size_t idx = (point->first.first - dac1min)*n2 + (point->first.second - dac2min);
+    plane[idx] = point->second;
+    filled[idx] = true;
+  }
+  for(std::vector<dacDacCell>::iterator cell = leaves.begin(); cell != leaves.end(); ++cell) {
+    std::map<uint32_t, std::vector<double> > values = dacDacCornerValues(samples, *cell);
+    for(int dac1 = cell->x0; dac1 <= cell->x1; dac1++) {
+      for(int dac2 = cell->y0; dac2 <= cell->y1; dac2++) {
+	size_t idx = (dac1 - dac1min)*n2 + (dac2 - dac2min);
+	if(filled[idx]) continue;
+	filled[idx] = true;
+	double t1 = (cell->x1 > cell->x0 ? static_cast<double>(dac1 - cell->x0)/(cell->x1 - cell->x0) : 0.);
+	double t2 = (cell->y1 > cell->y0 ? static_cast<double>(dac2 - cell->y0)/(cell->y1 - cell->y0) : 0.);
+	for(std::map<uint32_t, std::vector<double> >::iterator v = values.begin(); v != values.end(); ++v) {
+	  double value = (1.-t1)*(1.-t2)*v->second[0] + t1*(1.-t2)*v->second[1] + (1.-t1)*t2*v->second[2] + t1*t2*v->second[3];
+	  if(fabs(value) < 0.5) continue;
+	  plane[idx].push_back(pixel(static_cast<uint8_t>(v->first >> 16), static_cast<uint8_t>((v->first >> 8) & 0xff), static_cast<uint8_t>(v->first & 0xff),
+				     value > 0 ? value + 0.5 : value - 0.5));
+	}
+      }
+    }
+  }
+  for(int dac1 = dac1min; dac1 <= dac1max; dac1++) {
+    for(int dac2 = dac2min; dac2 <= dac2max; dac2++) {
+      dense->push_back(std::make_pair(static_cast<uint8_t>(dac1), std::make_pair(static_cast<uint8_t>(dac2), plane[(dac1 - dac1min)*n2 + (dac2 - dac2min)])));
+    }
+  }
+
+  return result;
+}
+
 std::vector<pixel> pxarCore::getPulseheightMap(uint16_t flags, uint16_t nTriggers) {
 
   if(!status()) {return std::vector<pixel>();}
@@ -1190,7 +1479,9 @@ std::vector<pixel> pxarCore::getPulseheightMap(uint16_t flags, uint16_t nTrigger
   std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, false, flags);
 
   // Repacking of all data segments into one long map vector:
+  timer trepack;
   std::vector<pixel> result = repackMapData(data, flags);
+  _timing.m_repack += trepack.getMicroseconds();
 
   return result;
 }
@@ -1214,7 +1505,9 @@ std::vector<pixel> pxarCore::getEfficiencyMap(uint16_t flags, uint16_t nTriggers
   std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, true, flags);
 
   // Repacking of all data segments into one long map vector:
+  timer trepack;
   std::vector<pixel> result = repackMapData(data, flags);
+  _timing.m_repack += trepack.getMicroseconds();
 
   return result;
 }
@@ -1268,7 +1561,9 @@ std::vector<pixel> pxarCore::getThresholdMap(std::string dacName, uint8_t dacSte
   std::vector<Event> data = expandLoop(pixelfn, multipixelfn, rocfn, multirocfn, param, true, flags);
 
   // Repacking of all data segments into one long map vector:
+  timer trepack;
   std::vector<pixel> result = repackThresholdMapData(data, dacStep, dacMin, dacMax, threshold, nTriggers, flags);
+  _timing.m_repack += trepack.getMicroseconds();
 
   return result;
 }
@@ -1556,6 +1851,49 @@ std::vector<Event> pxarCore::daqGetEventBuffer() {
   return _hal->daqAllEvents();
 }
 
+uint32_t pxarCore::daqDrainEventBuffer() {
+
+  // Reading out all data from the DTB, only the decoding statistics are kept:
+  return _hal->daqDrainEvents();
+}
+
+void pxarCore::daqHotPixelMonitor(uint32_t threshold) {
+  _hal->daqHotPixelMonitor(threshold);
+}
+
+std::vector<std::pair<pixel,double> > pxarCore::daqGetHotPixels() {
+  return _hal->daqHotPixels();
+}
+
+std::vector<std::pair<pixel,double> > pxarCore::daqGetNewHotPixels() {
+  return _hal->daqHotPixels(true);
+}
+
+uint32_t pxarCore::daqGetHotPixelEvents() {
+  return _hal->daqHotPixelEvents();
+}
+
+uint32_t pxarCore::daqMaskHotPixels() {
+
+  uint32_t masked = 0;
+  std::vector<std::pair<pixel,double> > hot = _hal->daqHotPixels();
+  for(std::vector<std::pair<pixel,double> >::iterator it = hot.begin(); it != hot.end(); ++it) {
+    // The token chains are counted over all configured ROCs, so the ROC id of
+    // decoded pixels already is the index of the ROC in the DUT:
+    size_t rocid = it->first.roc();
+    if(rocid >= _dut->roc.size()) continue;
+    std::vector<pixelConfig>::iterator px = std::find_if(_dut->roc.at(rocid).pixels.begin(),
+							 _dut->roc.at(rocid).pixels.end(),
+							 findPixelXY(it->first.column(),it->first.row()));
+    if(px == _dut->roc.at(rocid).pixels.end() || px->mask()) continue;
+    LOG(logDEBUGAPI) << "Masking hot pixel " << it->first << " (" << it->second << " hits/event)";
+    _dut->maskPixel(it->first.column(),it->first.row(),true,rocid);
+    masked++;
+  }
+  LOG(logDEBUGAPI) << "Masked " << masked << " hot pixels.";
+  return masked;
+}
+
 Event pxarCore::daqGetEvent() {
 
   // Return the next decoded Event from the FIFO buffer.
@@ -1611,7 +1949,30 @@ bool pxarCore::daqStop(const bool init) {
 
 std::vector<Event> pxarCore::expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPixelParallel multipixelfn, HalMemFnRocSerial rocfn, HalMemFnRocParallel multirocfn, std::vector<int32_t> param, bool efficiency, uint16_t flags) {
 
+  // Return the data of an identical scan with the same DUT configuration if cached:
+  uint64_t cachekey = 0;
+  if(_cache->enabled()) {
+    // Directly repeated identical scans are separate measurements, the repetition is part of the key:
+    uint64_t scankey = scanCacheKey(pixelfn, multipixelfn, rocfn, multirocfn, param, efficiency, flags);
+    if(scankey == _cache_lastscan) { _cache_repeat++; }
+    else { _cache_repeat = 0; }
+    _cache_lastscan = scankey;
+    scanHash hash;
+    hash.add(scankey);
+    hash.add(_cache_repeat);
+    cachekey = hash.value();
+
+    std::vector<Event> cached;
+    statistics stats;
+    if(_cache->get(cachekey, cached, stats)) {
+      LOG(logINFO) << "Test result taken from scan cache (" << cached.size() << " events).";
+      _statistics += stats;
+      return cached;
+    }
+  }
+
   // Ensure the pattern generator trigger is active:
+  timer tprogram;
   _hal->daqTriggerSource(TRG_SEL_PG_DIR);
   
   // pointer to vector to hold our data
@@ -1642,6 +2003,7 @@ std::vector<Event> pxarCore::expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPix
   else if((flags & FLAG_FORCE_SERIAL) != 0) { MaskAndTrim(false); }
   // Else just trim all the pixels:
   else { MaskAndTrim(true); }
+  _timing.m_program += tprogram.getMicroseconds();
 
   // Check if we might use parallel routine on whole module: more than one ROC
   // must be enabled and parallel execution not disabled by user
@@ -1706,7 +2068,11 @@ std::vector<Event> pxarCore::expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPix
       for (std::vector<rocConfig>::iterator rocit = enabledRocs.begin(); rocit != enabledRocs.end(); ++rocit) {
 
 	// If we have serial execution make sure to trim the ROC if we requested forceUnmasked:
-	if(((flags & FLAG_FORCE_SERIAL) != 0) && ((flags & FLAG_FORCE_UNMASKED) != 0)) { MaskAndTrim(true,rocit); }
+	if(((flags & FLAG_FORCE_SERIAL) != 0) && ((flags & FLAG_FORCE_UNMASKED) != 0)) {
+	  timer ttrim;
+	  MaskAndTrim(true,rocit);
+	  _timing.m_program += ttrim.getMicroseconds();
+	}
 
 	// execute call to HAL layer routine and save returned data in buffer
 	std::vector<Event> rocdata = CALL_MEMBER_FN(*_hal,rocfn)(rocit->i2c_address, efficiency, param);
@@ -1770,16 +2136,83 @@ std::vector<Event> pxarCore::expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPix
   if (data.empty()){ LOG(logCRITICAL) << "NO DATA FROM TEST FUNCTION -- are any TBMs/ROCs/PIXs enabled?!"; }
   
   // Test is over, mask the whole device again and clear leftover calibrate signals:
+  timer tmask;
   MaskAndTrim(false);
   SetCalibrateBits(false);
+  _timing.m_program += tmask.getMicroseconds();
 
   // Print timer value:
   LOG(logINFO) << "Test took " << t << "ms.";
 
+  // Cache the data together with the decoding statistics of this scan, unless it had errors:
+  if(_cache->enabled()) {
+    statistics stats = _hal->daqStatistics();
+    _statistics += stats;
+    if(!data.empty() && stats.errors() == 0) { _cache->put(cachekey, data, stats); }
+  }
   return data;
 } // expandLoop()
 
-std::vector<pixel> pxarCore::repackMapData(std::vector<Event> &data, uint16_t flags) {
+uint64_t pxarCore::scanCacheKey(HalMemFnPixelSerial pixelfn, HalMemFnPixelParallel multipixelfn, HalMemFnRocSerial rocfn, HalMemFnRocParallel multirocfn, std::vector<int32_t> &param, bool efficiency, uint16_t flags) {
+
+  scanHash hash;
+
+  // The test routines and their parameters:
+  hash.add(&pixelfn, sizeof(pixelfn));
+  hash.add(&multipixelfn, sizeof(multipixelfn));
+  hash.add(&rocfn, sizeof(rocfn));
+  hash.add(&multirocfn, sizeof(multirocfn));
+  for(std::vector<int32_t>::iterator p = param.begin(); p != param.end(); ++p) { hash.add(*p); }
+  hash.add(efficiency);
+  hash.add(flags);
+
+  // The ROC configurations including all pixels:
+  for(std::vector<rocConfig>::iterator rocit = _dut->roc.begin(); rocit != _dut->roc.end(); ++rocit) {
+    hash.add(rocit->enable());
+    hash.add(rocit->i2c_address);
+    hash.add(rocit->type);
+    for(std::map<uint8_t,uint8_t>::iterator dac = rocit->dacs.begin(); dac != rocit->dacs.end(); ++dac) {
+      hash.add(dac->first);
+      hash.add(dac->second);
+    }
+    for(std::vector<pixelConfig>::iterator px = rocit->pixels.begin(); px != rocit->pixels.end(); ++px) {
+      uint8_t pix[4] = {px->column(), px->row(), px->trim(), static_cast<uint8_t>((px->mask() ? 1 : 0) | (px->enable() ? 2 : 0))};
+      hash.add(pix, sizeof(pix));
+    }
+  }
+
+  // The TBM configurations:
+  for(std::vector<tbmConfig>::iterator tbmit = _dut->tbm.begin(); tbmit != _dut->tbm.end(); ++tbmit) {
+    hash.add(tbmit->enable);
+    hash.add(tbmit->type);
+    hash.add(tbmit->hubid);
+    hash.add(tbmit->core);
+    for(std::map<uint8_t,uint8_t>::iterator dac = tbmit->dacs.begin(); dac != tbmit->dacs.end(); ++dac) {
+      hash.add(dac->first);
+      hash.add(dac->second);
+    }
+    for(std::vector<uint8_t>::iterator chain = tbmit->tokenchains.begin(); chain != tbmit->tokenchains.end(); ++chain) { hash.add(*chain); }
+  }
+
+  // The testboard settings:
+  for(std::map<uint8_t,uint8_t>::iterator sig = _dut->sig_delays.begin(); sig != _dut->sig_delays.end(); ++sig) {
+    hash.add(sig->first);
+    hash.add(sig->second);
+  }
+  hash.add(_dut->va);
+  hash.add(_dut->vd);
+  hash.add(_dut->ia);
+  hash.add(_dut->id);
+  for(std::vector<std::pair<uint16_t,uint8_t> >::iterator pg = _dut->pg_setup.begin(); pg != _dut->pg_setup.end(); ++pg) {
+    hash.add(pg->first);
+    hash.add(pg->second);
+  }
+  hash.add(_dut->trigger_source);
+
+  return hash.value();
+}
+
+std::vector<pixel> pxar::repackMapData(std::vector<Event> &data, uint16_t flags) {
 
   // Keep track of the pixel to be expected:
   uint8_t expected_column = 0, expected_row = 0;
@@ -1831,7 +2264,7 @@ std::vector<pixel> pxarCore::repackMapData(std::vector<Event> &data, uint16_t fl
   return result;
 }
 
-std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::repackDacScanData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags){
+std::vector< std::pair<uint8_t, std::vector<pixel> > > pxar::repackDacScanData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags){
 
   // Keep track of the pixel to be expected:
   uint8_t expected_column = 0, expected_row = 0;
@@ -1900,7 +2333,7 @@ std::vector< std::pair<uint8_t, std::vector<pixel> > > pxarCore::repackDacScanDa
   return result;
 }
 
-std::vector<pixel> pxarCore::repackThresholdMapData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags) {
+std::vector<pixel> pxar::repackThresholdMapData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags) {
 
   std::vector<pixel> result;
   // Vector of pixels for which a threshold has already been found
@@ -2003,7 +2436,7 @@ std::vector<pixel> pxarCore::repackThresholdMapData (std::vector<Event> &data, u
   return result;
 }
 
-std::vector<std::pair<uint8_t,std::vector<pixel> > > pxarCore::repackThresholdDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags) {
+std::vector<std::pair<uint8_t,std::vector<pixel> > > pxar::repackThresholdDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags) {
 
   std::vector<std::pair<uint8_t,std::vector<pixel> > > result;
   // Map of pixels with already assigned threshold (key is the dac2 value):
@@ -2123,7 +2556,7 @@ std::vector<std::pair<uint8_t,std::vector<pixel> > > pxarCore::repackThresholdDa
   return result;
 }
 
-std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxarCore::repackDacDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t /*flags*/) {
+std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxar::repackDacDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t /*flags*/) {
   std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > result;
 
   // Measure time:
@@ -2179,12 +2612,26 @@ std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > pxar
 // Update mask and trim bits for the full DUT in NIOS structs:
 void pxarCore::MaskAndTrimNIOS() {
 
-  // First transmit all configured I2C addresses:
-  _hal->SetupI2CValues(_dut->getRocI2Caddr());
+  // First transmit all configured I2C addresses if they changed:
+  std::vector<uint8_t> i2caddresses = _dut->getRocI2Caddr();
+  if(i2caddresses != _nios_i2caddresses) {
+    _hal->SetupI2CValues(i2caddresses);
+    _nios_i2caddresses = i2caddresses;
+    // The NIOS trim storage is arranged by I2C address, transmit all ROCs again:
+    _nios_generation.clear();
+  }
   
-  // Now run over all existing ROCs and transmit the pixel trim/mask data:
+  // Now run over all existing ROCs and transmit the pixel trim/mask data
+  // for all ROCs which have been changed since the last transmission:
   for (std::vector<rocConfig>::iterator rocit = _dut->roc.begin(); rocit != _dut->roc.end(); ++rocit) {
+    size_t rocid = static_cast<size_t>(rocit - _dut->roc.begin());
+    std::map<size_t,uint32_t>::iterator gen = _nios_generation.find(rocid);
+    if(gen != _nios_generation.end() && gen->second == rocit->generation()) {
+      LOG(logDEBUGAPI) << "NIOS trimming & masking configuration for ROC@I2C " << static_cast<int>(rocit->i2c_address) << " unchanged.";
+      continue;
+    }
     _hal->SetupTrimValues(rocit->i2c_address,rocit->pixels);
+    _nios_generation[rocid] = rocit->generation();
   }
 }
 
@@ -2396,6 +2843,7 @@ uint32_t pxarCore::getPatternGeneratorDelaySum(std::vector<std::pair<uint16_t,ui
 bool pxarCore::setExternalClock(bool enable) {
 
   LOG(logDEBUGAPI) << "Setting clock to " << (enable ? "external" : "internal") << " source.";
+  _cache->clear();
   if(enable) {
     // Try to set the clock to external source:
     if(_hal->IsClockPresent()) { _hal->SetClockSource(CLK_SRC_EXT); return true; }
@@ -2420,6 +2868,7 @@ void pxarCore::setSignalMode(std::string signal, uint8_t mode, uint8_t speed) {
 
   if(mode == 3) { _hal->SigSetPRBS(sigRegister, speed); }
   else { _hal->SigSetMode(sigRegister, mode); }
+  _cache->clear();
 }
 
 void pxarCore::setSignalMode(std::string signal, std::string mode, uint8_t speed) {
@@ -2446,6 +2895,7 @@ void pxarCore::setClockStretch(uint8_t src, uint16_t delay, uint16_t width)
 {
   LOG(logDEBUGAPI) << "Set Clock Stretch " << static_cast<int>(src) << " " << static_cast<int>(delay) << " " << static_cast<int>(width);
   _hal->SetClockStretch(src,width,delay);
+  _cache->clear();
 
 }
 
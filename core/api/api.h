@@ -117,6 +117,10 @@ namespace pxar {
    */
   class hal;
 
+  /** Forward declaration, not including the header file!
+   */
+  class scanCache;
+
 
   /** Define typedefs to allow easy passing of member function
    *  addresses from the HAL class, used e.g. in loop expansion routines.
@@ -586,6 +590,41 @@ namespace pxar {
      */
     std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > getEfficiencyVsDACDAC(std::string dac1name, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags, uint16_t nTriggers);
 
+    /** Method to scan a 2D DAC-Range (DAC1 vs. DAC2) adaptively and measure
+     *  the pulse height
+     *
+     *  The plane is first sampled every "coarseStep" DAC values. A grid cell
+     *  in which the pulse height of any pixel differs by more than "threshold"
+     *  between its corners is split into four cells and the new corners are
+     *  measured, until the cells have size 1. The new corners of all cells of
+     *  one refinement level are measured together and every point only once.
+     *  Flat regions of the plane are therefore only measured on the coarse grid.
+     *
+     *  Returns the measured points in the format of getPulseheightVsDACDAC.
+     *  If "dense" is not NULL, it is filled with all points of the plane (step
+     *  size 1), the points which were not measured are interpolated bilinearly
+     *  from the corners of their cell.
+     *
+     *  If the readout of the DTB is corrupt, a pxar::DataMissingEvent is thrown.
+     *
+     */
+    std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > getPulseheightVsDACDACAdaptive(std::string dac1name, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2min, uint8_t dac2max, uint8_t coarseStep, uint16_t threshold, uint16_t flags, uint16_t nTriggers, std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > *dense = NULL);
+
+    /** Method to scan a 2D DAC-Range (DAC1 vs. DAC2) adaptively and measure
+     *  the efficiency
+     *
+     *  As getPulseheightVsDACDACAdaptive, cells are refined where the number
+     *  of hits of any pixel differs by more than "threshold" between the
+     *  corners, i.e. along the edges of the efficient region.
+     *
+     *  Returns the measured points in the format of getEfficiencyVsDACDAC,
+     *  "dense" (if not NULL) is filled with the interpolated full plane.
+     *
+     *  If the readout of the DTB is corrupt, a pxar::DataMissingEvent is thrown.
+     *
+     */
+    std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > getEfficiencyVsDACDACAdaptive(std::string dac1name, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2min, uint8_t dac2max, uint8_t coarseStep, uint16_t threshold, uint16_t flags, uint16_t nTriggers, std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > *dense = NULL);
+
     /** Method to get a map of the pulse height
      *
      *  Returns a vector of pixels, with the value of the pxar::pixel struct being
@@ -812,6 +851,53 @@ namespace pxar {
      */
     std::vector<Event> daqGetEventBuffer();
 
+    /** Function to decode the full currently available event buffer from the
+     *  testboard RAM without returning it. The data is split and decoded like
+     *  in pxarCore::daqGetEventBuffer(), but no pxar::Event objects are
+     *  stored, so memory usage does not grow with the number of events. Only
+     *  the decoding statistics (see pxarCore::getStatistics()) and the ROC
+     *  readback values are updated.
+     *
+     *  This is meant for tests which only check whether the data is clean,
+     *  e.g. timing and phase scans. Returns the number of events decoded,
+     *  no exception is thrown if there are none.
+     */
+    uint32_t daqDrainEventBuffer();
+
+    /** Function to enable the hot pixel monitor of the decoders. While it is
+     *  enabled, every decoded hit is counted per pixel, whether the events are
+     *  fetched with pxarCore::daqGetEventBuffer(), pxarCore::daqGetEvent() or
+     *  only drained with pxarCore::daqDrainEventBuffer(). Pixels are recorded
+     *  when they reach "threshold" hits. A threshold of 0 switches the monitor
+     *  off. The counters are reset by this call and by pxarCore::daqStart().
+     */
+    void daqHotPixelMonitor(uint32_t threshold);
+
+    /** Function to return the pixels which reached the threshold of the hot
+     *  pixel monitor, in the order in which they did. The pixel value holds
+     *  the number of hits (saturating at 32767), the second element the hits
+     *  per decoded event.
+     */
+    std::vector<std::pair<pixel,double> > daqGetHotPixels();
+
+    /** Function to return only the pixels which reached the threshold of the
+     *  hot pixel monitor since the last call of this function, of
+     *  pxarCore::daqGetHotPixels() or of pxarCore::daqMaskHotPixels(). Meant
+     *  to be polled during a DAQ run to get notified of new hot pixels.
+     */
+    std::vector<std::pair<pixel,double> > daqGetNewHotPixels();
+
+    /** Function to return the number of events counted by the hot pixel
+     *  monitor since it was enabled or since the last pxarCore::daqStart().
+     */
+    uint32_t daqGetHotPixelEvents();
+
+    /** Function to mask all pixels which reached the threshold of the hot
+     *  pixel monitor in the DUT. The masks are programmed with the next test
+     *  or DAQ start. Returns the number of newly masked pixels.
+     */
+    uint32_t daqMaskHotPixels();
+
     /** Function to return the full currently available ROC slow readback value
      *  buffer. The data is stored until a new DAQ session or test is called and
      *  can be fetched once (deleted at read time). The return vector contains
@@ -853,6 +939,44 @@ namespace pxar {
      */
     statistics getStatistics();
 
+    /** Function that returns a class object of the type pxar::timingStatistics
+     *  with the wall time spent in the trigger loops, the DTB readout, the
+     *  decoding, the trigger condensing and the repacking of all test calls
+     *  and DAQ readouts since the last call. Like getStatistics() the
+     *  counters are reset when fetched.
+     */
+    timingStatistics getTiming();
+
+    /** Enables the cache for the results of the test loops (all getXXX
+     *  scans). A scan which is repeated with the same parameters and the
+     *  same DUT configuration (DACs, trims, masks, enables, TBM registers,
+     *  signal delays, pattern generator and power settings) returns the
+     *  cached data without accessing the testboard.
+     *
+     *  memoryMB is the memory budget in MB, 0 disables the cache. Least
+     *  recently used results which exceed it are moved to files in the
+     *  given directory, up to diskMB MB. These files are removed when the
+     *  cache is cleared or the pxarCore object is destroyed.
+     *
+     *  Identical scans which directly follow each other (e.g. a scan split
+     *  into several runs with fewer triggers, or a retry after a readout
+     *  problem) are counted as repetitions and cached separately, each of
+     *  them is measured. Tests which repeat a scan with other scans in
+     *  between, and tests measuring hits from a source, beam or noise,
+     *  have to call clearScanCache() before the scan. Scans with decoding
+     *  errors are not cached.
+     *
+     *  The decoding statistics of a cached scan are stored with its data
+     *  and reported again by getStatistics() when it is taken from the cache.
+     */
+    void setScanCache(uint32_t memoryMB, std::string directory = "", uint32_t diskMB = 0);
+
+    /** Drops all cached scan results. This is done automatically for
+     *  changes of the testboard state which are not part of the DUT
+     *  configuration (HV, power, clock and signal settings).
+     */
+    void clearScanCache();
+
     /** DUT object for book keeping of settings
      */
     dut * _dut;
@@ -877,6 +1001,31 @@ namespace pxar {
      */
     hal * _hal;
 
+    /** Cache of the test loop results, see setScanCache()
+     */
+    scanCache * _cache;
+
+    /** Key of the last scan looked up in the cache and the number of
+     *  identical scans directly before it, part of the cache key
+     */
+    uint64_t _cache_lastscan;
+    uint32_t _cache_repeat;
+
+    /** Decoding statistics of the cached scans, added to the HAL statistics
+     *  by getStatistics()
+     */
+    statistics _statistics;
+
+    /** Hash of the test loop routines and parameters together with the full
+     *  DUT configuration, used as scan cache key
+     */
+    uint64_t scanCacheKey(HalMemFnPixelSerial pixelfn, HalMemFnPixelParallel multipixelfn, HalMemFnRocSerial rocfn, HalMemFnRocParallel multirocfn, std::vector<int32_t> &param, bool efficiency, uint16_t flags);
+
+    /** Time spent repacking the test data, the other phases are
+     *  accounted for by the HAL
+     */
+    timingStatistics _timing;
+
     /** Routine to loop over all active ROCs/pixels and call the
      *  appropriate pixel, ROC or module HAL methods for execution.
      *
@@ -887,28 +1036,10 @@ namespace pxar {
      */
     std::vector<Event> expandLoop(HalMemFnPixelSerial pixelfn, HalMemFnPixelParallel multipixelfn, HalMemFnRocSerial rocfn, HalMemFnRocParallel multirocfn, std::vector<int32_t> param, bool efficiency, uint16_t flags = 0);
     
-    /** Repacks map data from (possibly) several ROCs into one long vector
-     *  of pixels.
-     */
-    std::vector<pixel> repackMapData (std::vector<Event> &data, uint16_t flags);
-
-    /** Repacks map data from (possibly) several ROCs into one long vector
-     *  of pixels and returns the threshold value.
-     */
-    std::vector<pixel> repackThresholdMapData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags);
-
-    /** Repacks DAC scan data into pairs of DAC values with fired pxar::pixel vectors.
+    /** Adaptive DAC-DAC scan, common implementation of
+     *  getPulseheightVsDACDACAdaptive and getEfficiencyVsDACDACAdaptive
      */
-    std::vector< std::pair<uint8_t, std::vector<pixel> > > repackDacScanData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags);
-
-    /** Repacks DAC scan data into pairs of DAC values with fired pxar::pixel vectors and return the threshold value.
-     */
-    std::vector<std::pair<uint8_t,std::vector<pixel> > > repackThresholdDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags);
-
-    /** repacks (2D) DAC-DAC scan data into pairs of DAC values with
-     *  vectors of the fired pixels.
-     */
-    std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > repackDacDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags);
+    std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > adaptiveDacDacScan(bool efficiency, std::string dac1name, uint8_t dac1min, uint8_t dac1max, std::string dac2name, uint8_t dac2min, uint8_t dac2max, uint8_t coarseStep, uint16_t threshold, uint16_t flags, uint16_t nTriggers, std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > *dense);
 
     /** Helper function for conversion from string to register value
      *
@@ -1001,6 +1132,16 @@ namespace pxar {
 
     /** Warned the user about not initializing the DUT */
     bool _daq_startstop_warning;
+
+    /** I2C addresses last written to the NIOS storage
+     */
+    std::vector<uint8_t> _nios_i2caddresses;
+
+    /** Generation of the mask & trim configuration last written to the
+     *  NIOS trim storage, stored for every ROC id. ROCs with unchanged
+     *  generation are not transmitted again.
+     */
+    std::map<size_t,uint32_t> _nios_generation;
     
   }; // class pxarCore
 
@@ -357,6 +357,25 @@ namespace pxar {
     m_errors_pixel_buffer_corrupt = 0;
   }
 
+  void timingStatistics::dump() {
+    LOG(logINFO) << "Timing statistics (ms):";
+    LOG(logINFO) << "\t programming:   " << m_program/1000;
+    LOG(logINFO) << "\t trigger loops: " << m_loop/1000;
+    LOG(logINFO) << "\t readout:       " << m_readout/1000;
+    LOG(logINFO) << "\t decoding:      " << m_decode/1000;
+    LOG(logINFO) << "\t condensing:    " << m_condense/1000;
+    LOG(logINFO) << "\t repacking:     " << m_repack/1000;
+  }
+
+  void timingStatistics::clear() {
+    m_program = 0;
+    m_loop = 0;
+    m_readout = 0;
+    m_decode = 0;
+    m_condense = 0;
+    m_repack = 0;
+  }
+
   tbmConfig::tbmConfig(uint8_t tbmtype) : dacs(), type(tbmtype), hubid(31), core(0xE0), tokenchains(), enable(true) {
 
     if(tbmtype == 0x0) {
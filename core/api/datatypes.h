@@ -453,15 +453,22 @@ namespace pxar {
    */
   class DLLEXPORT rocConfig {
   public:
-  rocConfig() : pixels(), dacs(), type(0), _enable(true) {}
+  rocConfig() : pixels(), dacs(), type(0), _enable(true), _generation(0) {}
     std::vector< pixelConfig > pixels;
     std::map< uint8_t,uint8_t > dacs;
     uint8_t type;
     uint8_t i2c_address;
     bool enable() const { return _enable; }
     void setEnable(bool enable) { _enable = enable; }
+    /** Generation counter of the pixel mask & trim configuration. It is
+     *  incremented whenever a mask or trim bit of this ROC is changed and
+     *  allows to skip re-programming of unchanged ROCs.
+     */
+    uint32_t generation() const { return _generation; }
+    void incrementGeneration() { _generation++; }
   private:
     bool _enable;
+    uint32_t _generation;
   };
 
   /** Class for TBM states
@@ -659,5 +666,65 @@ namespace pxar {
     // Total number of pixels with row 80:
     uint32_t m_errors_pixel_buffer_corrupt;
   };
+
+  /** Class for the host-side wall time spent in the phases of the API tests
+   *
+   *  All times are accumulated in microseconds until they are fetched via
+   *  pxarCore::getTiming(). The readout phase covers waiting for and
+   *  transferring data from the DTB, the decode phase the splitting and
+   *  decoding of that data. The programming phase covers mask, trim, calibrate
+   *  and DAC programming as well as the setup of the DAQ session.
+   */
+  class DLLEXPORT timingStatistics {
+    /** Allow the HAL and the API to directly alter private members
+     */
+    friend class hal;
+    friend class pxarCore;
+
+  public:
+  timingStatistics() :
+    m_program(0),
+      m_loop(0),
+      m_readout(0),
+      m_decode(0),
+      m_condense(0),
+      m_repack(0)
+	{};
+    // Print all timing information:
+    void dump();
+    friend timingStatistics& operator+=(timingStatistics &lhs, const timingStatistics &rhs) {
+      lhs.m_program += rhs.m_program;
+      lhs.m_loop += rhs.m_loop;
+      lhs.m_readout += rhs.m_readout;
+      lhs.m_decode += rhs.m_decode;
+      lhs.m_condense += rhs.m_condense;
+      lhs.m_repack += rhs.m_repack;
+      return lhs;
+    };
+
+    uint64_t program() { return m_program; }
+    uint64_t loop() { return m_loop; }
+    uint64_t readout() { return m_readout; }
+    uint64_t decode() { return m_decode; }
+    uint64_t condense() { return m_condense; }
+    uint64_t repack() { return m_repack; }
+    uint64_t total() { return (m_program + m_loop + m_readout + m_decode + m_condense + m_repack); }
+  private:
+    // Clear all timing information:
+    void clear();
+
+    // Time spent programming the DUT and setting up the DAQ:
+    uint64_t m_program;
+    // Time spent in the trigger loop calls on the DTB:
+    uint64_t m_loop;
+    // Time spent reading data from the DTB:
+    uint64_t m_readout;
+    // Time spent splitting and decoding the data:
+    uint64_t m_decode;
+    // Time spent merging the triggers of each pixel:
+    uint64_t m_condense;
+    // Time spent repacking the test data for the user:
+    uint64_t m_repack;
+  };
 }
 #endif
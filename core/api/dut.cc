@@ -427,9 +427,12 @@ void dut:: maskPixel(uint8_t column, uint8_t row, bool mask) {
       std::vector<pixelConfig>::iterator it = std::find_if(rocit->pixels.begin(),
 							   rocit->pixels.end(),
 							   findPixelXY(column,row));
-      // Set enable bit
+      // Set mask bit
       if(it != rocit->pixels.end()) {
-	it->setMask(mask);
+	if(it->mask() != mask) {
+	  it->setMask(mask);
+	  rocit->incrementGeneration();
+	}
       } else {
 	LOG(logWARNING) << "Pixel at column " << static_cast<int>(column) << " and row " << static_cast<int>(row) << " not found for ROC " << static_cast<int>(rocit - roc.begin()) << "!" ;
       }
@@ -446,7 +449,10 @@ void dut:: maskPixel(uint8_t column, uint8_t row, bool mask, uint8_t rocid) {
 							 findPixelXY(column,row));
     // Set mask:
     if(it != roc.at(rocid).pixels.end()){
-      it->setMask(mask);
+      if(it->mask() != mask) {
+	it->setMask(mask);
+	roc.at(rocid).incrementGeneration();
+      }
     } else {
       LOG(logWARNING) << "Pixel at column " << static_cast<int>(column) << " and row " << static_cast<int>(row) << " not found for ROC " << static_cast<int>(rocid)<< "!" ;
     }
@@ -498,6 +504,7 @@ void dut::maskAllPixels(bool mask) {
       for (std::vector<pixelConfig>::iterator pixelit = rocit->pixels.begin() ; pixelit != rocit->pixels.end(); ++pixelit){
 	pixelit->setMask(mask);
       }
+      rocit->incrementGeneration();
     }
   }
 }
@@ -510,6 +517,7 @@ void dut::maskAllPixels(bool mask, uint8_t rocid) {
     for (std::vector<pixelConfig>::iterator pixelit = roc.at(rocid).pixels.begin() ; pixelit != roc.at(rocid).pixels.end(); ++pixelit){
       pixelit->setMask(mask);
     }
+    roc.at(rocid).incrementGeneration();
   }
 }
 
@@ -549,7 +557,10 @@ bool dut::updateTrimBits(pixelConfig trimming, uint8_t rocid) {
     // Pixel was not found:
     if(px == roc.at(0).pixels.end()) return false;
     // Pixel was found, set the new trimming values:
-    px->setTrim(trimming.trim());
+    if(px->trim() != trimming.trim()) {
+      px->setTrim(trimming.trim());
+      roc.at(rocid).incrementGeneration();
+    }
     return true;
   }
   else { return false; }
@@ -566,7 +577,10 @@ bool dut::updateTrimBits(uint8_t column, uint8_t row, uint8_t trim, uint8_t roci
     // Pixel was not found:
     if(px == roc.at(0).pixels.end()) return false;
     // Pixel was found, set the new trimming values:
-    px->setTrim(trim);
+    if(px->trim() != trim) {
+      px->setTrim(trim);
+      roc.at(rocid).incrementGeneration();
+    }
     return true;
   }
   else { return false; }
@@ -585,7 +599,10 @@ bool dut::updateTrimBits(std::vector<pixelConfig> trimming, uint8_t rocid) {
       // Pixel was not found:
       if(px == roc.at(0).pixels.end()) return false;
       // Pixel was found, set the new trimming values:
-      px->setTrim(it->trim());
+      if(px->trim() != it->trim()) {
+	px->setTrim(it->trim());
+	roc.at(rocid).incrementGeneration();
+      }
     }
     return true;
   }
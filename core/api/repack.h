@@ -0,0 +1,40 @@
+#ifndef PXAR_REPACK_H
+#define PXAR_REPACK_H
+
+#include <stdint.h>
+#include <vector>
+#include "datatypes.h"
+
+// Repacking of the condensed test data into the return formats of the API
+// test functions. These routines only work on the data passed in, they are
+// used by pxarCore and by the benchmarks (tools/bench.cc). This header is
+// internal to the library and not part of the public API.
+
+namespace pxar {
+
+  /** Repacks map data from (possibly) several ROCs into one long vector
+   *  of pixels.
+   */
+  DLLEXPORT std::vector<pixel> repackMapData (std::vector<Event> &data, uint16_t flags);
+
+  /** Repacks map data from (possibly) several ROCs into one long vector
+   *  of pixels and returns the threshold value.
+   */
+  DLLEXPORT std::vector<pixel> repackThresholdMapData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags);
+
+  /** Repacks DAC scan data into pairs of DAC values with fired pxar::pixel vectors.
+   */
+  DLLEXPORT std::vector< std::pair<uint8_t, std::vector<pixel> > > repackDacScanData (std::vector<Event> &data, uint8_t dacStep, uint8_t dacMin, uint8_t dacMax, uint16_t flags);
+
+  /** Repacks DAC scan data into pairs of DAC values with fired pxar::pixel vectors and return the threshold value.
+   */
+  DLLEXPORT std::vector<std::pair<uint8_t,std::vector<pixel> > > repackThresholdDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint8_t thresholdlevel, uint16_t nTriggers, uint16_t flags);
+
+  /** repacks (2D) DAC-DAC scan data into pairs of DAC values with
+   *  vectors of the fired pixels.
+   */
+  DLLEXPORT std::vector< std::pair<uint8_t, std::pair<uint8_t, std::vector<pixel> > > > repackDacDacScanData (std::vector<Event> &data, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max, uint16_t flags);
+
+}
+
+#endif /* PXAR_REPACK_H */
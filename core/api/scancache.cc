@@ -0,0 +1,217 @@
+#include "scancache.h"
+#include "log.h"
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+
+namespace pxar {
+
+  scanCache::scanCache() :
+    m_memory_budget(0),
+    m_disk_budget(0),
+    m_directory(),
+    m_memory(),
+    m_disk(),
+    m_memory_used(0),
+    m_disk_used(0),
+    m_clock(0),
+    m_hits(0),
+    m_misses(0) {}
+
+  scanCache::~scanCache() { clear(); }
+
+  void scanCache::setBudget(size_t memory, std::string directory, size_t disk) {
+    // Files in the old directory can not be found anymore:
+    if(directory != m_directory || directory.empty() || disk == 0) { shrinkDisk(0); }
+
+    m_memory_budget = memory;
+    m_directory = directory;
+    m_disk_budget = (directory.empty() ? 0 : disk);
+    if(!enabled()) { clear(); }
+    shrinkMemory(m_memory_budget);
+    shrinkDisk(m_disk_budget);
+
+    if(enabled()) {
+      LOG(logDEBUGAPI) << "Scan cache budget " << (m_memory_budget >> 20) << " MB memory"
+		       << (m_disk_budget > 0 ? ", " : "")
+		       << (m_disk_budget > 0 ? (m_disk_budget >> 20) : 0)
+		       << (m_disk_budget > 0 ? " MB disk in " + m_directory : "");
+    }
+  }
+
+  bool scanCache::get(uint64_t key, std::vector<Event> & data, statistics & stats) {
+    if(!enabled()) return false;
+
+    std::map<uint64_t, entry>::iterator mem = m_memory.find(key);
+    if(mem != m_memory.end()) {
+      mem->second.used = ++m_clock;
+      data = mem->second.data;
+      stats = mem->second.stats;
+      m_hits++;
+      return true;
+    }
+
+    std::map<uint64_t, diskEntry>::iterator dsk = m_disk.find(key);
+    if(dsk != m_disk.end()) {
+      if(readFile(key, data, stats)) {
+	// Move the entry back to memory:
+	removeFile(key);
+	put(key, data, stats);
+	m_hits++;
+	return true;
+      }
+      removeFile(key);
+    }
+
+    m_misses++;
+    return false;
+  }
+
+  void scanCache::put(uint64_t key, const std::vector<Event> & data, const statistics & stats) {
+    if(!enabled()) return;
+    size_t size = dataSize(data);
+    if(size > m_memory_budget) {
+      LOG(logDEBUGAPI) << "Scan data of " << size << " bytes exceeds the cache budget, not cached.";
+      return;
+    }
+
+    std::map<uint64_t, entry>::iterator mem = m_memory.find(key);
+    if(mem != m_memory.end()) {
+      m_memory_used -= mem->second.size;
+      m_memory.erase(mem);
+    }
+    shrinkMemory(m_memory_budget - size);
+
+    entry & e = m_memory[key];
+    e.data = data;
+    e.stats = stats;
+    e.size = size;
+    e.used = ++m_clock;
+    m_memory_used += size;
+  }
+
+  void scanCache::clear() {
+    m_memory.clear();
+    m_memory_used = 0;
+    shrinkDisk(0);
+  }
+
+  size_t scanCache::dataSize(const std::vector<Event> & data) {
+    size_t size = sizeof(std::vector<Event>) + data.size()*sizeof(Event);
+    for(std::vector<Event>::const_iterator evt = data.begin(); evt != data.end(); ++evt) {
+      size += evt->pixels.size()*sizeof(pixel);
+    }
+    return size;
+  }
+
+  std::string scanCache::fileName(uint64_t key) const {
+    std::ostringstream name;
+    name << m_directory << "/pxar-scan-" << std::hex << std::setw(16) << std::setfill('0') << key << ".cache";
+    return name.str();
+  }
+
+  // File layout: decoding statistics, number of events, then for every event
+  // the number of header words, trailer words and pixels followed by their
+  // data. Statistics and pixels are stored as in memory, the files are only
+  // read by the same process.
+  bool scanCache::writeFile(uint64_t key, const std::vector<Event> & data, const statistics & stats) {
+    FILE * file = fopen(fileName(key).c_str(), "wb");
+    if(!file) {
+      LOG(logWARNING) << "Could not write scan cache file " << fileName(key);
+      return false;
+    }
+
+    uint64_t nevents = data.size();
+    bool ok = fwrite(&stats, sizeof(statistics), 1, file) == 1
+      && fwrite(&nevents, sizeof(nevents), 1, file) == 1;
+    for(std::vector<Event>::const_iterator evt = data.begin(); ok && evt != data.end(); ++evt) {
+      Event e = *evt;
+      std::vector<uint16_t> header = e.getHeaders(), trailer = e.getTrailers();
+      uint32_t n[3] = {static_cast<uint32_t>(header.size()), static_cast<uint32_t>(trailer.size()), static_cast<uint32_t>(e.pixels.size())};
+      ok = fwrite(n, sizeof(uint32_t), 3, file) == 3
+	&& (n[0] == 0 || fwrite(&header[0], sizeof(uint16_t), n[0], file) == n[0])
+	&& (n[1] == 0 || fwrite(&trailer[0], sizeof(uint16_t), n[1], file) == n[1])
+	&& (n[2] == 0 || fwrite(&e.pixels[0], sizeof(pixel), n[2], file) == n[2]);
+    }
+    ok = (fclose(file) == 0) && ok;
+    if(!ok) {
+      LOG(logWARNING) << "Could not write scan cache file " << fileName(key);
+      remove(fileName(key).c_str());
+    }
+    return ok;
+  }
+
+  bool scanCache::readFile(uint64_t key, std::vector<Event> & data, statistics & stats) {
+    FILE * file = fopen(fileName(key).c_str(), "rb");
+    if(!file) return false;
+
+    uint64_t nevents = 0;
+    statistics filestats;
+    bool ok = fread(&filestats, sizeof(statistics), 1, file) == 1
+      && fread(&nevents, sizeof(nevents), 1, file) == 1;
+    std::vector<Event> events(ok ? nevents : 0);
+    for(std::vector<Event>::iterator evt = events.begin(); ok && evt != events.end(); ++evt) {
+      uint32_t n[3];
+      ok = fread(n, sizeof(uint32_t), 3, file) == 3;
+      if(!ok) break;
+      std::vector<uint16_t> words(n[0] + n[1]);
+      evt->pixels.resize(n[2]);
+      ok = (words.empty() || fread(&words[0], sizeof(uint16_t), words.size(), file) == words.size())
+	&& (n[2] == 0 || fread(&evt->pixels[0], sizeof(pixel), n[2], file) == n[2]);
+      for(size_t i = 0; ok && i < words.size(); i++) {
+	if(i < n[0]) evt->addHeader(words[i]);
+	else evt->addTrailer(words[i]);
+      }
+    }
+    fclose(file);
+
+    if(!ok) {
+      LOG(logWARNING) << "Could not read scan cache file " << fileName(key);
+      return false;
+    }
+    data.swap(events);
+    stats = filestats;
+    return true;
+  }
+
+  void scanCache::removeFile(uint64_t key) {
+    std::map<uint64_t, diskEntry>::iterator dsk = m_disk.find(key);
+    if(dsk == m_disk.end()) return;
+    remove(fileName(key).c_str());
+    m_disk_used -= dsk->second.size;
+    m_disk.erase(dsk);
+  }
+
+  void scanCache::shrinkMemory(size_t budget) {
+    while(m_memory_used > budget && !m_memory.empty()) {
+      std::map<uint64_t, entry>::iterator oldest = m_memory.begin();
+      for(std::map<uint64_t, entry>::iterator it = m_memory.begin(); it != m_memory.end(); ++it) {
+	if(it->second.used < oldest->second.used) oldest = it;
+      }
+
+      // Move to disk if it fits into the disk budget at all:
+      if(m_disk_budget >= oldest->second.size) {
+	shrinkDisk(m_disk_budget - oldest->second.size);
+	if(writeFile(oldest->first, oldest->second.data, oldest->second.stats)) {
+	  diskEntry & d = m_disk[oldest->first];
+	  d.size = oldest->second.size;
+	  d.used = oldest->second.used;
+	  m_disk_used += d.size;
+	}
+      }
+      m_memory_used -= oldest->second.size;
+      m_memory.erase(oldest);
+    }
+  }
+
+  void scanCache::shrinkDisk(size_t budget) {
+    while(m_disk_used > budget && !m_disk.empty()) {
+      std::map<uint64_t, diskEntry>::iterator oldest = m_disk.begin();
+      for(std::map<uint64_t, diskEntry>::iterator it = m_disk.begin(); it != m_disk.end(); ++it) {
+	if(it->second.used < oldest->second.used) oldest = it;
+      }
+      removeFile(oldest->first);
+    }
+  }
+
+}
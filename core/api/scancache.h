@@ -0,0 +1,108 @@
+#ifndef PXAR_SCANCACHE_H
+#define PXAR_SCANCACHE_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <map>
+#include "datatypes.h"
+
+namespace pxar {
+
+  /** Incremental 64 bit FNV-1a hash, used to build the cache keys
+   */
+  class scanHash {
+  public:
+    scanHash() : m_hash(14695981039346656037ULL) {}
+    void add(const void * data, size_t size) {
+      const unsigned char * p = static_cast<const unsigned char *>(data);
+      for(size_t i = 0; i < size; i++) {
+	m_hash ^= p[i];
+	m_hash *= 1099511628211ULL;
+      }
+    }
+    template <typename T> void add(const T & value) { add(&value, sizeof(T)); }
+    uint64_t value() const { return m_hash; }
+  private:
+    uint64_t m_hash;
+  };
+
+  /** Cache of the event data returned by the test loops of pxarCore,
+   *  together with the decoding statistics of the scan.
+   *
+   *  Entries are keyed by a hash of the scan routine, its parameters and the
+   *  full DUT state. Least recently used entries are moved from memory to
+   *  disk (if a directory and disk budget are set) and dropped from there.
+   *  The disk files are only valid for the lifetime of the cache, they are
+   *  removed by clear() and on destruction.
+   */
+  class scanCache {
+  public:
+    scanCache();
+    ~scanCache();
+
+    /** Sets the memory and disk budgets in bytes, a memory budget of zero
+     *  disables the cache. Entries exceeding the new budgets are dropped.
+     */
+    void setBudget(size_t memory, std::string directory = "", size_t disk = 0);
+    bool enabled() const { return m_memory_budget > 0; }
+
+    /** Looks up the data and statistics for the key, returns false if it
+     *  is not cached
+     */
+    bool get(uint64_t key, std::vector<Event> & data, statistics & stats);
+
+    /** Stores the data and statistics for the key. Data larger than the
+     *  memory budget is not cached.
+     */
+    void put(uint64_t key, const std::vector<Event> & data, const statistics & stats);
+
+    /** Drops all entries from memory and disk
+     */
+    void clear();
+
+    uint64_t hits() const { return m_hits; }
+    uint64_t misses() const { return m_misses; }
+    size_t memoryUsed() const { return m_memory_used; }
+    size_t diskUsed() const { return m_disk_used; }
+
+  private:
+    struct entry {
+      std::vector<Event> data;
+      statistics stats;
+      size_t size;
+      uint64_t used;
+    };
+    struct diskEntry {
+      size_t size;
+      uint64_t used;
+    };
+
+    static size_t dataSize(const std::vector<Event> & data);
+    std::string fileName(uint64_t key) const;
+    bool writeFile(uint64_t key, const std::vector<Event> & data, const statistics & stats);
+    bool readFile(uint64_t key, std::vector<Event> & data, statistics & stats);
+    void removeFile(uint64_t key);
+
+    // Evicts least recently used entries until the budgets are met:
+    void shrinkMemory(size_t budget);
+    void shrinkDisk(size_t budget);
+
+    size_t m_memory_budget;
+    size_t m_disk_budget;
+    std::string m_directory;
+
+    std::map<uint64_t, entry> m_memory;
+    std::map<uint64_t, diskEntry> m_disk;
+    size_t m_memory_used;
+    size_t m_disk_used;
+
+    // Use counter for the LRU order and statistics:
+    uint64_t m_clock;
+    uint64_t m_hits;
+    uint64_t m_misses;
+  };
+
+}
+#endif // PXAR_SCANCACHE_H
@@ -225,6 +225,8 @@ cdef extern from "api.h" namespace "pxar":
         void HVon()
         void Poff()
         void Pon()
+        void setScanCache(uint32_t memoryMB, string directory, uint32_t diskMB) except +
+        void clearScanCache()
         bool SignalProbe(string probe, string name, uint8_t channel) except +
         bool setDAC(string dacName, uint8_t dacValue, uint8_t rocid) except +
         bool setDAC(string dacName, uint8_t dacValue) except +
@@ -255,6 +257,12 @@ cdef extern from "api.h" namespace "pxar":
         rawEvent daqGetRawEvent() except +
         vector[rawEvent] daqGetRawEventBuffer() except +
         vector[Event] daqGetEventBuffer() except +
+        uint32_t daqDrainEventBuffer() except +
+        void daqHotPixelMonitor(uint32_t threshold) except +
+        vector[pair[pixel,double]] daqGetHotPixels() except +
+        vector[pair[pixel,double]] daqGetNewHotPixels() except +
+        uint32_t daqGetHotPixelEvents() except +
+        uint32_t daqMaskHotPixels() except +
         vector[uint16_t] daqGetBuffer() except +
         vector[vector[uint16_t]] daqGetReadback() except +
         vector[uint8_t] daqGetXORsum(uint8_t channel) except +
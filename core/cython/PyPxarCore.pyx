@@ -485,6 +485,10 @@ cdef class PyPxarCore:
         self.thisptr.Poff()
     def Pon(self):
         self.thisptr.Pon()
+    def setScanCache(self, uint32_t memoryMB, string directory = "", uint32_t diskMB = 0):
+        self.thisptr.setScanCache(memoryMB, directory, diskMB)
+    def clearScanCache(self):
+        self.thisptr.clearScanCache()
     def SignalProbe(self, string probe, string name, int channel = 0):
         return self.thisptr.SignalProbe(probe, name, channel)
     def setDAC(self, string dacName, uint8_t dacValue, rocid = None):
@@ -651,6 +655,38 @@ cdef class PyPxarCore:
             pixelevents.append(p)
         return pixelevents
 
+    def daqDrainEventBuffer(self):
+        return self.thisptr.daqDrainEventBuffer()
+
+    def daqHotPixelMonitor(self, uint32_t threshold):
+        self.thisptr.daqHotPixelMonitor(threshold)
+
+    def daqGetHotPixels(self):
+        cdef vector[pair[pixel,double]] r
+        r = self.thisptr.daqGetHotPixels()
+        pixels = list()
+        for p in r:
+            px = Pixel()
+            px.fill(p.first)
+            pixels.append((px, p.second))
+        return pixels
+
+    def daqGetNewHotPixels(self):
+        cdef vector[pair[pixel,double]] r
+        r = self.thisptr.daqGetNewHotPixels()
+        pixels = list()
+        for p in r:
+            px = Pixel()
+            px.fill(p.first)
+            pixels.append((px, p.second))
+        return pixels
+
+    def daqGetHotPixelEvents(self):
+        return self.thisptr.daqGetHotPixelEvents()
+
+    def daqMaskHotPixels(self):
+        return self.thisptr.daqMaskHotPixels()
+
     def daqGetRawEvent(self):
         cdef rawEvent r
         hits = []
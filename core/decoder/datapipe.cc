@@ -159,6 +159,9 @@ namespace pxar {
       // Clearing event content:
       roc_Event.Clear();
     }
+
+    // Count the hits of the hot pixel monitor:
+    if(hotThreshold > 0) { countHits(); }
     
     if(dump_count < 100 && (GetFlags() & FLAG_DUMP_FLAWED_EVENTS) != 0) {
       if(error_count != (decodingStats.errors_event()
@@ -658,6 +661,37 @@ namespace pxar {
     return tmp;
   }
 
+  void dtbEventDecoder::countHits() {
+    hitEvents++;
+    for(std::vector<pixel>::iterator px = roc_Event.pixels.begin(); px != roc_Event.pixels.end(); ++px) {
+      if(px->roc() >= MOD_NUMROCS || px->column() >= ROC_NUMCOLS || px->row() >= ROC_NUMROWS) continue;
+      size_t idx = (static_cast<size_t>(px->roc())*ROC_NUMCOLS + px->column())*ROC_NUMROWS + px->row();
+      // Record the pixel once, when it reaches the threshold:
+      if(++hitcount[idx] == hotThreshold) {
+	hotpixels.push_back(pixel(px->roc(),px->column(),px->row(),0));
+	LOG(logDEBUGPIPES) << "Hot pixel " << hotpixels.back() << " reached " << hotThreshold << " hits after " << hitEvents << " events.";
+      }
+    }
+  }
+
+  void dtbEventDecoder::setHotPixelMonitor(uint32_t threshold) {
+    hotThreshold = threshold;
+    if(threshold > 0) { hitcount.resize(MOD_NUMROCS*ROC_NUMCOLS*ROC_NUMROWS); }
+    else { std::vector<uint32_t>().swap(hitcount); }
+    clearHitCounts();
+  }
+
+  void dtbEventDecoder::clearHitCounts() {
+    std::fill(hitcount.begin(), hitcount.end(), 0);
+    hotpixels.clear();
+    hitEvents = 0;
+  }
+
+  uint32_t dtbEventDecoder::getHitCount(const pixel & px) {
+    if(hitcount.empty() || px.roc() >= MOD_NUMROCS || px.column() >= ROC_NUMCOLS || px.row() >= ROC_NUMROWS) return 0;
+    return hitcount.at((static_cast<size_t>(px.roc())*ROC_NUMCOLS + px.column())*ROC_NUMROWS + px.row());
+  }
+
   std::vector<uint8_t> dtbEventDecoder::getXORsum() {
     // Automatically clear the XOR sum vector after it was read out:
     std::vector<uint8_t> tmp = xorsum;
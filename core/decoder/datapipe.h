@@ -198,12 +198,27 @@ namespace pxar {
     uint32_t total_event, flawed_event, error_count, dump_count;
     std::vector<std::string> event_ringbuffer;
 
+    // Hot pixel monitor: hits per pixel of all decoded events
+    void countHits();
+    uint32_t hotThreshold;
+    uint32_t hitEvents;
+    std::vector<uint32_t> hitcount;
+    std::vector<pixel> hotpixels;
+
   public:
-  dtbEventDecoder() : decodingStats(), readback_dirty(), count(), shiftReg(), readback(), eventID(-1), ultrablack(0xfff), black(0xfff), levelS(0), sumUB(0), sumB(0), slidingWindow(0), total_event(5), flawed_event(0), error_count(0), dump_count(0), event_ringbuffer(7) {};
-    void Clear() { decodingStats.clear(); readback.clear(); count.clear(); shiftReg.clear(); eventID = -1; };
+  dtbEventDecoder() : decodingStats(), readback_dirty(), count(), shiftReg(), readback(), eventID(-1), ultrablack(0xfff), black(0xfff), levelS(0), sumUB(0), sumB(0), slidingWindow(0), total_event(5), flawed_event(0), error_count(0), dump_count(0), event_ringbuffer(7), hotThreshold(0), hitEvents(0), hitcount(), hotpixels() {};
+    void Clear() { decodingStats.clear(); readback.clear(); count.clear(); shiftReg.clear(); eventID = -1; clearHitCounts(); };
     statistics getStatistics();
     std::vector<std::vector<uint16_t> > getReadback();
     std::vector<uint8_t> getXORsum();
+
+    // Hot pixel monitor, threshold 0 switches it off:
+    void setHotPixelMonitor(uint32_t threshold);
+    void clearHitCounts();
+    uint32_t getHitEvents() { return hitEvents; }
+    uint32_t getHitCount(const pixel & px);
+    // Pixels in the order in which they reached the threshold:
+    const std::vector<pixel> & getHotPixels() { return hotpixels; }
   };
 }
 #endif
@@ -0,0 +1,50 @@
+#include "datasource_rawz.h"
+#include "rawcompression.h"
+#include "log.h"
+#include "constants.h"
+#include <cstring>
+
+namespace pxar {
+
+  rawzSource::rawzSource(std::string filename, uint8_t daqchannel, uint8_t tokenChainLength, uint8_t offset, uint8_t tbmtype, uint8_t roctype, uint16_t daqflags) : channel(daqchannel), flags(daqflags), chainlength(tokenChainLength), chainlengthOffset(offset), envelopetype(tbmtype), devicetype(roctype), file(NULL), lastSample(0x4000), pos(0), connected(false) {
+
+    file = fopen(filename.c_str(), "rb");
+    char magic[RAWZ_MAGIC_SIZE];
+    if(!file || fread(magic, 1, RAWZ_MAGIC_SIZE, file) != RAWZ_MAGIC_SIZE || memcmp(magic, RAWZ_MAGIC, RAWZ_MAGIC_SIZE) != 0) {
+      LOG(logERROR) << "Could not open compressed raw data file " << filename;
+      return;
+    }
+    connected = true;
+    LOG(logDEBUGPIPES) << "New rawzSource reading " << filename << ", channel " << static_cast<int>(channel)
+		       << " (" << static_cast<int>(chainlength) << " ROCs, "
+		       << static_cast<int>(chainlengthOffset) << "-" << static_cast<int>(chainlengthOffset+chainlength-1)<< ")"
+		       << (envelopetype == TBM_NONE ? " DESER160 " : (envelopetype == TBM_EMU ? " SOFTTBM " : " DESER400 "));
+  }
+
+  rawzSource::~rawzSource() {
+    if(file) fclose(file);
+  }
+
+  bool rawzSource::FillBuffer() {
+    buffer.clear();
+    pos = 0;
+
+    // Skip empty blocks, stop at the end of the file:
+    while(buffer.empty()) {
+      uint8_t header[RAWZ_BLOCK_HEADER_SIZE];
+      if(fread(header, 1, RAWZ_BLOCK_HEADER_SIZE, file) != RAWZ_BLOCK_HEADER_SIZE) return false;
+      uint32_t nwords = rawCompressor::readHeader(header);
+      uint32_t size = rawCompressor::readHeader(header + 4);
+
+      packed.resize(size);
+      if((size > 0 && fread(&packed[0], 1, size, file) != size)
+	 || !rawCompressor::decompressBlock(size > 0 ? &packed[0] : NULL, size, nwords, buffer)) {
+	LOG(logERROR) << "Corrupt block in compressed raw data file, stopping.";
+	buffer.clear();
+	return false;
+      }
+    }
+    return true;
+  }
+
+}
@@ -0,0 +1,76 @@
+#ifndef PXAR_DATASOURCE_RAWZ_H
+#define PXAR_DATASOURCE_RAWZ_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "datapipe.h"
+
+namespace pxar {
+
+  // Data source reading a compressed raw data file (see rawcompression.h)
+  // block by block, to be connected to the splitter like the other sources
+  class rawzSource : public dataSource<uint16_t> {
+    // --- Control/state
+    uint8_t channel;
+    uint16_t flags;
+    uint8_t chainlength;
+    uint8_t chainlengthOffset;
+    uint8_t envelopetype;
+    uint8_t devicetype;
+    FILE * file;
+
+    // --- data buffer, holding one decompressed block
+    uint16_t lastSample;
+    unsigned int pos;
+    bool connected;
+    std::vector<uint16_t> buffer;
+    std::vector<uint8_t> packed;
+    bool FillBuffer();
+
+    // --- virtual data access methods
+    uint16_t Read() {
+      if(!connected) throw dpNotConnected();
+      if(pos >= buffer.size() && !FillBuffer()) throw dsBufferEmpty();
+      return lastSample = buffer[pos++];
+    }
+    uint16_t ReadLast() {
+      if(!connected) throw dpNotConnected();
+      return lastSample;
+    }
+    uint8_t ReadChannel() {
+      if(!connected) throw dpNotConnected();
+      return channel;
+    }
+    uint16_t ReadFlags() {
+      if(!connected) throw dpNotConnected();
+      return flags;
+    }
+    uint8_t ReadTokenChainLength() {
+      if(!connected) throw dpNotConnected();
+      return chainlength;
+    }
+    uint8_t ReadTokenChainOffset() {
+      if(!connected) throw dpNotConnected();
+      return chainlengthOffset;
+    }
+    uint8_t ReadEnvelopeType() {
+      if(!connected) throw dpNotConnected();
+      return envelopetype;
+    }
+    uint8_t ReadDeviceType() {
+      if(!connected) throw dpNotConnected();
+      return devicetype;
+    }
+
+    rawzSource(const rawzSource&);
+    rawzSource& operator=(const rawzSource&);
+  public:
+    rawzSource(std::string filename, uint8_t daqchannel, uint8_t tokenChainLength, uint8_t offset, uint8_t tbmtype, uint8_t roctype, uint16_t daqflags = 0);
+    ~rawzSource();
+
+    // --- control and status
+    bool isConnected() { return connected; }
+  };
+}
+#endif // PXAR_DATASOURCE_RAWZ_H
@@ -0,0 +1,274 @@
+#include "rawcompression.h"
+
+namespace pxar {
+
+  namespace {
+
+    // Number of cached marker words and pixel flag combinations:
+    const int RAWZ_CACHE = 8;
+    const int RAWZ_FLAGS = 3;
+
+    // Prefix codes, bits in the order they are read:
+    //   0    + 3 bit     cached word
+    //   10   + ...       pixel hit (two words): flags, double column if
+    //                    changed, row, pulse height difference or value
+    //   110  + 16 bit    literal word
+    //   1110 + 3 bit     increment of a cached word
+    //   1111 + 6 bit     signed difference to the previous word
+    // All values are packed least significant bit first.
+
+    /** State shared by the encoder and the decoder, reset for every block
+     */
+    struct rawzModel {
+      uint16_t cache[RAWZ_CACHE];
+      uint8_t flags[RAWZ_FLAGS];
+      uint8_t dcol;
+      uint8_t ph;
+      uint16_t last;
+
+      rawzModel() : dcol(0), ph(0), last(0) {
+	// Start with the markers of the common readout chains:
+	static const uint16_t markers[RAWZ_CACHE] = { 0x8000, 0x47f8, 0xe000, 0xc000, 0x4000, 0x87f8, 0x07f8, 0xa000 };
+	for(int i = 0; i < RAWZ_CACHE; i++) cache[i] = markers[i];
+	flags[0] = 0x02; flags[1] = 0x00; flags[2] = 0x04;
+      }
+
+      void toFront(int i, uint16_t word) {
+	for(; i > 0; i--) cache[i] = cache[i-1];
+	cache[0] = word;
+      }
+      void flagsToFront(int i, uint8_t f) {
+	for(; i > 0; i--) flags[i] = flags[i-1];
+	flags[0] = f;
+      }
+      static uint16_t increment(uint16_t word) { return (word & 0xff00) | ((word + 1) & 0x00ff); }
+    };
+
+    class bitWriter {
+      std::vector<uint8_t> & out;
+      uint64_t acc;
+      int bits;
+    public:
+      bitWriter(std::vector<uint8_t> & o) : out(o), acc(0), bits(0) {}
+      inline void put(uint32_t value, int n) {
+	acc |= static_cast<uint64_t>(value) << bits;
+	bits += n;
+	if(bits >= 32) {
+	  uint32_t w = static_cast<uint32_t>(acc);
+	  out.push_back(w & 0xff); out.push_back((w >> 8) & 0xff);
+	  out.push_back((w >> 16) & 0xff); out.push_back(w >> 24);
+	  acc >>= 32;
+	  bits -= 32;
+	}
+      }
+      void flush() {
+	while(bits > 0) { out.push_back(acc & 0xff); acc >>= 8; bits -= 8; }
+	bits = 0;
+      }
+    };
+
+    class bitReader {
+      const uint8_t * data;
+      size_t size;
+      size_t pos;
+      uint64_t acc;
+      int bits;
+      bool overrun;
+    public:
+      bitReader(const uint8_t * d, size_t s) : data(d), size(s), pos(0), acc(0), bits(0), overrun(false) {}
+      inline uint32_t get(int n) {
+	if(bits < n) {
+	  while(bits <= 56) {
+	    if(pos < size) acc |= static_cast<uint64_t>(data[pos++]) << bits;
+	    else if(bits < n) overrun = true;
+	    else break;
+	    bits += 8;
+	  }
+	}
+	uint32_t value = static_cast<uint32_t>(acc & ((static_cast<uint64_t>(1) << n) - 1));
+	acc >>= n;
+	bits -= n;
+	return value;
+      }
+      bool failed() { return overrun; }
+    };
+
+    // Splits a pixel hit into double column, row code and pulse height if
+    // it only uses valid address digits and the pulse height fill bit is 0:
+    inline bool splitHit(uint32_t raw, uint8_t &dcol, uint8_t &rcode, uint8_t &ph) {
+      uint32_t c1 = (raw >> 21) & 7, c0 = (raw >> 18) & 7;
+      uint32_t r2 = (raw >> 15) & 7, r1 = (raw >> 12) & 7, r0 = (raw >> 9) & 7;
+      if((raw & 0x10) || c1 > 5 || c0 > 5 || r2 > 5 || r1 > 5 || r0 > 5) return false;
+      dcol = static_cast<uint8_t>(c1*6 + c0);
+      rcode = static_cast<uint8_t>(r2*36 + r1*6 + r0);
+      ph = static_cast<uint8_t>((raw & 0x0f) | ((raw >> 1) & 0xf0));
+      return true;
+    }
+
+    inline uint32_t joinHit(uint8_t dcol, uint8_t rcode, uint8_t ph) {
+      return (static_cast<uint32_t>(dcol/6) << 21) | (static_cast<uint32_t>(dcol%6) << 18)
+	| (static_cast<uint32_t>(rcode/36) << 15) | (static_cast<uint32_t>((rcode/6)%6) << 12)
+	| (static_cast<uint32_t>(rcode%6) << 9) | (static_cast<uint32_t>(ph & 0xf0) << 1) | (ph & 0x0f);
+    }
+
+    inline void putHeader(std::vector<uint8_t> & out, size_t pos, uint32_t value) {
+      out[pos] = value & 0xff; out[pos+1] = (value >> 8) & 0xff;
+      out[pos+2] = (value >> 16) & 0xff; out[pos+3] = value >> 24;
+    }
+  }
+
+  void rawCompressor::compress(const uint16_t * words, size_t nwords, std::vector<uint8_t> & out) {
+    for(size_t first = 0; first < nwords; first += RAWZ_BLOCK_WORDS) {
+      size_t n = (nwords - first < RAWZ_BLOCK_WORDS) ? nwords - first : RAWZ_BLOCK_WORDS;
+      compressBlock(words + first, n, out);
+    }
+  }
+
+  void rawCompressor::compressBlock(const uint16_t * words, size_t nwords, std::vector<uint8_t> & out) {
+
+    size_t header = out.size();
+    out.resize(header + RAWZ_BLOCK_HEADER_SIZE);
+    out.reserve(out.size() + nwords*2);
+
+    rawzModel m;
+    bitWriter bw(out);
+
+    for(size_t i = 0; i < nwords; i++) {
+      uint16_t w = words[i];
+
+      // Repeated marker words:
+      int c = 0;
+      while(c < RAWZ_CACHE && m.cache[c] != w) c++;
+      if(c < RAWZ_CACHE) {
+	bw.put(0, 1);
+	bw.put(c, 3);
+	m.toFront(c, w);
+	m.last = w;
+	continue;
+      }
+
+      // Pixel hits:
+      uint8_t dcol, rcode, ph;
+      if(i + 1 < nwords && splitHit((static_cast<uint32_t>(w & 0x0fff) << 12) | (words[i+1] & 0x0fff), dcol, rcode, ph)) {
+	uint8_t f = static_cast<uint8_t>(((w >> 12) << 4) | (words[i+1] >> 12));
+	bw.put(1, 2);
+	int k = 0;
+	while(k < RAWZ_FLAGS && m.flags[k] != f) k++;
+	if(k < RAWZ_FLAGS) bw.put(k, 2);
+	else { bw.put(3, 2); bw.put(f, 8); k = RAWZ_FLAGS - 1; }
+	m.flagsToFront(k, f);
+	if(dcol == m.dcol) bw.put(0, 1);
+	else { bw.put(1, 1); bw.put(dcol, 6); m.dcol = dcol; }
+	bw.put(rcode, 8);
+	int d = static_cast<int>(ph) - static_cast<int>(m.ph);
+	if(d >= -16 && d < 16) { bw.put(0, 1); bw.put(d & 0x1f, 5); }
+	else { bw.put(1, 1); bw.put(ph, 8); }
+	m.ph = ph;
+	m.last = words[++i];
+	continue;
+      }
+
+      // Incrementing event counters:
+      c = 0;
+      while(c < RAWZ_CACHE && rawzModel::increment(m.cache[c]) != w) c++;
+      if(c < RAWZ_CACHE) {
+	bw.put(7, 4);
+	bw.put(c, 3);
+	m.toFront(c, w);
+	m.last = w;
+	continue;
+      }
+
+      // Small changes, e.g. of analog levels:
+      int d = static_cast<int>(w) - static_cast<int>(m.last);
+      if(d >= -32 && d < 32) {
+	bw.put(15, 4);
+	bw.put(d & 0x3f, 6);
+	m.last = w;
+	continue;
+      }
+
+      // Everything else:
+      bw.put(3, 3);
+      bw.put(w, 16);
+      m.toFront(RAWZ_CACHE - 1, w);
+      m.last = w;
+    }
+    bw.flush();
+
+    putHeader(out, header, static_cast<uint32_t>(nwords));
+    putHeader(out, header + 4, static_cast<uint32_t>(out.size() - header - RAWZ_BLOCK_HEADER_SIZE));
+  }
+
+  bool rawCompressor::decompressBlock(const uint8_t * data, size_t nbytes, uint32_t nwords, std::vector<uint16_t> & out) {
+
+    if(nwords > RAWZ_BLOCK_WORDS) return false;
+    size_t end = out.size() + nwords;
+    out.reserve(end);
+
+    rawzModel m;
+    bitReader br(data, nbytes);
+
+    while(out.size() < end) {
+      if(br.get(1) == 0) {
+	int c = br.get(3);
+	uint16_t w = m.cache[c];
+	m.toFront(c, w);
+	out.push_back(m.last = w);
+      }
+      else if(br.get(1) == 0) {
+	if(out.size() + 2 > end) return false;
+	int k = br.get(2);
+	uint8_t f;
+	if(k < RAWZ_FLAGS) f = m.flags[k];
+	else { f = static_cast<uint8_t>(br.get(8)); k = RAWZ_FLAGS - 1; }
+	m.flagsToFront(k, f);
+	if(br.get(1)) m.dcol = static_cast<uint8_t>(br.get(6));
+	uint8_t rcode = static_cast<uint8_t>(br.get(8));
+	if(br.get(1)) m.ph = static_cast<uint8_t>(br.get(8));
+	else {
+	  int d = br.get(5);
+	  if(d & 0x10) d -= 0x20;
+	  m.ph = static_cast<uint8_t>(m.ph + d);
+	}
+	if(m.dcol > 35 || rcode > 215) return false;
+	uint32_t raw = joinHit(m.dcol, rcode, m.ph);
+	out.push_back(static_cast<uint16_t>(((f >> 4) << 12) | (raw >> 12)));
+	out.push_back(m.last = static_cast<uint16_t>(((f & 0x0f) << 12) | (raw & 0x0fff)));
+      }
+      else if(br.get(1) == 0) {
+	uint16_t w = static_cast<uint16_t>(br.get(16));
+	m.toFront(RAWZ_CACHE - 1, w);
+	out.push_back(m.last = w);
+      }
+      else if(br.get(1) == 0) {
+	int c = br.get(3);
+	uint16_t w = rawzModel::increment(m.cache[c]);
+	m.toFront(c, w);
+	out.push_back(m.last = w);
+      }
+      else {
+	int d = br.get(6);
+	if(d & 0x20) d -= 0x40;
+	out.push_back(m.last = static_cast<uint16_t>(m.last + d));
+      }
+      if(br.failed()) return false;
+    }
+    return true;
+  }
+
+  bool rawCompressor::decompress(const uint8_t * data, size_t nbytes, std::vector<uint16_t> & out) {
+    size_t pos = 0;
+    while(pos < nbytes) {
+      if(nbytes - pos < RAWZ_BLOCK_HEADER_SIZE) return false;
+      uint32_t nwords = readHeader(data + pos);
+      uint32_t size = readHeader(data + pos + 4);
+      pos += RAWZ_BLOCK_HEADER_SIZE;
+      if(size > nbytes - pos) return false;
+      if(!decompressBlock(data + pos, size, nwords, out)) return false;
+      pos += size;
+    }
+    return true;
+  }
+
+}
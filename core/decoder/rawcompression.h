@@ -0,0 +1,66 @@
+#ifndef PXAR_RAWCOMPRESSION_H
+#define PXAR_RAWCOMPRESSION_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <vector>
+#include "pxardllexport.h"
+
+// Compressed raw DTB data files start with this 8 byte magic string,
+// followed by independent blocks, each consisting of the number of words
+// (4 bytes), the number of payload bytes (4 bytes, both little endian) and
+// the payload.
+#define RAWZ_MAGIC "PXARRAWZ"
+#define RAWZ_MAGIC_SIZE 8
+#define RAWZ_BLOCK_HEADER_SIZE 8
+
+// Maximum number of words per block:
+#define RAWZ_BLOCK_WORDS 65536
+
+namespace pxar {
+
+  /** Lossless compression of raw DTB data streams.
+   *
+   *  Every word is coded with a short prefix code against a small model of
+   *  the stream: recently seen marker words (TBM and ROC headers, trailers)
+   *  are coded as an index into a move-to-front cache, incrementing event
+   *  counters as the increment of a cached word, digital pixel hits (two
+   *  words) by their double column (only if it changed), row and the
+   *  pulse height, bit-packed as difference to the previous hit where
+   *  small, and small differences to the previous word (e.g. analog
+   *  levels) as a six bit delta. Everything else is stored as a literal.
+   *  The model is reset for every block, so blocks can be decoded
+   *  independently.
+   */
+  class DLLEXPORT rawCompressor {
+  public:
+    /** Appends the words as blocks of at most RAWZ_BLOCK_WORDS words,
+     *  including the block headers, to out
+     */
+    static void compress(const uint16_t * words, size_t nwords, std::vector<uint8_t> & out);
+
+    /** Appends a single block with header, nwords must not exceed
+     *  RAWZ_BLOCK_WORDS
+     */
+    static void compressBlock(const uint16_t * words, size_t nwords, std::vector<uint8_t> & out);
+
+    /** Decodes the payload of one block of nwords words and appends the
+     *  words to out. Returns false if the payload is corrupt.
+     */
+    static bool decompressBlock(const uint8_t * data, size_t nbytes, uint32_t nwords, std::vector<uint16_t> & out);
+
+    /** Decodes a sequence of blocks including their headers, returns false
+     *  if the data is corrupt or truncated
+     */
+    static bool decompress(const uint8_t * data, size_t nbytes, std::vector<uint16_t> & out);
+
+    /** Reads a little endian block header field
+     */
+    static uint32_t readHeader(const uint8_t * data) {
+      return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8)
+	| (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+    }
+  };
+
+}
+#endif // PXAR_RAWCOMPRESSION_H
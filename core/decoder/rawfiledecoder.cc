@@ -0,0 +1,298 @@
+#include "rawfiledecoder.h"
+#include "datapipe.h"
+#include "log.h"
+#include "constants.h"
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+#ifndef WIN32
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace pxar {
+
+  namespace {
+
+    // Number of events decoded in one go by a thread, small enough to keep
+    // all threads busy until the end:
+    const uint64_t RANGE_MIN_EVENTS = 1024;
+
+    struct decodeRange {
+      uint8_t channel;
+      uint64_t first;
+      uint64_t last;
+    };
+
+    /** Work shared by all decoding threads, ranges are handed out in order
+     */
+    struct decodeJobs {
+      const uint16_t * data;
+      const rawIndex * index;
+      uint8_t envelope;
+      std::vector<decodeRange> ranges;
+      std::vector<uint8_t> chainlength, offset, roctype;
+      std::vector<uint16_t> flags;
+      rawEventHandler * handler;
+      size_t next;
+#ifndef WIN32
+      pthread_mutex_t mutex;
+#endif
+    };
+
+    /** Data source reading the events of a range straight from the mapped
+     *  file. Events following each other in the file are read as one
+     *  segment, so a range is only split where other channels' data is
+     *  interleaved.
+     */
+    class rangeSource : public dataSource<uint16_t> {
+      uint8_t channel;
+      uint8_t chainlength;
+      uint8_t chainlengthOffset;
+      uint8_t envelopetype;
+      uint8_t devicetype;
+      uint16_t flags;
+
+      std::vector<std::pair<const uint16_t *, const uint16_t *> > segments;
+      size_t segment;
+      const uint16_t * pos;
+      const uint16_t * end;
+      uint16_t lastSample;
+
+      uint16_t Read() {
+	while(pos == end) {
+	  if(segment == segments.size()) throw dsBufferEmpty();
+	  pos = segments[segment].first;
+	  end = segments[segment].second;
+	  segment++;
+	}
+	lastSample = *pos++;
+	return lastSample;
+      }
+      uint16_t ReadLast() { return lastSample; }
+      uint8_t ReadChannel() { return channel; }
+      uint16_t ReadFlags() { return flags; }
+      uint8_t ReadTokenChainLength() { return chainlength; }
+      uint8_t ReadTokenChainOffset() { return chainlengthOffset; }
+      uint8_t ReadEnvelopeType() { return envelopetype; }
+      uint8_t ReadDeviceType() { return devicetype; }
+
+    public:
+      rangeSource(uint8_t daqchannel, uint8_t tokenChainLength, uint8_t offset, uint8_t tbmtype, uint8_t roctype, uint16_t daqflags) :
+	channel(daqchannel), chainlength(tokenChainLength), chainlengthOffset(offset), envelopetype(tbmtype), devicetype(roctype), flags(daqflags),
+	segments(), segment(0), pos(NULL), end(NULL), lastSample(0x4000) {}
+
+      void AddData(const uint16_t * data, size_t size) {
+	if(size == 0) return;
+	if(!segments.empty() && segments.back().second == data) segments.back().second += size;
+	else segments.push_back(std::make_pair(data, data + size));
+      }
+    };
+
+    struct decodeResult {
+      decodeJobs * jobs;
+      statistics stats;
+      uint64_t events;
+      uint64_t pixels;
+    };
+
+    void decodeOneRange(decodeJobs * jobs, const decodeRange & r, decodeResult * result) {
+
+      uint8_t ch = r.channel;
+      const std::vector<uint64_t> & offsets = jobs->index->offsets(ch);
+      const std::vector<uint32_t> & lengths = jobs->index->lengths(ch);
+
+      rangeSource src(ch, jobs->chainlength.at(ch), jobs->offset.at(ch), jobs->envelope, jobs->roctype.at(ch), jobs->flags.at(ch));
+      for(uint64_t i = r.first; i < r.last; i++) src.AddData(jobs->data + offsets[i], lengths[i]);
+      // The splitter only closes an event without end marker when it sees
+      // the next start marker. Add the first word of the following event,
+      // so the last event of the range is emitted (with an end error) as in
+      // a sequential decode. The following event itself stays incomplete
+      // and is dropped, it is decoded with the next range.
+      if(r.last < offsets.size()) src.AddData(jobs->data + offsets[r.last], std::min<uint32_t>(lengths[r.last], 1));
+
+      dtbEventSplitter splitter;
+      dtbEventDecoder decoder;
+      dataSink<Event*> pump;
+      src >> splitter >> decoder >> pump;
+
+      uint64_t event = r.first;
+      try {
+	while(true) {
+	  Event * evt = pump.Get();
+	  result->events++;
+	  result->pixels += evt->pixels.size();
+	  if(jobs->handler) jobs->handler->process(ch, event, evt);
+	  event++;
+	}
+      }
+      catch(dsBufferEmpty &) {}
+      catch(dataPipeException &e) { LOG(logERROR) << e.what(); }
+
+      result->stats += decoder.getStatistics();
+    }
+
+    void * runDecodeJobs(void * arg) {
+      decodeResult * result = reinterpret_cast<decodeResult*>(arg);
+      decodeJobs * jobs = result->jobs;
+      while(true) {
+#ifndef WIN32
+	pthread_mutex_lock(&jobs->mutex);
+#endif
+	size_t r = jobs->next++;
+#ifndef WIN32
+	pthread_mutex_unlock(&jobs->mutex);
+#endif
+	if(r >= jobs->ranges.size()) break;
+	decodeOneRange(jobs, jobs->ranges[r], result);
+      }
+      return NULL;
+    }
+  }
+
+  rawFileDecoder::rawFileDecoder(std::string filename) :
+    m_data(NULL),
+    m_words(0),
+    m_mapped(0),
+    m_channels(),
+    m_events(0),
+    m_pixels(0) {
+
+#ifndef WIN32
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if(fd < 0 || fstat(fd, &st) != 0) {
+      LOG(logERROR) << "Could not open raw data file " << filename << ": " << strerror(errno);
+      if(fd >= 0) close(fd);
+      return;
+    }
+    m_words = st.st_size/sizeof(uint16_t);
+    if(m_words > 0) {
+      m_mapped = m_words*sizeof(uint16_t);
+      void * mem = mmap(NULL, m_mapped, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(mem == MAP_FAILED) {
+	LOG(logERROR) << "Could not map raw data file " << filename << ": " << strerror(errno);
+	m_words = 0;
+	m_mapped = 0;
+      }
+      else {
+	m_data = reinterpret_cast<uint16_t*>(mem);
+	// Ranges are read front to back by every thread:
+	madvise(mem, m_mapped, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+#else
+    // Without mmap the file is read into memory:
+    FILE * file = fopen(filename.c_str(), "rb");
+    if(!file) {
+      LOG(logERROR) << "Could not open raw data file " << filename;
+      return;
+    }
+    uint16_t block[4096];
+    size_t n;
+    while((n = fread(block, sizeof(uint16_t), 4096, file)) > 0) m_buffer.insert(m_buffer.end(), block, block + n);
+    fclose(file);
+    m_words = m_buffer.size();
+    if(!m_buffer.empty()) m_data = &m_buffer[0];
+#endif
+  }
+
+  rawFileDecoder::~rawFileDecoder() {
+#ifndef WIN32
+    if(m_data) munmap(m_data, m_mapped);
+#endif
+  }
+
+  void rawFileDecoder::setChannel(uint8_t channel, uint8_t tokenChainLength, uint8_t offset, uint8_t roctype, uint16_t daqflags) {
+    if(m_channels.size() <= channel) {
+      channelConfig none = { false, 0, 0, 0, 0 };
+      m_channels.resize(channel + 1, none);
+    }
+    channelConfig cfg = { true, tokenChainLength, offset, roctype, daqflags };
+    m_channels.at(channel) = cfg;
+  }
+
+  statistics rawFileDecoder::decode(const rawIndex & index, uint32_t nthreads, rawEventHandler * handler) {
+
+    m_events = 0;
+    m_pixels = 0;
+    statistics stats;
+    if(!m_data) return stats;
+    if(index.words() > m_words) {
+      LOG(logERROR) << "Index covers " << index.words() << " words but the file only has " << m_words << ".";
+      return stats;
+    }
+    if(nthreads < 1) nthreads = 1;
+#ifdef WIN32
+    nthreads = 1;
+#endif
+
+    decodeJobs jobs;
+    jobs.data = m_data;
+    jobs.index = &index;
+    jobs.envelope = index.envelopeType();
+    jobs.handler = handler;
+    jobs.next = 0;
+
+    // Cut every configured channel into ranges of consecutive events:
+    uint64_t total = index.events();
+    uint64_t rangesize = std::max(RANGE_MIN_EVENTS, total/(8*nthreads) + 1);
+    for(size_t ch = 0; ch < index.channels(); ch++) {
+      bool set = ch < m_channels.size() && m_channels.at(ch).set;
+      jobs.chainlength.push_back(set ? m_channels.at(ch).chainlength : 0);
+      jobs.offset.push_back(set ? m_channels.at(ch).offset : 0);
+      jobs.roctype.push_back(set ? m_channels.at(ch).roctype : 0);
+      jobs.flags.push_back(set ? m_channels.at(ch).flags : 0);
+
+      uint64_t nevents = index.offsets(ch).size();
+      if(!set) {
+	if(nevents > 0) { LOG(logWARNING) << "No configuration for channel " << ch << ", skipping " << nevents << " events."; }
+	continue;
+      }
+      // The analog levels are averaged over all events of a channel, so
+      // analog data is decoded in one piece to give the same result with
+      // any number of threads:
+      uint64_t size = (jobs.roctype.back() < ROC_PSI46DIG ? std::max<uint64_t>(nevents, 1) : rangesize);
+      for(uint64_t first = 0; first < nevents; first += size) {
+	decodeRange r;
+	r.channel = static_cast<uint8_t>(ch);
+	r.first = first;
+	r.last = std::min(first + size, nevents);
+	jobs.ranges.push_back(r);
+      }
+    }
+    nthreads = static_cast<uint32_t>(std::min<size_t>(nthreads, std::max<size_t>(jobs.ranges.size(), 1)));
+    LOG(logDEBUGAPI) << "Decoding " << total << " events in " << jobs.ranges.size() << " ranges with " << nthreads << " threads.";
+
+    std::vector<decodeResult> results(nthreads);
+    for(uint32_t t = 0; t < nthreads; t++) {
+      results[t].jobs = &jobs;
+      results[t].events = 0;
+      results[t].pixels = 0;
+    }
+
+#ifndef WIN32
+    pthread_mutex_init(&jobs.mutex, NULL);
+    std::vector<pthread_t> threads(nthreads);
+    for(uint32_t t = 0; t < nthreads; t++) pthread_create(&threads[t], NULL, runDecodeJobs, &results[t]);
+    for(uint32_t t = 0; t < nthreads; t++) pthread_join(threads[t], NULL);
+    pthread_mutex_destroy(&jobs.mutex);
+#else
+    runDecodeJobs(&results[0]);
+#endif
+
+    // Merge the results of all threads:
+    for(uint32_t t = 0; t < nthreads; t++) {
+      stats += results[t].stats;
+      m_events += results[t].events;
+      m_pixels += results[t].pixels;
+    }
+    return stats;
+  }
+
+}
@@ -0,0 +1,83 @@
+#ifndef PXAR_RAWFILEDECODER_H
+#define PXAR_RAWFILEDECODER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "datatypes.h"
+#include "rawindex.h"
+#include "pxardllexport.h"
+
+namespace pxar {
+
+  /** Receives the decoded events of a rawFileDecoder. The handler is
+   *  called from all decoding threads concurrently and has to take care of
+   *  its own locking. Events arrive in order within their range only, the
+   *  event number is the position of the event in the index of its channel.
+   *  The event is only valid during the call.
+   */
+  class DLLEXPORT rawEventHandler {
+  public:
+    virtual ~rawEventHandler() {}
+    virtual void process(uint8_t channel, uint64_t event, Event * evt) = 0;
+  };
+
+  /** Parallel decoding of an indexed raw DTB data file.
+   *
+   *  The file is memory-mapped and the indexed events of every channel are
+   *  cut into ranges which are decoded by a pool of threads, each range
+   *  with its own splitter and dtbEventDecoder. The decoding statistics of
+   *  all ranges are summed up afterwards. Since the decoders start afresh
+   *  for every range, checks spanning several events (TBM event ID
+   *  sequence, readback) are restarted at range boundaries. Analog data is
+   *  not cut: the ultrablack and black levels depend on all earlier events
+   *  of the channel, so only different channels are decoded in parallel.
+   */
+  class DLLEXPORT rawFileDecoder {
+  public:
+    rawFileDecoder(std::string filename);
+    ~rawFileDecoder();
+
+    bool isOpen() const { return m_data != NULL; }
+    const uint16_t * data() const { return m_data; }
+    uint64_t words() const { return m_words; }
+
+    /** Sets the readout configuration of a DAQ channel, the envelope type
+     *  is taken from the index. Channels without configuration are not
+     *  decoded.
+     */
+    void setChannel(uint8_t channel, uint8_t tokenChainLength, uint8_t offset, uint8_t roctype, uint16_t daqflags = 0);
+
+    /** Decodes all events of the index with nthreads threads and returns
+     *  the summed decoder statistics. The index has to belong to this file.
+     */
+    statistics decode(const rawIndex & index, uint32_t nthreads, rawEventHandler * handler = NULL);
+
+    uint64_t eventsDecoded() const { return m_events; }
+    uint64_t pixelsDecoded() const { return m_pixels; }
+
+  private:
+    struct channelConfig {
+      bool set;
+      uint8_t chainlength;
+      uint8_t offset;
+      uint8_t roctype;
+      uint16_t flags;
+    };
+
+    uint16_t * m_data;
+    uint64_t m_words;
+    size_t m_mapped;
+#ifdef WIN32
+    std::vector<uint16_t> m_buffer;
+#endif
+    std::vector<channelConfig> m_channels;
+    uint64_t m_events;
+    uint64_t m_pixels;
+
+    rawFileDecoder(const rawFileDecoder&);
+    rawFileDecoder& operator=(const rawFileDecoder&);
+  };
+
+}
+#endif // PXAR_RAWFILEDECODER_H
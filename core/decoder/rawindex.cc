@@ -0,0 +1,167 @@
+#include "rawindex.h"
+#include "constants.h"
+#include "log.h"
+#include <cstdio>
+#include <cstring>
+
+namespace pxar {
+
+  rawIndex::rawIndex(uint8_t tbmtype) :
+    m_envelope(tbmtype),
+    m_words(0),
+    m_offsets(),
+    m_lengths(),
+    m_channel(0),
+    m_start(0),
+    m_open(false),
+    m_started(false) {}
+
+  void rawIndex::clear() {
+    m_words = 0;
+    m_offsets.clear();
+    m_lengths.clear();
+    m_channel = 0;
+    m_start = 0;
+    m_open = false;
+    m_started = false;
+  }
+
+  uint64_t rawIndex::events() const {
+    uint64_t n = 0;
+    for(size_t ch = 0; ch < m_offsets.size(); ch++) n += m_offsets.at(ch).size();
+    return n;
+  }
+
+  void rawIndex::close(uint64_t end) {
+    // Words without event start marker are no event on their own:
+    if(m_open && m_started) {
+      m_offsets.at(m_channel).push_back(m_start);
+      m_lengths.at(m_channel).push_back(static_cast<uint32_t>(end - m_start));
+    }
+    m_open = false;
+  }
+
+  void rawIndex::add(const uint16_t * data, size_t nwords, uint8_t channel) {
+
+    // Events never continue in the data of another channel:
+    if(channel != m_channel) { close(m_words); m_channel = channel; }
+    if(m_offsets.size() <= channel) {
+      m_offsets.resize(channel + 1);
+      m_lengths.resize(channel + 1);
+    }
+
+    for(size_t i = 0; i < nwords; i++, m_words++) {
+      uint16_t w = data[i];
+
+      // Every event starts right after the previous one, so a splitter
+      // started at the event sees the same words as one running through
+      // the whole file, including garbage before the start marker:
+      if(!m_open) {
+	m_start = m_words;
+	m_open = true;
+	m_started = false;
+      }
+
+      if(m_envelope == TBM_NONE) {
+	// DESER160 and analog data: the splitter skips everything up to the
+	// 0x8000 start marker, the event ends with the 0x4000 marker (which
+	// can be in the same word) or before the next start marker:
+	if(!m_started) {
+	  if(w & 0x8000) {
+	    m_started = true;
+	    if(w & 0x4000) close(m_words + 1);
+	  }
+	}
+	else if(w & 0x4000) close(m_words + 1);
+	else if(w & 0x8000) { close(m_words); m_start = m_words; m_open = true; m_started = true; }
+      }
+      else {
+	// TBM envelope: without header the splitter takes the next word as
+	// header instead. The event ends with the last TBM trailer word or
+	// before the next header:
+	bool header = ((w & 0xe000) == 0xa000);
+	if(m_start == m_words) m_started = header;
+	else if(!m_started) m_started = true;
+	else if(header) { close(m_words); m_start = m_words; m_open = true; m_started = true; }
+	else if((w & (m_envelope == TBM_EMU ? 0xef00 : 0xe000)) == 0xc000) close(m_words + 1);
+      }
+    }
+  }
+
+  void rawIndex::finish() { close(m_words); }
+
+  bool rawIndex::write(std::string filename) {
+    finish();
+
+    FILE * file = fopen(filename.c_str(), "wb");
+    if(!file) {
+      LOG(logERROR) << "Could not open index file " << filename;
+      return false;
+    }
+
+    uint32_t envelope = m_envelope;
+    uint32_t nchannels = static_cast<uint32_t>(m_offsets.size());
+    bool ok = fwrite(RAWINDEX_MAGIC, 1, RAWINDEX_MAGIC_SIZE, file) == RAWINDEX_MAGIC_SIZE
+      && fwrite(&envelope, sizeof(envelope), 1, file) == 1
+      && fwrite(&nchannels, sizeof(nchannels), 1, file) == 1
+      && fwrite(&m_words, sizeof(m_words), 1, file) == 1;
+
+    for(size_t ch = 0; ok && ch < m_offsets.size(); ch++) {
+      uint64_t nevents = m_offsets.at(ch).size();
+      ok = fwrite(&nevents, sizeof(nevents), 1, file) == 1;
+      if(ok && nevents > 0) {
+	ok = fwrite(&m_offsets.at(ch)[0], sizeof(uint64_t), nevents, file) == nevents
+	  && fwrite(&m_lengths.at(ch)[0], sizeof(uint32_t), nevents, file) == nevents;
+      }
+    }
+
+    if(fclose(file) != 0) ok = false;
+    if(!ok) { LOG(logERROR) << "Could not write index file " << filename; }
+    return ok;
+  }
+
+  bool rawIndex::read(std::string filename) {
+    clear();
+
+    FILE * file = fopen(filename.c_str(), "rb");
+    if(!file) return false;
+
+    char magic[RAWINDEX_MAGIC_SIZE];
+    uint32_t envelope = 0, nchannels = 0;
+    bool ok = fread(magic, 1, RAWINDEX_MAGIC_SIZE, file) == RAWINDEX_MAGIC_SIZE
+      && memcmp(magic, RAWINDEX_MAGIC, RAWINDEX_MAGIC_SIZE) == 0
+      && fread(&envelope, sizeof(envelope), 1, file) == 1
+      && fread(&nchannels, sizeof(nchannels), 1, file) == 1
+      && fread(&m_words, sizeof(m_words), 1, file) == 1
+      && nchannels <= DTB_DAQ_CHANNELS;
+
+    if(ok) {
+      m_envelope = static_cast<uint8_t>(envelope);
+      m_offsets.resize(nchannels);
+      m_lengths.resize(nchannels);
+    }
+
+    for(size_t ch = 0; ok && ch < nchannels; ch++) {
+      uint64_t nevents = 0;
+      ok = fread(&nevents, sizeof(nevents), 1, file) == 1 && nevents <= m_words;
+      if(ok && nevents > 0) {
+	m_offsets.at(ch).resize(nevents);
+	m_lengths.at(ch).resize(nevents);
+	ok = fread(&m_offsets.at(ch)[0], sizeof(uint64_t), nevents, file) == nevents
+	  && fread(&m_lengths.at(ch)[0], sizeof(uint32_t), nevents, file) == nevents;
+      }
+      // Reject indices pointing outside of the raw file:
+      for(size_t i = 0; ok && i < nevents; i++) {
+	if(m_offsets.at(ch)[i] + m_lengths.at(ch)[i] > m_words) ok = false;
+      }
+    }
+    fclose(file);
+
+    if(!ok) {
+      LOG(logERROR) << "Could not read index file " << filename;
+      clear();
+    }
+    return ok;
+  }
+
+}
@@ -0,0 +1,86 @@
+#ifndef PXAR_RAWINDEX_H
+#define PXAR_RAWINDEX_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "pxardllexport.h"
+
+// Index files start with this 8 byte magic string, followed by the
+// envelope type and the number of channels (4 bytes each), the number of
+// words of the indexed raw file (8 bytes) and for every channel the number
+// of events (8 bytes), their word offsets (8 bytes each) and lengths (4
+// bytes each). All values are stored in host byte order like the raw data.
+#define RAWINDEX_MAGIC "PXARIDX1"
+#define RAWINDEX_MAGIC_SIZE 8
+
+namespace pxar {
+
+  /** Event offset index of a raw DTB data file as written by pxardaq.
+   *
+   *  The index is built in a single pass over the data, which can be fed
+   *  in arbitrary pieces in file order. Event boundaries are found with the
+   *  same markers the dtbEventSplitter uses for the given envelope type, so
+   *  every indexed event can be split and decoded on its own. Data of
+   *  several DAQ channels can be indexed by passing the channel with every
+   *  piece; an open event is closed when data of another channel follows.
+   */
+  class DLLEXPORT rawIndex {
+  public:
+    rawIndex(uint8_t tbmtype = 0);
+
+    /** Indexes the next nwords words of the file, read from the given
+     *  DAQ channel
+     */
+    void add(const uint16_t * data, size_t nwords, uint8_t channel = 0);
+
+    /** Closes the last open event, to be called after the last add()
+     */
+    void finish();
+
+    void clear();
+
+    /** Writes the index to a file, returns false on failure
+     */
+    bool write(std::string filename);
+
+    /** Reads an index file, returns false if it could not be read or is
+     *  not an index file
+     */
+    bool read(std::string filename);
+
+    uint8_t envelopeType() const { return m_envelope; }
+    uint64_t words() const { return m_words; }
+    size_t channels() const { return m_offsets.size(); }
+    uint64_t events() const;
+
+    /** Word offsets and lengths of all events of the channel
+     */
+    const std::vector<uint64_t> & offsets(size_t channel) const { return m_offsets.at(channel); }
+    const std::vector<uint32_t> & lengths(size_t channel) const { return m_lengths.at(channel); }
+
+    /** Default index file name for a raw data file
+     */
+    static std::string indexFile(std::string rawfile) { return rawfile + ".idx"; }
+
+  private:
+    uint8_t m_envelope;
+    uint64_t m_words;
+
+    std::vector<std::vector<uint64_t> > m_offsets;
+    std::vector<std::vector<uint32_t> > m_lengths;
+
+    // Indexer state: channel of the last piece, the start of the event
+    // still open in that channel, if any, and whether its start marker was
+    // seen already:
+    uint8_t m_channel;
+    uint64_t m_start;
+    bool m_open;
+    bool m_started;
+
+    void close(uint64_t end);
+  };
+
+}
+#endif // PXAR_RAWINDEX_H
@@ -2,7 +2,13 @@
 #include "datatypes.h"
 #include "log.h"
 #include "constants.h"
+#include "generator.h"
 #include <stdlib.h>
+#include <cmath>
+#include <sstream>
+#ifndef WIN32
+#include <pthread.h>
+#endif
 
 namespace pxar {
   
@@ -69,22 +75,51 @@ namespace pxar {
 
   }
 
-  void fillRawData(uint32_t event, std::vector<uint16_t> &data, uint8_t tbm, uint8_t nroc, bool empty, bool noise, size_t col, size_t row, std::vector<uint16_t> pattern, uint32_t flags) {
+  uint16_t tbmTrailer(const std::vector<uint16_t> &pattern) {
+    uint16_t trailer = 0xe000;
+    for(size_t i = 0; i < pattern.size(); i++) {
+      if((pattern.at(i)&PG_REST) != 0) trailer |= (1 << 6);
+      if((pattern.at(i)&PG_RESR) != 0) trailer |= (1 << 5);
+    }
+    return trailer;
+  }
 
+  size_t beginEvent(std::vector<uint16_t> &data, uint32_t event, uint8_t tbm) {
     size_t pos = data.size();
-    
     // Add a TBM header if necessary:
     if(tbm != TBM_NONE) {
       data.push_back(0xa000 | (event%256 & 0x00ff));
       data.push_back(0x8007);
     }
+    return pos;
+  }
+
+  void addRocHeader(std::vector<uint16_t> &data, uint8_t tbm) {
+    if(tbm == TBM_EMU) data.push_back(0x47f8);
+    else if(tbm != TBM_NONE) data.push_back(0x4001);
+    else data.push_back(0x07f8);
+  }
+
+  void endEvent(std::vector<uint16_t> &data, size_t pos, uint8_t tbm, uint8_t nroc, uint16_t trailer) {
+    // Add a TBM trailer if necessary:
+    if(tbm != TBM_NONE) {
+      data.push_back(trailer | ((nroc==0) << 7));
+      data.push_back(0xc002);
+    }
+    // Adjust event start and end marker:
+    else if(data.size() > pos) {
+      data.at(pos) = 0x8000 | (data.at(pos) & 0x0fff);
+      data.back() = 0x4000 | (data.back() & 0x8fff);
+    }
+  }
+
+  void fillRawData(uint32_t event, std::vector<uint16_t> &data, uint8_t tbm, uint8_t nroc, bool empty, bool noise, size_t col, size_t row, std::vector<uint16_t> pattern, uint32_t flags) {
+
+    size_t pos = beginEvent(data, event, tbm);
 
     // For every ROC configured, add one noise hit:
     for(size_t roc = 0; roc < nroc; roc++) {
-      // Add a ROC header:
-      if(tbm == TBM_EMU) data.push_back(0x47f8);
-      else if(tbm != TBM_NONE) data.push_back(0x4001);
-      else data.push_back(0x07f8);
+      addRocHeader(data, tbm);
 
       if(!empty) {
 	// Add pixel hit:
@@ -104,21 +139,180 @@ namespace pxar {
       }
     }
 
-    // Add a TBM trailer if necessary:
-    if(tbm != TBM_NONE) {
-      bool has_tbm_reset = false;
-      bool has_roc_reset = false;
-      for(size_t i = 0; i < pattern.size(); i++) {
-	if((pattern.at(i)&PG_REST) != 0) has_tbm_reset = true;
-	if((pattern.at(i)&PG_RESR) != 0) has_roc_reset = true;
+    endEvent(data, pos, tbm, nroc, tbmTrailer(pattern));
+  }
+
+  uint32_t fastRandom::poisson(double mean) {
+    if(mean <= 0) return 0;
+    // Gaussian approximation for large means:
+    if(mean > 30) {
+      double g = sqrt(-2*log(uniform()))*cos(2*M_PI*uniform());
+      double n = mean + sqrt(mean)*g + 0.5;
+      return (n < 0 ? 0 : static_cast<uint32_t>(n));
+    }
+    // Knuth's multiplication method otherwise:
+    double limit = exp(-mean), p = uniform();
+    uint32_t n = 0;
+    while(p > limit) { p *= uniform(); n++; }
+    return n;
+  }
+
+  generatorConfig::generatorConfig(const std::string &config) : seed(1), occupancy(1.0), clustersize(2.0), phmpv(80.0), phwidth(10.0), corruption(0.0), threads(1), events(1000) {
+    std::stringstream ss(config);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+      size_t eq = item.find('=');
+      if(eq == std::string::npos) continue;
+      std::string key = item.substr(0,eq);
+      double value = atof(item.substr(eq+1).c_str());
+      if(key == "seed") seed = static_cast<uint64_t>(value);
+      else if(key == "occupancy") occupancy = value;
+      else if(key == "cluster") clustersize = (value < 1 ? 1 : value);
+      else if(key == "phmpv") phmpv = value;
+      else if(key == "phwidth") phwidth = value;
+      else if(key == "corruption") corruption = value;
+      else if(key == "threads") threads = (value < 1 ? 1 : static_cast<uint32_t>(value));
+      else if(key == "events") events = static_cast<uint32_t>(value);
+      else LOG(logWARNING) << "Unknown hit generator setting \"" << key << "\"";
+    }
+  }
+
+  timingConfig::timingConfig(const std::string &config) : latency(250.0), call(5.0), bandwidth(20.0), trigger(10.0), pixel(50.0), buffer(DTB_SOURCE_BUFFER_SIZE) {
+    std::stringstream ss(config);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+      size_t eq = item.find('=');
+      if(eq == std::string::npos) continue;
+      std::string key = item.substr(0,eq);
+      double value = atof(item.substr(eq+1).c_str());
+      if(key == "latency") latency = value;
+      else if(key == "call") call = value;
+      else if(key == "bandwidth") bandwidth = value;
+      else if(key == "trigger") trigger = value;
+      else if(key == "pixel") pixel = value;
+      else if(key == "buffer") buffer = static_cast<uint32_t>(value);
+      else LOG(logWARNING) << "Unknown timing model setting \"" << key << "\"";
+    }
+  }
+
+  static void uDelay(double us) {
+    if(us < 1) return;
+#ifdef WIN32
+    Sleep(static_cast<DWORD>(us/1000));
+#else
+    usleep(static_cast<useconds_t>(us));
+#endif
+  }
+
+  void timingModel::transfer(size_t bytes, bool roundtrip) const {
+    // 1 MB/s equals 1 byte/us:
+    double t = _pending + (_config.bandwidth > 0 ? bytes/_config.bandwidth : 0);
+    // Calls without return value are queued like on the link, their time is
+    // paid with the next round trip or once it adds up to a millisecond:
+    if(!roundtrip) {
+      _pending = t + _config.call;
+      if(_pending < 1000) return;
+    }
+    else t += _config.latency;
+    _pending = 0;
+    uDelay(t);
+  }
+
+  void timingModel::loop(size_t triggers, uint16_t ntriggers) const {
+    uDelay(_pending + triggers*_config.trigger + (ntriggers > 0 ? _config.pixel*triggers/ntriggers : 0));
+    _pending = 0;
+  }
+
+  void hitGenerator::fillEvent(std::vector<uint16_t> &data, uint32_t event, uint8_t tbm, uint8_t nroc, uint16_t trailer) const {
+
+    fastRandom rnd(_config.seed ^ (static_cast<uint64_t>(event) << 20));
+    size_t pos = beginEvent(data, event, tbm);
+
+    for(size_t roc = 0; roc < nroc; roc++) {
+      addRocHeader(data, tbm);
+
+      uint32_t nclusters = rnd.poisson(_config.occupancy);
+      for(uint32_t c = 0; c < nclusters; c++) {
+	// Seed pixel and random walk to the neighbours:
+	int col = rnd.integer(ROC_NUMCOLS);
+	int row = rnd.integer(ROC_NUMROWS);
+	uint32_t npix = 1 + rnd.poisson(_config.clustersize - 1);
+	for(uint32_t p = 0; p < npix; p++) {
+	  if(p > 0) {
+	    uint32_t step = rnd.integer(4);
+	    if(step == 0 && col > 0) col--;
+	    else if(step == 1 && col < ROC_NUMCOLS-1) col++;
+	    else if(step == 2 && row > 0) row--;
+	    else if(row < ROC_NUMROWS-1) row++;
+	  }
+	  // Landau-like pulse height spectrum:
+	  double ph = _config.phmpv - _config.phwidth*log(-log(rnd.uniform()));
+	  uint16_t pulseheight = static_cast<uint16_t>(ph < 0 ? 0 : (ph > 255 ? 255 : ph));
+	  uint32_t word = pixel(static_cast<uint8_t>(roc),static_cast<uint8_t>(col),static_cast<uint8_t>(row),pulseheight).encode();
+	  data.push_back(0x0000 | ((word >> 12) & 0x0fff));
+	  data.push_back(0x2000 | (word & 0x0fff));
+	}
       }
-      data.push_back(0xe000 | ((nroc==0) << 7) | (has_tbm_reset << 6) | (has_roc_reset << 5));
-      data.push_back(0xc002);
     }
-    // Adjust event start and end marker:
-    else {
-      data.at(pos) = 0x8000 | (data.at(pos) & 0x0fff);
-      data.at(data.size()-1) = 0x4000 | (data.back() & 0x8fff);
+
+    endEvent(data, pos, tbm, nroc, trailer);
+
+    // Flip single bits to emulate transmission errors:
+    if(_config.corruption > 0) {
+      for(size_t i = pos + static_cast<size_t>(-log(rnd.uniform())/_config.corruption); i < data.size();
+	  i += 1 + static_cast<size_t>(-log(rnd.uniform())/_config.corruption)) {
+	data.at(i) ^= (1 << rnd.integer(16));
+      }
+    }
+  }
+
+  namespace {
+    struct generatorJob {
+      const hitGenerator * gen;
+      std::vector<uint16_t> data;
+      uint32_t first, nevents;
+      uint8_t tbm, nrocs;
+      uint16_t trailer;
+    };
+
+    void * runGeneratorJob(void * arg) {
+      generatorJob * job = reinterpret_cast<generatorJob*>(arg);
+      for(uint32_t e = job->first; e < job->first + job->nevents; e++) job->gen->fillEvent(job->data, e, job->tbm, job->nrocs, job->trailer);
+      return NULL;
+    }
+  }
+
+  void hitGenerator::fill(std::vector<uint16_t> &data, uint32_t first, uint32_t nevents, uint8_t tbm, uint8_t nrocs, const std::vector<uint16_t> &pattern) const {
+
+    uint16_t trailer = tbmTrailer(pattern);
+
+    // Not worth spawning threads for a handful of events:
+    uint32_t nthreads = std::min(_config.threads, nevents/256);
+#ifdef WIN32
+    nthreads = 1;
+#endif
+    if(nthreads <= 1) {
+      for(uint32_t e = first; e < first + nevents; e++) fillEvent(data, e, tbm, nrocs, trailer);
+      return;
+    }
+
+#ifndef WIN32
+    // Generate consecutive event ranges in parallel and concatenate them:
+    std::vector<generatorJob> jobs(nthreads);
+    std::vector<pthread_t> threads(nthreads);
+    for(uint32_t t = 0; t < nthreads; t++) {
+      jobs[t].gen = this;
+      jobs[t].first = first + static_cast<uint32_t>(static_cast<uint64_t>(nevents)*t/nthreads);
+      jobs[t].nevents = first + static_cast<uint32_t>(static_cast<uint64_t>(nevents)*(t+1)/nthreads) - jobs[t].first;
+      jobs[t].tbm = tbm;
+      jobs[t].nrocs = nrocs;
+      jobs[t].trailer = trailer;
+      pthread_create(&threads[t], NULL, runGeneratorJob, &jobs[t]);
+    }
+    for(uint32_t t = 0; t < nthreads; t++) {
+      pthread_join(threads[t], NULL);
+      data.insert(data.end(), jobs[t].data.begin(), jobs[t].data.end());
     }
+#endif
   }
 }
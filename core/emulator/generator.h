@@ -26,7 +26,10 @@ typedef unsigned char uint8_t;
 
 #include "api.h"
 #include "datatypes.h"
+#include "constants.h"
 #include <stdlib.h>
+#include <string>
+#include <vector>
 
 namespace pxar {
   
@@ -35,7 +38,137 @@ namespace pxar {
   
   bool isInTornadoRegion(size_t dac1min, size_t dac1max, size_t dac1, size_t dac2min, size_t dac2max, size_t dac2);
   void fillEvent(pxar::Event * evt, uint8_t rocid, size_t col, size_t row, uint32_t flags);
+  /** Event framing shared by all emulated data streams: beginEvent() adds
+   *  the TBM header and returns the start position of the event, endEvent()
+   *  adds the TBM trailer or sets the DESER160 start and end markers.
+   *  tbmTrailer() is the trailer word with the reset bits of the pattern.
+   */
+  uint16_t tbmTrailer(const std::vector<uint16_t> &pattern);
+  size_t beginEvent(std::vector<uint16_t> &data, uint32_t event, uint8_t tbm);
+  void addRocHeader(std::vector<uint16_t> &data, uint8_t tbm);
+  void endEvent(std::vector<uint16_t> &data, size_t pos, uint8_t tbm, uint8_t nrocs, uint16_t trailer);
+
   void fillRawData(uint32_t event, std::vector<uint16_t> &data, uint8_t tbm, uint8_t nrocs, bool empty, bool noise, size_t col, size_t row, std::vector<uint16_t> pattern = std::vector<uint16_t>(), uint32_t flags = 0);
+
+  /** Small and fast pseudo random number generator (xorshift64*), seeded
+   *  via splitmix64 so that neighbouring seeds give independent sequences
+   */
+  class fastRandom {
+  public:
+    fastRandom(uint64_t seed) { reseed(seed); }
+    void reseed(uint64_t seed) {
+      uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      state = (z ^ (z >> 31)) | 1;
+    }
+    uint64_t next() {
+      state ^= state >> 12; state ^= state << 25; state ^= state >> 27;
+      return state * 0x2545f4914f6cdd1dULL;
+    }
+    /** Uniform in [0,n) */
+    uint32_t integer(uint32_t n) { return static_cast<uint32_t>((next() >> 32) * n >> 32); }
+    /** Uniform in (0,1) */
+    double uniform() { return (static_cast<double>(next() >> 11) + 0.5) / 9007199254740992.0; }
+    /** Poisson distributed number with the given mean */
+    uint32_t poisson(double mean);
+  private:
+    uint64_t state;
+  };
+
+  /** Configuration of the hit generator, parsed from a comma-separated
+   *  list of key=value pairs, e.g. "occupancy=5,cluster=2.5,threads=4":
+   *  seed       - seed of the random number generator
+   *  occupancy  - mean number of particle hits (clusters) per ROC and trigger
+   *  cluster    - mean number of pixels per cluster
+   *  phmpv      - most probable pulse height
+   *  phwidth    - width of the pulse height distribution
+   *  corruption - probability per data word to have one bit flipped
+   *  threads    - number of threads generating events in parallel
+   *  events     - events delivered per channel with external triggers before
+   *               the DAQ buffer is reported empty
+   */
+  struct generatorConfig {
+    uint64_t seed;
+    double occupancy;
+    double clustersize;
+    double phmpv;
+    double phwidth;
+    double corruption;
+    uint32_t threads;
+    uint32_t events;
+  generatorConfig() : seed(1), occupancy(1.0), clustersize(2.0), phmpv(80.0), phwidth(10.0), corruption(0.0), threads(1), events(1000) {}
+    generatorConfig(const std::string &config);
+  };
+
+  /** Generator of physics-like raw data: Poisson-distributed number of
+   *  clusters per ROC, clusters grown around a seed pixel and Landau-like
+   *  (Gumbel) pulse heights, framed like fillRawData() with beginEvent() and
+   *  endEvent(). Every event uses its own random sequence
+   *  derived from seed and event number, the data are therefore identical
+   *  for any number of threads.
+   */
+  class hitGenerator {
+  public:
+    hitGenerator(const generatorConfig &config) : _config(config) {}
+    const generatorConfig & config() const { return _config; }
+
+    /** Appends the events first ... first+nevents-1 for one DAQ channel */
+    void fill(std::vector<uint16_t> &data, uint32_t first, uint32_t nevents, uint8_t tbm, uint8_t nrocs, const std::vector<uint16_t> &pattern) const;
+
+    /** Appends a single event, trailer is the TBM trailer word including
+     *  the reset bits of the pattern generator
+     */
+    void fillEvent(std::vector<uint16_t> &data, uint32_t event, uint8_t tbm, uint8_t nrocs, uint16_t trailer) const;
+
+  private:
+    generatorConfig _config;
+  };
+
+  /** Configuration of the emulator timing model, parsed from a comma-separated
+   *  list of key=value pairs like generatorConfig:
+   *  latency   - round trip time of an RPC call returning data, in us
+   *  call      - time to send an RPC call without return value, in us
+   *  bandwidth - throughput of the DTB link in MB/s
+   *  trigger   - NIOS loop execution time per trigger, in us
+   *  pixel     - NIOS loop overhead per pixel (masking, calibrate), in us
+   *  buffer    - DTB RAM per DAQ channel in 16bit words; loops are interrupted
+   *              when their data would not fit
+   */
+  struct timingConfig {
+    double latency;
+    double call;
+    double bandwidth;
+    double trigger;
+    double pixel;
+    uint32_t buffer;
+  timingConfig() : latency(250.0), call(5.0), bandwidth(20.0), trigger(10.0), pixel(50.0), buffer(DTB_SOURCE_BUFFER_SIZE) {}
+    timingConfig(const std::string &config);
+  };
+
+  /** Timing model of the emulated DTB: delays the calling thread by the
+   *  time the corresponding operation would take on real hardware
+   */
+  class timingModel {
+  public:
+    timingModel(const timingConfig &config) : _config(config), _pending(0) {}
+    const timingConfig & config() const { return _config; }
+
+    /** One RPC call transferring the given number of bytes, waiting for
+     *  the round trip or only sending the call
+     */
+    void transfer(size_t bytes, bool roundtrip = true) const;
+
+    /** NIOS loop execution for the given number of triggers, with
+     *  ntriggers triggers sent per pixel
+     */
+    void loop(size_t triggers, uint16_t ntriggers) const;
+
+  private:
+    timingConfig _config;
+    // time of queued calls without return value, in us
+    mutable double _pending;
+  };
   
 }
 
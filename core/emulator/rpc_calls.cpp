@@ -5,259 +5,419 @@
 #include "config.h"
 #include "constants.h"
 #include <vector>
+#include <limits>
 
 using namespace pxar;
 
+CTestboard::~CTestboard() {
+  delete generator;
+  delete timing;
+}
+
+void CTestboard::InitGenerator() {
+  const char * config = getenv("PXAR_EMULATOR_GENERATOR");
+  if(config == NULL) return;
+  generator = new hitGenerator(generatorConfig(config));
+  LOG(logINFO) << "Emulator generates hits with occupancy " << generator->config().occupancy
+	       << " and cluster size " << generator->config().clustersize << " using "
+	       << generator->config().threads << " thread(s).";
+}
+
+void CTestboard::InitTiming() {
+  const char * config = getenv("PXAR_EMULATOR_TIMING");
+  if(config == NULL) return;
+  timing = new timingModel(timingConfig(config));
+  LOG(logINFO) << "Emulator timing model: " << timing->config().latency << "us latency, "
+	       << timing->config().call << "us per call, "
+	       << timing->config().bandwidth << "MB/s, DTB RAM of " << timing->config().buffer << " words.";
+}
+
+// RPC message header (type, command, parameter size) and header of data
+// blocks like vectors and strings (type, size), in bytes:
+#define RPC_MSG_HEADER 4
+#define RPC_DATA_HEADER 4
+
+void CTestboard::rpcWrite(size_t request) {
+  if(timing) timing->transfer(RPC_MSG_HEADER + request, false);
+}
+
+void CTestboard::rpcRead(size_t request, size_t response) {
+  if(timing) timing->transfer(2*RPC_MSG_HEADER + request + response, true);
+}
+
+bool CTestboard::loopInterrupted() {
+  if(!timing) return false;
+  for(size_t ch = 0; ch < DTB_DAQ_CHANNELS; ch++) {
+    if(loop_pending_pos.at(ch) < loop_pending.at(ch).size()) return true;
+  }
+  return false;
+}
+
+bool CTestboard::loopRelease(uint16_t nTriggers) {
+  if(!timing) return true;
+
+  // Freshly generated loop data is taken out of the DAQ buffers first:
+  if(!loopInterrupted()) {
+    for(size_t ch = 0; ch < DTB_DAQ_CHANNELS; ch++) {
+      loop_pending.at(ch).clear();
+      loop_pending.at(ch).swap(daq_buffer.at(ch));
+      loop_pending_pos.at(ch) = 0;
+    }
+  }
+
+  // Find the number of events fitting into the DTB RAM of every channel:
+  size_t nevents = std::numeric_limits<size_t>::max();
+  size_t total = 0;
+  std::vector<std::vector<size_t> > starts(DTB_DAQ_CHANNELS);
+  for(size_t ch = 0; ch < DTB_DAQ_CHANNELS; ch++) {
+    const std::vector<uint16_t> &pending = loop_pending.at(ch);
+    size_t pos = loop_pending_pos.at(ch);
+    if(pending.size() <= pos) continue;
+    for(size_t i = pos; i < pending.size(); i++) {
+      if(tbmtype != TBM_NONE ? (pending[i]&0xe000) == 0xa000 : (pending[i]&0x8000) != 0) starts.at(ch).push_back(i);
+    }
+    starts.at(ch).push_back(pending.size());
+    size_t space = (timing->config().buffer > daq_buffer.at(ch).size() ? timing->config().buffer - daq_buffer.at(ch).size() : 0);
+    size_t fit = 0;
+    while(fit + 1 < starts.at(ch).size() && starts.at(ch).at(fit + 1) - pos <= space) fit++;
+    nevents = std::min(nevents, fit);
+    total = std::max(total, starts.at(ch).size() - 1);
+  }
+
+  // Like the NIOS, only interrupt after all triggers of a pixel:
+  if(nevents < total) {
+    size_t ntrig = std::max<uint16_t>(nTriggers,1);
+    nevents = std::max(nevents - nevents%ntrig, std::min(ntrig, total));
+  }
+  else nevents = total;
+
+  // Move the data of these events to the DTB RAM:
+  for(size_t ch = 0; ch < DTB_DAQ_CHANNELS; ch++) {
+    std::vector<uint16_t> &pending = loop_pending.at(ch);
+    if(pending.size() <= loop_pending_pos.at(ch)) continue;
+    size_t end = starts.at(ch).at(std::min(nevents, starts.at(ch).size() - 1));
+    daq_buffer.at(ch).insert(daq_buffer.at(ch).end(), pending.begin() + loop_pending_pos.at(ch), pending.begin() + end);
+    loop_pending_pos.at(ch) = end;
+  }
+  timing->loop(nevents, nTriggers);
+
+  bool done = !loopInterrupted();
+  if(done) {
+    for(size_t ch = 0; ch < DTB_DAQ_CHANNELS; ch++) {
+      loop_pending.at(ch).clear();
+      loop_pending_pos.at(ch) = 0;
+    }
+  }
+  LOG(logDEBUGRPC) << "Loop " << (done ? "finished" : "interrupted") << " after " << nevents << " events.";
+  return done;
+}
+
 void CTestboard::GetInfo(std::string &message) {
   LOG(pxar::logDEBUGRPC) << "called.";
   message = " pxarCore DTB Emulator \n "
     + std::string(PACKAGE_STRING)
     + "\n";
+  rpcRead(0, RPC_DATA_HEADER + message.size());
 }
 
 uint16_t CTestboard::GetBoardId() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return 0x0;
 }
 
 void CTestboard::GetHWVersion(std::string &rpc_par1) {
   LOG(pxar::logDEBUGRPC) << "called.";
   rpc_par1 = "Hardware Revision 0";
+  rpcRead(0, RPC_DATA_HEADER + rpc_par1.size());
 }
 
 uint16_t CTestboard::GetFWVersion() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return 0x0;
 }
 
 uint16_t CTestboard::GetSWVersion() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return 0x0;
 }
 
 uint16_t CTestboard::UpgradeGetVersion() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return 0x0100;
 }
 
 uint8_t CTestboard::UpgradeStart(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(2, 1);
   return 0;
 }
 
-uint8_t CTestboard::UpgradeData(std::string &) {
+uint8_t CTestboard::UpgradeData(std::string &record) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(RPC_DATA_HEADER + record.size(), 1);
   return 0;
 }
 
 uint8_t CTestboard::UpgradeError() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 1);
   return 0;
 }
 
 void CTestboard::UpgradeErrorMsg(std::string &rpc_par1) {
   LOG(pxar::logDEBUGRPC) << "called.";
   rpc_par1 = "No error.";
+  rpcRead(0, RPC_DATA_HEADER + rpc_par1.size());
 }
 
 void CTestboard::UpgradeExec(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Init() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::Welcome() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::SetLed(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::cDelay(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::uDelay(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
   pxar::mDelay(1);
 }
 
 // Emulator always has the same clock:
 void CTestboard::SetClockSource(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 bool CTestboard::IsClockPresent() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 1);
   return true;
 }
 
 void CTestboard::SetClock(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::SetClockStretch(uint8_t, uint16_t, uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(5);
 }
 
 void CTestboard::Sig_SetMode(uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Sig_SetPRBS(uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Sig_SetDelay(uint8_t, uint16_t, int8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(4);
 }
 
 void CTestboard::Sig_SetLevel(uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Sig_SetOffset(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::Sig_SetLVDS() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::Sig_SetLCDS() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::Sig_SetRdaToutDelay(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::SignalProbeDeserD1(uint8_t a, uint8_t b) {
   LOG(pxar::logDEBUGRPC) << "called with " << std::hex << static_cast<int>(a) << " " << static_cast<int>(b) << std::dec;
+  rpcWrite(2);
 }
 
 void CTestboard::SignalProbeDeserD2(uint8_t a, uint8_t b) {
   LOG(pxar::logDEBUGRPC) << "called with " << std::hex << static_cast<int>(a) << " " << static_cast<int>(b) << std::dec;
+  rpcWrite(2);
 }
 
 void CTestboard::SignalProbeD1(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::SignalProbeD2(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::SignalProbeA1(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::SignalProbeA2(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::SignalProbeADC(uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Pon() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::Poff() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::_SetVD(uint16_t voltage) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
   vd = voltage;
 }
 
 void CTestboard::_SetVA(uint16_t voltage) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
   va = voltage;
 }
 
 void CTestboard::_SetID(uint16_t current) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
   id = current;
 }
 
 void CTestboard::_SetIA(uint16_t current) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
   ia = current;
 }
 
 uint16_t CTestboard::_GetVD() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return vd;
 }
 
 uint16_t CTestboard::_GetVA() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return va;
 }
 
 uint16_t CTestboard::_GetID() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return id;
 }
 
 uint16_t CTestboard::_GetIA() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return ia;
 }
 
 uint16_t CTestboard::_GetVD_Reg() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return vd;
 }
 
 uint16_t CTestboard::_GetVDAC_Reg() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return vd;
 }
 
 uint16_t CTestboard::_GetVD_Cap() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 2);
   return vd;
 }
 
 void CTestboard::HVon() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::HVoff() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::ResetOn() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::ResetOff() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 uint8_t CTestboard::GetStatus() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 1);
   return 0;
 }
 
 void CTestboard::SetRocAddress(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::Pg_SetCmd(uint16_t, uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(4);
 }
 
 // FIXME PG could be used for real.
 void CTestboard::Pg_SetCmdAll(std::vector<uint16_t> &pg) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(RPC_DATA_HEADER + 2*pg.size());
   // Store pattern generator:
   pg_setup = std::vector<uint16_t>(pg);
   LOG(logDEBUGRPC) << "Pattern Generator is:" << listVector(pg_setup);
@@ -265,33 +425,43 @@ void CTestboard::Pg_SetCmdAll(std::vector<uint16_t> &pg) {
 
 void CTestboard::Pg_SetSum(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Pg_Stop() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::Pg_Single() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::Pg_Trigger() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 // Receiving triggers for PG:
 void CTestboard::Pg_Triggers(uint32_t nTriggers, uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(6);
 
   // Check how many open DAQ channels we have:
   size_t channels = std::count(daq_status.begin(), daq_status.end(), true);
-  // Distribute the ROCs evenly:
-  size_t roc_per_ch = roci2c.size()/channels;
+
+  if(generator) {
+    for(size_t ch = 0; ch < channels; ch++) {
+      generator->fill(daq_buffer.at(ch),daq_event.at(ch),nTriggers,tbmtype,rocsOnChannel(ch,roci2c.size()),pg_setup);
+      daq_event.at(ch) += nTriggers;
+    }
+    return;
+  }
 
   for(size_t i = 0; i < nTriggers; i++) {
     for(size_t ch = 0; ch < channels; ch++) {
-      size_t rocs = notokenpass(tbmtype,ch) ? 0 : roc_per_ch;
-      fillRawData(i,daq_buffer.at(ch),tbmtype,rocs,false,true,0,0);
+      fillRawData(i,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2c.size()),false,true,0,0);
     }
   }
 }
@@ -299,12 +469,14 @@ void CTestboard::Pg_Triggers(uint32_t nTriggers, uint16_t) {
 // FIXME Receiving loop command
 void CTestboard::Pg_Loop(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
   // Set DAQ into state where it always returns events.
 }
 
 // Trigger selection
 void CTestboard::Trigger_Select(uint16_t src) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
   // Store trigger:
   trigger = src;
   // Triggers via TBM Emulator:
@@ -313,27 +485,33 @@ void CTestboard::Trigger_Select(uint16_t src) {
 
 void CTestboard::Trigger_Delay(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::Trigger_Timeout(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Trigger_SetGenPeriodic(uint32_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(4);
 }
 
 void CTestboard::Trigger_SetGenRandom(uint32_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(4);
 }
 
 void CTestboard::Trigger_Send(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 // DAQ Open
 uint32_t CTestboard::Daq_Open(uint32_t buffersize, uint8_t channel) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(5, 4);
 
   if(channel > daq_buffer.size()) return 0;
 
@@ -348,40 +526,47 @@ uint32_t CTestboard::Daq_Open(uint32_t buffersize, uint8_t channel) {
 
 void CTestboard::Daq_Close(uint8_t channel) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
   // Clear DAQ buffer
   daq_buffer.at(channel).clear();
 }
 
 void CTestboard::Daq_Start(uint8_t channel) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
   daq_status.at(channel) = true;
   daq_event.at(channel) = 0;
 }
 
 void CTestboard::Daq_Stop(uint8_t channel) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
   daq_status.at(channel) = false;
 }
 
 void CTestboard::Daq_MemReset(uint8_t channel) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
   daq_buffer.at(channel).clear();
 }
 
 uint32_t CTestboard::Daq_GetSize(uint8_t channel) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(1, 4);
   if(daq_status.at(channel)) return daq_buffer.at(channel).size();
   else return 0;
 }
 
 uint8_t CTestboard::Daq_FillLevel(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(1, 1);
   // We are always on 30%:
   return 30;
 }
 
 uint8_t CTestboard::Daq_FillLevel() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 1);
   // We are always on 30%:
   return 30;
 }
@@ -394,20 +579,36 @@ uint8_t CTestboard::Daq_Read(std::vector<uint16_t> &data, uint32_t blocksize, ui
 
 uint8_t CTestboard::Daq_Read(std::vector<uint16_t> &data, uint32_t blocksize, uint32_t &available, uint8_t channel) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  uint8_t state = daqReadBlock(data, blocksize, available, channel);
+  rpcRead(5, 5 + RPC_DATA_HEADER + 2*data.size());
+  return state;
+}
+
+uint8_t CTestboard::daqReadBlock(std::vector<uint16_t> &data, uint32_t blocksize, uint32_t &available, uint8_t channel) {
   data.clear();
 
+  // With the hit generator, deliver full blocks until the configured number
+  // of events has been read:
+  if(generator && (trigger == TRG_SEL_ASYNC || trigger == TRG_SEL_ASYNC_DIR)) {
+    if(!daq_status.at(channel)) { available = 0; return 0; }
+    while(daq_buffer.at(channel).size() < blocksize/2 && daq_event.at(channel) < generator->config().events) {
+      uint32_t n = std::min<uint32_t>(256*generator->config().threads, generator->config().events - daq_event.at(channel));
+      generator->fill(daq_buffer.at(channel),daq_event.at(channel),n,tbmtype,rocsOnChannel(channel,roci2c.size()),pg_setup);
+      daq_event.at(channel) += n;
+    }
+  }
   // Fake buffer empty after 1k events:
-  if(eventcounter >= 1000) {
+  else if(eventcounter >= 1000) {
     eventcounter = 0;
     return 0;
   }
   
   // If we are on external triggers, just deliver one event per channel:
-  if(trigger == TRG_SEL_ASYNC || trigger == TRG_SEL_ASYNC_DIR) {
+  else if(trigger == TRG_SEL_ASYNC || trigger == TRG_SEL_ASYNC_DIR) {
     eventcounter++;
     LOG(logDEBUGRPC) << "Event counter: " << eventcounter;
     if(!daq_status.at(channel)) { available = 0; return 0; }
-    fillRawData(daq_event.at(channel)++,daq_buffer.at(channel),tbmtype,roci2c.size(),false,true,0,0,pg_setup);
+    fillRawData(daq_event.at(channel)++,daq_buffer.at(channel),tbmtype,rocsOnChannel(channel,roci2c.size()),false,true,0,0,pg_setup);
     mDelay(10);
   }
 
@@ -423,111 +624,152 @@ uint8_t CTestboard::Daq_Read(std::vector<uint16_t> &data, uint32_t blocksize, ui
   return 0;
 }
 
+uint8_t CTestboard::Daq_Read_Pipelined(pxar::rawBuffer<uint16_t> &data, uint32_t blocksize, uint32_t &available, uint8_t channel, uint8_t depth) {
+  LOG(pxar::logDEBUGRPC) << "called.";
+
+  // Serve the blocks one after the other, the link latency is only paid
+  // once for all requests in flight:
+  std::vector<uint16_t> block;
+  uint8_t state = 0;
+  data.clear();
+  for(uint8_t i = 0; i < std::max<uint8_t>(depth,1); i++) {
+    state |= daqReadBlock(block, blocksize, available, channel);
+    if(!block.empty()) std::copy(block.begin(), block.end(), data.extend(block.size()));
+  }
+  rpcRead(6, 5 + RPC_DATA_HEADER + 2*data.size());
+  return state;
+}
+
 void CTestboard::Daq_Select_ADC(uint16_t, uint8_t, uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(5);
 }
 
 void CTestboard::Daq_Select_Deser160(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::Daq_Select_Deser400() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
   // Produce TBM headers!
 }
 
 void CTestboard::Daq_Deser400_Reset(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::Deser400_SetPhase(uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Deser400_SetPhaseAutoAll() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::Deser400_GateRun(uint8_t,uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Daq_Deser400_OldFormat(bool) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::Daq_Select_Datagenerator(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::Daq_DeselectAll() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 // Collect all ROCs that have ever been programmed:
 void CTestboard::roc_I2cAddr(uint8_t i2c) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
   std::vector<uint8_t>::iterator thisroc = std::find(roci2c.begin(),roci2c.end(),i2c);
   if(thisroc == roci2c.end()) roci2c.push_back(i2c);
 }
 
 void CTestboard::roc_ClrCal() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 void CTestboard::roc_SetDAC(uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::roc_Pix(uint8_t, uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(3);
 }
 
 void CTestboard::roc_Pix_Trim(uint8_t, uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(3);
 }
 
 void CTestboard::roc_Pix_Mask(uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::roc_Pix_Cal(uint8_t, uint8_t, bool) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(3);
 }
 
 void CTestboard::roc_Col_Enable(uint8_t, bool) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::roc_AllCol_Enable(bool) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::roc_Col_Mask(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 void CTestboard::roc_Chip_Mask() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
 }
 
 bool CTestboard::TBM_Present() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(0, 1);
   return (tbmtype != TBM_NONE);
 }
 
 void CTestboard::tbm_Enable(bool tbm) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
   if(tbm) tbmtype = TBM_08;
   else tbmtype = TBM_NONE;
 }
 
 void CTestboard::tbm_Addr(uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::mod_Addr(uint8_t hubid) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
   // Add this TBM to the map:
   std::map<uint8_t, uint8_t> regmap;
   std::map<uint8_t, std::map<uint8_t,uint8_t> > coremap;
@@ -541,10 +783,12 @@ void CTestboard::mod_Addr(uint8_t hubid) {
 
 void CTestboard::mod_Addr(uint8_t, uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::tbm_Set(uint8_t reg, uint8_t val) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 
   LOG(logDEBUGRPC) << "Set " << (int)active_tbm << " " << std::hex << (int)(reg&0xF0) << " " << (int)(reg&0x0F) << " " << (int)val;
   
@@ -560,48 +804,71 @@ void CTestboard::tbm_Set(uint8_t reg, uint8_t val) {
 
 void CTestboard::tbm_SelectRDA(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(1);
 }
 
 bool CTestboard::tbm_Get(uint8_t, uint8_t &) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(1, 2);
   return true;
 }
 
 bool CTestboard::tbm_GetRaw(uint8_t, uint32_t &) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(1, 5);
   return true;
 }
 
-int16_t CTestboard::TrimChip(std::vector<int16_t> &) {
+int16_t CTestboard::TrimChip(std::vector<int16_t> &trim) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(RPC_DATA_HEADER + 2*trim.size(), 2);
   return 0;
 }
 
-// FIXME do we emulate loop interrupts?
 void CTestboard::LoopInterruptReset() {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(0);
+  // Drop the remaining data of an interrupted loop:
+  for(size_t ch = 0; ch < DTB_DAQ_CHANNELS; ch++) {
+    loop_pending.at(ch).clear();
+    loop_pending_pos.at(ch) = 0;
+  }
 }
 
 void CTestboard::SetLoopTriggerDelay(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 void CTestboard::SetLoopTrimDelay(uint16_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcWrite(2);
 }
 
 bool CTestboard::SetI2CAddresses(std::vector<uint8_t> &rpc_par1) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(RPC_DATA_HEADER + rpc_par1.size(), 1);
   nrocs_loops = rpc_par1.size();
   return true;
 }
 
 // FIXME here we could implement masked pixels
-bool CTestboard::SetTrimValues(uint8_t, std::vector<uint8_t> &) {
+bool CTestboard::SetTrimValues(uint8_t, std::vector<uint8_t> &trimvalues) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(1 + RPC_DATA_HEADER + trimvalues.size(), 1);
   return true;
 }
 
+size_t CTestboard::rocsOnChannel(uint8_t channel, size_t nrocs) {
+
+  // The ROCs are distributed evenly over the open DAQ channels, remaining
+  // ROCs go to the first channels:
+  size_t channels = std::count(daq_status.begin(), daq_status.end(), true);
+  if(channels == 0 || notokenpass(tbmtype,channel)) return 0;
+  size_t rank = std::count(daq_status.begin(), daq_status.begin() + channel, true);
+  return nrocs/channels + (rank < nrocs%channels ? 1 : 0);
+}
+
 bool CTestboard::notokenpass(uint8_t tbmtype, uint8_t channel) {
 
   // No or emulated TBM - token passes:
@@ -617,49 +884,50 @@ bool CTestboard::notokenpass(uint8_t tbmtype, uint8_t channel) {
 
 bool CTestboard::LoopMultiRocAllPixelsCalibrate(std::vector<uint8_t> &roci2cs, uint16_t nTriggers, uint16_t flags) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(4 + RPC_DATA_HEADER + roci2cs.size(), 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
 
   // Check how many open DAQ channels we have:
   size_t channels = std::count(daq_status.begin(), daq_status.end(), true);
-  // Distribute the ROCs evenly:
-  size_t roc_per_ch = (roci2cs.size()/channels);
 
   uint32_t event = 0;
   for(size_t i = 0; i < ROC_NUMCOLS; i++) {
     for(size_t j = 0; j < ROC_NUMROWS; j++) {
       for(size_t k = 0; k < nTriggers; k++) {
 	for(size_t ch = 0; ch < channels; ch++) {
-	  size_t rocs = notokenpass(tbmtype,ch) ? 0 : roc_per_ch;
-	  fillRawData(event,daq_buffer.at(ch),tbmtype,rocs,false,false,i,j,pg_setup,flags);
+	  fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),false,false,i,j,pg_setup,flags);
 	}
 	event++;
       }
     }
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopMultiRocOnePixelCalibrate(std::vector<uint8_t> &roci2cs, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(6 + RPC_DATA_HEADER + roci2cs.size(), 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
 
   // Check how many open DAQ channels we have:
   size_t channels = std::count(daq_status.begin(), daq_status.end(), true);
-  // Distribute the ROCs evenly:
-  size_t roc_per_ch = roci2cs.size()/channels;
 
   uint32_t event = 0;
   for(size_t k = 0; k < nTriggers; k++) {
     for(size_t ch = 0; ch < channels; ch++) {
-      fillRawData(event,daq_buffer.at(ch),tbmtype,roc_per_ch,false,false,column,row,pg_setup,flags);
+      fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),false,false,column,row,pg_setup,flags);
     }
     event++;
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopSingleRocAllPixelsCalibrate(uint8_t, uint16_t nTriggers, uint16_t flags) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(5, 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
   
   uint32_t event = 0;
   for(size_t i = 0; i < ROC_NUMCOLS; i++) {
@@ -671,11 +939,13 @@ bool CTestboard::LoopSingleRocAllPixelsCalibrate(uint8_t, uint16_t nTriggers, ui
     }
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopSingleRocOnePixelCalibrate(uint8_t, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(7, 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
 
   uint32_t event = 0;
   for(size_t k = 0; k < nTriggers; k++) {
@@ -683,7 +953,7 @@ bool CTestboard::LoopSingleRocOnePixelCalibrate(uint8_t, uint8_t column, uint8_t
     event++;
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopMultiRocAllPixelsDacScan(std::vector<uint8_t> &roci2cs, uint16_t nTriggers, uint16_t flags, uint8_t dacreg, uint8_t dacmin, uint8_t dacmax) {
@@ -692,11 +962,11 @@ bool CTestboard::LoopMultiRocAllPixelsDacScan(std::vector<uint8_t> &roci2cs, uin
 
 bool CTestboard::LoopMultiRocAllPixelsDacScan(std::vector<uint8_t> &roci2cs, uint16_t nTriggers, uint16_t flags, uint8_t, uint8_t dacstep, uint8_t dacmin, uint8_t dacmax) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(8 + RPC_DATA_HEADER + roci2cs.size(), 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
 
   // Check how many open DAQ channels we have:
   size_t channels = std::count(daq_status.begin(), daq_status.end(), true);
-  // Distribute the ROCs evenly:
-  size_t roc_per_ch = roci2cs.size()/channels;
 
   uint8_t dachalf = static_cast<uint8_t>(dacmax-dacmin)/2;
   uint32_t event = 0;
@@ -708,9 +978,9 @@ bool CTestboard::LoopMultiRocAllPixelsDacScan(std::vector<uint8_t> &roci2cs, uin
 	  for(size_t ch = 0; ch < channels; ch++) {
 	    // Mimic some edge at 50% of the DAC range:
 	    if(((flags&FLAG_RISING_EDGE) && dac > dachalf) || (!(flags&FLAG_RISING_EDGE) && dac < dachalf)) {
-	      fillRawData(event,daq_buffer.at(ch),tbmtype,roc_per_ch,false,false,i,j,pg_setup,flags);
+	      fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),false,false,i,j,pg_setup,flags);
 	    }
-	    else { fillRawData(event,daq_buffer.at(ch),tbmtype,roc_per_ch,true, false,i,j,pg_setup,flags); }
+	    else { fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),true, false,i,j,pg_setup,flags); }
 	  }
 	  event++;
 	}
@@ -718,7 +988,7 @@ bool CTestboard::LoopMultiRocAllPixelsDacScan(std::vector<uint8_t> &roci2cs, uin
     }
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopMultiRocOnePixelDacScan(std::vector<uint8_t> &roci2cs, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags, uint8_t dacreg, uint8_t dacmin, uint8_t dacmax) {
@@ -727,11 +997,11 @@ bool CTestboard::LoopMultiRocOnePixelDacScan(std::vector<uint8_t> &roci2cs, uint
 
 bool CTestboard::LoopMultiRocOnePixelDacScan(std::vector<uint8_t> &roci2cs, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags, uint8_t, uint8_t dacstep, uint8_t dacmin, uint8_t dacmax) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(10 + RPC_DATA_HEADER + roci2cs.size(), 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
   
   // Check how many open DAQ channels we have:
   size_t channels = std::count(daq_status.begin(), daq_status.end(), true);
-  // Distribute the ROCs evenly:
-  size_t roc_per_ch = roci2cs.size()/channels;
 
   uint8_t dachalf = static_cast<uint8_t>(dacmax-dacmin)/2;
   uint32_t event = 0;
@@ -741,15 +1011,15 @@ bool CTestboard::LoopMultiRocOnePixelDacScan(std::vector<uint8_t> &roci2cs, uint
       for(size_t ch = 0; ch < channels; ch++) {
 	// Mimic some edge at 50% of the DAC range:
 	if(((flags&FLAG_RISING_EDGE) && dac > dachalf) || (!(flags&FLAG_RISING_EDGE) && dac < dachalf)) {
-	  fillRawData(event,daq_buffer.at(ch),tbmtype,roc_per_ch,false,false,column,row,pg_setup,flags);
+	  fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),false,false,column,row,pg_setup,flags);
 	}
-	else { fillRawData(event,daq_buffer.at(ch),tbmtype,roc_per_ch,true, false,column,row,pg_setup,flags); }
+	else { fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),true, false,column,row,pg_setup,flags); }
       }
       event++;
     }
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopSingleRocAllPixelsDacScan(uint8_t roci2c, uint16_t nTriggers, uint16_t flags, uint8_t dacreg, uint8_t dacmin, uint8_t dacmax) {
@@ -758,6 +1028,8 @@ bool CTestboard::LoopSingleRocAllPixelsDacScan(uint8_t roci2c, uint16_t nTrigger
 
 bool CTestboard::LoopSingleRocAllPixelsDacScan(uint8_t, uint16_t nTriggers, uint16_t flags, uint8_t, uint8_t dacstep, uint8_t dacmin, uint8_t dacmax) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(9, 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
 
   uint8_t dachalf = static_cast<uint8_t>(dacmax-dacmin)/2;
   uint32_t event = 0;
@@ -777,7 +1049,7 @@ bool CTestboard::LoopSingleRocAllPixelsDacScan(uint8_t, uint16_t nTriggers, uint
     }
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopSingleRocOnePixelDacScan(uint8_t roci2c, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags, uint8_t dacreg, uint8_t dacmin, uint8_t dacmax) {
@@ -786,6 +1058,8 @@ bool CTestboard::LoopSingleRocOnePixelDacScan(uint8_t roci2c, uint8_t column, ui
 
 bool CTestboard::LoopSingleRocOnePixelDacScan(uint8_t, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags, uint8_t, uint8_t dacstep, uint8_t dacmin, uint8_t dacmax) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(11, 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
   
   uint8_t dachalf = static_cast<uint8_t>(dacmax-dacmin)/2;
   uint32_t event = 0;
@@ -801,7 +1075,7 @@ bool CTestboard::LoopSingleRocOnePixelDacScan(uint8_t, uint8_t column, uint8_t r
     event++;
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopMultiRocAllPixelsDacDacScan(std::vector<uint8_t> &roci2cs, uint16_t nTriggers, uint16_t flags, uint8_t dac1reg, uint8_t dac1min, uint8_t dac1max, uint8_t dac2reg, uint8_t dac2min, uint8_t dac2max) {
@@ -810,11 +1084,11 @@ bool CTestboard::LoopMultiRocAllPixelsDacDacScan(std::vector<uint8_t> &roci2cs,
 
 bool CTestboard::LoopMultiRocAllPixelsDacDacScan(std::vector<uint8_t> &roci2cs, uint16_t nTriggers, uint16_t flags, uint8_t, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(12 + RPC_DATA_HEADER + roci2cs.size(), 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
 
   // Check how many open DAQ channels we have:
   size_t channels = std::count(daq_status.begin(), daq_status.end(), true);
-  // Distribute the ROCs evenly:
-  size_t roc_per_ch = roci2cs.size()/channels;
 
   uint32_t event = 0;
 
@@ -826,9 +1100,9 @@ bool CTestboard::LoopMultiRocAllPixelsDacDacScan(std::vector<uint8_t> &roci2cs,
 	    for(size_t ch = 0; ch < channels; ch++) {
 	      // Mimic some working band of the two DACs:
 	      if(isInTornadoRegion(dac1min, dac1max, dac1, dac2min, dac2max, dac2)) {
-		fillRawData(event,daq_buffer.at(ch),tbmtype,roc_per_ch,false,false,i,j,pg_setup,flags);
+		fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),false,false,i,j,pg_setup,flags);
 	      }
-	      else { fillRawData(event,daq_buffer.at(ch),tbmtype,roc_per_ch,true, false,i,j,pg_setup,flags); }
+	      else { fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),true, false,i,j,pg_setup,flags); }
 	    }
 	    event++;
 	  }
@@ -837,7 +1111,7 @@ bool CTestboard::LoopMultiRocAllPixelsDacDacScan(std::vector<uint8_t> &roci2cs,
     }
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopMultiRocOnePixelDacDacScan(std::vector<uint8_t> &roci2cs, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags, uint8_t dac1reg, uint8_t dac1min, uint8_t dac1max, uint8_t dac2reg, uint8_t dac2min, uint8_t dac2max) {
@@ -846,11 +1120,11 @@ bool CTestboard::LoopMultiRocOnePixelDacDacScan(std::vector<uint8_t> &roci2cs, u
 
 bool CTestboard::LoopMultiRocOnePixelDacDacScan(std::vector<uint8_t> &roci2cs, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags, uint8_t, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(14 + RPC_DATA_HEADER + roci2cs.size(), 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
 
   // Check how many open DAQ channels we have:
   size_t channels = std::count(daq_status.begin(), daq_status.end(), true);
-  // Distribute the ROCs evenly:
-  size_t roc_per_ch = roci2cs.size()/channels;
 
   uint32_t event = 0;
 
@@ -860,16 +1134,16 @@ bool CTestboard::LoopMultiRocOnePixelDacDacScan(std::vector<uint8_t> &roci2cs, u
 	for(size_t ch = 0; ch < channels; ch++) {
 	  // Mimic some working band of the two DACs:
 	  if(isInTornadoRegion(dac1min, dac1max, dac1, dac2min, dac2max, dac2)) {
-	    fillRawData(event,daq_buffer.at(ch),tbmtype,roc_per_ch,false,false,column,row,pg_setup,flags);
+	    fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),false,false,column,row,pg_setup,flags);
 	  }
-	  else { fillRawData(event,daq_buffer.at(ch),tbmtype,roc_per_ch,true, false,column,row,pg_setup,flags); }
+	  else { fillRawData(event,daq_buffer.at(ch),tbmtype,rocsOnChannel(ch,roci2cs.size()),true, false,column,row,pg_setup,flags); }
 	}
 	event++;
       }
     }
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopSingleRocAllPixelsDacDacScan(uint8_t roci2c, uint16_t nTriggers, uint16_t flags, uint8_t dac1reg, uint8_t dac1min, uint8_t dac1max, uint8_t dac2reg, uint8_t dac2min, uint8_t dac2max) {
@@ -878,6 +1152,8 @@ bool CTestboard::LoopSingleRocAllPixelsDacDacScan(uint8_t roci2c, uint16_t nTrig
 
 bool CTestboard::LoopSingleRocAllPixelsDacDacScan(uint8_t, uint16_t nTriggers, uint16_t flags, uint8_t, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(13, 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
 
   uint32_t event = 0;
 
@@ -898,7 +1174,7 @@ bool CTestboard::LoopSingleRocAllPixelsDacDacScan(uint8_t, uint16_t nTriggers, u
     }
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 bool CTestboard::LoopSingleRocOnePixelDacDacScan(uint8_t roci2c, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags, uint8_t dac1reg, uint8_t dac1min, uint8_t dac1max, uint8_t dac2reg, uint8_t dac2min, uint8_t dac2max) {
@@ -907,6 +1183,8 @@ bool CTestboard::LoopSingleRocOnePixelDacDacScan(uint8_t roci2c, uint8_t column,
 
 bool CTestboard::LoopSingleRocOnePixelDacDacScan(uint8_t, uint8_t column, uint8_t row, uint16_t nTriggers, uint16_t flags, uint8_t, uint8_t dac1step, uint8_t dac1min, uint8_t dac1max, uint8_t, uint8_t dac2step, uint8_t dac2min, uint8_t dac2max) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(15, 1);
+  if(loopInterrupted()) return loopRelease(nTriggers);
 
   uint32_t event = 0;
 
@@ -923,11 +1201,12 @@ bool CTestboard::LoopSingleRocOnePixelDacDacScan(uint8_t, uint8_t column, uint8_
     }
   }
   
-  return 1;
+  return loopRelease(nTriggers);
 }
 
 uint16_t CTestboard::GetADC(uint8_t) {
   LOG(pxar::logDEBUGRPC) << "called.";
+  rpcRead(1, 2);
   return 0;
 }
 
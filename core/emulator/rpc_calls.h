@@ -4,6 +4,9 @@
 
 #include "log.h"
 #include "constants.h"
+#include "rawbuffer.h"
+
+namespace pxar { class hitGenerator; class timingModel; }
 
 class CRpcError {
  public:
@@ -37,20 +40,48 @@ class CTestboard {
   std::map<uint8_t,std::map<uint8_t, std::map<uint8_t, uint8_t> > > tbm_registers;
   uint8_t active_tbm;
 
+  // Optional physics-like data generator, configured via the environment
+  // variable PXAR_EMULATOR_GENERATOR (see pxar::generatorConfig)
+  pxar::hitGenerator * generator;
+  void InitGenerator();
+  void InitTiming();
+
+  // Optional timing model (environment variable PXAR_EMULATOR_TIMING, see
+  // pxar::timingConfig). Loop data exceeding the DTB RAM is kept back and
+  // delivered by the following calls of the interrupted loop.
+  pxar::timingModel * timing;
+  std::vector<std::vector<uint16_t> > loop_pending;
+  std::vector<size_t> loop_pending_pos;
+  bool loopInterrupted();
+  bool loopRelease(uint16_t nTriggers);
+  // Charge the timing model for an RPC call without return value, or for
+  // the round trip of a call returning data. Sizes of the parameters and
+  // return values are in bytes.
+  void rpcWrite(size_t request);
+  void rpcRead(size_t request, size_t response);
+  uint8_t daqReadBlock(std::vector<uint16_t> &data, uint32_t blocksize, uint32_t &available, uint8_t channel);
+  // Number of the given ROCs read out through a DAQ channel
+  size_t rocsOnChannel(uint8_t channel, size_t nrocs);
+
  public:
  CTestboard() : vd(0), va(0), id(0), ia(0),
     nrocs_loops(0), roci2c(), tbmtype(TBM_NONE),trigger(TRG_SEL_PG_DIR),
     eventcounter(0),
-    daq_buffer(), daq_status(), daq_event(), tbm_registers(), active_tbm(0)
+    daq_buffer(), daq_status(), daq_event(), tbm_registers(), active_tbm(0),
+    generator(NULL), timing(NULL), loop_pending(), loop_pending_pos()
   {
     // Initialize all available DAQ channels:
     for(size_t i = 0; i < DTB_DAQ_CHANNELS; i++) {
       daq_buffer.push_back(std::vector<uint16_t>());
       daq_status.push_back(false);
       daq_event.push_back(0);
+      loop_pending.push_back(std::vector<uint16_t>());
+      loop_pending_pos.push_back(0);
     }
+    InitGenerator();
+    InitTiming();
   }
-  ~CTestboard() { }
+  ~CTestboard();
 
   int32_t GetHostRpcCallCount() { return 999; }
   std::vector<std::string> GetHostRpcCallNames() { return std::vector<std::string>(); }
@@ -88,6 +119,7 @@ class CTestboard {
   }
 
   void SetTimeout(unsigned int) {}
+  void SetEthernetTxBatch(unsigned int) {}
   bool IsConnected() { return true; }
   const char * ConnectionError() { return "none."; }
 
@@ -217,6 +249,7 @@ class CTestboard {
   uint8_t Daq_FillLevel();
   uint8_t Daq_Read(std::vector<uint16_t> &data, uint32_t blocksize = 65536, uint8_t channel = 0);
   uint8_t Daq_Read(std::vector<uint16_t> &data, uint32_t blocksize, uint32_t &availsize, uint8_t channel = 0);
+  uint8_t Daq_Read_Pipelined(pxar::rawBuffer<uint16_t> &data, uint32_t blocksize, uint32_t &availsize, uint8_t channel, uint8_t depth);
 	
 
   void Daq_Select_ADC(uint16_t blocksize, uint8_t source, uint8_t start, uint8_t stop = 0);
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <cstring>
+
 #include "EthernetInterface.h"
 #include "rpc_error.h"
 #include "config.h"
@@ -168,15 +171,19 @@ CEthernet::~CEthernet(){
 }
 
 void CEthernet::Write(const void *buffer, unsigned int size){
-    for(unsigned int i = 0 ; i < size; i++){
-        if(tx_payload_size == MAX_TX_DATA){
-            Flush();
-        }
-        tx_frame[ETH_HEADER_SIZE + tx_payload_size] = ((char*)buffer)[i];
-        tx_payload_size++;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(buffer);
+    while(size > 0){
+        if(tx_payload_size == MAX_TX_DATA) FinishFrame();
+        unsigned int n = std::min(size, MAX_TX_DATA - tx_payload_size);
+        memcpy(&tx_frames[tx_count][ETH_HEADER_SIZE + tx_payload_size], data, n);
+        tx_payload_size += n;
+        data += n;
+        size -= n;
     }
 }
-void CEthernet::Flush(){
+
+void CEthernet::FinishFrame(){
+    unsigned char* tx_frame = tx_frames[tx_count];
 	for(int i =0; i < 6; i++){
 		tx_frame[i] = dtb_mac[i];
 		tx_frame[i+6] = host_mac[i];
@@ -194,76 +201,109 @@ void CEthernet::Flush(){
       std::stringstream st;
       st << std::uppercase << std::hex;
       for(size_t i = 0; i < tx_payload_size + ETH_HEADER_SIZE; i++) {
-	st << std::setw(2) << std::setfill('0') << tx_frame[i];
+	st << std::setw(2) << std::setfill('0') << static_cast<int>(tx_frame[i]);
       }
       st << std::nouppercase << std::dec;
-      LOG(logINTERFACE) << "Sent packet: " << st.str();
+      LOG(logINTERFACE) << "Queued packet: " << st.str();
     }
-    
-    pcap_sendpacket(descr, tx_frame, tx_payload_size + ETH_HEADER_SIZE);
+
+    tx_sizes[tx_count++] = tx_payload_size + ETH_HEADER_SIZE;
     tx_payload_size = 0;
+    if(tx_count >= tx_batch) SendFrames();
 }
+
+void CEthernet::SendFrames(){
+    unsigned int sent = 0;
+#ifdef __linux__
+    // hand the whole batch to the capture socket with a single system call
+    struct mmsghdr msgs[MAX_TX_FRAMES];
+    struct iovec iov[MAX_TX_FRAMES];
+    memset(msgs, 0, sizeof(msgs));
+    for(unsigned int i = 0; i < tx_count; i++){
+        iov[i].iov_base = tx_frames[i];
+        iov[i].iov_len = tx_sizes[i];
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    int fd = pcap_get_selectable_fd(descr);
+    while(fd >= 0 && sent < tx_count){
+        int n = sendmmsg(fd, msgs + sent, tx_count - sent, 0);
+        if(n <= 0) break;
+        sent += n;
+    }
+#endif
+    // send whatever is left frame by frame
+    for(; sent < tx_count; sent++){
+        if(pcap_inject(descr, tx_frames[sent], tx_sizes[sent]) < 0){
+            LOG(logCRITICAL) << "Error writing to ethernet: " << pcap_geterr(descr);
+            tx_count = 0;
+            throw CRpcError(CRpcError::WRITE_ERROR);
+        }
+    }
+    tx_count = 0;
+}
+
+void CEthernet::Flush(){
+    if(tx_payload_size > 0) FinishFrame();
+    if(tx_count > 0) SendFrames();
+}
+void CEthernet::SetTxBatch(unsigned int frames){
+    // send what is queued before the batch can get smaller
+    if(tx_count > 0) SendFrames();
+    tx_batch = std::max(1u, std::min(frames, static_cast<unsigned int>(MAX_TX_FRAMES)));
+}
+
 void CEthernet::Clear(){
     tx_payload_size = 0;
-    rx_buffer.clear();
+    tx_count = 0;
+    rx_buffer.Clear();
+}
+
+void CEthernet::RxCollect(unsigned char* self, const struct pcap_pkthdr* hdr, const unsigned char* rx_frame){
+    CEthernet* eth = reinterpret_cast<CEthernet*>(self);
+
+    IFLOG(logINTERFACE) {
+      std::stringstream st;
+      st << std::uppercase << std::hex;
+      for(size_t i = 0; i < hdr->caplen; i++){
+	st << std::setw(2) << std::setfill('0') << static_cast<int>(rx_frame[i]);
+      }
+      st << std::nouppercase << std::dec;
+      LOG(logINTERFACE) << "Received packet: " << st.str();
+    }
+
+    if(eth->rx_buffer.Collect(rx_frame, hdr->caplen, eth->host_mac, eth->host_pid)) {
+      LOG(logINTERFACE) << "Passed Filter.";
+    }
 }
+
 void CEthernet::Read(void *buffer, unsigned int size){
     int timeout = 10000;
-    for(unsigned int i = 0; i < size; i++){
-        if(!rx_buffer.empty()){
-            ((unsigned char*)buffer)[i] = rx_buffer.front();
-            rx_buffer.pop_front();
-        } else{
-            const unsigned char* rx_frame = pcap_next(descr, &header);
-            if(rx_frame == NULL){
-                timeout--;
-                i--;
-                if(timeout == 0){
-                    printf("Error reading from ethernet.\n");
-                    throw CRpcError(CRpcError::TIMEOUT);
-                }
-            }
-
-	    IFLOG(logINTERFACE) {
-	      std::stringstream st;
-	      st << std::uppercase << std::hex;
-	      for(size_t i = 0; i < header.len; i++){
-		st << std::setw(2) << std::setfill('0') << rx_frame[i];
-	      }
-	      st << std::nouppercase << std::dec;
-	      LOG(logINTERFACE) << "Received packet: " << st.str();
-	    }
-
-            if(header.len < ETH_HEADER_SIZE){ // malformed message
-                i--;
-                continue;
-            }
-            
-            if(!packet_equals(rx_frame,host_mac,6) || 
-               !packet_equals(rx_frame+14,host_pid,2) ||
-               rx_frame[16] != 0) {
-				   i--;
-				   continue;
-			   }
-	    LOG(logINTERFACE) << "Passed Filter.";
-			
-            unsigned int rx_payload_size = rx_frame[17];
-            rx_payload_size = (rx_payload_size << 8) | rx_frame[18];
-
-            for(unsigned int j =0; j < rx_payload_size;j++){
-                rx_buffer.push_back(rx_frame[j + ETH_HEADER_SIZE]);
+    // collect all frames already captured in one go until enough data arrived
+    while(rx_buffer.Available() < size){
+        int frames = pcap_dispatch(descr, -1, RxCollect, reinterpret_cast<unsigned char*>(this));
+        if(frames < 0){
+            LOG(logCRITICAL) << "Error reading from ethernet: " << pcap_geterr(descr);
+            throw CRpcError(CRpcError::READ_ERROR);
+        }
+        if(frames == 0){
+            timeout--;
+            if(timeout == 0){
+                printf("Error reading from ethernet.\n");
+                throw CRpcError(CRpcError::TIMEOUT);
             }
-            i--;
         }
     }
+
+    rx_buffer.Read(buffer, size);
 }
 
 void CEthernet::InitInterface(){
-    rx_buffer.resize(0);
-    for(int i =0; i < TX_FRAME_SIZE; i++){
-        tx_frame[i] = 0;
-    }
+    rx_buffer.Clear();
+    memset(tx_frames, 0, sizeof(tx_frames));
     tx_payload_size = 0;
+    tx_count = 0;
+    tx_batch = TX_BATCH_FRAMES;
     
     char errbuf[PCAP_ERRBUF_SIZE];
     descr = pcap_open_live(interface.c_str(), BUFSIZ,0,100,errbuf);
@@ -274,7 +314,32 @@ void CEthernet::InitInterface(){
     }
     
     Get_MAC(interface.c_str(), host_mac); 
-    for(int i = 0; i < 6; i++) tx_frame[i+6] = host_mac[i];
+    InitFilter();
+}
+
+void CEthernet::InitFilter(){
+    // Let the kernel drop all frames not meant for this process: wrong
+    // ethertype, other host PID, frames sent by ourselves and foreign unicast.
+    // The checks in RxCollect() stay in place for systems without BPF support.
+    char filter[256];
+    snprintf(filter, sizeof(filter),
+             "ether proto 0x0809 and ether[14:2] = 0x%02x%02x"
+             " and not ether src %02x:%02x:%02x:%02x:%02x:%02x"
+             " and (ether dst %02x:%02x:%02x:%02x:%02x:%02x or ether broadcast)",
+             host_pid[0], host_pid[1],
+             host_mac[0], host_mac[1], host_mac[2], host_mac[3], host_mac[4], host_mac[5],
+             host_mac[0], host_mac[1], host_mac[2], host_mac[3], host_mac[4], host_mac[5]);
+
+    struct bpf_program program;
+    if(pcap_compile(descr, &program, filter, 1, PCAP_NETMASK_UNKNOWN) < 0){
+      LOG(logWARNING) << "Could not compile ethernet capture filter: " << pcap_geterr(descr);
+      return;
+    }
+    if(pcap_setfilter(descr, &program) < 0){
+      LOG(logWARNING) << "Could not set ethernet capture filter: " << pcap_geterr(descr);
+    }
+    else { LOG(logINTERFACE) << "Capture filter: " << filter; }
+    pcap_freecode(&program);
 }
 
 bool CEthernet::EnumFirst(unsigned int &nDevices){
@@ -317,7 +382,6 @@ void CEthernet::Close(){
 	if(!success) throw CRpcError(CRpcError::ETH_ERROR);
 	for(int i =0; i < 6; i++){
 		dtb_mac[i] = 0x00;
-		tx_frame[i] = dtb_mac[i];
 	}
 	is_open = false;
 }
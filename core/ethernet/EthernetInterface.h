@@ -1,7 +1,6 @@
 #ifndef PXAR_ETHERNET_H
 #define PXAR_ETHERNET_H
 
-#include <deque>
 #include <string>
 #include <vector>
 #include <ctime>
@@ -11,18 +10,21 @@
 #include <pcap.h>
 
 #include "rpc_io.h"
+#include "EthernetRxBuffer.h"
 
 
 #define RX_FRAME_SIZE 2048
 #define TX_FRAME_SIZE 2048
 
 #define MAX_TX_DATA 1500
-#define ETH_HEADER_SIZE 19
+#define MAX_TX_FRAMES 32 // maximum number of frames sent as one batch
+#define TX_BATCH_FRAMES 1 // default batch size, 1 sends every full frame right away
 
 
 class CEthernet : public CRpcIo
 {
     void InitInterface();
+    void InitFilter();
     
     void Hello();
     bool Claim(const unsigned char* MAC, bool force);
@@ -38,12 +40,23 @@ class CEthernet : public CRpcIo
     
     unsigned char host_pid[2];
     
-    std::deque<unsigned char>    rx_buffer;
-    unsigned char      tx_frame[TX_FRAME_SIZE];
+    // Contiguous receive buffer collecting the payload of the accepted frames
+    CEthernetRxBuffer  rx_buffer;
+    static void        RxCollect(unsigned char* self, const struct pcap_pkthdr* hdr, const unsigned char* frame);
+
+    // Transmit batch: Write() fills tx_frames[tx_count], full frames are
+    // queued and all of them are sent together on Flush() or when tx_batch
+    // frames are queued
+    unsigned char      tx_frames[MAX_TX_FRAMES][TX_FRAME_SIZE];
+    unsigned int       tx_sizes[MAX_TX_FRAMES];
+    unsigned int       tx_count;
+    unsigned int       tx_batch;
+    void               FinishFrame();
+    void               SendFrames();
     unsigned char      dtb_mac[6];
     unsigned char      host_mac[6];
     
-    unsigned int       tx_payload_size;//data in tx buffer minus header(14 bytes)
+    unsigned int       tx_payload_size;//data in current tx frame minus header(19 bytes)
     bool                is_open;
 public:
     CEthernet();
@@ -69,6 +82,12 @@ public:
     void Close(CRpcIo* io);
     void Close();
     bool IsOpen();
+
+    // Number of full frames collected before they are sent back-to-back
+    // (1 to MAX_TX_FRAMES). Larger batches save system calls, but the DTB
+    // has to accept the frames as a burst. Set through the testboard
+    // parameter "ethtxbatch".
+    void SetTxBatch(unsigned int frames);
 };
 
 #endif
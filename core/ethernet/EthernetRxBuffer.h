@@ -0,0 +1,68 @@
+// Receive side of the DTB Ethernet protocol: CEthernet hands every captured
+// frame to Collect(), which checks the header and appends the payload of the
+// frames meant for this host process to a contiguous buffer. Read() takes
+// the reassembled byte stream out again.
+// The class has no dependency on libpcap, so captured frames can be replayed
+// through it, e.g. for testing.
+
+#ifndef ETHERNETRXBUFFER_H
+#define ETHERNETRXBUFFER_H
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#define ETH_HEADER_SIZE 19
+#define RX_BUFFER_SIZE 0x100000 // initial size of the receive buffer
+
+class CEthernetRxBuffer
+{
+  // Payload of the accepted frames is appended at m_end, Read() takes it
+  // out at m_pos. Both are reset once the buffer is empty.
+  std::vector<unsigned char> m_data;
+  size_t m_pos, m_end;
+
+  unsigned char *Reserve(size_t size) {
+    // move the unread data to the front before growing the buffer
+    if(m_end + size > m_data.size() && m_pos > 0) {
+      memmove(&m_data[0], &m_data[m_pos], m_end - m_pos);
+      m_end -= m_pos;
+      m_pos = 0;
+    }
+    if(m_end + size > m_data.size()) m_data.resize(std::max(2*m_data.size(), m_end + size));
+    unsigned char *p = &m_data[m_end];
+    m_end += size;
+    return p;
+  }
+
+public:
+  CEthernetRxBuffer() : m_data(RX_BUFFER_SIZE), m_pos(0), m_end(0) {}
+
+  size_t Available() const { return m_end - m_pos; }
+
+  void Clear() { m_pos = m_end = 0; }
+
+  // Appends the payload of a data frame addressed to host_mac and host_pid.
+  // Returns false for frames of other hosts or processes, control frames
+  // and truncated frames, which are ignored.
+  bool Collect(const unsigned char *frame, size_t caplen,
+               const unsigned char host_mac[6], const unsigned char host_pid[2]) {
+    if(caplen < ETH_HEADER_SIZE) return false; // malformed message
+    if(memcmp(frame, host_mac, 6) != 0 || memcmp(frame + 14, host_pid, 2) != 0 || frame[16] != 0) return false;
+
+    size_t size = (static_cast<size_t>(frame[17]) << 8) | frame[18];
+    if(size > caplen - ETH_HEADER_SIZE) return false; // truncated frame
+
+    if(size) memcpy(Reserve(size), frame + ETH_HEADER_SIZE, size);
+    return true;
+  }
+
+  // Takes size bytes out of the buffer, the caller has to check Available()
+  void Read(void *buffer, size_t size) {
+    if(size) memcpy(buffer, &m_data[m_pos], size);
+    m_pos += size;
+    if(m_pos == m_end) m_pos = m_end = 0;
+  }
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef PXAR_CONDENSE_H
+#define PXAR_CONDENSE_H
+
+#include <stdint.h>
+#include <vector>
+#include "datatypes.h"
+
+// Trigger condensing of the HAL test loops. Only works on the data passed
+// in, used by the HAL and by the benchmarks (tools/bench.cc). This header
+// is internal to the library and not part of the public API.
+
+namespace pxar {
+
+  /** Merges all consecutive triggers into one pxar::Event. This function deletes the original event data after
+   *  merging! 
+   */
+  DLLEXPORT std::vector<Event> condenseTriggers(std::vector<Event> &data, uint16_t nTriggers, bool efficiency);
+
+}
+
+#endif /* PXAR_CONDENSE_H */
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "datasource_dtb.h"
 #include "helper.h"
 #include "log.h"
@@ -10,7 +11,12 @@ namespace pxar {
   uint16_t dtbSource::FillBuffer() {
     pos = 0;
     do {
-      dtbState = tb->Daq_Read(buffer, DTB_SOURCE_BLOCK_SIZE, dtbRemainingSize, channel);
+      // Keep several requests in flight if the DTB reported more data:
+      uint32_t blocks = (dtbRemainingSize + DTB_SOURCE_BLOCK_SIZE - 1)/DTB_SOURCE_BLOCK_SIZE;
+      uint8_t depth = static_cast<uint8_t>(std::max<uint32_t>(1, std::min<uint32_t>(blocks, DTB_SOURCE_PIPELINE_DEPTH)));
+      timer t;
+      dtbState = tb->Daq_Read_Pipelined(buffer, DTB_SOURCE_BLOCK_SIZE, dtbRemainingSize, channel, depth);
+      readoutTime += t.getMicroseconds();
     
       if (buffer.size() == 0) {
 	if (stopAtEmptyData) throw dsBufferEmpty();
@@ -26,7 +32,7 @@ namespace pxar {
     LOG(logDEBUGPIPES) << "Remaining " << static_cast<int>(dtbRemainingSize);
     LOG(logDEBUGPIPES) << "-------------------------";
     LOG(logDEBUGPIPES) << "FULL RAW DATA BLOB:";
-    LOG(logDEBUGPIPES) << listVector(buffer,true);
+    LOG(logDEBUGPIPES) << listVector(std::vector<uint16_t>(buffer.begin(),buffer.end()),true);
     LOG(logDEBUGPIPES) << "-------------------------";
 
     return lastSample = buffer[pos++];
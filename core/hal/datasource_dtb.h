@@ -4,6 +4,8 @@
 #include <stdexcept>
 #include "datapipe.h"
 #include "rpc_calls.h"
+#include "rawbuffer.h"
+#include "timer.h"
 
 namespace pxar {
 
@@ -22,11 +24,13 @@ namespace pxar {
     bool connected;
     uint8_t envelopetype;
     uint8_t devicetype;
+    // wall time spent in DTB reads, in microseconds
+    uint64_t readoutTime;
 
-    // --- data buffer
+    // --- data buffer, reused for every block read from the DTB
     uint16_t lastSample;
     unsigned int pos;
-    std::vector<uint16_t> buffer;
+    rawBuffer<uint16_t> buffer;
     uint16_t FillBuffer();
 
     // --- virtual data access methods
@@ -64,13 +68,14 @@ namespace pxar {
     }
   public:
   dtbSource(CTestboard * src, uint8_t daqchannel, uint8_t tokenChainLength, uint8_t offset, uint8_t tbmtype, uint8_t roctype, bool endlessStream, uint16_t daqflags = 0)
-    : stopAtEmptyData(endlessStream), tb(src), channel(daqchannel), flags(daqflags), chainlength(tokenChainLength), chainlengthOffset(offset), connected(true), envelopetype(tbmtype), devicetype(roctype), lastSample(0x4000), pos(0) {}
-  dtbSource() : connected(false) {}
+    : stopAtEmptyData(endlessStream), tb(src), channel(daqchannel), flags(daqflags), chainlength(tokenChainLength), chainlengthOffset(offset), dtbRemainingSize(0), dtbState(0), connected(true), envelopetype(tbmtype), devicetype(roctype), readoutTime(0), lastSample(0x4000), pos(0) {}
+  dtbSource() : connected(false), readoutTime(0) {}
     bool isConnected() { return connected; }
 
     // --- control and status
     uint8_t  GetState() { return dtbState; }
     uint32_t GetRemainingSize() { return dtbRemainingSize; }
+    uint64_t GetReadoutTime() { return readoutTime; }
     void Stop() { stopAtEmptyData = true; }
   };
 
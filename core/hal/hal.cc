@@ -1,4 +1,5 @@
 #include "hal.h"
+#include "condense.h"
 #include "log.h"
 #include "timer.h"
 #include "helper.h"
@@ -23,10 +24,14 @@ hal::hal(std::string name) :
   m_roccount(0),
   m_tokenchains(),
   m_daqstatus(),
+  m_pucstate(),
+  m_chipmasked(),
   _currentTrgSrc(TRG_SEL_PG_DIR),
   m_src(),
   m_splitter(),
-  m_decoder()
+  m_decoder(),
+  m_hotreported(),
+  m_timing()
 {
 
   // Get a new CTestboard class instance:
@@ -222,6 +227,10 @@ void hal::setTestboardDelays(std::map<uint8_t,uint8_t> sig_delays) {
       LOG(logDEBUGHAL) << "caching ADC Token Out delay as " << static_cast<int>(sigIt->second);
       m_toutdelay = sigIt->second;
     }
+    else if(sigIt->first == SIG_ETH_TXBATCH) {
+      LOG(logDEBUGHAL) << "Set Ethernet transmit batch to " << static_cast<int>(sigIt->second) << " frames";
+      _testboard->SetEthernetTxBatch(sigIt->second);
+    }
     else if(sigIt->first == SIG_ADC_TIMEOUT) {
       LOG(logDEBUGHAL) << "caching ADC timeout as " << static_cast<int>(sigIt->second)*10 << " clk";
       m_adctimeout = sigIt->second*10;
@@ -361,6 +370,10 @@ void hal::initROC(uint8_t roci2c, uint8_t type, std::map< uint8_t,uint8_t > dacV
   m_roccount++;
   LOG(logDEBUGHAL) << "Currently have " << static_cast<int>(m_roccount) << " ROCs in HAL";
 
+  // We don't know the pixel configuration of this ROC (yet):
+  m_pucstate.erase(roci2c);
+  m_chipmasked.erase(roci2c);
+
   // Programm all DAC registers according to the configuration data:
   LOG(logDEBUGHAL) << "Setting DAC vector for ROC@I2C " << static_cast<int>(roci2c) << ".";
   rocSetDACs(roci2c,dacVector);
@@ -558,6 +571,7 @@ void hal::setHubId(uint8_t hub0, uint8_t hub1) {
 
 bool hal::rocSetDACs(uint8_t roci2c, std::map< uint8_t, uint8_t > dacPairs) {
 
+  timer tprogram;
   // Make sure we are writing to the correct ROC by setting the I2C address:
   _testboard->roc_I2cAddr(roci2c);
 
@@ -590,12 +604,14 @@ bool hal::rocSetDACs(uint8_t roci2c, std::map< uint8_t, uint8_t > dacPairs) {
 
   // Send all queued commands to the testboard:
   _testboard->Flush();
+  m_timing.m_program += tprogram.getMicroseconds();
   // Everything went all right:
   return true;
 }
 
 bool hal::rocSetDAC(uint8_t roci2c, uint8_t dacId, uint8_t dacValue) {
 
+  timer tprogram;
   // Make sure we are writing to the correct ROC by setting the I2C address:
   _testboard->roc_I2cAddr(roci2c);
 
@@ -609,6 +625,7 @@ bool hal::rocSetDAC(uint8_t roci2c, uint8_t dacId, uint8_t dacValue) {
     LOG(logDEBUGHAL) << "WBC has been programmed - sending a ROC Reset command.";
     daqTriggerSingleSignal(TRG_SEND_RSR);
   }
+  m_timing.m_program += tprogram.getMicroseconds();
   return true;
 }
 
@@ -685,11 +702,22 @@ void hal::RocSetMask(uint8_t roci2c, bool mask, std::vector<pixelConfig> pixels)
 
   // Check if we want to mask or unmask&trim:
   if(mask) {
+    // Nothing to be done if the ROC has not been touched since the last masking:
+    if(m_chipmasked.count(roci2c)) {
+      LOG(logDEBUGHAL) << "ROC@I2C " << static_cast<int>(roci2c) << " is already fully masked.";
+      return;
+    }
+
     // This is quite easy:
     LOG(logDEBUGHAL) << "Masking full ROC@I2C " << static_cast<int>(roci2c);
 
     // Mask the PUC and detach all DC from their readout (both done on NIOS):
     _testboard->roc_Chip_Mask();
+    m_chipmasked.insert(roci2c);
+
+    // The double columns are detached now, single pixel updates would not
+    // re-attach them. Forget the state so the next unmasking uses TrimChip:
+    m_pucstate.erase(roci2c);
   }
   else {
     // Prepare configuration of the pixels, linearize vector:
@@ -705,11 +733,41 @@ void hal::RocSetMask(uint8_t roci2c, bool mask, std::vector<pixelConfig> pixels)
       else trim[position] = pxIt->trim();
     }
 
-    // We really want to program that full thing with correct mask/trim bits:
-    LOG(logDEBUGHAL) << "Updating mask bits & trim values of ROC@I2C " << static_cast<int>(roci2c);
+    // Compare with the configuration currently programmed into the ROC, if known:
+    std::vector<int16_t> & state = m_pucstate[roci2c];
+    std::vector<size_t> changed;
+    if(state.size() == trim.size()) {
+      for(size_t i = 0; i < trim.size(); i++) {
+	if(state[i] != trim[i]) { changed.push_back(i); }
+	if(changed.size() > ROC_MAX_PIXEL_UPDATES) break;
+      }
+    }
 
-    // Trim the whole ROC:
-    _testboard->TrimChip(trim);
+    if(state.size() == trim.size() && changed.empty()) {
+      LOG(logDEBUGHAL) << "Mask bits & trim values of ROC@I2C " << static_cast<int>(roci2c) << " unchanged.";
+    }
+    else if(state.size() == trim.size() && changed.size() <= ROC_MAX_PIXEL_UPDATES) {
+      // Only a few pixels differ, update them one by one:
+      LOG(logDEBUGHAL) << "Updating mask bits & trim values of " << changed.size()
+		       << " pixels on ROC@I2C " << static_cast<int>(roci2c);
+      for(std::vector<size_t>::iterator px = changed.begin(); px != changed.end(); ++px) {
+	uint8_t column = static_cast<uint8_t>(*px/ROC_NUMROWS);
+	uint8_t row = static_cast<uint8_t>(*px%ROC_NUMROWS);
+	if(trim[*px] < 0) _testboard->roc_Pix_Mask(column,row);
+	else _testboard->roc_Pix_Trim(column,row,static_cast<uint8_t>(trim[*px]));
+      }
+    }
+    else {
+      // We really want to program that full thing with correct mask/trim bits:
+      LOG(logDEBUGHAL) << "Updating mask bits & trim values of ROC@I2C " << static_cast<int>(roci2c);
+
+      // Trim the whole ROC:
+      _testboard->TrimChip(trim);
+    }
+
+    // Store the new configuration of the ROC:
+    state = trim;
+    m_chipmasked.erase(roci2c);
   }
 }
 
@@ -726,6 +784,11 @@ void hal::AllColumnsSetEnable(uint8_t roci2c, bool enable) {
 
   _testboard->roc_AllCol_Enable(enable);
   _testboard->Flush();
+
+  // Double columns have been attached or detached. Detached columns are only
+  // re-attached by a full TrimChip, so forget the pixel state in that case:
+  m_chipmasked.erase(roci2c);
+  if(!enable) { m_pucstate.erase(roci2c); }
 }
 
 void hal::PixelSetCalibrate(uint8_t roci2c, uint8_t column, uint8_t row, uint16_t flags) {
@@ -799,7 +862,9 @@ std::vector<Event> hal::MultiRocAllPixelsCalibrate(std::vector<uint8_t> roci2cs,
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopMultiRocAllPixelsCalibrate(roci2cs, nTriggers, flags);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -841,7 +906,9 @@ std::vector<Event> hal::MultiRocOnePixelCalibrate(std::vector<uint8_t> roci2cs,
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopMultiRocOnePixelCalibrate(roci2cs, column, row, nTriggers, flags);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -882,7 +949,9 @@ std::vector<Event> hal::SingleRocAllPixelsCalibrate(uint8_t roci2c, bool efficie
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopSingleRocAllPixelsCalibrate(roci2c, nTriggers, flags);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -922,7 +991,9 @@ std::vector<Event> hal::SingleRocOnePixelCalibrate(uint8_t roci2c, uint8_t colum
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopSingleRocOnePixelCalibrate(roci2c, column, row, nTriggers, flags);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -974,7 +1045,9 @@ std::vector<Event> hal::MultiRocAllPixelsDacScan(std::vector<uint8_t> roci2cs, b
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopMultiRocAllPixelsDacScan(roci2cs, nTriggers, flags, dacreg, dacstep, dacmin, dacmax);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -1027,7 +1100,9 @@ std::vector<Event> hal::MultiRocOnePixelDacScan(std::vector<uint8_t> roci2cs, ui
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopMultiRocOnePixelDacScan(roci2cs, column, row, nTriggers, flags, dacreg, dacstep, dacmin, dacmax);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -1076,7 +1151,9 @@ std::vector<Event> hal::SingleRocAllPixelsDacScan(uint8_t roci2c, bool efficienc
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopSingleRocAllPixelsDacScan(roci2c, nTriggers, flags, dacreg, dacstep, dacmin, dacmax);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -1125,7 +1202,9 @@ std::vector<Event> hal::SingleRocOnePixelDacScan(uint8_t roci2c, uint8_t column,
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopSingleRocOnePixelDacScan(roci2c, column, row, nTriggers, flags, dacreg, dacstep, dacmin, dacmax);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -1184,7 +1263,9 @@ std::vector<Event> hal::MultiRocAllPixelsDacDacScan(std::vector<uint8_t> roci2cs
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopMultiRocAllPixelsDacDacScan(roci2cs, nTriggers, flags, dac1reg, dac1step, dac1min, dac1max, dac2reg, dac2step, dac2min, dac2max);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -1246,7 +1327,9 @@ std::vector<Event> hal::MultiRocOnePixelDacDacScan(std::vector<uint8_t> roci2cs,
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopMultiRocOnePixelDacDacScan(roci2cs, column, row, nTriggers, flags, dac1reg, dac1step, dac1min, dac1max, dac2reg, dac2step, dac2min, dac2max);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -1304,7 +1387,9 @@ std::vector<Event> hal::SingleRocAllPixelsDacDacScan(uint8_t roci2c, bool effici
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopSingleRocAllPixelsDacDacScan(roci2c, nTriggers, flags, dac1reg, dac1step, dac1min, dac1max, dac2reg, dac2step, dac2min, dac2max);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -1362,7 +1447,9 @@ std::vector<Event> hal::SingleRocOnePixelDacDacScan(uint8_t roci2c, uint8_t colu
   bool done = false;
   std::vector<Event> data = std::vector<Event>();
   while(!done) {
+    timer tloop;
     done = _testboard->LoopSingleRocOnePixelDacDacScan(roci2c, column, row, nTriggers, flags, dac1reg, dac1step, dac1min, dac1max, dac2reg, dac2step, dac2min, dac2max);
+    m_timing.m_loop += tloop.getMicroseconds();
     LOG(logDEBUGHAL) << "Loop " << (done ? "finished" : "interrupted") << " (" << t << "ms), reading " << daqBufferStatus() << " words...";
     addCondensedData(data,nTriggers,efficiency,t);
   }
@@ -1413,6 +1500,8 @@ void hal::Pon() {
   m_roctype = ROC_NONE;
   m_roccount = 0;
   m_tokenchains.clear();
+  m_pucstate.clear();
+  m_chipmasked.clear();
 
   // Wait a little and let the power switch do its job:
   mDelay(300);
@@ -1422,6 +1511,10 @@ void hal::Poff() {
   // Turn off DUT power and execute (flush):
   _testboard->Poff();
   _testboard->Flush();
+
+  // All pixel configurations are lost:
+  m_pucstate.clear();
+  m_chipmasked.clear();
 }
 
 
@@ -1517,10 +1610,19 @@ void hal::SigSetLVDS(){
 void hal::daqStart(uint16_t flags, uint8_t deser160phase, uint32_t buffersize) {
 
   LOG(logDEBUGHAL) << "Starting new DAQ session.";
+  timer tprogram;
   for(uint8_t channel = 0; channel < DTB_DAQ_CHANNELS; channel++) { m_daqstatus.push_back(false); }
   
   // Clear all decoder instances:
   for(size_t ch = 0; ch < m_decoder.size(); ch++) { m_decoder.at(ch).Clear(); }
+  m_hotreported.assign(m_decoder.size(),0);
+
+  // The NIOS trigger loops unmask and trim pixels themselves unless running
+  // with FLAG_FORCE_UNMASKED, we can't rely on our knowledge of the PUCs anymore:
+  if((flags & FLAG_FORCE_UNMASKED) == 0) {
+    m_pucstate.clear();
+    m_chipmasked.clear();
+  }
 
   // Figure out the number of DAQ channels we need:
   if(m_tokenchains.empty()) { m_tokenchains.push_back(m_roccount); }
@@ -1608,6 +1710,7 @@ void hal::daqStart(uint16_t flags, uint8_t deser160phase, uint32_t buffersize) {
   
   _testboard->uDelay(100);
   _testboard->Flush();
+  m_timing.m_program += tprogram.getMicroseconds();
 }
 
 Event hal::daqEvent() {
@@ -1648,10 +1751,26 @@ Event hal::daqEvent() {
   return current_Event;
 }
 
+uint64_t hal::daqReadoutTime() {
+  uint64_t readout = 0;
+  for(size_t ch = 0; ch < m_src.size(); ch++) { readout += m_src.at(ch).GetReadoutTime(); }
+  return readout;
+}
+
+void hal::addDecodingTime(timer &t, uint64_t readout) {
+  // Everything not spent waiting for the DTB counts as decoding:
+  uint64_t total = t.getMicroseconds();
+  readout = daqReadoutTime() - readout;
+  m_timing.m_readout += readout;
+  m_timing.m_decode += (total > readout ? total - readout : 0);
+}
+
 std::vector<Event> hal::daqAllEvents() {
 
   std::vector<Event> evt;
   uint16_t flags = 0;
+  timer t;
+  uint64_t readout = daqReadoutTime();
   
   // Prepare channel flags:
   std::vector<bool> done_ch;
@@ -1676,7 +1795,7 @@ std::vector<Event> hal::daqAllEvents() {
 	  _testboard->Daq_MemReset(ch);
 	  done_ch.at(ch) = true;
 	}
-	catch (dataPipeException &e) { LOG(logERROR) << e.what(); return evt; }
+	catch (dataPipeException &e) { LOG(logERROR) << e.what(); addDecodingTime(t,readout); return evt; }
       }
       else { done_ch.at(ch) = true; }
     }
@@ -1693,6 +1812,7 @@ std::vector<Event> hal::daqAllEvents() {
       // Check for the channels all reporting the same event number:
       if((flags & FLAG_DISABLE_EVENTID_CHECK) == 0 && !equalElements(current_Event.triggerCounts())) {
 	LOG(logERROR) << "Channels report mismatching event numbers: " << listVector(current_Event.triggerCounts());
+	addDecodingTime(t,readout);
 	throw DataEventNumberMismatch("Channels report mismatching event numbers: " + listVector(current_Event.triggerCounts()));
       }
       // Store the event
@@ -1700,10 +1820,78 @@ std::vector<Event> hal::daqAllEvents() {
     }
   }
   
+  addDecodingTime(t,readout);
   if(evt.empty()) throw DataNoEvent("No event available");
   return evt;
 }
 
+uint32_t hal::daqDrainEvents() {
+
+  uint32_t nevents = 0;
+  uint16_t flags = 0;
+  timer t;
+  uint64_t readout = daqReadoutTime();
+
+  // Prepare channel flags:
+  std::vector<bool> done_ch;
+  for(size_t i = 0; i < m_src.size(); i++) { done_ch.push_back(false); }
+
+  // Trigger counts of all channels for the current event, reused:
+  std::vector<uint8_t> counts;
+
+  while(1) {
+    // Pump the next Event through each of the pipes, the decoders reuse their
+    // Event object so nothing is stored but the decoding statistics:
+    counts.clear();
+    for(size_t ch = 0; ch < m_src.size(); ch++) {
+      if(m_src.at(ch).isConnected() && (!done_ch.at(ch))) {
+	dataSink<Event*> Eventpump;
+	m_splitter.at(ch) >> m_decoder.at(ch) >> Eventpump;
+
+	// Read the supplied DAQ flags:
+	if(flags == 0 && ch == 0) { flags = Eventpump.GetFlags(); }
+
+	try {
+	  Event * evt = Eventpump.Get();
+	  if((flags & FLAG_DISABLE_EVENTID_CHECK) == 0) {
+	    std::vector<uint8_t> tc = evt->triggerCounts();
+	    counts.insert(counts.end(), tc.begin(), tc.end());
+	  }
+	}
+	catch (dsBufferEmpty &) {
+	  LOG(logDEBUGHAL) << "Finished readout Channel " << ch << ".";
+	  // Reset the DTB memory to work around buffer issue:
+	  _testboard->Daq_MemReset(ch);
+	  done_ch.at(ch) = true;
+	}
+	catch (dataPipeException &e) { LOG(logERROR) << e.what(); addDecodingTime(t,readout); return nevents; }
+      }
+      else { done_ch.at(ch) = true; }
+    }
+
+    _testboard->Flush();
+
+    // If all readout is finished, return:
+    std::vector<bool>::iterator fin = std::find(done_ch.begin(), done_ch.end(), false);
+    if(fin == done_ch.end()) {
+      LOG(logDEBUGHAL) << "Drained all DAQ channels, " << nevents << " events.";
+      break;
+    }
+    else {
+      // Check for the channels all reporting the same event number:
+      if((flags & FLAG_DISABLE_EVENTID_CHECK) == 0 && !equalElements(counts)) {
+	LOG(logERROR) << "Channels report mismatching event numbers: " << listVector(counts);
+	addDecodingTime(t,readout);
+	throw DataEventNumberMismatch("Channels report mismatching event numbers: " + listVector(counts));
+      }
+      nevents++;
+    }
+  }
+
+  addDecodingTime(t,readout);
+  return nevents;
+}
+
 rawEvent hal::daqRawEvent() {
 
   rawEvent current_Event;
@@ -1860,9 +2048,11 @@ void hal::daqTriggerSingleSignal(uint8_t signal) {
 void hal::daqTrigger(uint32_t nTrig, uint16_t period) {
 
   LOG(logDEBUGHAL) << "Triggering " << nTrig << "x";
+  timer t;
   _testboard->Pg_Triggers(nTrig, period);
   // Push to testboard:
   _testboard->Flush();
+  m_timing.m_loop += t.getMicroseconds();
 }
 
 void hal::daqTriggerLoop(uint16_t period) {
@@ -1904,6 +2094,46 @@ statistics hal::daqStatistics() {
   return errors;
 }
 
+void hal::daqHotPixelMonitor(uint32_t threshold) {
+  if(threshold > 0) { LOG(logDEBUGHAL) << "Enabling hot pixel monitor, threshold " << threshold << " hits."; }
+  else { LOG(logDEBUGHAL) << "Disabling hot pixel monitor."; }
+  for(size_t ch = 0; ch < m_decoder.size(); ch++) { m_decoder.at(ch).setHotPixelMonitor(threshold); }
+  m_hotreported.assign(m_decoder.size(),0);
+}
+
+std::vector<std::pair<pixel,double> > hal::daqHotPixels(bool onlynew) {
+
+  std::vector<std::pair<pixel,double> > hot;
+  m_hotreported.resize(m_decoder.size(),0);
+
+  for(size_t ch = 0; ch < m_decoder.size(); ch++) {
+    // Every channel sees all triggers, but only the ROCs of its token chain:
+    uint32_t events = m_decoder.at(ch).getHitEvents();
+    const std::vector<pixel> & px = m_decoder.at(ch).getHotPixels();
+    // The decoders only append to their list, skip what has been reported:
+    size_t first = onlynew ? std::min(m_hotreported.at(ch),px.size()) : 0;
+    m_hotreported.at(ch) = px.size();
+    for(std::vector<pixel>::const_iterator it = px.begin() + first; it != px.end(); ++it) {
+      uint32_t hits = m_decoder.at(ch).getHitCount(*it);
+      pixel p(it->roc(),it->column(),it->row(),std::min<uint32_t>(hits,32767));
+      hot.push_back(std::make_pair(p,events > 0 ? static_cast<double>(hits)/events : 0.));
+    }
+  }
+  return hot;
+}
+
+uint32_t hal::daqHotPixelEvents() {
+  uint32_t events = 0;
+  for(size_t ch = 0; ch < m_decoder.size(); ch++) { events = std::max(events,m_decoder.at(ch).getHitEvents()); }
+  return events;
+}
+
+timingStatistics hal::daqTiming() {
+  timingStatistics timing = m_timing;
+  m_timing.clear();
+  return timing;
+}
+
 std::vector<std::vector<uint16_t> > hal::daqReadback() {
 
   // Collect readback values from all decoder instances:
@@ -1925,6 +2155,8 @@ std::vector<uint8_t> hal::daqXORsum(uint8_t channel) {
 
 void hal::daqStop() {
 
+  timer tprogram;
+
   // Stop the Pattern Generator, just in case (also stops Pg_Loop())
   _testboard->Pg_Stop();
 
@@ -1936,6 +2168,7 @@ void hal::daqStop() {
   for(uint8_t channel = 0; channel < DTB_DAQ_CHANNELS; channel++) { _testboard->Daq_Stop(channel); }
   _testboard->uDelay(100);
   _testboard->Flush();
+  m_timing.m_program += tprogram.getMicroseconds();
 
   LOG(logDEBUGHAL) << "Stopped DAQ session.";
 }
@@ -1947,8 +2180,10 @@ void hal::daqClear() {
 
   // Running Daq_Close() to delete all data and free allocated RAM:
   LOG(logDEBUGHAL) << "Closing DAQ session, deleting data buffers.";
+  timer tprogram;
   for(uint8_t channel = 0; channel < DTB_DAQ_CHANNELS; channel++) { _testboard->Daq_Close(channel); }
   m_daqstatus.clear();
+  m_timing.m_program += tprogram.getMicroseconds();
 }
 
 std::vector<uint16_t> hal::daqADC(uint8_t analog_probe, uint8_t gain, uint16_t nSample, uint8_t source, uint8_t start, uint8_t stop){
@@ -1994,7 +2229,7 @@ uint16_t hal::GetADC(uint8_t rpc_par1){
   return _testboard->GetADC(rpc_par1);
 }
 
-std::vector<Event> hal::condenseTriggers(std::vector<Event> &data, uint16_t nTriggers, bool efficiency) {
+std::vector<Event> pxar::condenseTriggers(std::vector<Event> &data, uint16_t nTriggers, bool efficiency) {
 
   std::vector<Event> packed;
 
@@ -2065,7 +2300,9 @@ void hal::addCondensedData(std::vector<Event> &data, uint16_t nTriggers, bool ef
   std::vector<Event> tmpdata = std::vector<Event>();
   try {
     tmpdata = daqAllEvents();
+    timer tcondense;
     tmpdata = condenseTriggers(tmpdata, nTriggers, efficiency);
+    m_timing.m_condense += tcondense.getMicroseconds();
     data.insert(data.end(),tmpdata.begin(),tmpdata.end());
     LOG(logDEBUGHAL) << (tmpdata.size()*nTriggers) << " events read and condensed (" << t << "ms), "
 		     << data.size() << " events buffered.";
@@ -7,6 +7,7 @@
 #include "datasource_dtb.h"
 #include "constants.h"
 #include "timer.h"
+#include <set>
 
 namespace pxar {
 
@@ -367,10 +368,36 @@ namespace pxar {
      */
     std::vector<Event> daqAllEvents();
 
+    /** Decode all remaining Events from the FIFO buffer without storing them,
+     *  only the decoding statistics (and readback) are updated. Returns the
+     *  number of events
+     */
+    uint32_t daqDrainEvents();
+
     /** Return the current decoding statistics for all channels:
      */
     statistics daqStatistics();
 
+    /** Enable the hot pixel monitor of all decoders (threshold > 0) or switch
+     *  it off (threshold 0). The hit counters are reset here and at daqStart()
+     */
+    void daqHotPixelMonitor(uint32_t threshold);
+
+    /** Return the pixels which reached the hot pixel threshold, in the order
+     *  they did, together with their hits per decoded event. With onlynew set
+     *  only the pixels not returned by a previous call are listed.
+     */
+    std::vector<std::pair<pixel,double> > daqHotPixels(bool onlynew = false);
+
+    /** Return the number of events counted by the hot pixel monitor
+     */
+    uint32_t daqHotPixelEvents();
+
+    /** Return the wall time accumulated in the test phases since the last
+     *  call and reset the counters
+     */
+    timingStatistics daqTiming();
+
     /** Return all readback values for the last readout. Return format is a vector containing
      *  one vector of uint16_t radback values for every ROC in the readout chain.
      */
@@ -399,7 +426,12 @@ namespace pxar {
 
     // Functions to set bits somewhere on the ROC:
 
-    /** Mask all pixels on a specific ROC I2C address
+    /** Mask all pixels on a specific ROC I2C address or unmask & trim them
+     *  according to the supplied pixel configuration.
+     *
+     *  The state last programmed into the ROC is kept, so that unchanged ROCs
+     *  are skipped and only a few changed pixels are updated one by one
+     *  instead of re-trimming the full ROC.
      */
     void RocSetMask(uint8_t roci2c, bool mask, std::vector<pixelConfig> pixels = std::vector<pixelConfig>());
 
@@ -452,6 +484,18 @@ namespace pxar {
     // Store which channels are active:
     std::vector<bool> m_daqstatus;
 
+    /** Shadow copy of the mask & trim state last programmed into the Pixel Unit
+     *  Cells of every ROC, stored by I2C address (-1 = masked). ROCs without
+     *  entry are in an unknown state or have detached double columns, they
+     *  are programmed in full.
+     */
+    std::map<uint8_t, std::vector<int16_t> > m_pucstate;
+
+    /** I2C addresses of ROCs which have been fully masked (including their
+     *  double columns) and have not been touched since.
+     */
+    std::set<uint8_t> m_chipmasked;
+
     uint16_t _currentTrgSrc;
 
     /** Print the info block with software and firmware versions,
@@ -477,11 +521,6 @@ namespace pxar {
      */
     void estimateDataVolume(uint32_t events, uint8_t nROCs);
 
-    /** Merges all consecutive triggers into one pxar::Event. This function deletes the original event data after
-     *  merging! 
-     */
-    std::vector<Event> condenseTriggers(std::vector<Event> &data, uint16_t nTriggers, bool efficiency);
-
     /** Helper function reading data, passing it to the condenser and then returns it to the test function
      */
     void addCondensedData(std::vector<Event> &data, uint16_t nTriggers, bool efficiency, timer t);
@@ -519,6 +558,22 @@ namespace pxar {
     std::vector<dtbSource> m_src;
     std::vector<dtbEventSplitter> m_splitter;
     std::vector<dtbEventDecoder> m_decoder;
+
+    // Number of hot pixels per decoder already returned by daqHotPixels(true):
+    std::vector<size_t> m_hotreported;
+
+    /** Wall time spent in the different phases of the tests
+     */
+    timingStatistics m_timing;
+
+    /** Sum of the DTB read time of all data sources
+     */
+    uint64_t daqReadoutTime();
+
+    /** Adds the time since the timer was started to the readout and decode
+     *  phases, readout is the data source read time at the start
+     */
+    void addDecodingTime(timer &t, uint64_t readout);
   };
 }
 #endif
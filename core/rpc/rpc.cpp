@@ -95,9 +95,13 @@ void rpc_SendRaw(CRpcIo &rpc_io, const void *x, uint32_t size)
 
 void rpc_DataSink(CRpcIo &rpc_io, uint32_t size)
 {
-	if (size == 0) return;
-	CBuffer buffer(size);
-	rpc_io.Read(&buffer, size);
+	uint8_t buffer[4096];
+	while (size)
+	{
+		uint32_t n = (size < sizeof(buffer)) ? size : sizeof(buffer);
+		rpc_io.Read(buffer, n);
+		size -= n;
+	}
 }
 
 
@@ -105,14 +109,8 @@ void rpc_Receive(CRpcIo &rpc_io, string &x)
 {
 	CDataHeader msg;
 	msg.RecvHeader(rpc_io);
-	x.clear();
-	x.reserve(msg.m_size);
-	char ch;
-	for (uint32_t i=0; i<msg.m_size; i++)
-	{
-		rpc_io.Read(&ch, 1);
-		x.push_back(ch);
-	}
+	x.resize(msg.m_size);
+	if (msg.m_size) rpc_io.Read(&(x[0]), msg.m_size);
 }
 
 
@@ -13,6 +13,7 @@
 #include "rpc_io.h"
 #include "rpc_error.h"
 #include "log.h"
+#include "rawbuffer.h"
 
 #ifdef ENABLE_RPC_PROFILING
 #define RPC_PROFILING PROFILING LOG(pxar::logDEBUGRPC) << "called.";
@@ -178,6 +179,23 @@ void rpc_Receive(CRpcIo &rpc_io, vector<T> &x)
 }
 
 
+// Receives directly into reusable, uninitialized storage. With append
+// set the data is added behind the current content of the buffer.
+template <class T>
+void rpc_Receive(CRpcIo &rpc_io, pxar::rawBuffer<T> &x, bool append = false)
+{
+	CDataHeader msg;
+	msg.RecvHeader(rpc_io);
+	if ((msg.m_size % sizeof(T)) != 0)
+	{
+		rpc_DataSink(rpc_io, msg.m_size);
+		throw CRpcError(CRpcError::WRONG_DATA_SIZE);
+	}
+	if (!append) x.clear();
+	if (msg.m_size != 0) rpc_io.Read(x.extend(msg.m_size/sizeof(T)), msg.m_size);
+}
+
+
 inline void rpc_Send(CRpcIo &rpc_io, const string &x)
 {
 	rpc_SendRaw(rpc_io, x.c_str(), x.length());
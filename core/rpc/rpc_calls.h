@@ -1,7 +1,9 @@
 #pragma once
 
 #include "rpc.h"
+#include "rpc_record.h"
 #include <vector>
+#include <stdlib.h>
 
 #ifdef INTERFACE_USB
 #include "USBInterface.h"
@@ -26,11 +28,16 @@ class CTestboard
 
   std::vector<CRpcIo*> interfaceList;
 
+  CRpcIoRecorder *recorder;
+  CRpcIoReplay *replay;
+
 public:
 	CRpcIo& GetIo() { return *rpc_io; }
 
 	CTestboard() { 
 	  RPC_INIT 
+	  recorder = NULL;
+	  replay = NULL;
 
 #ifdef INTERFACE_USB
 	  usb = NULL;
@@ -40,7 +47,7 @@ public:
 	  ethernet = NULL;
 #endif /* INTERFACE_ETH */
 	}
-	~CTestboard() { RPC_EXIT }
+	~CTestboard() { delete recorder; delete replay; RPC_EXIT }
 
 	int32_t GetHostRpcCallCount() { return rpc_cmdListSize; }
 	bool GetHostRpcCallName(int32_t id, stringR &callName) { callName = rpc_cmdName[id]; return true; }
@@ -119,6 +126,19 @@ public:
 	    }
 	  }
 
+	  // Record all traffic with the selected interface if requested:
+	  const char *recordFile = getenv(RPC_RECORD_ENV);
+	  if(ifaceFound && recordFile != NULL) {
+	    try {
+	      if(recorder == NULL) recorder = new CRpcIoRecorder(recordFile);
+	      recorder->Attach(rpc_io);
+	      rpc_io = recorder;
+	    }
+	    catch (CRpcError &) {
+	      LOG(pxar::logERROR) << "Could not open " << recordFile << " for recording.";
+	    }
+	  }
+
 	  return ifaceFound;
 	}
 
@@ -143,6 +163,22 @@ public:
 	std::vector<CRpcIo*> GetInterfaceList() {
 	  interfaceList.clear();
 
+	  // A recorded session replaces all hardware interfaces:
+	  const char *replayFile = getenv(RPC_REPLAY_ENV);
+	  if(replayFile != NULL) {
+	    try {
+	      if(replay == NULL) {
+		const char *realtime = getenv(RPC_REPLAY_REALTIME_ENV);
+		replay = new CRpcIoReplay(replayFile, realtime != NULL && std::string(realtime) == "1");
+	      }
+	      interfaceList.push_back(replay);
+	    }
+	    catch(CRpcError &) {
+	      LOG(pxar::logERROR) << "Could not open recorded session " << replayFile << ".";
+	    }
+	    return interfaceList;
+	  }
+
 #ifdef INTERFACE_ETH
 	  if(ethernet == NULL) {
 	    try {
@@ -209,6 +245,13 @@ public:
 
 	void SetTimeout(unsigned int timeout) { rpc_io->SetTimeout(timeout); }
 
+	// Number of Ethernet frames sent as one burst, no effect on USB
+	void SetEthernetTxBatch(unsigned int frames) {
+#ifdef INTERFACE_ETH
+	  if(ethernet != NULL) ethernet->SetTxBatch(frames);
+#endif /*INTERFACE_ETH*/
+	}
+
 	bool IsConnected() { return rpc_io->Connected(); }
 	const char * ConnectionError()
 	{ return rpc_io->GetErrorMsg(rpc_io->GetLastError()); }
@@ -339,6 +382,83 @@ public:
 	RPC_EXPORT uint8_t Daq_FillLevel();
 	RPC_EXPORT uint8_t Daq_Read(HWvectorR<uint16_t> &data, uint32_t blocksize = 65536, uint8_t channel = 0);
 	RPC_EXPORT uint8_t Daq_Read(HWvectorR<uint16_t> &data, uint32_t blocksize, uint32_t &availsize, uint8_t channel = 0);
+
+	// Pipelined Daq_Read: sends "depth" read requests back-to-back and only
+	// then waits for the answers, so the link round trip is paid once per
+	// batch instead of once per block. The DTB answers RPC calls strictly in
+	// order, so the responses are matched to the requests first-in first-out.
+	// The blocks are concatenated in "data", "availsize" holds the value
+	// reported with the last block and the returned state is the OR of all
+	// block states. The request is sent with the id of Daq_Read (83).
+	// The data is received straight into the reusable buffer, no memory is
+	// allocated or zero-filled once the buffer has reached its working size.
+	// If an error occurs within the batch, the outstanding responses are
+	// read and discarded (or the receive buffer is cleared if the stream
+	// can not be resynchronized) before the error is passed on, so later
+	// calls do not pick up the answers to these requests.
+	uint8_t Daq_Read_Pipelined(pxar::rawBuffer<uint16_t> &data, uint32_t blocksize, uint32_t &availsize, uint8_t channel, uint8_t depth) {
+	  uint8_t rpc_par0 = 0;
+	  if (depth == 0) depth = 1;
+	  try {
+	    uint16_t rpc_clientCallId = rpc_GetCallId(83);
+	    RPC_THREAD_LOCK
+	    for (uint8_t i = 0; i < depth; i++) {
+	      rpcMessage msg;
+	      msg.Create(rpc_clientCallId);
+	      msg.Put_UINT32(blocksize);
+	      msg.Put_UINT32(availsize);
+	      msg.Put_UINT8(channel);
+	      msg.Send(*rpc_io);
+	    }
+	    rpc_io->Flush();
+
+	    data.clear();
+	    // Responses not completely read, and whether the data block of the
+	    // current response is still in the stream:
+	    uint8_t pending = depth;
+	    bool dataPending = false;
+	    try {
+	      for (; pending > 0; pending--) {
+		rpcMessage msg;
+		msg.Receive(*rpc_io);
+		dataPending = true;
+		msg.Check(rpc_clientCallId,5);
+		rpc_par0 |= msg.Get_UINT8();
+		availsize = msg.Get_UINT32();
+		rpc_Receive(*rpc_io, data, true);
+		dataPending = false;
+	      }
+	    } catch (CRpcError &e) {
+	      Daq_Read_Drain(e, pending, dataPending);
+	      throw;
+	    }
+	    RPC_THREAD_UNLOCK
+	  } catch (CRpcError &e) { e.SetFunction(83); throw; };
+	  return rpc_par0;
+	}
+
+	// Skips the remaining responses of a failed Daq_Read_Pipelined batch.
+	// Only possible if the failing response was read up to a known position,
+	// i.e. its header did not match or its data block was sunk already.
+	void Daq_Read_Drain(const CRpcError &e, uint8_t pending, bool dataPending) {
+	  bool resync = (e.error == CRpcError::WRONG_DATA_SIZE)
+	    || (dataPending && (e.error == CRpcError::UNKNOWN_CMD || e.error == CRpcError::CMD_PAR_SIZE));
+	  if (e.error == CRpcError::WRONG_DATA_SIZE) dataPending = false;
+	  if (resync) {
+	    try {
+	      pxar::rawBuffer<uint16_t> scratch;
+	      if (dataPending) rpc_Receive(*rpc_io, scratch);
+	      for (uint8_t i = 1; i < pending; i++) {
+		rpcMessage msg;
+		msg.Receive(*rpc_io);
+		rpc_Receive(*rpc_io, scratch);
+	      }
+	      return;
+	    } catch (CRpcError &) {}
+	  }
+	  // Position in the stream unknown, drop everything received so far:
+	  rpc_io->Clear();
+	}
 	
 
 	RPC_EXPORT void Daq_Select_ADC(uint16_t blocksize, uint8_t source, uint8_t start, uint8_t stop = 0);
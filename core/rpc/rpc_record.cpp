@@ -0,0 +1,261 @@
+// rpc_record.cpp
+
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/time.h>
+#endif
+
+#include "rpc.h"
+#include "rpc_record.h"
+#include "log.h"
+
+
+static uint64_t rpc_TimeUs()
+{
+#ifndef WIN32
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return static_cast<uint64_t>(tv.tv_sec)*1000000 + tv.tv_usec;
+#else
+	return 0;
+#endif
+}
+
+
+// === recorder =============================================================
+
+// interval in us in which the recording is written to disk, so a crash
+// only loses the last part of it
+#define RPC_RECORD_FLUSH_INTERVAL 1000000
+
+
+CRpcIoRecorder::CRpcIoRecorder(const char *filename) : m_io(&RpcIoNull), m_start(rpc_TimeUs()), m_flushed(0)
+{
+	m_file = fopen(filename, "wb");
+	if (!m_file) throw CRpcError(CRpcError::IF_INIT_ERROR);
+	fwrite(RPC_RECORD_MAGIC, 1, strlen(RPC_RECORD_MAGIC), m_file);
+	LOG(pxar::logINFO) << "Recording DTB traffic to " << filename;
+}
+
+
+CRpcIoRecorder::~CRpcIoRecorder()
+{
+	fclose(m_file);
+}
+
+
+void CRpcIoRecorder::Attach(CRpcIo *io)
+{
+	m_io = io;
+}
+
+
+void CRpcIoRecorder::Record(uint8_t type, const void *data, uint32_t size)
+{
+	uint64_t t = rpc_TimeUs() - m_start;
+	fwrite(&type, 1, 1, m_file);
+	fwrite(&size, 4, 1, m_file);
+	fwrite(&t, 8, 1, m_file);
+	if (size) fwrite(data, 1, size, m_file);
+	if (t - m_flushed >= RPC_RECORD_FLUSH_INTERVAL)
+	{
+		fflush(m_file);
+		m_flushed = t;
+	}
+}
+
+
+void CRpcIoRecorder::Write(const void *buffer, uint32_t size)
+{
+	Record(RPC_RECORD_WRITE, buffer, size);
+	m_io->Write(buffer, size);
+}
+
+
+void CRpcIoRecorder::Flush()
+{
+	Record(RPC_RECORD_FLUSH, NULL, 0);
+	m_io->Flush();
+}
+
+
+void CRpcIoRecorder::Clear()
+{
+	Record(RPC_RECORD_CLEAR, NULL, 0);
+	m_io->Clear();
+}
+
+
+void CRpcIoRecorder::Read(void *buffer, uint32_t size)
+{
+	// only complete reads end up in the file, a failed read throws
+	m_io->Read(buffer, size);
+	Record(RPC_RECORD_READ, buffer, size);
+}
+
+
+const char* CRpcIoRecorder::Name()
+{
+	// keep the name of the recorded interface so it is found by name
+	return m_io->Name();
+}
+
+
+bool CRpcIoRecorder::Open(char name[])
+{
+	Record(RPC_RECORD_OPEN, name, strlen(name) + 1);
+	return m_io->Open(name);
+}
+
+
+void CRpcIoRecorder::Close()
+{
+	Record(RPC_RECORD_CLOSE, NULL, 0);
+	m_io->Close();
+	fflush(m_file);
+}
+
+
+// === replay ===============================================================
+
+bool CRpcIoReplay::CStream::Open(const char *filename, uint8_t type)
+{
+	if (m_file) fclose(m_file);
+	m_file = fopen(filename, "rb");
+	if (!m_file) return false;
+	char magic[sizeof(RPC_RECORD_MAGIC)] = { 0 };
+	if (fread(magic, 1, strlen(RPC_RECORD_MAGIC), m_file) != strlen(RPC_RECORD_MAGIC)
+		|| strcmp(magic, RPC_RECORD_MAGIC) != 0) return false;
+	m_type = type;
+	m_left = 0;
+	return true;
+}
+
+
+static bool rpc_ReadRecordHeader(FILE *file, uint8_t &type, uint32_t &size, uint64_t &time)
+{
+	return fread(&type, 1, 1, file) == 1
+		&& fread(&size, 4, 1, file) == 1
+		&& fread(&time, 8, 1, file) == 1;
+}
+
+
+bool CRpcIoReplay::CStream::Next()
+{
+	if (!m_file) return false;
+	if (m_left) { fseek(m_file, m_left, SEEK_CUR); m_left = 0; }
+	uint8_t type;
+	uint32_t size;
+	uint64_t time;
+	while (rpc_ReadRecordHeader(m_file, type, size, time))
+	{
+		if (type == m_type && size > 0) { m_left = size; m_time = time; return true; }
+		if (size) fseek(m_file, size, SEEK_CUR);
+	}
+	return false;
+}
+
+
+void CRpcIoReplay::CStream::Get(void *buffer, uint32_t size)
+{
+	if (size > m_left || fread(buffer, 1, size, m_file) != size) throw CRpcError(CRpcError::READ_ERROR);
+	m_left -= size;
+}
+
+
+CRpcIoReplay::CRpcIoReplay(const char *filename, bool realtime)
+	: m_realtime(realtime), m_open(false), m_start(0), m_origin(0), m_mismatches(0)
+{
+	// The device name is taken from the first recorded Open()
+	CStream opens;
+	if (!opens.Open(filename, RPC_RECORD_OPEN)) throw CRpcError(CRpcError::IF_INIT_ERROR);
+	if (opens.Next())
+	{
+		m_origin = opens.Time();
+		std::string name(opens.Left(), '\0');
+		opens.Get(&name[0], opens.Left());
+		m_device = name.c_str();
+	}
+	if (!m_reads.Open(filename, RPC_RECORD_READ) || !m_writes.Open(filename, RPC_RECORD_WRITE))
+		throw CRpcError(CRpcError::IF_INIT_ERROR);
+	LOG(pxar::logINFO) << "Replaying DTB traffic of " << m_device << " from " << filename
+		<< (m_realtime ? " at recorded timing" : "");
+}
+
+
+bool CRpcIoReplay::Open(char /*name*/[])
+{
+	if (m_start == 0) m_start = rpc_TimeUs();
+	m_open = true;
+	return true;
+}
+
+
+void CRpcIoReplay::Write(const void *buffer, uint32_t size)
+{
+	// Writes are only checked, a differing request makes the following
+	// responses meaningless
+	const uint8_t *p = reinterpret_cast<const uint8_t*>(buffer);
+	uint8_t recorded[256];
+	while (size)
+	{
+		if (!m_writes.Left() && !m_writes.Next()) throw CRpcError(CRpcError::WRITE_ERROR);
+		uint32_t n = size;
+		if (n > m_writes.Left()) n = m_writes.Left();
+		if (n > sizeof(recorded)) n = sizeof(recorded);
+		m_writes.Get(recorded, n);
+		if (memcmp(recorded, p, n) != 0 && m_mismatches++ == 0)
+		{
+			LOG(pxar::logWARNING) << "Replay: request differs from the recorded session, responses may not match.";
+		}
+		p += n;
+		size -= n;
+	}
+}
+
+
+void CRpcIoReplay::Read(void *buffer, uint32_t size)
+{
+	uint8_t *p = reinterpret_cast<uint8_t*>(buffer);
+	while (size)
+	{
+		if (!m_reads.Left())
+		{
+			if (!m_reads.Next()) throw CRpcError(CRpcError::READ_TIMEOUT);
+#ifndef WIN32
+			if (m_realtime)
+			{
+				uint64_t now = rpc_TimeUs() - m_start;
+				uint64_t due = (m_reads.Time() > m_origin) ? m_reads.Time() - m_origin : 0;
+				if (due > now) usleep(due - now);
+			}
+#endif
+		}
+		uint32_t n = (size < m_reads.Left()) ? size : m_reads.Left();
+		m_reads.Get(p, n);
+		p += n;
+		size -= n;
+	}
+}
+
+
+bool CRpcIoReplay::EnumFirst(uint32_t &nDevices)
+{
+	nDevices = m_device.empty() ? 0 : 1;
+	return nDevices > 0;
+}
+
+
+bool CRpcIoReplay::EnumNext(char name[])
+{
+	return Enum(name, 0);
+}
+
+
+bool CRpcIoReplay::Enum(char name[], uint32_t pos)
+{
+	if (pos != 0 || m_device.empty()) return false;
+	strcpy(name, m_device.c_str());
+	return true;
+}
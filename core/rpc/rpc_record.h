@@ -0,0 +1,117 @@
+// rpc_record.h
+
+#pragma once
+
+#include <stdio.h>
+#include <string>
+
+#include "rpc_io.h"
+
+
+// Environment variables picked up by CTestboard::GetInterfaceList():
+//   PXAR_RPC_RECORD=<file>       record all traffic with the selected DTB
+//   PXAR_RPC_REPLAY=<file>       replace all interfaces by a recorded session
+//   PXAR_RPC_REPLAY_REALTIME=1   replay responses at the recorded timing
+#define RPC_RECORD_ENV          "PXAR_RPC_RECORD"
+#define RPC_REPLAY_ENV          "PXAR_RPC_REPLAY"
+#define RPC_REPLAY_REALTIME_ENV "PXAR_RPC_REPLAY_REALTIME"
+
+// File layout: the magic string, followed by records consisting of
+// type (1 byte), payload size (4 bytes), time since the start of the
+// recording in us (8 bytes), all in host byte order, and the payload.
+// Replay timing is relative to the first Open() record.
+#define RPC_RECORD_MAGIC "PXARRPC1"
+
+#define RPC_RECORD_WRITE 'W'
+#define RPC_RECORD_READ  'R'
+#define RPC_RECORD_FLUSH 'F'
+#define RPC_RECORD_CLEAR 'C'
+#define RPC_RECORD_OPEN  'O'
+#define RPC_RECORD_CLOSE 'X'
+
+
+// Decorator recording all traffic passing through another interface
+class CRpcIoRecorder : public CRpcIo
+{
+	CRpcIo *m_io;
+	FILE *m_file;
+	uint64_t m_start;
+	uint64_t m_flushed; // time of the last file flush
+
+	void Record(uint8_t type, const void *data, uint32_t size);
+public:
+	CRpcIoRecorder(const char *filename);
+	~CRpcIoRecorder();
+
+	// Interface to pass the traffic to
+	void Attach(CRpcIo *io);
+	CRpcIo* Attached() { return m_io; }
+
+	void Write(const void *buffer, uint32_t size);
+	void Flush();
+	void Clear();
+	void Read(void *buffer, uint32_t size);
+	const char* Name();
+	// Error processing
+	int32_t GetLastError() { return m_io->GetLastError(); }
+	const char* GetErrorMsg(int error) { return m_io->GetErrorMsg(error); }
+	// Connection
+	bool Open(char name[]);
+	void Close();
+	bool EnumFirst(uint32_t &nDevices) { return m_io->EnumFirst(nDevices); }
+	bool EnumNext(char name[]) { return m_io->EnumNext(name); }
+	bool Enum(char name[], uint32_t pos) { return m_io->Enum(name, pos); }
+	bool Connected() { return m_io->Connected(); }
+	void SetTimeout(unsigned int timeout) { m_io->SetTimeout(timeout); }
+};
+
+
+// Interface serving a recorded session: reads return the recorded
+// responses in order, writes are compared against the recorded requests.
+class CRpcIoReplay : public CRpcIo
+{
+	class CStream
+	{
+		FILE *m_file;
+		uint8_t m_type;
+		uint32_t m_left;
+		uint64_t m_time;
+	public:
+		CStream() : m_file(NULL), m_type(0), m_left(0), m_time(0) {}
+		~CStream() { if (m_file) fclose(m_file); }
+		bool Open(const char *filename, uint8_t type);
+		// Moves to the next record of the stream type, false at the end
+		bool Next();
+		uint32_t Left() { return m_left; }
+		uint64_t Time() { return m_time; }
+		void Get(void *buffer, uint32_t size);
+	};
+
+	std::string m_device;
+	bool m_realtime;
+	bool m_open;
+	uint64_t m_start;  // time the replay was opened
+	uint64_t m_origin; // recorded time of the Open() call
+	uint32_t m_mismatches;
+	CStream m_reads;
+	CStream m_writes;
+public:
+	CRpcIoReplay(const char *filename, bool realtime = false);
+
+	void Write(const void *buffer, uint32_t size);
+	void Flush() {}
+	void Clear() {}
+	void Read(void *buffer, uint32_t size);
+	const char* Name() { return "Replay"; }
+	// Error processing
+	int32_t GetLastError() { return 0; }
+	const char* GetErrorMsg(int /*error*/) { return NULL; }
+	// Connection
+	bool Open(char name[]);
+	void Close() { m_open = false; }
+	bool EnumFirst(uint32_t &nDevices);
+	bool EnumNext(char name[]);
+	bool Enum(char name[], uint32_t pos);
+	bool Connected() { return m_open; }
+	void SetTimeout(unsigned int /*timeout*/) {}
+};
@@ -0,0 +1,109 @@
+// Asynchronous USB readout: keeps a configurable number of bulk read
+// transfers queued at the device so that the chip never has to wait for
+// the host to issue the next read. Completed transfers are handled strictly
+// in submission order, their data is appended to the host ring buffer and
+// the transfer is resubmitted right away.
+// The transfers themselves are handled by a CUSBTransferLayer, which is
+// implemented on top of libusb for the libftdi backend and can be replaced
+// by a mock to exercise the queueing logic without hardware.
+
+#ifndef USBASYNCREADER_H
+#define USBASYNCREADER_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "USBRingBuffer.h"
+
+class CUSBTransferLayer
+{
+public:
+  virtual ~CUSBTransferLayer() {}
+
+  // Queues a read of up to size bytes into buffer, using transfer slot "slot"
+  virtual bool Submit(uint32_t slot, unsigned char *buffer, uint32_t size) = 0;
+
+  // Blocks until the transfer in the given slot has finished. Returns the
+  // number of payload bytes now at the start of its buffer, or a negative
+  // error code. Cancelled transfers return 0.
+  virtual int32_t Wait(uint32_t slot) = 0;
+
+  // Requests cancellation of the transfer in the given slot, Wait() still
+  // has to be called to reap it
+  virtual void Cancel(uint32_t slot) = 0;
+
+  // Called from another thread to end the readout: cancels all outstanding
+  // transfers, makes a blocking Wait() return and refuses further submits
+  virtual void Interrupt() = 0;
+};
+
+
+class CUSBAsyncReader
+{
+  CUSBTransferLayer &m_layer;
+  CUSBRingBuffer &m_ring;
+  uint32_t m_size;
+  uint32_t m_depth;
+  uint32_t m_next; // oldest outstanding slot
+  std::vector<unsigned char> m_memory;
+  std::vector<bool> m_submitted;
+  volatile bool m_stop;
+
+  unsigned char * Buffer(uint32_t slot) { return &m_memory[0] + static_cast<size_t>(slot)*m_size; }
+
+  CUSBAsyncReader(const CUSBAsyncReader&);
+  CUSBAsyncReader& operator=(const CUSBAsyncReader&);
+
+public:
+  CUSBAsyncReader(CUSBTransferLayer &layer, CUSBRingBuffer &ring, uint32_t transfersize, uint32_t depth)
+    : m_layer(layer), m_ring(ring), m_size(transfersize), m_depth(depth > 0 ? depth : 1), m_next(0),
+    m_memory(static_cast<size_t>(transfersize)*(depth > 0 ? depth : 1)), m_submitted(depth > 0 ? depth : 1, false), m_stop(false) {}
+  ~CUSBAsyncReader() { Stop(); }
+
+  uint32_t Depth() { return m_depth; }
+  uint32_t TransferSize() { return m_size; }
+
+  // Fills the queue with transfers. Returns false if one could not be submitted.
+  bool Start() {
+    m_next = 0;
+    for (uint32_t slot = 0; slot < m_depth; slot++) {
+      if (!m_layer.Submit(slot, Buffer(slot), m_size)) return false;
+      m_submitted[slot] = true;
+    }
+    return true;
+  }
+
+  // Waits for the oldest transfer, forwards its data to the ring buffer and
+  // queues it again. Returns the number of bytes forwarded or a negative
+  // error code from the transfer layer.
+  int32_t Step() {
+    uint32_t slot = m_next;
+    int32_t br = m_layer.Wait(slot);
+    m_submitted[slot] = false;
+    if (br < 0) return br;
+    if (br > 0) m_ring.Write(Buffer(slot), br);
+    if (!m_layer.Submit(slot, Buffer(slot), m_size)) return -1;
+    m_submitted[slot] = true;
+    m_next = (slot + 1) % m_depth;
+    return br;
+  }
+
+  // Asks the thread running Step() to finish, may be called from any thread.
+  // The running Step() returns soon after, Stopping() is true from now on.
+  void RequestStop() {
+    m_stop = true;
+    m_layer.Interrupt();
+  }
+  bool Stopping() const { return m_stop; }
+
+  // Cancels all outstanding transfers and waits for them to be returned
+  void Stop() {
+    for (uint32_t slot = 0; slot < m_depth; slot++) { if (m_submitted[slot]) m_layer.Cancel(slot); }
+    for (uint32_t i = 0; i < m_depth; i++) {
+      uint32_t slot = (m_next + i) % m_depth;
+      if (m_submitted[slot]) { m_layer.Wait(slot); m_submitted[slot] = false; }
+    }
+  }
+};
+
+#endif
@@ -32,6 +32,10 @@ typedef uint32_t DWORD;
 #define USBWRITEBUFFERSIZE  4096
 #define USBREADBUFFERSIZE   4096
 
+#define USBREADTRANSFERSIZE  16384 // bytes per queued USB read transfer
+#define USBREADTRANSFERDEPTH 8     // number of USB read transfers kept queued
+#define FTD2XXTRANSFERSIZE   8192  // transfer size of the ftd2xx driver
+
 
 #define ESC_EXTENDED 0x8f
 
@@ -48,6 +52,8 @@ class CUSB : public CRpcIo
   uint32_t enumPos, enumCount;
   uint32_t m_timeout; // maximum time to awit for read/write call in ms
 
+  uint32_t m_transferSize, m_transferDepth; // USB read transfer setup
+
   uint32_t m_posW;
   unsigned char m_bufferW[USBWRITEBUFFERSIZE];
 
@@ -92,6 +98,10 @@ public:
   bool Show();
   void SetTimeout(unsigned int timeout);
 
+  // Sets size and number of the USB read transfers kept in flight, takes
+  // effect with the next Open(). A depth of zero selects synchronous reads.
+  void SetReadTransfers(uint32_t size, uint32_t depth);
+
 
   // read methods
 
@@ -26,6 +26,8 @@ CUSB::CUSB(){
   ftdiStatus = 0;
   enumPos = enumCount = 0;
   m_timeout = 150000; // maximum time to wait for read call in ms
+  m_transferSize = FTD2XXTRANSFERSIZE;
+  m_transferDepth = USBREADTRANSFERDEPTH;
  }
 
  CUSB::~CUSB(){
@@ -194,7 +196,8 @@ bool CUSB::Open(char serialNumber[])
   ftdiStatus = FT_SetBaudRate(ftHandle, 9600);
   if (ftdiStatus != FT_OK) UsbConnectionError("Error setting FTDI baud rate.");
   // set usb transfer size parameters (see: http://www.ftdichip.com/Support/Knowledgebase/ft_setusbparameters.htm)
-  ftdiStatus = FT_SetUSBParameters(ftHandle, 8192, 8192); // default: 4096, must be multiple of 64
+  // the driver queues the read requests itself, only the size is configurable
+  ftdiStatus = FT_SetUSBParameters(ftHandle, m_transferSize, 8192); // default: 4096, must be multiple of 64
   if (ftdiStatus != FT_OK) UsbConnectionError("Error setting USB transfer size parameters.");
 
 
@@ -357,6 +360,14 @@ void CUSB::SetTimeout(unsigned int timeout)
   FT_SetTimeouts(ftHandle,m_timeout,m_timeout);
 }
 
+void CUSB::SetReadTransfers(uint32_t size, uint32_t depth)
+{
+  // the driver takes multiples of 64 bytes up to 64 kB
+  if (size > 65536) size = 65536;
+  m_transferSize = (size < 64) ? 64 : (size/64)*64;
+  m_transferDepth = depth;
+}
+
 void CUSB::Read_String(char *s, uint16_t maxlength)
 {
 	char ch = 0;
@@ -1,4 +1,5 @@
 #include <libusb.h>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <stdlib.h>
@@ -11,19 +12,18 @@
 #include "exceptions.h"
 
 #include "USBInterface.h"
+#include "USBRingBuffer.h"
+#include "USBAsyncReader.h"
 
 // needed for threaded readout of FTDI
 #include <pthread.h> 
-#include <semaphore.h>
 
 static struct ftdi_context ftdic;
 
 // the read buffer needs to be accessable outside of our USB class
-#define BUFSIZE 0x200000
+#define BUFSIZE 0x200000 // must be a power of two
 static pthread_t readerthread;
-static sem_t buf_data, buf_space;
-static unsigned char read_buffer[BUFSIZE];
-static int32_t head, tail; // read buffer is used as ring buffer
+static CUSBRingBuffer read_buffer(BUFSIZE);
 
 // cleanup is threaded to include a timeout on the calls to the device that sometimes hang
 pthread_mutex_t cleanup_mutex = PTHREAD_MUTEX_INITIALIZER;
@@ -37,29 +37,13 @@ const int32_t vendorID = 0x0403; // Future Technology Devices International, Ltd
 using namespace std;
 using namespace pxar;
 
-static void add_to_buf (unsigned char c) {
-    int32_t nh;
-
-    sem_wait (&buf_space);
-    if (head == (BUFSIZE -1)) nh = 0;
-    else                      nh = head + 1;
-
-    if (nh == tail) {
-        fprintf (stderr, "USBInterface (libftdi) FATAL: overflow of circular buffer in threaded read routine. Sorry -- will exit now.\n");
-        exit (1);
-    }
-    read_buffer[head] = c;
-    head = nh;
-    sem_post (&buf_data);
-}
-
 static void *reader (void *arg) {
   // there is no non-blocking read command implemented in libftdi ->
   // therefore we use multithreading and a static buffer to emulate
   // non-blocking calls
     struct ftdi_context *handle = reinterpret_cast<struct ftdi_context *>(arg);
     unsigned char buf[0x1000];
-    int32_t br, i;
+    int32_t br;
 
     while (1) {
       usleep(100); // wait 0.1 ms
@@ -70,15 +54,115 @@ static void *reader (void *arg) {
 	LOG(logCRITICAL)<< "ERROR during USB read polling: error code from libusb_bulk_transfer(): " << br;
 	throw UsbConnectionError("ERROR during USB read polling");
       }
-      if (br > 0){
-	for (i=0; i<br; i++){
-	  add_to_buf (buf[i]);
-	}
-      }
+      // blocks while the host buffer is full, the FTDI chip keeps the data meanwhile
+      if (br > 0) read_buffer.Write(buf, br);
     }
     return NULL;
 }
 
+// libusb implementation of the transfer layer used by the asynchronous
+// reader: bulk transfers are queued directly on the read endpoint of the
+// FTDI chip with their own buffers, since the libftdi submit functions
+// share one buffer per device. The modem status bytes heading every USB
+// packet are stripped after completion.
+class CFtdiTransferLayer : public CUSBTransferLayer
+{
+  struct ftdi_context *m_ftdi;
+  std::vector<struct libusb_transfer*> m_transfers;
+  std::vector<int> m_completed;
+  volatile bool m_interrupted;
+
+  static void LIBUSB_CALL Callback(struct libusb_transfer *transfer) {
+    *reinterpret_cast<int*>(transfer->user_data) = 1;
+  }
+
+public:
+  CFtdiTransferLayer(struct ftdi_context *ftdi, uint32_t depth) : m_ftdi(ftdi), m_transfers(depth), m_completed(depth, 1), m_interrupted(false) {
+    for (uint32_t slot = 0; slot < depth; slot++) { m_transfers[slot] = libusb_alloc_transfer(0); }
+  }
+  ~CFtdiTransferLayer() {
+    for (size_t slot = 0; slot < m_transfers.size(); slot++) { libusb_free_transfer(m_transfers[slot]); }
+  }
+
+  bool Submit(uint32_t slot, unsigned char *buffer, uint32_t size) {
+    if (m_interrupted) return false;
+    m_completed[slot] = 0;
+    libusb_fill_bulk_transfer(m_transfers[slot], m_ftdi->usb_dev, m_ftdi->out_ep, buffer, size, Callback, &m_completed[slot], 0);
+    if (libusb_submit_transfer(m_transfers[slot]) == 0) return true;
+    m_completed[slot] = 1;
+    return false;
+  }
+
+  int32_t Wait(uint32_t slot) {
+    // libusb must not be interrupted while handling events
+    int cancelstate;
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancelstate);
+    // the transfers have no timeout, so the event handling wakes up
+    // regularly to notice an interrupt on an idle link
+    int status = 0;
+    bool cancelled = false;
+    while (!m_completed[slot] && status == 0) {
+      if (m_interrupted && !cancelled) { libusb_cancel_transfer(m_transfers[slot]); cancelled = true; }
+      struct timeval tv = {0, 100000};
+      status = libusb_handle_events_timeout_completed(m_ftdi->usb_ctx, &tv, &m_completed[slot]);
+      if (status == LIBUSB_ERROR_INTERRUPTED) status = 0;
+    }
+    pthread_setcancelstate(cancelstate, NULL);
+    if (status != 0) return status;
+
+    struct libusb_transfer *transfer = m_transfers[slot];
+    if (transfer->status == LIBUSB_TRANSFER_CANCELLED) return 0;
+    if (transfer->status != LIBUSB_TRANSFER_COMPLETED) return -transfer->status;
+
+    int32_t payload = 0;
+    int32_t packetsize = m_ftdi->max_packet_size;
+    for (int32_t pos = 0; pos < transfer->actual_length; pos += packetsize) {
+      int32_t len = std::min(packetsize, transfer->actual_length - pos) - 2;
+      if (len <= 0) continue;
+      memmove(transfer->buffer + payload, transfer->buffer + pos + 2, len);
+      payload += len;
+    }
+    return payload;
+  }
+
+  void Cancel(uint32_t slot) { libusb_cancel_transfer(m_transfers[slot]); }
+
+  void Interrupt() {
+    m_interrupted = true;
+    // transfers which are not in flight just return LIBUSB_ERROR_NOT_FOUND
+    for (size_t slot = 0; slot < m_transfers.size(); slot++) { libusb_cancel_transfer(m_transfers[slot]); }
+  }
+};
+
+static CFtdiTransferLayer *transfer_layer = NULL;
+static CUSBAsyncReader *async_reader = NULL;
+
+static void asyncreader_stop (void *arg) {
+  reinterpret_cast<CUSBAsyncReader *>(arg)->Stop();
+}
+
+static void *asyncreader (void *arg) {
+  // keeps several USB read transfers queued at all times and forwards
+  // their data to the ring buffer in the order they were submitted
+  CUSBAsyncReader *areader = reinterpret_cast<CUSBAsyncReader *>(arg);
+  int32_t br = 0;
+
+  pthread_cleanup_push(asyncreader_stop, areader);
+  if (!areader->Start()) br = -1;
+  while (br >= 0 && !areader->Stopping()) {
+    pthread_testcancel();
+    br = areader->Step();
+  }
+  pthread_cleanup_pop(1);
+
+  // regular end of the readout, requested by Close()
+  if (areader->Stopping()) return NULL;
+
+  LOG(logCRITICAL)<< "ERROR during asynchronous USB readout: error code from libusb: " << br;
+  throw UsbConnectionError("ERROR during asynchronous USB readout");
+  return NULL;
+}
+
 static void *usbclose (void *arg) {
   // on some circumstances, the ftdi_usb_close() call hangs;
   // this is a workaround to implement a timeout
@@ -136,6 +220,8 @@ uint32_t FindAllUSB(struct ftdi_device_list ** devlist){
 CUSB::CUSB(){
       m_posR = m_sizeR = m_posW = 0;
       m_timeout = 150000; // maximum time to wait for read call in ms
+      m_transferSize = USBREADTRANSFERSIZE;
+      m_transferDepth = USBREADTRANSFERDEPTH;
       isUSB_open = false;
       ftdiStatus = 0;
       enumPos = enumCount = 0;
@@ -367,9 +453,14 @@ bool CUSB::Open(char serialNumber[])
 
 
   // init threads for client-side data buffering
-  sem_init (&buf_data, 0, 0);
-  sem_init (&buf_space, 0, BUFSIZE);
-  pthread_create (&readerthread, NULL, reader, &ftdic);
+  read_buffer.Reset();
+  if (m_transferDepth > 0) {
+    LOG(logINTERFACE) << " Queueing " << m_transferDepth << " USB read transfers of " << m_transferSize << " bytes ";
+    transfer_layer = new CFtdiTransferLayer(&ftdic, m_transferDepth);
+    async_reader = new CUSBAsyncReader(*transfer_layer, read_buffer, m_transferSize, m_transferDepth);
+    pthread_create (&readerthread, NULL, asyncreader, async_reader);
+  }
+  else pthread_create (&readerthread, NULL, reader, &ftdic);
 
   return true;
 }
@@ -377,12 +468,15 @@ bool CUSB::Open(char serialNumber[])
 
 void CUSB::Close(){
   if( !isUSB_open) return;
+  // the asynchronous reader can not be cancelled while it waits for its
+  // transfers, these are cancelled first to make it return
+  if (async_reader) async_reader->RequestStop();
   pthread_cancel(readerthread);
   usleep(10000);
-  // join reader thread and clean up semaphores
+  // join reader thread
   pthread_join(readerthread, NULL);
-  sem_destroy (&buf_data);
-  sem_destroy (&buf_space);
+  delete async_reader; async_reader = NULL;
+  delete transfer_layer; transfer_layer = NULL;
   usleep(10000);
   // set the flag (lock mutex first)
   pthread_mutex_lock(&cleanup_mutex); usbclose_done = false; pthread_mutex_unlock(&cleanup_mutex);
@@ -449,45 +543,22 @@ void CUSB::Read(uint32_t bytesToRead, void *buffer, uint32_t &bytesRead)
 {
   if (!isUSB_open) throw UsbConnectionError("Attempt to read from USB without open connection.");
  
-   // Copy over data from the circular buffer
-    uint32_t timewasted = 0; // time in ms wasted in this routine
-
-    uint32_t bytesReadSoFar = 0;
-      for (uint32_t i=0; i<bytesToRead; i++) {
-	bool bufferready = true;
-	if (tail == head) bufferready = false;
-	if (!bufferready){
-	  while (!bufferready && timewasted<m_timeout){
-	    if (timewasted==(m_timeout/10)) {
-	      LOG(logWARNING) << "USBInterface: Read(): data not ready (got " << bytesReadSoFar << "b of "<< bytesToRead <<"b) after " << timewasted << "ms yet! Will wait for up to " << m_timeout << "ms";
-	    }
-	    usleep(1000); //wait 1 ms
-	    timewasted++;
-	    if (tail != head) bufferready = true;	    
-	  }
-	}
-	if (bufferready){
-	  sem_wait (&buf_data);	
-	  (reinterpret_cast<unsigned char*>(const_cast<void*>(buffer)))[i] = read_buffer[tail];
-	  if (tail == (BUFSIZE -1)) tail = 0;
-	  else                      tail++;
-	  sem_post (&buf_space);
-	  bytesReadSoFar++;
-	} 
-	else // buffer was not ready and reading it timed out so we stop attempting it now
-	  {
-	    bytesRead = i;
-	    LOG(logCRITICAL) << " Timeout reading from USB buffer after " << m_timeout << " ms ";
-	    if (bytesRead < bytesToRead) {
-	      LOG(logCRITICAL) << "Requested to read " << bytesToRead 
-			       << "b, actually read  " << bytesRead 
-			       << "b - " << (bytesToRead-bytesRead) << "b missing!";
-	    }
-	    throw UsbConnectionTimeout("Timeout reading from USB");
-	    break;
-	  }
-      }
-      bytesRead = bytesReadSoFar;
+  // Copy over data from the circular buffer, waiting while it is empty
+  unsigned char *dest = reinterpret_cast<unsigned char*>(buffer);
+  bytesRead = read_buffer.Read(dest, bytesToRead, m_timeout/10);
+  if (bytesRead < bytesToRead) {
+    LOG(logWARNING) << "USBInterface: Read(): data not ready (got " << bytesRead << "b of "<< bytesToRead <<"b) after " << m_timeout/10 << "ms yet! Will wait for up to " << m_timeout << "ms";
+    bytesRead += read_buffer.Read(dest + bytesRead, bytesToRead - bytesRead, m_timeout - m_timeout/10);
+  }
+
+  // buffer was not ready and reading it timed out so we stop attempting it now
+  if (bytesRead < bytesToRead) {
+    LOG(logCRITICAL) << " Timeout reading from USB buffer after " << m_timeout << " ms ";
+    LOG(logCRITICAL) << "Requested to read " << bytesToRead 
+		     << "b, actually read  " << bytesRead 
+		     << "b - " << (bytesToRead-bytesRead) << "b missing!";
+    throw UsbConnectionTimeout("Timeout reading from USB");
+  }
 }
 
 //----------------------------------------------------------------------
@@ -498,11 +569,7 @@ void CUSB::Clear()
   ftdiStatus = ftdi_usb_purge_buffers(&ftdic);
 
   // drain our buffer.
-  while (head != tail) {
-    unsigned char t;
-    uint32_t n;
-    Read(1, &t, n);
-  }
+  read_buffer.Discard();
 
   m_posR = m_sizeR = 0;
   m_posW = 0;
@@ -520,7 +587,7 @@ bool CUSB::Show()
 
   unsigned char latency;
   if (ftdi_get_latency_timer(&ftdic,&latency)==0){ LOG(logINFO) << "  - FTDI latency timer set to " << static_cast<int>(latency); }
-  LOG(logINFO) << "  - data waiting in local read buffer: " << !(tail == head);
+  LOG(logINFO) << "  - data waiting in local read buffer: " << read_buffer.Available() << "b";
  
   return true;
 }
@@ -530,6 +597,13 @@ void CUSB::SetTimeout(unsigned int timeout)
   m_timeout = timeout;
 }
 
+void CUSB::SetReadTransfers(uint32_t size, uint32_t depth)
+{
+  // every USB packet starts with two status bytes, so full packets are requested
+  m_transferSize = (size < 512) ? 512 : (size/512)*512;
+  m_transferDepth = depth;
+}
+
 //----------------------------------------------------------------------
 void CUSB::Read_String(char *s, uint16_t maxlength)
 {
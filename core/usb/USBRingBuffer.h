@@ -0,0 +1,153 @@
+// Single-producer single-consumer ring buffer used by the threaded libftdi
+// USB backend: the reader thread appends the data arriving from the device,
+// CUSB::Read takes it out again.
+// Both sides copy whole contiguous spans with memcpy. The ring indices are
+// exchanged lock-free, the mutex and condition variable are only used to
+// sleep while the buffer is empty (consumer) or full (producer).
+// The class has no dependency on libftdi, so it can be driven by any
+// thread standing in for the device, e.g. for testing.
+
+#ifndef USBRINGBUFFER_H
+#define USBRINGBUFFER_H
+
+#include <stdint.h>
+#include <cstring>
+#include <pthread.h>
+#include <sys/time.h>
+#include <time.h>
+
+class CUSBRingBuffer
+{
+  unsigned char *m_data;
+  uint32_t m_size; // must be a power of two
+  uint32_t m_mask;
+
+  // free-running counters, only written by the producer / consumer
+  uint32_t m_head;
+  uint32_t m_tail;
+
+  // set while one of the sides sleeps on the condition variable
+  int32_t m_consumerWaiting;
+  int32_t m_producerWaiting;
+
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_cond;
+
+  // unlock handler for producers cancelled while waiting for space
+  static void Unlock(void *mutex) { pthread_mutex_unlock(reinterpret_cast<pthread_mutex_t*>(mutex)); }
+
+  static uint32_t Load(const uint32_t &x) { return __atomic_load_n(&x, __ATOMIC_ACQUIRE); }
+  static void Store(uint32_t &x, uint32_t value) { __atomic_store_n(&x, value, __ATOMIC_RELEASE); }
+
+  // Wakes up the other side if it announced that it is sleeping. The full
+  // barrier orders the index update before reading the flag, the waiting
+  // side sets its flag before re-checking the index (and vice versa).
+  void Wake(int32_t &waiting) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&waiting, __ATOMIC_RELAXED)) {
+      pthread_mutex_lock(&m_mutex);
+      pthread_cond_broadcast(&m_cond);
+      pthread_mutex_unlock(&m_mutex);
+    }
+  }
+
+  static void Deadline(struct timespec &ts, uint32_t timeout_ms) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t ns = static_cast<uint64_t>(now.tv_usec)*1000 + static_cast<uint64_t>(timeout_ms%1000)*1000000;
+    ts.tv_sec = now.tv_sec + timeout_ms/1000 + ns/1000000000;
+    ts.tv_nsec = ns%1000000000;
+  }
+
+  CUSBRingBuffer(const CUSBRingBuffer&);
+  CUSBRingBuffer& operator=(const CUSBRingBuffer&);
+
+public:
+  CUSBRingBuffer(uint32_t size) : m_size(size), m_mask(size-1), m_head(0), m_tail(0), m_consumerWaiting(0), m_producerWaiting(0) {
+    m_data = new unsigned char[m_size];
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_cond, NULL);
+  }
+  ~CUSBRingBuffer() {
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_mutex);
+    delete[] m_data;
+  }
+
+  uint32_t Size() { return m_size; }
+
+  // Number of bytes waiting to be read
+  uint32_t Available() { return Load(m_head) - Load(m_tail); }
+
+  // Producer side: appends count bytes, sleeps while the buffer is full.
+  // The wait is a cancellation point.
+  void Write(const unsigned char *data, uint32_t count) {
+    while (count > 0) {
+      uint32_t head = m_head;
+      uint32_t space = m_size - (head - Load(m_tail));
+      if (space == 0) {
+	pthread_mutex_lock(&m_mutex);
+	pthread_cleanup_push(Unlock, &m_mutex);
+	__atomic_store_n(&m_producerWaiting, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	while (m_size == head - Load(m_tail)) pthread_cond_wait(&m_cond, &m_mutex);
+	__atomic_store_n(&m_producerWaiting, 0, __ATOMIC_RELAXED);
+	pthread_cleanup_pop(1);
+	continue;
+      }
+      uint32_t n = (count < space) ? count : space;
+      uint32_t pos = head & m_mask;
+      uint32_t first = (n < m_size - pos) ? n : m_size - pos;
+      memcpy(m_data + pos, data, first);
+      if (n > first) memcpy(m_data, data + first, n - first);
+      Store(m_head, head + n);
+      Wake(m_consumerWaiting);
+      data += n;
+      count -= n;
+    }
+  }
+
+  // Consumer side: copies up to count bytes, sleeping while the buffer is
+  // empty for at most timeout_ms in total. Returns the number of bytes read.
+  uint32_t Read(unsigned char *data, uint32_t count, uint32_t timeout_ms) {
+    uint32_t done = 0;
+    bool deadlineSet = false;
+    struct timespec deadline;
+    while (done < count) {
+      uint32_t tail = m_tail;
+      uint32_t avail = Load(m_head) - tail;
+      if (avail == 0) {
+	if (!deadlineSet) { Deadline(deadline, timeout_ms); deadlineSet = true; }
+	bool timeout = false;
+	pthread_mutex_lock(&m_mutex);
+	__atomic_store_n(&m_consumerWaiting, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	while (Load(m_head) == tail && !timeout) timeout = (pthread_cond_timedwait(&m_cond, &m_mutex, &deadline) != 0);
+	__atomic_store_n(&m_consumerWaiting, 0, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&m_mutex);
+	if (timeout && Load(m_head) == tail) break;
+	continue;
+      }
+      uint32_t n = (count - done < avail) ? count - done : avail;
+      uint32_t pos = tail & m_mask;
+      uint32_t first = (n < m_size - pos) ? n : m_size - pos;
+      memcpy(data + done, m_data + pos, first);
+      if (n > first) memcpy(data + done + first, m_data, n - first);
+      Store(m_tail, tail + n);
+      Wake(m_producerWaiting);
+      done += n;
+    }
+    return done;
+  }
+
+  // Consumer side: drops all data currently in the buffer
+  void Discard() {
+    Store(m_tail, Load(m_head));
+    Wake(m_producerWaiting);
+  }
+
+  // Only to be called while no producer is running
+  void Reset() { m_head = m_tail = 0; }
+};
+
+#endif
@@ -12,6 +12,7 @@ namespace pxar {
 // --- Data Transmission settings & flags --------------------------------------
 #define DTB_SOURCE_BLOCK_SIZE  8192
 #define DTB_SOURCE_BUFFER_SIZE 50000000
+#define DTB_SOURCE_PIPELINE_DEPTH 4 // max. number of outstanding Daq_Read requests per channel
 #define DTB_DAQ_FIFO_OVFL 4 // bit 2 = DAQ fast HW FIFO overflow
 #define DTB_DAQ_MEM_OVFL  2 // bit 1 = DAQ RAM FIFO overflow
 #define DTB_DAQ_STOPPED   1 // bit 0 = DAQ stopped (because of overflow)
@@ -48,6 +49,9 @@ namespace pxar {
 #define ROC_NUMROWS 80
 #define ROC_NUMCOLS 52
 #define MOD_NUMROCS 16
+// Maximum number of changed pixels for which single-pixel mask/trim commands
+// are sent instead of re-trimming the full ROC:
+#define ROC_MAX_PIXEL_UPDATES 500
 
 // --- ROC Types ---------------------------------------------------------------
 #define ROC_NONE              0x00
@@ -106,6 +110,7 @@ namespace pxar {
 #define SIG_DESER400PHASE1 0xF1
 #define SIG_DESER400PHASE2 0xF2
 #define SIG_DESER400PHASE3 0xF3
+#define SIG_ETH_TXBATCH 0xF4
 #define SIG_DESER400RATE 0xF5
 #define SIG_LOOP_TRIM_DELAY 0xF6
 #define SIG_ADC_TINDELAY 0xF7
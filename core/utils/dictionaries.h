@@ -145,6 +145,8 @@ namespace pxar {
       _registers["tout"]          = dacConfig(SIG_RDA_TOUT,19,DTB_REG);
       _registers["rda"]           = dacConfig(SIG_RDA_TOUT,19,DTB_REG);
 
+      _registers["ethtxbatch"]    = dacConfig(SIG_ETH_TXBATCH,32,DTB_REG);
+
 
       //------- TBM registers -----------------------------
       _registers["counters"]      = dacConfig(TBM_REG_COUNTER_SWITCHES,255,TBM_REG,false);
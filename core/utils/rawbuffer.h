@@ -0,0 +1,77 @@
+/* This file contains the reusable buffer used to receive raw data
+   blocks from the testboard without per-block allocations */
+
+#ifndef PXAR_RAWBUFFER_H
+#define PXAR_RAWBUFFER_H
+
+#include <cstddef>
+#include <cstring>
+
+namespace pxar {
+
+  /** Reusable buffer for raw data read from the testboard.
+   *  In contrast to std::vector the memory is not initialized when the
+   *  buffer grows, and it is kept when the buffer is cleared. Repeated reads
+   *  into the same buffer therefore neither touch the heap nor zero-fill
+   *  memory which is overwritten right away. Only to be used with plain
+   *  data types.
+   */
+  template <class T>
+    class rawBuffer {
+    T * m_data;
+    size_t m_size;
+    size_t m_capacity;
+
+  public:
+  rawBuffer() : m_data(NULL), m_size(0), m_capacity(0) {}
+  rawBuffer(const rawBuffer &other) : m_data(NULL), m_size(0), m_capacity(0) { *this = other; }
+    ~rawBuffer() { delete[] m_data; }
+
+    rawBuffer & operator=(const rawBuffer &other) {
+      if(this == &other) return *this;
+      m_size = 0;
+      reserve(other.m_size);
+      if(other.m_size) memcpy(m_data, other.m_data, other.m_size*sizeof(T));
+      m_size = other.m_size;
+      return *this;
+    }
+
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    bool empty() const { return m_size == 0; }
+
+    T * begin() { return m_data; }
+    T * end() { return m_data + m_size; }
+    const T * begin() const { return m_data; }
+    const T * end() const { return m_data + m_size; }
+
+    T & operator[](size_t i) { return m_data[i]; }
+    const T & operator[](size_t i) const { return m_data[i]; }
+
+    /** Drops the content but keeps the allocated memory */
+    void clear() { m_size = 0; }
+
+    /** Makes sure at least n elements fit without reallocation */
+    void reserve(size_t n) {
+      if(n <= m_capacity) return;
+      T * p = new T[n];
+      if(m_size) memcpy(p, m_data, m_size*sizeof(T));
+      delete[] m_data;
+      m_data = p;
+      m_capacity = n;
+    }
+
+    /** Appends n uninitialized elements and returns a pointer to the first
+     *  of them. The capacity grows geometrically to amortize reallocations.
+     */
+    T * extend(size_t n) {
+      if(m_size + n > m_capacity) { reserve(m_size + n > 2*m_capacity ? m_size + n : 2*m_capacity); }
+      T * p = m_data + m_size;
+      m_size += n;
+      return p;
+    }
+  };
+
+} //namespace pxar
+
+#endif /* PXAR_RAWBUFFER_H */
@@ -20,13 +20,19 @@ namespace pxar {
      */
     timer() { start = GetTime(); }
 
-    uint64_t get() { return static_cast<uint64_t>(GetTime() - start); }
+    /** Returns the elapsed time in milliseconds
+     */
+    uint64_t get() { return static_cast<uint64_t>(GetTime() - start)/1000; }
+
+    /** Returns the elapsed time in microseconds
+     */
+    uint64_t getMicroseconds() { return static_cast<uint64_t>(GetTime() - start); }
   private:
     /** Private member function to store start time of the timer object
      */
     uint64_t start;
 
-    /** Returns the amount of milliseconds elapsed since the UNIX epoch.
+    /** Returns the amount of microseconds elapsed since the UNIX epoch.
 	Works on both windows and linux.
       */
     uint64_t GetTime() {
@@ -44,8 +50,8 @@ namespace pxar {
       uint64_t ret = li.QuadPart;
       // Convert from file time to UNIX epoch time.
       ret -= 116444736000000000LL; 
-      // From 100 nano seconds (10^-7) to 1 millisecond (10^-3) intervals
-      ret /= 10000;
+      // From 100 nano seconds (10^-7) to 1 microsecond (10^-6) intervals
+      ret /= 10;
 
       return ret;
 #else
@@ -55,26 +61,24 @@ namespace pxar {
       gettimeofday(&tv, NULL);
 
       uint64_t ret = tv.tv_usec;
-      // Convert from micro seconds (10^-6) to milliseconds (10^-3)
-      ret /= 1000;
 
-      // Adds the seconds (10^0) after converting them to milliseconds (10^-3)
-      ret += (tv.tv_sec * 1000);
+      // Adds the seconds (10^0) after converting them to microseconds (10^-6)
+      ret += (static_cast<uint64_t>(tv.tv_sec) * 1000000);
 
       return ret;
 #endif
     }
 
-    /** Overloaded ostream operator to give the current elapsed time.
+    /** Overloaded ostream operator to give the current elapsed time in milliseconds.
      */
     friend std::ostream & operator<<(std::ostream &out, timer &t) {
-      return out << static_cast<uint64_t>(t.GetTime() - t.start);
+      return out << t.get();
     }
 
-    /** Overloaded ostream operator to give the current elapsed time.
+    /** Overloaded ostream operator to give the current elapsed time in milliseconds.
      */
     friend std::ostream & operator<<(std::ostream &out, timer * t) {
-      return out << static_cast<uint64_t>(t->GetTime() - t->start);
+      return out << t->get();
     }
   };
 
@@ -195,6 +195,13 @@ int main(int argc, char *argv[]){
     api->SignalProbe("d1", configParameters->getProbe("d1"));
     api->SignalProbe("d2", configParameters->getProbe("d2"));
 
+    // -- Reuse the results of repeated scans (off unless configured):
+    if (configParameters->getScanCacheMB() > 0) {
+      api->setScanCache(configParameters->getScanCacheMB(),
+			configParameters->getScanCacheDir(),
+			configParameters->getScanCacheDiskMB());
+    }
+
     LOG(logINFO) << "DUT info: ";
     api->_dut->info();
   }
@@ -226,24 +226,14 @@ vector<TH1*> PixTest::scurveMaps(string dac, string name, int ntrig, int dacmin,
   print(Form("dac: %s name: %s ntrig: %d dacrange: %d .. %d (%d/%d) %s flags = %d (plus default)",
              dac.c_str(), name.c_str(), ntrig, dacmin, dacmax, dacsperstep, ntrigperstep, type.c_str(), flag));
 
-  vector<shist256*>  maps;
   vector<TH1*>       resultMaps;
   resultMaps.clear();
 
-  shist256 *pshistBlock  = new (fPixSetup->fPxarMemory) shist256[16*52*80];
-  shist256 *ph;
+  // -- only the enabled ROCs and the scanned DAC range, hit counts in 16 bit
+  shistStore maps;
+  maps.book(rocIds.size(), dacmin, dacmax, (1 == ihit), ntrig);
   rsstools rss;
-
-  int idx(0);
-  for (unsigned int iroc = 0; iroc < rocIds.size(); ++iroc) {
-    for (unsigned int ic = 0; ic < 52; ++ic) {
-      for (unsigned int ir = 0; ir < 80; ++ir) {
-        idx = PixUtil::rcr2idx(iroc, ic, ir);
-        ph = pshistBlock + idx;
-        maps.push_back(ph);
-      }
-    }
-  }
+  LOG(logDEBUG) << "PixTest::scurveMaps booked " << maps.bytes()/1024 << " kB of scan histograms";
 
 
   int ntrigMax(ntrig);
@@ -1433,7 +1423,7 @@ void PixTest::print(string what, TLogLevel log) {
 
 
 // ----------------------------------------------------------------------
-void PixTest::preScan(string dac, vector<shist256*> maps, int &dacmin, int &dacmax) {
+void PixTest::preScan(string dac, shistStore &maps, int &dacmin, int &dacmax) {
   PixTest::update();
   uint16_t FLAGS = FLAG_FORCE_MASKED | FLAG_DUMP_FLAWED_EVENTS;
 
@@ -1461,23 +1451,10 @@ void PixTest::preScan(string dac, vector<shist256*> maps, int &dacmin, int &dacm
     return;
   }
 
-  int idx(0), roc(0), ic(0), ir(0);
-  double val(0.);
-  for (unsigned int idac = 0; idac < results.size(); ++idac) {
-    int dac = results[idac].first;
-    for (unsigned int ipix = 0; ipix < results[idac].second.size(); ++ipix) {
-      ic =   results[idac].second[ipix].column();
-      ir =   results[idac].second[ipix].row();
-      roc = results[idac].second[ipix].roc();
-      if (ic > 51 || ir > 79) {
-        LOG(logDEBUG) << "bad pixel address encountered: ROC/col/row = " << roc << "/" << ic << "/" << ir;
-        continue;
-      }
-      val =  results[idac].second[ipix].value();
-      idx = PixUtil::rcr2idx(getIdxFromId(roc), ic, ir);
-      if (idx > -1) maps[idx]->fill(dac, val);
-    }
-  }
+  vector<int> rocIdx(256, -1);
+  for (unsigned int iroc = 0; iroc < rocIds.size(); ++iroc) rocIdx[rocIds[iroc]] = getIdxFromId(rocIds[iroc]);
+  maps.book(rocIds.size(), 1, 200, true, ntrig);
+  maps.fill(results, rocIdx);
 
 
   // -- analyze results
@@ -1487,12 +1464,12 @@ void PixTest::preScan(string dac, vector<shist256*> maps, int &dacmin, int &dacm
   for (unsigned int iroc = 0; iroc < rocIds.size(); ++iroc) {
     LOG(logDEBUG) << "analyzing ROC " << static_cast<int>(rocIds[iroc]);
     for (unsigned int i = iroc*4160; i < (iroc+1)*4160; ++i) {
-      if (maps[i]->getSumOfWeights() < 1) continue;
+      if (maps.getSumOfWeights(i) < 1) continue;
 
       h1->Reset();
       for (int ib = 1; ib <= 256; ++ib) {
-        h1->SetBinContent(ib, maps[i]->get(ib));
-        h1->SetBinError(ib, ntrig*PixUtil::dBinomial(static_cast<int>(maps[i]->get(ib)), ntrig));
+        h1->SetBinContent(ib, maps.get(i, ib));
+        h1->SetBinError(ib, ntrig*PixUtil::dBinomial(static_cast<int>(maps.get(i, ib)), ntrig));
       }
 
       ok = threshold(h1);
@@ -1551,7 +1528,7 @@ void PixTest::preScan(string dac, vector<shist256*> maps, int &dacmin, int &dacm
 
 
 // ----------------------------------------------------------------------
-void PixTest::dacScan(string dac, int ntrig, int dacmin, int dacmax, vector<shist256*> maps, int ihit, int FLAGS) {
+void PixTest::dacScan(string dac, int ntrig, int dacmin, int dacmax, shistStore &maps, int ihit, int FLAGS) {
   //  uint16_t FLAGS = flag | FLAG_FORCE_MASKED;
 
   FLAGS |= FLAG_DUMP_FLAWED_EVENTS;
@@ -1609,6 +1586,14 @@ void PixTest::dacScan(string dac, int ntrig, int dacmin, int dacmax, vector<shis
     done = (cnt>5) || done;
   }
 
+  // -- the common case is filled in parallel, one thread per group of ROCs
+  if (!unmasked) {
+    vector<int> rocIdx(256, -1);
+    for (unsigned int i = 0; i < rocIds.size(); ++i) rocIdx[rocIds[i]] = getIdxFromId(rocIds[i]);
+    maps.fill(results, rocIdx);
+    return;
+  }
+
   int idx(0);
   for (unsigned int idac = 0; idac < results.size(); ++idac) {
     int dac = results[idac].first;
@@ -1622,17 +1607,12 @@ void PixTest::dacScan(string dac, int ntrig, int dacmin, int dacmax, vector<shis
       }
       val =  results[idac].second[ipix].value();
       idx = PixUtil::rcr2idx(getIdxFromId(iroc), ic, ir);
-      if (unmasked) {
-        h3 = fXrayMaps[getIdxFromId(iroc)];
-        if (results[idac].second[ipix].value() > 0) {
-          if (idx > -1) maps[idx]->fill(dac, val);
-        } else {
-          h3->Fill(results[idac].second[ipix].column(), results[idac].second[ipix].row(), 1);
-        }
+      h3 = fXrayMaps[getIdxFromId(iroc)];
+      if (results[idac].second[ipix].value() > 0) {
+        if (idx > -1) maps.fill(idx, dac, val);
       } else {
-        if (idx > -1) maps[idx]->fill(dac, val);
+        h3->Fill(results[idac].second[ipix].column(), results[idac].second[ipix].row(), 1);
       }
-
     }
   }
 
@@ -1640,7 +1620,7 @@ void PixTest::dacScan(string dac, int ntrig, int dacmin, int dacmax, vector<shis
 
 
 // ----------------------------------------------------------------------
-void PixTest::scurveAna(string dac, string name, vector<shist256*> maps, vector<TH1*> &resultMaps, int result) {
+void PixTest::scurveAna(string dac, string name, shistStore &maps, vector<TH1*> &resultMaps, int result) {
   fDirectory->cd();
   TH1* h2(0), *h3(0), *h4(0);
   //  string fname("SCurveData");
@@ -1652,6 +1632,11 @@ void PixTest::scurveAna(string dac, string name, vector<shist256*> maps, vector<
   int roc(0), ic(0), ir(0);
   TH1D *h1 = new TH1D("h1", "h1", 256, 0., 256.); h1->Sumw2();
 
+  // -- the bins 1 .. 256 of h1 hold the DAC values 1 .. 256
+  vector<shistStore::scurve> scurves;
+  int nfits(0);
+  if (result & 0x40) maps.scurves(scurves, 1);
+
   for (unsigned int iroc = 0; iroc < rocIds.size(); ++iroc) {
     LOG(logDEBUG) << "analyzing ROC " << static_cast<int>(rocIds[iroc]);
     h2 = bookTH2D(Form("thr_%s_%s_C%d", name.c_str(), dac.c_str(), rocIds[iroc]),
@@ -1681,18 +1666,32 @@ void PixTest::scurveAna(string dac, string name, vector<shist256*> maps, vector<
 
     for (unsigned int i = iroc*4160; i < (iroc+1)*4160; ++i) {
       PixUtil::idx2rcr(i, roc, ic, ir);
-      if (maps[i]->getSumOfWeights() < 1) {
+      if (maps.getSumOfWeights(i) < 1) {
         if (dumpFile) OutputFile << empty << endl;
         continue;
       }
-      // -- calculated "proper" errors
-      h1->Reset();
-      for (int ib = 1; ib <= 256; ++ib) {
-        h1->SetBinContent(ib, maps[i]->get(ib));
-        h1->SetBinError(ib, fNtrig*PixUtil::dBinomial(static_cast<int>(maps[i]->get(ib)), fNtrig));
+      bool fast = (result & 0x40) && scurves[i].ok;
+      if (!fast || dumpFile || (result & 0x20)) {
+        // -- calculated "proper" errors
+        h1->Reset();
+        for (int ib = 1; ib <= 256; ++ib) {
+          h1->SetBinContent(ib, maps.get(i, ib));
+          h1->SetBinError(ib, fNtrig*PixUtil::dBinomial(static_cast<int>(maps.get(i, ib)), fNtrig));
+        }
       }
 
-      bool ok = threshold(h1);
+      bool ok(true);
+      if (fast) {
+        // -- h1 has DAC value x in the bin [x-1, x), the fit threshold is on that axis
+        fThreshold  = scurves[i].thr - 0.5;
+        fThresholdE = TMath::Sqrt(0.5*TMath::Pi()/fNtrig)*scurves[i].sig;
+        fSigma      = scurves[i].sig;
+        fSigmaE     = fSigma/TMath::Sqrt(2.*fNtrig);
+        fThresholdN = scurves[i].thrN;
+      } else {
+        ok = threshold(h1);
+        ++nfits;
+      }
       if (((result & 0x10) && !ok) || (result & 0x20)) {
         TH1D *h1c = (TH1D*)h1->Clone(Form("scurve_%s_c%d_r%d_C%d", dac.c_str(), ic, ir, rocIds[iroc]));
         if (!ok) {
@@ -1759,6 +1758,9 @@ void PixTest::scurveAna(string dac, string name, vector<shist256*> maps, vector<
 
   fDisplayedHist = find(fHistList.begin(), fHistList.end(), h2);
 
+  if (result & 0x40) {
+    LOG(logDEBUG) << "PixTest::scurveAna fitted " << nfits << " s-curves failing the closed-form estimate";
+  }
   delete h1;
 
   if (h2) h2->Draw("colz");
@@ -2098,6 +2100,8 @@ void PixTest::trimHotPixels(int hitThr, int runSeconds, bool maskuntrimmable) {
     uint8_t perFull;
     bool daq_loop = true;
 
+    // -- the decoders count the hits, pixels with more than THR hits are recorded
+    fApi->daqHotPixelMonitor(static_cast<uint32_t>(THR) + 1);
     fApi->daqStart(FLAG_DUMP_FLAWED_EVENTS);
 
     int finalPeriod = fApi->daqTriggerLoop(totalPeriod);
@@ -2109,14 +2113,7 @@ void PixTest::trimHotPixels(int hitThr, int runSeconds, bool maskuntrimmable) {
         LOG(logINFO) << "Buffer almost full, pausing triggers.";
         fApi->daqTriggerLoopHalt();
         t.Stop();
-        vector<Event> daqdat;
-        try { daqdat = fApi->daqGetEventBuffer(); }
-        catch(DataNoEvent &) {}
-        for(vector<Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
-          for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
-            hotpixel_map[getIdxFromId(it->pixels[ipix].roc())]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-          }
-        }
+        fApi->daqDrainEventBuffer();
 
         LOG(logINFO) << "Resuming triggers.";
         t.Start(kFALSE);
@@ -2135,21 +2132,9 @@ void PixTest::trimHotPixels(int hitThr, int runSeconds, bool maskuntrimmable) {
     fApi->daqTriggerLoopHalt();
     fApi->daqStop();
 
-    vector<Event> daqdat;
-    try { daqdat = fApi->daqGetEventBuffer(); }
-    catch(DataNoEvent &) {}
-    for(vector<Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
-      for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
-        int rocIdx = getIdxFromId(it->pixels[ipix].roc());
-        if (rocIdx >= 0 && rocIdx < static_cast<int>(hotpixel_map.size())) {
-          hotpixel_map[rocIdx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-        } else {
-          LOG(logERROR) << "found hit from disabled ROC " << (int)it->pixels[ipix].roc()
-                        << ", col " << (int)it->pixels[ipix].column() << " row " << (int)it->pixels[ipix].row();
-          break;
-        }
-      }
-    }
+    fApi->daqDrainEventBuffer();
+    fillHotPixelMaps(hotpixel_map);
+    fApi->daqHotPixelMonitor(0);
     finalCleanup();
 
     // -- analysis of hit map
@@ -2329,6 +2314,9 @@ void PixTest::maskHotPixels(vector<TH2D*> v) {
   uint8_t perFull;
   bool daq_loop = true;
 
+  // -- the decoders count the hits, pixels with more than THR hits are recorded
+  double THR = 1.e-5*NSECONDS*TRGFREQ*1000;
+  fApi->daqHotPixelMonitor(static_cast<uint32_t>(THR) + 1);
   fApi->daqStart(FLAG_DUMP_FLAWED_EVENTS);
 
   int finalPeriod = fApi->daqTriggerLoop(totalPeriod);
@@ -2339,16 +2327,7 @@ void PixTest::maskHotPixels(vector<TH2D*> v) {
     if (perFull > 80) {
       LOG(logINFO) << "Buffer almost full, pausing triggers.";
       fApi->daqTriggerLoopHalt();
-
-      // fillMap(v):
-      vector<Event> daqdat;
-      try { daqdat = fApi->daqGetEventBuffer(); }
-      catch(DataNoEvent &) {}
-      for(vector<Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
-        for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
-          v[getIdxFromId(it->pixels[ipix].roc())]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-        }
-      }
+      fApi->daqDrainEventBuffer();
 
       LOG(logINFO) << "Resuming triggers.";
           fApi->daqTriggerLoop(finalPeriod);
@@ -2364,21 +2343,15 @@ void PixTest::maskHotPixels(vector<TH2D*> v) {
   fApi->daqTriggerLoopHalt();
   fApi->daqStop();
 
-  // fillMap(v):
-  vector<Event> daqdat;
-  try { daqdat = fApi->daqGetEventBuffer(); }
-  catch(DataNoEvent &) {}
-  for(vector<Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
-    for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
-      v[getIdxFromId(it->pixels[ipix].roc())]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-    }
-  }
+  // -- the maps only contain the pixels above threshold
+  fApi->daqDrainEventBuffer();
+  fillHotPixelMaps(v);
+  fApi->daqHotPixelMonitor(0);
 
   finalCleanup();
 
 
   // -- analysis of hit map
-  double THR = 1.e-5*NSECONDS*TRGFREQ*1000;
   LOG(logDEBUG) << "hot pixel determination with THR = " << THR;
   int cntHot(0);
   TH2D *h(0);
@@ -2406,6 +2379,21 @@ void PixTest::maskHotPixels(vector<TH2D*> v) {
 }
 
 
+// ----------------------------------------------------------------------
+void PixTest::fillHotPixelMaps(vector<TH2D*> v) {
+  vector<pair<pixel, double> > hot = fApi->daqGetHotPixels();
+  double nevt = fApi->daqGetHotPixelEvents();
+  for (unsigned int i = 0; i < hot.size(); ++i) {
+    int idx = getIdxFromId(hot[i].first.roc());
+    if (idx < 0 || idx >= static_cast<int>(v.size())) {
+      LOG(logERROR) << "found hits from disabled ROC " << (int)hot[i].first.roc()
+                    << ", col " << (int)hot[i].first.column() << " row " << (int)hot[i].first.row();
+      continue;
+    }
+    v[idx]->SetBinContent(hot[i].first.column()+1, hot[i].first.row()+1, TMath::Nint(hot[i].second*nevt));
+  }
+}
+
 // ----------------------------------------------------------------------
 bool sortRocHist(const TH1* h1, const TH1* h2) {
   string hname1 = h1->GetName();
@@ -2476,7 +2464,6 @@ statistics PixTest::getEvents(int NEvents, int period, int buffer) {
   if (NRemainder==0) NRemainder=NStep;
 
   statistics results;
-  vector<Event> daqEv;
 
   if (buffer > 0) {
     vector<rawEvent> daqRawEv;
@@ -2489,15 +2476,13 @@ statistics PixTest::getEvents(int NEvents, int period, int buffer) {
   for (int iloop=0; iloop<NLoops; iloop++) {
     LOG(logDEBUG) << "Collecting " << (iloop+1)*NStep << "/" << NEvents << " Triggers";
     fApi->daqTrigger(NStep, period);
-    try { daqEv = fApi->daqGetEventBuffer(); }
-    catch(DataNoEvent &) {}
+    fApi->daqDrainEventBuffer();
     results += fApi->getStatistics();
   }
 
   LOG(logDEBUG) << "Collecting " << (NLoops*NStep)+NRemainder << "/" << NEvents << " Triggers";
   fApi->daqTrigger(NRemainder, period);
-  try { daqEv = fApi->daqGetEventBuffer(); }
-  catch(DataNoEvent &) {}
+  fApi->daqDrainEventBuffer();
   results += fApi->getStatistics();
 
   return results;
@@ -2507,7 +2492,6 @@ statistics PixTest::getEvents(int NEvents, int period, int buffer) {
 bool PixTest::checkReadBackBits(uint16_t period) {
 
   bool ReadBackGood = true;
-  vector<Event> daqEv;
   vector<vector<uint16_t> > ReadBackBits;
 
   vector<uint8_t> rocids = fApi->_dut->getRocI2Caddr();
@@ -2529,8 +2513,7 @@ bool PixTest::checkReadBackBits(uint16_t period) {
   }
 
   fApi->daqTrigger(32, period);
-  try { daqEv = fApi->daqGetEventBuffer(); }
-  catch(DataNoEvent &) {}
+  fApi->daqDrainEventBuffer();
   ReadBackBits = fApi->daqGetReadback();
   statistics results = fApi->getStatistics();
   int NEvents = (results.info_events_empty()+results.info_events_valid())/nTokenChains;
@@ -33,6 +33,7 @@ typedef char int8_t;
 #include "PixSetup.hh"
 #include "PixTestParameters.hh"
 #include "shist256.hh"
+#include "shiststore.hh"
 
 typedef struct { 
   uint16_t dac;
@@ -115,11 +116,11 @@ public:
   /// work-around to cope with suboptimal pxar/core
   int pixelThreshold(std::string dac, int ntrig, int dacmin, int dacmax);
   /// scan a dac range. Will call preScan to protect against r/o problems. 
-  void dacScan(std::string dac, int ntrig, int dacmin, int dacmax, std::vector<shist256*> maps, int ihit, int flag = 0);
-  /// kind of another work-around (splitting the range, adjusting ntrig, etc)
-  void preScan(std::string dac, std::vector<shist256*> maps, int &dacmin, int &dacmax);
+  void dacScan(std::string dac, int ntrig, int dacmin, int dacmax, shistStore &maps, int ihit, int flag = 0);
+  /// kind of another work-around (splitting the range, adjusting ntrig, etc); books maps itself
+  void preScan(std::string dac, shistStore &maps, int &dacmin, int &dacmax);
   /// do the scurve analysis
-  void scurveAna(std::string dac, std::string name, std::vector<shist256*> maps, std::vector<TH1*> &resultMaps, int result);
+  void scurveAna(std::string dac, std::string name, shistStore &maps, std::vector<TH1*> &resultMaps, int result);
   /// determine PH error interpolation
   void getPhError(std::string dac, int dacmin, int dacmax, int FLAGS, int ntrig);
   /// returns TH2D's with pulseheight maps
@@ -138,6 +139,7 @@ public:
   /// result & 0x8: also dump distributions for those maps enabled with 1,2, or 4
   /// result &0x10: dump 'problematic' threshold histogram fits
   /// result &0x20: dump all threshold histogram fits
+  /// result &0x40: closed-form s-curve estimates, only pixels failing the quality cuts are fitted
   std::vector<TH1*> scurveMaps(std::string dac, std::string name, int ntrig = 10, int daclo = 0, int dachi = 255, 
 			       int dacsperstep = -1, int ntrigperstep = 1, 
 			       int result = 15, int ihit = 1, int flag = FLAG_FORCE_MASKED); 
@@ -165,6 +167,8 @@ public:
   void trimHotPixels(int hitThreshold = -1, int runSeconds = 10, bool maskuntrimmable = false);  
   /// determine hot pixels with high occupancy
   void maskHotPixels(std::vector<TH2D*>); 
+  /// set the hit maps of the pixels recorded by the hot pixel monitor of the DAQ
+  void fillHotPixelMaps(std::vector<TH2D*>);
   /// send reset to ROC(s)
   void resetROC();
   /// send reset to TBM(s)
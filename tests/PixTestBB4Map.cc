@@ -228,6 +228,8 @@ void PixTestBB4Map::doTest()
 	fApi->setDAC("Vcal",1); // set Vcal to zero
 	fApi->setDAC("VthrComp" , fParVthrCompLo);
 
+	// noise hits differ from run to run, do not reuse cached scans
+	fApi->clearScanCache();
 	mapeff(noisemaps);	//get efficiency maps
 
 	LOG(logINFO) << "starting loop over VthrComp";
@@ -16,7 +16,7 @@ ClassImp(PixTestDaq)
 
 // ----------------------------------------------------------------------
 PixTestDaq::PixTestDaq(PixSetup *a, std::string name) : PixTest(a, name), fParDelayTBM(0), fParFillTree(0), fParStretch(0), 
-  fParTriggerFrequency(0), fParNtrig(1), fParIter(0), fRunDaqTrigger(0), fParSeconds(0) {
+  fParTriggerFrequency(0), fParNtrig(1), fParIter(0), fRunDaqTrigger(0), fParSeconds(0), fPhId(-1), fQId(-1) {
   PixTest::init();
   init(); 
   LOG(logDEBUG) << "PixTestDaq ctor(PixSetup &a, string, TGTab *)";
@@ -27,7 +27,7 @@ PixTestDaq::PixTestDaq(PixSetup *a, std::string name) : PixTest(a, name), fParDe
 }
 
 //----------------------------------------------------------
-PixTestDaq::PixTestDaq() : PixTest() {
+PixTestDaq::PixTestDaq() : PixTest(), fPhId(-1), fQId(-1) {
   LOG(logDEBUG) << "PixTestDaq ctor()";
   fTree = 0; 
 }
@@ -193,6 +193,12 @@ void PixTestDaq::bookHist(string /*name*/) {
 		setTitles(h1, "Q [Vcal]", "Entries/bin");
 		fQ.push_back(h1);
 	}
+
+	fHitStore.book(rocIds);
+	if (rocIds.size() > 0) {
+		fPhId = fHitStore.book(fPh[0]);
+		fQId = fHitStore.book(fQ[0]);
+	}
 }
 
 // ----------------------------------------------------------------------
@@ -218,48 +224,47 @@ void PixTestDaq::ProcessData(uint16_t numevents){
 	LOG(logDEBUG) << "Processing Data: " << daqdat.size() << " events.";
 
 	int pixCnt(0);
-	int idx(-1);
 	uint16_t q;
-	vector<uint8_t> rocIds = fApi->_dut->getEnabledRocIDs();
-	for (std::vector<pxar::Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
+	vector<vector<double> > qs(daqdat.size());
+	if (fPhCalOK && !fPhCal.hasLookupTable()) fPhCal.buildLookupTable();
+	for (unsigned int ievt = 0; ievt < daqdat.size(); ++ievt) {
+		pxar::Event *it = &daqdat[ievt];
 		pixCnt += it->pixels.size();
+		if (fPhCalOK) {
+			fPhCal.vcal(it->pixels, qs[ievt]);
+			for (unsigned int ipix = 0; ipix < qs[ievt].size(); ++ipix) qs[ievt][ipix] = static_cast<uint16_t>(qs[ievt][ipix]);
+		}
 
 		if (fParFillTree) {
 		        bookTree();  
 			fTreeEvent.header = it->getHeader();
 			fTreeEvent.dac = 0;
 			fTreeEvent.trailer = it->getTrailer();
-		}
-
-		for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
-			idx = getIdxFromId(it->pixels[ipix].roc());
-			if(idx == -1) {
-				LOG(logWARNING) << "PixTestDaq::ProcessData() wrong 'idx' value --> return";
-				return;    			
-			}
-			fHitMap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-			fPhmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), it->pixels[ipix].value());
-			fPh[idx]->Fill(it->pixels[ipix].value());
-
-			if (fPhCalOK) {
-				q = static_cast<uint16_t>(fPhCal.vcal(it->pixels[ipix].roc(), it->pixels[ipix].column(),	
-								      it->pixels[ipix].row(), it->pixels[ipix].value()));
-			}
-			else {
-				q = 0;
+			for (unsigned int ipix = 0; ipix < it->pixels.size() && ipix < 20000; ++ipix) {
+				q = (fPhCalOK ? static_cast<uint16_t>(qs[ievt][ipix]) : 0);
+				++fTreeEvent.npix;
+				fTreeEvent.proc[ipix] = it->pixels[ipix].roc();
+				fTreeEvent.pcol[ipix] = it->pixels[ipix].column();
+				fTreeEvent.prow[ipix] = it->pixels[ipix].row();
+				fTreeEvent.pval[ipix] = it->pixels[ipix].value();
+				fTreeEvent.pq[ipix] = q;
 			}
-			fQ[idx]->Fill(q);
-			fQmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), q);
-				if (fParFillTree && ipix < 20000) {
-				  ++fTreeEvent.npix;
-				  fTreeEvent.proc[ipix] = it->pixels[ipix].roc();
-				  fTreeEvent.pcol[ipix] = it->pixels[ipix].column();
-				  fTreeEvent.prow[ipix] = it->pixels[ipix].row();
-				  fTreeEvent.pval[ipix] = it->pixels[ipix].value();
-				  fTreeEvent.pq[ipix] = q;
-				}
+			fTree->Fill();
 		}
-		if (fParFillTree) fTree->Fill();
+	}
+
+	// -- histogram in plain arrays, the ROOT histograms are only set once per call
+	uint64_t skipped = fHitStore.skipped();
+	fHitStore.fill(daqdat, qs, fPhId, fQId);
+	if (fHitStore.skipped() > skipped) {
+		LOG(logWARNING) << "PixTestDaq::ProcessData() ignored " << fHitStore.skipped() - skipped << " hits of unknown ROCs";
+	}
+	for (int iroc = 0; iroc < fHitStore.nRocs(); ++iroc) {
+		fHitStore.flushHits(iroc, fHitMap[iroc]);
+		fHitStore.flushPh(iroc, fPhmap[iroc]);
+		fHitStore.flush(fPhId, iroc, fPh[iroc]);
+		fHitStore.flushQ(iroc, fQmap[iroc]);
+		fHitStore.flush(fQId, iroc, fQ[iroc]);
 	}
 
   	//to draw the hitsmap as 'online' check.
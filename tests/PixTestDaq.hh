@@ -3,6 +3,7 @@
 
 #include "PixTest.hh"
 #include "PHCalibration.hh"
+#include "hitstore.hh"
 
 #include <TH1.h>
 #include <TH2.h>
@@ -51,6 +52,8 @@ private:
   std::vector<TH1D*> fPh;
   std::vector<TH1D*> fQ;
   std::vector<TProfile2D*> fQmap;
+  hitStore fHitStore; //! filled in ProcessData, copied into the histograms above
+  int      fPhId, fQId;
 
   std::vector<std::vector<std::pair<int, int> > > fHotPixels;
 
@@ -12,6 +12,7 @@
 
 #include "PixTestGainPedestal.hh"
 #include "PHCalibration.hh"
+#include "PixGainPedestalFit.hh"
 #include "PixUtil.hh"
 #include "log.h"
 
@@ -413,75 +414,123 @@ void PixTestGainPedestal::fit() {
   
   double nl(0.), ifunction(0.), ipol1(0.), x0(0.), y0(0.), x1(200.), y1(0.); 
   int iroc(0), ic(0), ir(0); 
-
-  for (unsigned int i = 0; i < fHists.size(); ++i) {
-    h1->Reset();
-    for (int ib = 0; ib < static_cast<int>(fLpoints.size()); ++ib) {
-      h1->SetBinContent(fLpoints[ib]+1, fHists[i]->get(ib+1));
-      h1->SetBinError(fLpoints[ib]+1, fracErr*fHists[i]->get(ib+1)); 
-    }
-    for (int ib = 0; ib < static_cast<int>(fHpoints.size()); ++ib) {
-      h1->SetBinContent(7*fHpoints[ib]+1, fHists[i]->get(100+ib+1));
-      h1->SetBinError(7*fHpoints[ib]+1, fracErr*fHists[i]->get(100+ib+1)); 
+  double par[4], parErr[4]; 
+
+  // -- without displaying or dumping the fits all pixels are fitted in parallel, without ROOT. 
+  //    The points are the bin centers of h1, a high range point replaces a low range point in the same bin
+  bool parallel = !fParShowFits && !fParDumpHists; 
+  PixGainPedestalFit gpf(mode); 
+  vector<PixGainPedestalFit::result> fits; 
+  if (parallel) {
+    vector<pair<int, int> > points; // (h1 bin, shist256 bin)
+    int nlo = static_cast<int>(fLpoints.size()); 
+    for (int ib = 0; ib < nlo + static_cast<int>(fHpoints.size()); ++ib) {
+      int bin = (ib < nlo ? fLpoints[ib] : 7*fHpoints[ib-nlo]) + 1; 
+      int sbin = (ib < nlo ? ib+1 : 100+(ib-nlo)+1); 
+      unsigned int j(0); 
+      while (j < points.size() && points[j].first != bin) ++j; 
+      if (j < points.size()) {
+	points[j].second = sbin; 
+      } else {
+	points.push_back(make_pair(bin, sbin)); 
+      }
     }
-    if (0 == mode) {
-      f = fPIF->gpErr(h1); 
-    } else if (1 == mode) {
-      f = fPIF->gpTanH(h1); 
+    vector<double> x; 
+    for (unsigned int j = 0; j < points.size(); ++j) x.push_back(h1->GetBinCenter(points[j].first)); 
+    vector<vector<double> > y(fHists.size(), vector<double>(points.size())); 
+    for (unsigned int i = 0; i < fHists.size(); ++i) {
+      for (unsigned int j = 0; j < points.size(); ++j) y[i][j] = fHists[i]->get(points[j].second); 
     }
-    if (h1->Integral() < 1) continue;
-    PixUtil::idx2rcr(i, iroc, ic, ir);
-    if (fParShowFits) {
-      TH1D *hc = (TH1D*)h1->Clone(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc));
-      hc->SetTitle(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc)); 
-      string hcname = hc->GetName();
-      LOG(logDEBUG) << hcname; 
-      hc->Fit(f, "r");
-      fHistList.push_back(hc); 
-      PixTest::update(); 
+    TStopwatch t; 
+    gpf.fit(x, y, fits, fracErr); 
+    LOG(logDEBUG) << "fitted " << fits.size() << " pixels in " << t.RealTime() << " seconds"; 
+  }
+
+  for (unsigned int i = 0; i < fHists.size(); ++i) {
+    if (parallel) {
+      if (!fits[i].ok) continue;
+      PixUtil::idx2rcr(i, iroc, ic, ir);
+      for (int ipar = 0; ipar < 4; ++ipar) {
+	par[ipar] = fits[i].par[ipar]; 
+	parErr[ipar] = fits[i].err[ipar]; 
+      }
+      ifunction = gpf.integral(par, 0., 200.);
+      y0 = gpf.eval(par, x0);
+      y1 = gpf.eval(par, x1);
     } else {
-      if (fParDumpHists) {
-	h1->SetTitle(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc)); 
-	h1->SetName(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc)); 
+      h1->Reset();
+      for (int ib = 0; ib < static_cast<int>(fLpoints.size()); ++ib) {
+	h1->SetBinContent(fLpoints[ib]+1, fHists[i]->get(ib+1));
+	h1->SetBinError(fLpoints[ib]+1, fracErr*fHists[i]->get(ib+1)); 
+      }
+      for (int ib = 0; ib < static_cast<int>(fHpoints.size()); ++ib) {
+	h1->SetBinContent(7*fHpoints[ib]+1, fHists[i]->get(100+ib+1));
+	h1->SetBinError(7*fHpoints[ib]+1, fracErr*fHists[i]->get(100+ib+1)); 
       }
-      h1->Fit(f, "rq");
-      if (fParDumpHists) {
-	ifunction = f->Integral(0., 200.);
-	y0 = f->Eval(x0);
-	y1 = f->Eval(x1);
-	ipol1 = y0*x1 + 0.5*x1*(y1-y0);
-	nl = ifunction/ipol1;
-	nllist[getIdxFromId(iroc)]->Fill(nl); 
-	h1->SetTitle(Form("%s, if = %6.4f, ip = %6.4f, nl = %6.4f", h1->GetTitle(), ifunction, ipol1, nl)); 
-
-	h1->SetDirectory(fDirectory); 
-	h1->Write();
+      if (0 == mode) {
+	f = fPIF->gpErr(h1); 
+      } else if (1 == mode) {
+	f = fPIF->gpTanH(h1); 
+      }
+      if (h1->Integral() < 1) continue;
+      PixUtil::idx2rcr(i, iroc, ic, ir);
+      if (fParShowFits) {
+	TH1D *hc = (TH1D*)h1->Clone(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc));
+	hc->SetTitle(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc)); 
+	string hcname = hc->GetName();
+	LOG(logDEBUG) << hcname; 
+	hc->Fit(f, "r");
+	fHistList.push_back(hc); 
+	PixTest::update(); 
+      } else {
+	if (fParDumpHists) {
+	  h1->SetTitle(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc)); 
+	  h1->SetName(Form("gainPedestal_c%d_r%d_C%d", ic, ir, iroc)); 
+	}
+	h1->Fit(f, "rq");
+	if (fParDumpHists) {
+	  ifunction = f->Integral(0., 200.);
+	  y0 = f->Eval(x0);
+	  y1 = f->Eval(x1);
+	  ipol1 = y0*x1 + 0.5*x1*(y1-y0);
+	  nl = ifunction/ipol1;
+	  nllist[getIdxFromId(iroc)]->Fill(nl); 
+	  h1->SetTitle(Form("%s, if = %6.4f, ip = %6.4f, nl = %6.4f", h1->GetTitle(), ifunction, ipol1, nl)); 
+
+	  h1->SetDirectory(fDirectory); 
+	  h1->Write();
+	}
+      }
+
+      for (int ipar = 0; ipar < 4; ++ipar) {
+	par[ipar] = f->GetParameter(ipar); 
+	parErr[ipar] = f->GetParError(ipar); 
       }
+      ifunction = f->Integral(0., 200.);
+      y0 = f->Eval(x0);
+      y1 = f->Eval(x1);
     }
 
-    ifunction = f->Integral(0., 200.);
-    y0 = f->Eval(x0);
-    y1 = f->Eval(x1);
     ipol1 = y0*x1 + 0.5*x1*(y1-y0);
     nllist[getIdxFromId(iroc)]->Fill(ifunction/ipol1); 
 
 
 
     int idx = ic*80 + ir; 
-    v[iroc][idx].p0 = f->GetParameter(0); 
-    v[iroc][idx].p1 = f->GetParameter(1); 
-    v[iroc][idx].p2 = f->GetParameter(2); 
-    v[iroc][idx].p3 = f->GetParameter(3); 
-
-    p0list[getIdxFromId(iroc)]->Fill(f->GetParameter(0)); 
-    p1list[getIdxFromId(iroc)]->Fill(f->GetParameter(1)); 
-    p2list[getIdxFromId(iroc)]->Fill(f->GetParameter(2)); 
-    p3list[getIdxFromId(iroc)]->Fill(f->GetParameter(3)); 
-
-    e0list[getIdxFromId(iroc)]->Fill(f->GetParError(0)/f->GetParameter(0)); 
-    e1list[getIdxFromId(iroc)]->Fill(f->GetParError(1)/f->GetParameter(1)); 
-    e2list[getIdxFromId(iroc)]->Fill(f->GetParError(2)/f->GetParameter(2)); 
-    e3list[getIdxFromId(iroc)]->Fill(f->GetParError(3)/f->GetParameter(3)); 
+    v[iroc][idx].p0 = par[0]; 
+    v[iroc][idx].p1 = par[1]; 
+    v[iroc][idx].p2 = par[2]; 
+    v[iroc][idx].p3 = par[3]; 
+
+    p0list[getIdxFromId(iroc)]->Fill(par[0]); 
+    p1list[getIdxFromId(iroc)]->Fill(par[1]); 
+    p2list[getIdxFromId(iroc)]->Fill(par[2]); 
+    p3list[getIdxFromId(iroc)]->Fill(par[3]); 
+
+    e0list[getIdxFromId(iroc)]->Fill(parErr[0]/par[0]); 
+    e1list[getIdxFromId(iroc)]->Fill(parErr[1]/par[1]); 
+    e2list[getIdxFromId(iroc)]->Fill(parErr[2]/par[2]); 
+    e3list[getIdxFromId(iroc)]->Fill(parErr[3]/par[3]); 
 
   }
 
@@ -10,6 +10,7 @@
 #include <TStyle.h>
 
 #include "PixUtil.hh"
+#include "hitstore.hh"
 
 
 #include <TH2.h>
@@ -267,6 +268,8 @@ void PixTestHighRate::doCalDelScan() {
   int ntrig(10);
   banner(Form("PixTestHighRate::calDelScan() ntrig = %d, vcal = %d", ntrig, fParVcal));
   cacheDacs();
+  // -- hits from the beam/source differ from run to run, do not reuse cached scans
+  fApi->clearScanCache();
 
   gStyle->SetPalette(1);
   fDirectory->cd();
@@ -438,6 +441,8 @@ void PixTestHighRate::doXPixelAlive() {
 
   banner(Form("PixTestHighRate::xPixelAlive() ntrig = %d, vcal = %d", fParNtrig, fParVcal));
   cacheDacs();
+  // -- hits from the beam/source differ from run to run, do not reuse cached scans
+  fApi->clearScanCache();
   gStyle->SetPalette(1);
 
 
@@ -595,6 +600,8 @@ void PixTestHighRate::doXNoiseMaps() {
 
   banner(Form("PixTestHighRate::xNoiseMaps() ntrig = %d, vcal = %d", fParNtrig, fParVcal));
   cacheDacs();
+  // -- hits from the beam/source differ from run to run, do not reuse cached scans
+  fApi->clearScanCache();
   gStyle->SetPalette(1);
 
   // -- cache triggerdelay
@@ -880,10 +887,14 @@ void PixTestHighRate::fillMap(vector<TH2D*> hist) {
 
   for(std::vector<pxar::Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
     pixCnt += it->pixels.size();
+  }
 
-    for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {
-      hist[getIdxFromId(it->pixels[ipix].roc())]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-    }
+  // -- count in plain arrays, then add to the ROOT histograms
+  hitStore hits;
+  hits.book(fApi->_dut->getEnabledRocIDs());
+  hits.fill(daqdat, vector<vector<double> >());
+  for (int iroc = 0; iroc < hits.nRocs() && iroc < static_cast<int>(hist.size()); ++iroc) {
+    hits.flushHits(iroc, hist[iroc], true);
   }
   LOG(logDEBUG) << "Processing Data: " << daqdat.size() << " events with " << pixCnt << " pixels";
 }
@@ -29,7 +29,8 @@ PixTest(a, name),
   fParVcal(200),
   fParDeltaVthrComp(-50),
   fParFracCalDel(0.5),
-  fIgnoreProblems(0) {
+  fIgnoreProblems(0),
+  fAdaptiveScan(0) {
   PixTest::init();
   init();
 }
@@ -90,6 +91,12 @@ bool PixTestPretest::setParameter(string parName, string sval) {
 	fIgnoreProblems = atoi(sval.c_str());
       }
 
+      if (!parName.compare("adaptivescan")) {
+	PixUtil::replaceAll(sval, "checkbox(", "");
+	PixUtil::replaceAll(sval, ")", "");
+	fAdaptiveScan = atoi(sval.c_str());
+      }
+
       if (!parName.compare("pix") || !parName.compare("pix1") ) {
 	s1 = sval.find(",");
 	if (string::npos != s1) {
@@ -681,7 +688,14 @@ void PixTestPretest::setVthrCompCalDel() {
     if (fStopTest) break;
 
     try{
-      rresults = fApi->getEfficiencyVsDACDAC("caldel", 0, 255, "vthrcomp", 0, 180, FLAGS, fParNtrig);
+      if (fAdaptiveScan) {
+	// -- adaptive scan: refined only along the edges of the tornado, the rest is interpolated
+	vector<pair<uint8_t, pair<uint8_t, vector<pixel> > > > measured
+	  = fApi->getEfficiencyVsDACDACAdaptive("caldel", 0, 255, "vthrcomp", 0, 180, 8, fParNtrig/4, FLAGS, fParNtrig, &rresults);
+	LOG(logINFO) << "adaptive CalDel/VthrComp scan measured " << measured.size() << " of " << rresults.size() << " points";
+      } else {
+	rresults = fApi->getEfficiencyVsDACDAC("caldel", 0, 255, "vthrcomp", 0, 180, FLAGS, fParNtrig);
+      }
       done = true;
     } catch(DataMissingEvent &e){
       LOG(logCRITICAL) << "problem with readout: "<< e.what() << " missing " << e.numberMissing << " events";
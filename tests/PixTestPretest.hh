@@ -36,6 +36,7 @@ private:
   int     fParVcal, fParDeltaVthrComp;
   double  fParFracCalDel;
   int     fIgnoreProblems;
+  int     fAdaptiveScan;
 
   ClassDef(PixTestPretest, 1)
 
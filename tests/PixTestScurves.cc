@@ -22,7 +22,7 @@ ClassImp(PixTestScurves)
 // ----------------------------------------------------------------------
 PixTestScurves::PixTestScurves(PixSetup *a, std::string name) : PixTest(a, name), 
   fParDac(""), fParNtrig(1), fParDacLo(0), fParDacHi(0), fParDacsPerStep(1), fParNtrigPerStep(1), 
-  fAdjustVcal(1), fDumpAll(-1), fDumpProblematic(-1), fDumpOutputFile(-1) {
+  fAdjustVcal(1), fDumpAll(-1), fDumpProblematic(-1), fDumpOutputFile(-1), fFastScurves(0) {
   PixTest::init();
   init(); 
 }
@@ -81,6 +81,13 @@ bool PixTestScurves::setParameter(string parName, string sval) {
 	setToolTips();
       }
 
+      if (!parName.compare("fastscurves")) {
+	PixUtil::replaceAll(sval, "checkbox(", ""); 
+	PixUtil::replaceAll(sval, ")", ""); 
+	fFastScurves = atoi(sval.c_str()); 
+	setToolTips();
+      }
+
       if (!parName.compare("dumpoutputfile")) {
 	PixUtil::replaceAll(sval, "checkbox(", ""); 
 	PixUtil::replaceAll(sval, ")", ""); 
@@ -255,6 +262,7 @@ void PixTestScurves::scurves() {
   int results(0xf); 
   if (fDumpAll) results |= 0x20;
   if (fDumpProblematic) results |= 0x10;
+  if (fFastScurves) results |= 0x40;
 
   int FLAG = FLAG_FORCE_MASKED;
   vector<TH1*> thr0 = scurveMaps(fParDac, "scurve"+fParDac, fParNtrig, fParDacLo, fParDacHi, fParDacsPerStep, fParNtrigPerStep, results, 1, FLAG); 
@@ -25,7 +25,7 @@ public:
 private:
 
   std::string fParDac;
-  int         fParNtrig, fParDacLo, fParDacHi, fParDacsPerStep, fParNtrigPerStep, fAdjustVcal, fDumpAll, fDumpProblematic, fDumpOutputFile;
+  int         fParNtrig, fParDacLo, fParDacHi, fParDacsPerStep, fParNtrigPerStep, fAdjustVcal, fDumpAll, fDumpProblematic, fDumpOutputFile, fFastScurves;
 
   ClassDef(PixTestScurves, 1)
 
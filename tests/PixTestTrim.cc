@@ -20,7 +20,7 @@ using namespace pxar;
 ClassImp(PixTestTrim)
 
 // ----------------------------------------------------------------------
-PixTestTrim::PixTestTrim(PixSetup *a, std::string name) : PixTest(a, name), fParVcal(35), fParNtrig(1) {
+PixTestTrim::PixTestTrim(PixSetup *a, std::string name) : PixTest(a, name), fParVcal(35), fParNtrig(1), fParTolerance(0) {
   PixTest::init();
   init();
   //  LOG(logINFO) << "PixTestTrim ctor(PixSetup &a, string, TGTab *)";
@@ -28,7 +28,7 @@ PixTestTrim::PixTestTrim(PixSetup *a, std::string name) : PixTest(a, name), fPar
 
 
 //----------------------------------------------------------
-PixTestTrim::PixTestTrim() : PixTest() {
+PixTestTrim::PixTestTrim() : PixTest(), fParTolerance(0) {
   //  LOG(logINFO) << "PixTestTrim ctor()";
 }
 
@@ -45,6 +45,9 @@ bool PixTestTrim::setParameter(string parName, string sval) {
       if (!parName.compare("vcal")) {
 	fParVcal = atoi(sval.c_str());
       }
+      if (!parName.compare("tolerance")) {
+	fParTolerance = atoi(sval.c_str());
+      }
       break;
     }
   }
@@ -350,6 +353,20 @@ void PixTestTrim::trimTest() {
     fProblem = true;
     return;
   }
+  // -- pixels within tolerance are not touched (nor rescanned) by the correction steps
+  TH1D *hconv = bookTH1D("TrimOpenPixels", "TrimOpenPixels", 5, 0., 5.);
+  setTitles(hconv, "trim step", "pixels out of tolerance");
+  hconv->SetMinimum(0.);
+  fHistList.push_back(hconv);
+  for (unsigned int iroc = 0; iroc < rocIds.size(); ++iroc) {
+    for (int ix = 0; ix < 52; ++ix) {
+      for (int iy = 0; iy < 80; ++iy) {
+	fConverged[iroc][ix][iy] = false;
+      }
+    }
+  }
+  hconv->SetBinContent(1, updateConvergence(thr2));
+
   double maxthr = getMaximumThreshold(thr2);
   double minthr = getMinimumThreshold(thr2);
   print(Form("TrimStepCorr4 extremal thresholds: %f .. %f", minthr,  maxthr));
@@ -362,6 +379,7 @@ void PixTestTrim::trimTest() {
     fProblem = true;
     return;
   }
+  hconv->SetBinContent(2, updateConvergence(thr2a));
 
 
   correction = 2;
@@ -377,6 +395,7 @@ void PixTestTrim::trimTest() {
     fProblem = true;
     return;
   }
+  hconv->SetBinContent(3, updateConvergence(thr3a));
 
   correction = 1;
   maxthr = getMaximumThreshold(thr3a);
@@ -391,6 +410,7 @@ void PixTestTrim::trimTest() {
     fProblem = true;
     return;
   }
+  hconv->SetBinContent(4, updateConvergence(thr4a));
 
   correction = 1;
   maxthr = getMaximumThreshold(thr4a);
@@ -405,6 +425,7 @@ void PixTestTrim::trimTest() {
     fProblem = true;
     return;
   }
+  hconv->SetBinContent(5, updateConvergence(thr5a));
 
   // -- create trimMap
   string trimbitsMeanString(""), trimbitsRmsString("");
@@ -629,6 +650,7 @@ vector<TH1*> PixTestTrim::trimStep(string name, int correction, vector<TH1*> cal
     for (int ix = 0; ix < 52; ++ix) {
       for (int iy = 0; iy < 80; ++iy) {
 	trimBitsOld[i][ix][iy] = fTrimBits[i][ix][iy];
+	if (fConverged[i][ix][iy]) continue;
         if (effHighVcal[i]->GetBinContent(ix+1, iy+1) < nTrigAlive * 0.95) {
           trim = fTrimBits[i][ix][iy] + correction;
           if (trim > 15) trim = 15;
@@ -648,7 +670,40 @@ vector<TH1*> PixTestTrim::trimStep(string name, int correction, vector<TH1*> cal
   }
 
   setTrimBits();
-  vector<TH1*> calNew = scurveMaps("vcal", name, NTRIG, vcalMin, vcalMax, -1, -1, 1);
+
+  // -- rescan only the open pixels. The same pixels are enabled on all ROCs (so that the ROCs are
+  //    still scanned in parallel); with many open pixels the full ROC scan is faster than the pixel loop
+  int NSPARSEMAX(500);
+  vector<pair<int, int> > open;
+  for (int ix = 0; ix < 52; ++ix) {
+    for (int iy = 0; iy < 80; ++iy) {
+      for (unsigned int i = 0; i < calOld.size(); ++i) {
+	if (!fConverged[i][ix][iy]) {
+	  open.push_back(make_pair(ix, iy));
+	  break;
+	}
+      }
+    }
+  }
+  bool sparse = (open.size() < static_cast<size_t>(NSPARSEMAX));
+  LOG(logINFO) << name << ": rescanning " << open.size() << " pixel positions"
+	       << (sparse ? " (pixel loop)" : " (full ROC)") << ", correction = " << correction;
+  if (sparse) {
+    fApi->_dut->testAllPixels(false);
+    for (unsigned int ipix = 0; ipix < open.size(); ++ipix) {
+      fApi->_dut->testPixel(open[ipix].first, open[ipix].second, true);
+    }
+  }
+  vector<TH1*> calNew;
+  if (open.size() > 0) calNew = scurveMaps("vcal", name, NTRIG, vcalMin, vcalMax, -1, -1, 1);
+  if (sparse) fApi->_dut->testAllPixels(true);
+  if (0 == open.size()) {
+    // -- nothing to do: keep the previous thresholds
+    for (unsigned int i = 0; i < calOld.size(); ++i) {
+      TH1 *h = (TH1*)calOld[i]->Clone(Form("%s_%s", calOld[i]->GetName(), name.c_str()));
+      calNew.push_back(h);
+    }
+  }
   if (calNew.size() != calOld.size()) {
     LOG(logERROR) << "scurve map size " << calNew.size() << " does not agree with previous number " << calOld.size();
     fProblem = true;
@@ -660,6 +715,10 @@ vector<TH1*> PixTestTrim::trimStep(string name, int correction, vector<TH1*> cal
     for (int ix = 0; ix < 52; ++ix) {
       for (int iy = 0; iy < 80; ++iy) {
 
+	if (fConverged[i][ix][iy]) {
+	  calNew[i]->SetBinContent(ix + 1, iy + 1, calOld[i]->GetBinContent(ix + 1, iy + 1));
+	  continue;
+	}
         if (effHighVcal[i]->GetBinContent(ix+1, iy+1) < nTrigAlive * 0.95) {
           calNew[i]->SetBinContent(ix+1, iy+1, 0); // threshold too low!
         }
@@ -689,6 +748,32 @@ vector<TH1*> PixTestTrim::trimStep(string name, int correction, vector<TH1*> cal
 }
 
 
+// ----------------------------------------------------------------------
+int PixTestTrim::updateConvergence(vector<TH1*> thr) {
+  int nopen(0), nconv(0), nnew(0);
+  for (unsigned int i = 0; i < thr.size(); ++i) {
+    for (int ix = 0; ix < 52; ++ix) {
+      for (int iy = 0; iy < 80; ++iy) {
+	if (fConverged[i][ix][iy]) {
+	  ++nconv;
+	  continue;
+	}
+	double vcal = thr[i]->GetBinContent(ix+1, iy+1);
+	if (fParTolerance > 0 && vcal > 0. && TMath::Abs(vcal - fParVcal) <= fParTolerance) {
+	  fConverged[i][ix][iy] = true;
+	  ++nnew;
+	} else {
+	  ++nopen;
+	}
+      }
+    }
+  }
+  LOG(logINFO) << "trim convergence (|thr - " << fParVcal << "| <= " << fParTolerance << "): "
+	       << nconv << " pixels converged before, " << nnew << " now, " << nopen << " still open";
+  return nopen;
+}
+
+
 // ----------------------------------------------------------------------
 void PixTestTrim::setTrimBits(int itrim) {
   vector<uint8_t> rocIds = fApi->_dut->getEnabledRocIDs();
@@ -20,14 +20,17 @@ public:
   int adjustVtrim(); 
   std::vector<TH1*> trimStep(std::string name, int corrections, std::vector<TH1*> calMapOld, int vcalMin, int vcalMax); 
   void setTrimBits(int itrim = -1); 
+  /// mark the pixels with a threshold within fParTolerance of fParVcal as converged, returns the number of open pixels
+  int  updateConvergence(std::vector<TH1*> thr);
 
   void doTest(); 
 
 private:
 
-  int     fParVcal, fParNtrig; 
+  int     fParVcal, fParNtrig, fParTolerance; 
   std::vector<std::pair<int, int> > fPIX; 
   int fTrimBits[16][52][80]; 
+  bool fConverged[16][52][80]; ///< trim bits of these pixels are no longer changed (and the pixels not rescanned)
   
   ClassDef(PixTestTrim, 1)
 
@@ -9,6 +9,7 @@
 #include <TStyle.h>
 
 #include "PixUtil.hh"
+#include "hitstore.hh"
 
 #include <TH2.h>
 #include <TMath.h>
@@ -539,6 +540,8 @@ void PixTestXray::doRateScan() {
   fApi->_dut->testAllPixels(true);
   fApi->_dut->maskAllPixels(false);
 
+  // -- the source hits differ from run to run, do not reuse cached scans
+  fApi->clearScanCache();
   vector<TH1*> thr0 = scurveMaps("vcal", "xrayScan", 5, 0, 255, -1, -1, 9); 
 
   fHits[0]->Draw();
@@ -683,47 +686,47 @@ void PixTestXray::readData() {
   try { daqdat = fApi->daqGetEventBuffer(); }
   catch(pxar::DataNoEvent &) {}
   
-  for (std::vector<pxar::Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
+  vector<vector<double> > qs(daqdat.size());
+  if (fPhCalOK && !fPhCal.hasLookupTable()) fPhCal.buildLookupTable();
+  for (unsigned int ievt = 0; ievt < daqdat.size(); ++ievt) {
+    pxar::Event *it = &daqdat[ievt];
     pixCnt += it->pixels.size();
+    if (fPhCalOK) fPhCal.vcal(it->pixels, qs[ievt]);
 
     if (fParFillTree) {
       bookTree();  
       fTreeEvent.header           = it->getHeader(); 
       fTreeEvent.dac              = 0;
       fTreeEvent.trailer          = it->getTrailer(); 
-    }
-
-    int idx(0); 
-    double q(0.);
-    for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {   
-      idx = getIdxFromId(it->pixels[ipix].roc());
-      if (fPhCalOK) {
-	q = fPhCal.vcal(it->pixels[ipix].roc(), 
-			it->pixels[ipix].column(), 
-			it->pixels[ipix].row(), 
-			it->pixels[ipix].value());
-      } else {
-	q = 0;
-      }
-      fHitMap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-      fQ[idx]->Fill(q);
-      fQmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), q);
-
-      fPHmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), it->pixels[ipix].value());
-      fPH[idx]->Fill(it->pixels[ipix].value());
-	
-      if (fParFillTree && ipix < 20000) {
+      for (unsigned int ipix = 0; ipix < it->pixels.size() && ipix < 20000; ++ipix) {   
 	++fTreeEvent.npix;
 	fTreeEvent.proc[ipix] = it->pixels[ipix].roc(); 
 	fTreeEvent.pcol[ipix] = it->pixels[ipix].column(); 
 	fTreeEvent.prow[ipix] = it->pixels[ipix].row(); 
 	fTreeEvent.pval[ipix] = it->pixels[ipix].value(); 
-	fTreeEvent.pq[ipix]   = q;
+	fTreeEvent.pq[ipix]   = (fPhCalOK ? qs[ievt][ipix] : 0.);
       }
+      fTree->Fill();
     }
-    
-    if (fParFillTree) fTree->Fill();
-    
+  }
+
+  // -- histogram in plain arrays, then add to the ROOT histograms
+  hitStore hits; 
+  hits.book(fApi->_dut->getEnabledRocIDs());
+  bool phrun(fQ.size() > 0); 
+  int phId(-1), qId(-1); 
+  if (phrun) {
+    phId = hits.book(fPH[0]); 
+    qId  = hits.book(fQ[0]); 
+  }
+  hits.fill(daqdat, qs, phId, qId); 
+  for (int iroc = 0; iroc < hits.nRocs(); ++iroc) {
+    hits.flushHits(iroc, fHitMap[iroc], true);
+    if (!phrun) continue;
+    hits.flushQ(iroc, fQmap[iroc], true);
+    hits.flush(qId, iroc, fQ[iroc], true);
+    hits.flushPh(iroc, fPHmap[iroc], true);
+    hits.flush(phId, iroc, fPH[iroc], true);
   }
   LOG(logDEBUG) << "Processing Data: " << daqdat.size() << " events with " << pixCnt << " pixels";
 }
@@ -756,12 +759,25 @@ void PixTestXray::processData(uint16_t numevents) {
 
   LOG(logDEBUG) << "Processing Data: " << daqdat.size() << " events.";
   
+  hitStore hits; 
+  hits.book(fApi->_dut->getEnabledRocIDs());
+  int phId = hits.book(fPH[0]); 
+  int qId  = hits.book(fQ[0]); 
+  int evtId    = hits.book(fHitsVsEvents[0]); 
+  int colId    = hits.book(fHitsVsColumn[0]); 
+  int evtColId = hits.book(fHitsVsEvtCol[0]); 
+
   int idx(-1); 
-  uint16_t q; 
-  for (std::vector<pxar::Event>::iterator it = daqdat.begin(); it != daqdat.end(); ++it) {
+  vector<vector<double> > qs(daqdat.size());
+  if (fPhCalOK && !fPhCal.hasLookupTable()) fPhCal.buildLookupTable();
+  for (unsigned int ievt = 0; ievt < daqdat.size(); ++ievt) {
+    pxar::Event *it = &daqdat[ievt];
     ++evtCnt;
     pixCnt += it->pixels.size(); 
-    
+    if (fPhCalOK) {
+      fPhCal.vcal(it->pixels, qs[ievt]);
+      for (unsigned int ipix = 0; ipix < qs[ievt].size(); ++ipix) qs[ievt][ipix] = static_cast<uint16_t>(qs[ievt][ipix]);
+    }
     
     if (fParFillTree) {
       bookTree();  
@@ -771,39 +787,38 @@ void PixTestXray::processData(uint16_t numevents) {
     }
 
     for (unsigned int ipix = 0; ipix < it->pixels.size(); ++ipix) {   
-      idx = getIdxFromId(it->pixels[ipix].roc());
+      idx = hits.index(it->pixels[ipix].roc());
+      if (idx < 0) continue;
 
-      fHitsVsEvents[idx]->Fill(evtCnt); 
-      fHitsVsColumn[idx]->Fill(it->pixels[ipix].column()); 
-      fHitsVsEvtCol[idx]->Fill(evtCnt, it->pixels[ipix].column()); 
+      hits.fill(evtId, idx, evtCnt); 
+      hits.fill(colId, idx, it->pixels[ipix].column()); 
+      hits.fill(evtColId, idx, evtCnt, it->pixels[ipix].column()); 
 
-      if (fPhCalOK) {
-	q = fPhCal.vcal(it->pixels[ipix].roc(), 
-			it->pixels[ipix].column(), 
-			it->pixels[ipix].row(), 
-			it->pixels[ipix].value());
-      } else {
-	q = 0;
-      }
-      fHmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row());
-      fQ[idx]->Fill(q);
-      fQmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), q);
-
-      fPHmap[idx]->Fill(it->pixels[ipix].column(), it->pixels[ipix].row(), it->pixels[ipix].value());
-      fPH[idx]->Fill(it->pixels[ipix].value());
-	
       if (fParFillTree && ipix < 20000) {
 	++fTreeEvent.npix;
 	fTreeEvent.proc[ipix] = it->pixels[ipix].roc(); 
 	fTreeEvent.pcol[ipix] = it->pixels[ipix].column(); 
 	fTreeEvent.prow[ipix] = it->pixels[ipix].row(); 
 	fTreeEvent.pval[ipix] = it->pixels[ipix].value(); 
-	fTreeEvent.pq[ipix]   = q;
+	fTreeEvent.pq[ipix]   = (fPhCalOK ? qs[ievt][ipix] : 0);
       }
     }
     
     if (fParFillTree) fTree->Fill();
   }
+
+  // -- pixel maps and spectra in plain arrays, then add to the ROOT histograms
+  hits.fill(daqdat, qs, phId, qId); 
+  for (int iroc = 0; iroc < hits.nRocs(); ++iroc) {
+    hits.flushHits(iroc, fHmap[iroc], true);
+    hits.flushQ(iroc, fQmap[iroc], true);
+    hits.flush(qId, iroc, fQ[iroc], true);
+    hits.flushPh(iroc, fPHmap[iroc], true);
+    hits.flush(phId, iroc, fPH[iroc], true);
+    hits.flush(evtId, iroc, fHitsVsEvents[iroc], true);
+    hits.flush(colId, iroc, fHitsVsColumn[iroc], true);
+    hits.flush(evtColId, iroc, fHitsVsEvtCol[iroc], true);
+  }
   
   LOG(logDEBUG) << Form(" # events read: %6ld, pixels seen in all events: %3d", daqdat.size(), pixCnt);
   
@@ -0,0 +1,473 @@
+/* pxar_bench: microbenchmarks of the raw data decoding and repacking hot
+   paths. All corpora are generated from fixed seeds, no testboard is needed.
+   The results are written as JSON to track performance between releases. */
+
+#ifndef WIN32
+#include <sys/time.h>
+#else
+#include <Windows.h>
+#endif
+
+#include "api.h"
+#include "condense.h"
+#include "repack.h"
+#include "datapipe.h"
+#include "datasource_evt.h"
+#include "rawcompression.h"
+#include "constants.h"
+#include "log.h"
+#include "config.h"
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdlib.h>
+
+using namespace pxar;
+
+// Wall clock in seconds with microsecond resolution:
+double now() {
+#ifdef WIN32
+  FILETIME ft;
+  GetSystemTimeAsFileTime(&ft);
+  ULARGE_INTEGER li;
+  li.LowPart = ft.dwLowDateTime;
+  li.HighPart = ft.dwHighDateTime;
+  return static_cast<double>(li.QuadPart)/1e7;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec/1e6;
+#endif
+}
+
+// Small deterministic random number generator, independent of the libc:
+class benchRandom {
+  uint32_t state;
+public:
+  benchRandom(uint32_t seed) : state(seed ? seed : 1) {}
+  uint32_t next() { state ^= state << 13; state ^= state >> 17; state ^= state << 5; return state; }
+  uint32_t integer(uint32_t n) { return next()%n; }
+};
+
+// Raw data of one DAQ channel together with the settings needed to decode it:
+struct corpus {
+  std::string name;
+  uint8_t tbmtype;
+  uint8_t roctype;
+  uint8_t nrocs;
+  size_t events;
+  std::vector<uint16_t> data;
+};
+
+struct result {
+  std::string name;
+  std::string corpus;
+  double seconds;
+  size_t words;
+  size_t events;
+  size_t pixels;
+  double ratio;
+};
+
+std::vector<result> results;
+int repetitions = 5;
+
+void report(std::string name, std::string corpusname, double seconds, size_t words, size_t events, size_t pixels, double ratio = 0) {
+  result r;
+  r.name = name; r.corpus = corpusname; r.seconds = seconds;
+  r.words = words; r.events = events; r.pixels = pixels; r.ratio = ratio;
+  results.push_back(r);
+  std::cerr << std::left << std::setw(28) << name << std::setw(18) << corpusname << std::right
+	    << std::setw(10) << std::fixed << std::setprecision(2) << seconds*1e3 << " ms  "
+	    << std::setw(10) << std::setprecision(3) << (words ? words/seconds/1e6 : 0) << " Mwords/s  "
+	    << std::setw(10) << (events ? events/seconds/1e6 : 0) << " Mevents/s";
+  if(ratio > 0) std::cerr << std::setw(8) << std::setprecision(2) << ratio << "x";
+  std::cerr << std::endl;
+}
+
+// Digital ROC data framed like the DTB does for the different readout chains:
+corpus makeDigitalCorpus(std::string name, uint8_t tbmtype, uint8_t nrocs, size_t nevents, uint32_t seed) {
+  corpus c;
+  c.name = name; c.tbmtype = tbmtype; c.roctype = ROC_PSI46DIGV21RESPIN;
+  c.nrocs = nrocs; c.events = nevents;
+  benchRandom rnd(seed);
+
+  for(size_t ev = 0; ev < nevents; ev++) {
+    size_t pos = c.data.size();
+    if(tbmtype != TBM_NONE) {
+      c.data.push_back(0xa000 | (ev%256));
+      c.data.push_back(0x8000);
+    }
+    for(uint8_t roc = 0; roc < nrocs; roc++) {
+      if(tbmtype == TBM_NONE) c.data.push_back(0x07f8);
+      else if(tbmtype == TBM_EMU) c.data.push_back(0x47f8);
+      else c.data.push_back(0x4001);
+      // Zero to three hits per ROC:
+      uint32_t nhits = rnd.integer(4);
+      for(uint32_t h = 0; h < nhits; h++) {
+	uint32_t raw = pixel(roc, static_cast<uint8_t>(rnd.integer(ROC_NUMCOLS)), static_cast<uint8_t>(rnd.integer(ROC_NUMROWS)), static_cast<double>(rnd.integer(256))).encode();
+	c.data.push_back((raw >> 12) & 0x0fff);
+	c.data.push_back(0x2000 | (raw & 0x0fff));
+      }
+    }
+    if(tbmtype != TBM_NONE) {
+      c.data.push_back(0xe000);
+      c.data.push_back(0xc000);
+    }
+    else {
+      c.data.at(pos) |= 0x8000;
+      c.data.back() = 0x4000 | (c.data.back() & 0x8fff);
+    }
+  }
+  return c;
+}
+
+// Analog PSI46V2 data as read by the DTB ADC, DESER160-style markers:
+corpus makeAnalogCorpus(std::string name, size_t nevents, uint32_t seed) {
+  corpus c;
+  c.name = name; c.tbmtype = TBM_NONE; c.roctype = ROC_PSI46V2;
+  c.nrocs = 1; c.events = nevents;
+  benchRandom rnd(seed);
+
+  // Ultrablack at -200, black at 0 gives address levels of 50 ADC units:
+  const int16_t ultrablack = -200, level1 = 50;
+  for(size_t ev = 0; ev < nevents; ev++) {
+    size_t pos = c.data.size();
+    c.data.push_back(ultrablack & 0x0fff);
+    c.data.push_back(0);
+    c.data.push_back(rnd.integer(100));
+    uint32_t nhits = 1 + rnd.integer(3);
+    for(uint32_t h = 0; h < nhits; h++) {
+      int col = rnd.integer(ROC_NUMCOLS), row = rnd.integer(ROC_NUMROWS);
+      int c0 = col/2, r = 2*(ROC_NUMROWS - row) + (col&1);
+      int digits[5] = { c0/6, c0%6, r/36, (r/6)%6, r%6 };
+      for(int d = 0; d < 5; d++) c.data.push_back(((digits[d] - 1)*level1) & 0x0fff);
+      c.data.push_back(rnd.integer(200));
+    }
+    c.data.at(pos) |= 0x8000;
+    c.data.back() |= 0x4000;
+  }
+  return c;
+}
+
+// Serves pre-split events to the decoder. Each event is copied since
+// the decoder strips the TBM header and trailer in place.
+class rawEventReplay : public dataSource<rawEvent*> {
+  const std::vector<rawEvent> &events;
+  const corpus &c;
+  size_t pos;
+  rawEvent record;
+  rawEvent* Read() {
+    if(pos >= events.size()) throw dsBufferEmpty();
+    record = events[pos++];
+    return &record;
+  }
+  rawEvent* ReadLast() { return &record; }
+  uint8_t ReadChannel() { return 0; }
+  uint16_t ReadFlags() { return FLAG_DISABLE_EVENTID_CHECK; }
+  uint8_t ReadTokenChainLength() { return c.nrocs; }
+  uint8_t ReadTokenChainOffset() { return 0; }
+  uint8_t ReadEnvelopeType() { return c.tbmtype; }
+  uint8_t ReadDeviceType() { return c.roctype; }
+public:
+  rawEventReplay(const std::vector<rawEvent> &evts, const corpus &crp) : events(evts), c(crp), pos(0) {}
+};
+
+void benchDecoding(const corpus &c) {
+
+  // Splitting only:
+  double best = 1e9;
+  std::vector<rawEvent> split;
+  for(int rep = 0; rep < repetitions; rep++) {
+    evtSource src(0, c.nrocs, 0, c.tbmtype, c.roctype, FLAG_DISABLE_EVENTID_CHECK);
+    dtbEventSplitter splitter;
+    dataSink<rawEvent*> sink;
+    src >> splitter >> sink;
+    src.AddData(c.data);
+    split.clear();
+    split.reserve(c.events);
+    double t0 = now();
+    try { while(true) split.push_back(*sink.Get()); }
+    catch(dsBufferEmpty &) {}
+    best = std::min(best, now() - t0);
+  }
+  report("dtbEventSplitter", c.name, best, c.data.size(), split.size(), 0);
+
+  // Decoding of the split events:
+  best = 1e9;
+  size_t npixels = 0;
+  for(int rep = 0; rep < repetitions; rep++) {
+    rawEventReplay src(split, c);
+    dtbEventDecoder decoder;
+    dataSink<Event*> sink;
+    src >> decoder >> sink;
+    npixels = 0;
+    double t0 = now();
+    try { while(true) npixels += sink.Get()->pixels.size(); }
+    catch(dsBufferEmpty &) {}
+    best = std::min(best, now() - t0);
+  }
+  report("dtbEventDecoder", c.name, best, c.data.size(), split.size(), npixels);
+
+  // Full pipeline as used by the HAL:
+  best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    evtSource src(0, c.nrocs, 0, c.tbmtype, c.roctype, FLAG_DISABLE_EVENTID_CHECK);
+    dtbEventSplitter splitter;
+    dtbEventDecoder decoder;
+    dataSink<Event*> sink;
+    src >> splitter >> decoder >> sink;
+    src.AddData(c.data);
+    double t0 = now();
+    try { while(true) sink.Get(); }
+    catch(dsBufferEmpty &) {}
+    best = std::min(best, now() - t0);
+  }
+  report("splitter+decoder", c.name, best, c.data.size(), split.size(), npixels);
+}
+
+void benchCompression(const corpus &c) {
+
+  std::vector<uint8_t> packed;
+  double best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    packed.clear();
+    double t0 = now();
+    rawCompressor::compress(&c.data[0], c.data.size(), packed);
+    best = std::min(best, now() - t0);
+  }
+  double ratio = static_cast<double>(c.data.size()*sizeof(uint16_t))/packed.size();
+  report("rawCompressor::compress", c.name, best, c.data.size(), c.events, 0, ratio);
+
+  std::vector<uint16_t> unpacked;
+  best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    unpacked.clear();
+    double t0 = now();
+    rawCompressor::decompress(&packed[0], packed.size(), unpacked);
+    best = std::min(best, now() - t0);
+  }
+  report("rawCompressor::decompress", c.name, best, c.data.size(), c.events, 0, ratio);
+  if(unpacked != c.data) std::cerr << "ERROR: decompressed data of " << c.name << " differs from the original!" << std::endl;
+}
+
+void benchPixelDecoding(uint32_t seed) {
+  const size_t n = 1000000;
+  benchRandom rnd(seed);
+  std::vector<uint32_t> raw, linear;
+  std::vector<std::vector<uint16_t> > analog;
+  for(size_t i = 0; i < n; i++) {
+    pixel px(0, static_cast<uint8_t>(rnd.integer(ROC_NUMCOLS)), static_cast<uint8_t>(rnd.integer(ROC_NUMROWS)), static_cast<double>(rnd.integer(256)));
+    raw.push_back(px.encode());
+    linear.push_back(px.encodeLinear());
+  }
+  for(size_t i = 0; i < n/10; i++) {
+    int col = rnd.integer(ROC_NUMCOLS), row = rnd.integer(ROC_NUMROWS);
+    int c0 = col/2, r = 2*(ROC_NUMROWS - row) + (col&1);
+    int digits[5] = { c0/6, c0%6, r/36, (r/6)%6, r%6 };
+    std::vector<uint16_t> levels;
+    for(int d = 0; d < 5; d++) levels.push_back(((digits[d] - 1)*50) & 0x0fff);
+    levels.push_back(rnd.integer(200));
+    analog.push_back(levels);
+  }
+
+  double best = 1e9;
+  uint32_t sum = 0;
+  for(int rep = 0; rep < repetitions; rep++) {
+    double t0 = now();
+    for(size_t i = 0; i < n; i++) sum += pixel(raw[i], 0).column();
+    best = std::min(best, now() - t0);
+  }
+  report("pixel::decodeRaw", "random", best, 2*n, 0, n);
+
+  best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    double t0 = now();
+    for(size_t i = 0; i < n; i++) sum += pixel(linear[i], 0, false, true).column();
+    best = std::min(best, now() - t0);
+  }
+  report("pixel::decodeLinear", "random", best, 2*n, 0, n);
+
+  best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    double t0 = now();
+    for(size_t i = 0; i < analog.size(); i++) sum += pixel(analog[i], 0, -200, 0).column();
+    best = std::min(best, now() - t0);
+  }
+  report("pixel::decodeAnalog", "random", best, 6*analog.size(), 0, analog.size());
+  if(sum == 0) std::cerr << std::endl; // keep the loops from being optimized away
+}
+
+// Calibration-like event data: one event per trigger and pixel (or DAC
+// setting), containing the hit of the pulsed pixel on every ROC
+std::vector<Event> makeScanEvents(uint8_t nrocs, size_t npixels, size_t nsteps, uint16_t ntriggers, bool efficiency, uint32_t seed) {
+  std::vector<Event> data;
+  benchRandom rnd(seed);
+  data.reserve(npixels*nsteps);
+  for(size_t px = 0; px < npixels; px++) {
+    uint8_t col = static_cast<uint8_t>((px/ROC_NUMROWS)%ROC_NUMCOLS), row = static_cast<uint8_t>(px%ROC_NUMROWS);
+    for(size_t step = 0; step < nsteps; step++) {
+      Event evt;
+      for(uint8_t roc = 0; roc < nrocs; roc++) {
+	// Efficiency rising with the DAC setting, s-curve centered on the range:
+	if(efficiency) {
+	  int32_t eff = static_cast<int32_t>(step*ntriggers/nsteps*2) - ntriggers/2 + static_cast<int32_t>(rnd.integer(3)) - 1;
+	  if(eff <= 0) continue;
+	  evt.pixels.push_back(pixel(roc, col, row, static_cast<double>(std::min<int32_t>(eff, ntriggers))));
+	}
+	else evt.pixels.push_back(pixel(roc, col, row, static_cast<double>(80 + rnd.integer(20))));
+      }
+      data.push_back(evt);
+    }
+  }
+  return data;
+}
+
+void benchRepacking(uint32_t seed) {
+  const uint16_t ntriggers = 10;
+  const size_t allpixels = ROC_NUMCOLS*ROC_NUMROWS;
+  double best;
+
+  // Trigger condensing, pulse height and efficiency mode:
+  for(int mode = 0; mode < 2; mode++) {
+    std::vector<Event> input = makeScanEvents(16, allpixels, ntriggers, ntriggers, false, seed);
+    best = 1e9;
+    for(int rep = 0; rep < repetitions; rep++) {
+      std::vector<Event> data = input;
+      double t0 = now();
+      std::vector<Event> out = condenseTriggers(data, ntriggers, mode == 1);
+      best = std::min(best, now() - t0);
+    }
+    report(mode ? "condenseTriggers(eff)" : "condenseTriggers(ph)", "16 ROCs", best, 0, input.size(), 16*input.size());
+  }
+
+  // Map data of a full module:
+  std::vector<Event> input = makeScanEvents(16, allpixels, 1, ntriggers, false, seed);
+  best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    std::vector<Event> data = input;
+    double t0 = now();
+    repackMapData(data, 0);
+    best = std::min(best, now() - t0);
+  }
+  report("repackMapData", "16 ROCs", best, 0, input.size(), 16*input.size());
+
+  // DAC scan of a full module, 32 DAC settings:
+  input = makeScanEvents(16, allpixels, 32, ntriggers, true, seed);
+  best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    std::vector<Event> data = input;
+    double t0 = now();
+    repackDacScanData(data, 8, 0, 248, 0);
+    best = std::min(best, now() - t0);
+  }
+  report("repackDacScanData", "16 ROCs", best, 0, input.size(), 16*input.size());
+
+  // Threshold map of a single ROC, 16 DAC settings:
+  input = makeScanEvents(1, allpixels, 16, ntriggers, true, seed);
+  best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    std::vector<Event> data = input;
+    double t0 = now();
+    repackThresholdMapData(data, 16, 0, 240, 50, ntriggers, FLAG_RISING_EDGE);
+    best = std::min(best, now() - t0);
+  }
+  report("repackThresholdMapData", "1 ROC", best, 0, input.size(), input.size());
+
+  // DAC-DAC scan of one pixel on a full module, 64x64 DAC settings:
+  input = makeScanEvents(16, 1, 64*64, ntriggers, true, seed);
+  best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    std::vector<Event> data = input;
+    double t0 = now();
+    repackDacDacScanData(data, 4, 0, 252, 4, 0, 252, 0);
+    best = std::min(best, now() - t0);
+  }
+  report("repackDacDacScanData", "16 ROCs", best, 0, input.size(), 16*input.size());
+
+  best = 1e9;
+  for(int rep = 0; rep < repetitions; rep++) {
+    std::vector<Event> data = input;
+    double t0 = now();
+    repackThresholdDacScanData(data, 4, 0, 252, 4, 0, 252, 50, ntriggers, FLAG_RISING_EDGE);
+    best = std::min(best, now() - t0);
+  }
+  report("repackThresholdDacScanData", "16 ROCs", best, 0, input.size(), 16*input.size());
+}
+
+void writeJSON(std::ostream &out, uint32_t seed) {
+  out << "{" << std::endl;
+  out << "  \"version\": \"" << PACKAGE_STRING << "\"," << std::endl;
+  out << "  \"seed\": " << seed << "," << std::endl;
+  out << "  \"repetitions\": " << repetitions << "," << std::endl;
+  out << "  \"benchmarks\": [" << std::endl;
+  for(size_t i = 0; i < results.size(); i++) {
+    const result &r = results.at(i);
+    out << std::setprecision(9)
+	<< "    { \"name\": \"" << r.name << "\", \"corpus\": \"" << r.corpus << "\""
+	<< ", \"seconds\": " << r.seconds
+	<< ", \"words\": " << r.words << ", \"events\": " << r.events << ", \"pixels\": " << r.pixels
+	<< ", \"words_per_s\": " << (r.words ? r.words/r.seconds : 0)
+	<< ", \"events_per_s\": " << (r.events ? r.events/r.seconds : 0);
+    if(r.ratio > 0) out << ", \"ratio\": " << r.ratio;
+    out << " }"
+	<< (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  out << "  ]" << std::endl;
+  out << "}" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+
+  std::string filename, filter;
+  uint32_t seed = 42;
+  size_t nevents = 100000;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      std::cout << "Help:" << std::endl;
+      std::cout << "-o filename    write results as JSON to this file, default stdout" << std::endl;
+      std::cout << "-r repetitions repetitions per benchmark, the best is reported (default 5)" << std::endl;
+      std::cout << "-n events      events per raw data corpus (default 100000)" << std::endl;
+      std::cout << "-s seed        seed for the generated corpora (default 42)" << std::endl;
+      std::cout << "-b name        only run benchmarks of this group (decoding, compression, pixel, repacking)" << std::endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-o") && i+1 < argc) { filename = std::string(argv[++i]); }
+    else if (!strcmp(argv[i],"-r") && i+1 < argc) { repetitions = std::max(1, atoi(argv[++i])); }
+    else if (!strcmp(argv[i],"-n") && i+1 < argc) { nevents = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-s") && i+1 < argc) { seed = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-b") && i+1 < argc) { filter = std::string(argv[++i]); }
+  }
+
+  // Decoding and repacking errors are expected to be silent here:
+  Log::ReportingLevel() = Log::FromString("QUIET");
+
+  if(filter.empty() || filter == "decoding" || filter == "compression") {
+    std::vector<corpus> corpora;
+    corpora.push_back(makeAnalogCorpus("ADC PSI46V2", nevents, seed));
+    corpora.push_back(makeDigitalCorpus("DESER160", TBM_NONE, 1, nevents, seed));
+    corpora.push_back(makeDigitalCorpus("SoftTBM", TBM_EMU, 8, nevents, seed));
+    corpora.push_back(makeDigitalCorpus("DESER400 TBM08B", TBM_08B, 8, nevents, seed));
+    corpora.push_back(makeDigitalCorpus("DESER400 TBM09C", TBM_09C, 4, nevents, seed));
+    corpora.push_back(makeDigitalCorpus("DESER400 TBM10C", TBM_10C, 4, nevents, seed));
+    for(size_t i = 0; i < corpora.size(); i++) {
+      if(filter != "compression") benchDecoding(corpora.at(i));
+      if(filter != "decoding") benchCompression(corpora.at(i));
+    }
+  }
+  if(filter.empty() || filter == "pixel") benchPixelDecoding(seed);
+  if(filter.empty() || filter == "repacking") benchRepacking(seed);
+
+  if(filename.empty()) writeJSON(std::cout, seed);
+  else {
+    std::ofstream out(filename.c_str());
+    writeJSON(out, seed);
+    std::cout << "Wrote results to " << filename << std::endl;
+  }
+  return 0;
+}
@@ -6,6 +6,7 @@
 
 #include "pxar.h"
 #include "timer.h"
+#include "rawwriter.h"
 #include <iomanip>
 #include <iostream>
 #include <fstream>
@@ -14,6 +15,7 @@
 #include <cstring>
 #include <cstdio>
 #include <stdlib.h>
+#include <algorithm>
 #include <signal.h>
 
 bool daq_loop = true;
@@ -44,6 +46,17 @@ int getspill() {
    return spillnumber;       
 }
 
+// Moves everything currently in the DTB RAM to the writer:
+size_t readout(pxar::rawWriter * writer) {
+  try {
+    std::vector<uint16_t> daqdat = _api->daqGetBuffer();
+    size_t dropped = writer->write(daqdat);
+    if(dropped > 0) std::cout << "Writer buffers full, dropped " << dropped << " words!" << std::endl;
+    return daqdat.size();
+  }
+  catch(pxar::DataNoEvent &) { return 0; }
+}
+
 int main(int argc, char* argv[]) {
 
   std::cout << argc << " arguments provided." << std::endl;
@@ -52,6 +65,10 @@ int main(int argc, char* argv[]) {
   bool testpulses = false;
   bool spills = false;
   bool oos = false;
+  bool direct = false;
+  bool compress = false;
+  uint32_t buffermb = 64;
+  uint32_t rotatemb = 0;
 
   uint8_t hubid = 31;
 
@@ -65,6 +82,11 @@ int main(int argc, char* argv[]) {
       std::cout << "-sp            lock on accelerator spills" << std::endl;
       std::cout << "-tp            activate test pulses" << std::endl;
       std::cout << "-oos           test OutOfSync problem w/ 100 triggers & 1 token" << std::endl;
+      std::cout << "-b megabytes   memory for buffering data to be written, default 64" << std::endl;
+      std::cout << "-r megabytes   start a new file after this size, default off. Compressed" << std::endl;
+      std::cout << "               files are rotated between 4MB buffers, at least 4MB" << std::endl;
+      std::cout << "-direct        write files bypassing the page cache (O_DIRECT)" << std::endl;
+      std::cout << "-z             write compressed files (.rawz)" << std::endl;
       return 0;
     }
     else if (!strcmp(argv[i],"-f")) {
@@ -93,11 +115,34 @@ int main(int argc, char* argv[]) {
       oos = true;
       continue;
     }
+    else if (!strcmp(argv[i],"-b")) {
+      buffermb = atoi(argv[++i]);
+      continue;
+    }
+    else if (!strcmp(argv[i],"-r")) {
+      rotatemb = atoi(argv[++i]);
+      std::cout << "Starting new files every " << rotatemb << "MB" << std::endl;
+      continue;
+    }
+    else if (!strcmp(argv[i],"-direct")) {
+      direct = true;
+      continue;
+    }
+    else if (!strcmp(argv[i],"-z")) {
+      compress = true;
+      continue;
+    }
     else {
       std::cout << "Unrecognized command line option " << argv[i] << std::endl;
     }
   }
 
+  // Compressed data can only be rotated between the 4MB buffers:
+  if(compress && rotatemb > 0 && rotatemb < 4) {
+    std::cout << "Compressed files can only be rotated every 4MB or more." << std::endl;
+    return 1;
+  }
+
   // Prepare some vectors for all the configurations we use:
   std::vector<std::pair<std::string,uint8_t> > sig_delays;
   std::vector<std::pair<std::string,double> > power_settings;
@@ -204,12 +249,16 @@ int main(int argc, char* argv[]) {
   rocDACs.push_back(dacs);
   rocPixels.push_back(pixels);
 
+  // Data is written in the background from a pool of 4MB buffers:
+  pxar::rawWriter * writer = new pxar::rawWriter(4*1024*1024, std::max<uint32_t>(buffermb/4, 2), direct, static_cast<uint64_t>(rotatemb)*1024*1024, compress);
+
   // Create new API instance:
   try {
     _api = new pxar::pxarCore("*",verbosity != "" ? verbosity : "INFO");
   
     // Initialize the testboard:
     if(!_api->initTestboard(sig_delays, power_settings, pg_setup)) {
+      delete writer;
       delete _api;
       return -1;
     }
@@ -217,6 +266,7 @@ int main(int argc, char* argv[]) {
     // Initialize the DUT (power it up and stuff):
     if (!_api->initDUT(hubid,"tbm08",tbmDACs,roctype,rocDACs,rocPixels)){
       std::cout << " initDUT failed -> invalid configuration?! " << std::endl;
+      delete writer;
       delete _api;
       return -2;
     }
@@ -288,6 +338,17 @@ int main(int argc, char* argv[]) {
 	std::cout << std::endl << "Data acquisition for spill " << getspill() << " started." << std::endl;
       }
 
+      // If we are running on spills just take that number as filename:
+      if(spills) {
+	std::stringstream sstr;
+	sstr << oldspillnumber;
+	filename = "tbdata/spill_" + sstr.str() + (compress ? ".rawz" : ".dat");
+      }
+      if(filename == "") { filename = (compress ? "defaultdata.rawz" : "defaultdata.dat"); }
+      std::cout << "Writing data to file " << filename << std::endl;
+      writer->open(filename);
+      size_t words = 0;
+
       // Start the DAQ:
       _api->daqStart();
 
@@ -311,35 +372,33 @@ int main(int argc, char* argv[]) {
 	    }
           }
           wait(1);
+	  words += readout(writer);
 	}
       }
     
       // Stop the DAQ:
       _api->daqStop();
 
-      // And read out the full buffer:
+      // And read out the rest of the buffer:
       std::cout << "Start reading data from DTB RAM." << std::endl;
-      std::vector<uint16_t> daqdat = _api->daqGetBuffer();
-      std::cout << "Read " << daqdat.size() << " words of data: ";
-      if(daqdat.size() > 550000) std::cout << (daqdat.size()/524288) << "MB." << std::endl;
-      else std::cout << (daqdat.size()/512) << "kB." << std::endl;
-
-      // If we are running on spills just take that number as filename:
-      if(spills) {
-	std::stringstream sstr;
-	sstr << (getspill()-1);
-	filename = "tbdata/spill_" + sstr.str() + ".dat";
-      }
-
-      // Write all the data to the file:
-      if(filename == "") { filename = "defaultdata.dat"; }
-      std::ofstream fout(filename.c_str(), std::ios::out | std::ios::binary);
-      fout.write(reinterpret_cast<const char*>(&daqdat[0]), sizeof(daqdat[0])*daqdat.size());
-      fout.close();
-      std::cout << "Wrote data to file " << filename << std::endl;
+      words += readout(writer);
+      std::cout << "Read " << words << " words of data: ";
+      if(words > 550000) std::cout << (words/524288) << "MB." << std::endl;
+      else std::cout << (words/512) << "kB." << std::endl;
 
     } // End of DAQ loop
 
+    // Wait for all data to be on disk:
+    writer->close();
+    std::cout << "Wrote " << writer->wordsWritten() << " words of data to " << writer->filesWritten() << " file(s)";
+    if(compress) std::cout << ", compressed to " << writer->bytesWritten() << " bytes";
+    std::cout << "." << std::endl;
+    if(writer->wordsDropped() > 0 || writer->error()) {
+      std::cout << "WARNING: " << writer->wordsDropped() << " words of data could not be written!" << std::endl;
+    }
+    delete writer;
+    writer = NULL;
+
     delete spillruntime;
     _api->HVoff();
 
@@ -349,6 +408,7 @@ int main(int argc, char* argv[]) {
   }
   catch (...) {
     std::cout << "pxar takedata mode caught an exception. Exiting." << std::endl;
+    delete writer;
     delete _api;
     return -1;
   }
@@ -0,0 +1,147 @@
+/* Decodes raw DTB data files written by pxardaq on several threads. The
+   event index of a file is built in one pass on first use and stored next
+   to it, so re-decoding the same data with other decoder settings only
+   costs the (parallel) decoding. Compressed files (pxardaq -z) are
+   decoded sequentially, straight from the file. */
+
+#include "rawindex.h"
+#include "rawfiledecoder.h"
+#include "rawcompression.h"
+#include "datasource_rawz.h"
+#include "datapipe.h"
+#include "dictionaries.h"
+#include "constants.h"
+#include "timer.h"
+#include "log.h"
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <stdlib.h>
+
+using namespace pxar;
+
+namespace {
+
+  bool isCompressed(std::string filename) {
+    char magic[RAWZ_MAGIC_SIZE];
+    FILE * file = fopen(filename.c_str(), "rb");
+    if(!file) return false;
+    bool compressed = (fread(magic, 1, RAWZ_MAGIC_SIZE, file) == RAWZ_MAGIC_SIZE && memcmp(magic, RAWZ_MAGIC, RAWZ_MAGIC_SIZE) == 0);
+    fclose(file);
+    return compressed;
+  }
+
+  // Decodes a compressed file through the usual splitter and decoder:
+  int decodeCompressed(std::string filename, uint8_t nrocs, uint8_t tbmtype, uint8_t roctype) {
+    rawzSource src(filename, 0, nrocs, 0, tbmtype, roctype);
+    if(!src.isConnected()) return -1;
+    dtbEventSplitter splitter;
+    dtbEventDecoder decoder;
+    dataSink<Event*> pump;
+    src >> splitter >> decoder >> pump;
+
+    timer t;
+    uint64_t events = 0, pixels = 0;
+    try {
+      while(true) {
+	Event * evt = pump.Get();
+	events++;
+	pixels += evt->pixels.size();
+      }
+    }
+    catch(dsBufferEmpty &) {}
+    catch(dataPipeException &e) { LOG(logERROR) << e.what(); }
+
+    std::cout << "Decoded " << events << " events with " << pixels << " pixels from compressed file in "
+	      << t.get() << "ms." << std::endl;
+    decoder.getStatistics().dump();
+    return 0;
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  std::string filename, verbosity = "INFO";
+  std::string tbmname = "notbm", rocname = "psi46digv21";
+  uint32_t nrocs = 1;
+  uint32_t nthreads = 4;
+  bool reindex = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      std::cout << "Help:" << std::endl;
+      std::cout << "-f filename    raw data file to decode" << std::endl;
+      std::cout << "-t tbmtype     TBM type the data was taken with, default notbm" << std::endl;
+      std::cout << "-r roctype     ROC type the data was taken with, default psi46digv21" << std::endl;
+      std::cout << "-n rocs        number of ROCs in the token chain, default 1" << std::endl;
+      std::cout << "-j threads     number of decoding threads, default 4. Analog data is only" << std::endl;
+      std::cout << "               split by DAQ channel, to keep the same black levels as -j 1." << std::endl;
+      std::cout << "               Compressed files (.rawz) are always decoded on one thread" << std::endl;
+      std::cout << "-i             rebuild the event index even if one exists" << std::endl;
+      std::cout << "-v verbosity   verbosity level, default INFO" << std::endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-f") && i+1 < argc) { filename = argv[++i]; }
+    else if (!strcmp(argv[i],"-t") && i+1 < argc) { tbmname = argv[++i]; }
+    else if (!strcmp(argv[i],"-r") && i+1 < argc) { rocname = argv[++i]; }
+    else if (!strcmp(argv[i],"-n") && i+1 < argc) { nrocs = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-j") && i+1 < argc) { nthreads = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-i")) { reindex = true; }
+    else if (!strcmp(argv[i],"-v") && i+1 < argc) { verbosity = argv[++i]; }
+    else {
+      std::cout << "Unrecognized command line option " << argv[i] << std::endl;
+    }
+  }
+  Log::ReportingLevel() = Log::FromString(verbosity);
+
+  if(filename.empty()) {
+    std::cout << "No raw data file given (-f)." << std::endl;
+    return -1;
+  }
+
+  uint8_t tbmtype = DeviceDictionary::getInstance()->getDevCode(tbmname);
+  uint8_t roctype = DeviceDictionary::getInstance()->getDevCode(rocname);
+  if(tbmtype < TBM_NONE) {
+    std::cout << "Unknown TBM type " << tbmname << std::endl;
+    return -1;
+  }
+  if(roctype == ROC_NONE || roctype >= TBM_NONE) {
+    std::cout << "Unknown ROC type " << rocname << std::endl;
+    return -1;
+  }
+
+  if(isCompressed(filename)) { return decodeCompressed(filename, nrocs, tbmtype, roctype); }
+
+  rawFileDecoder file(filename);
+  if(!file.isOpen()) return -1;
+
+  // Use the stored index if it matches the file and readout:
+  rawIndex index;
+  std::string indexname = rawIndex::indexFile(filename);
+  if(reindex || !index.read(indexname) || index.words() != file.words() || index.envelopeType() != tbmtype) {
+    timer t;
+    index = rawIndex(tbmtype);
+    index.add(file.data(), file.words());
+    index.finish();
+    std::cout << "Indexed " << index.events() << " events in " << t.get() << "ms";
+    if(index.write(indexname)) std::cout << ", index stored in " << indexname;
+    std::cout << "." << std::endl;
+  }
+  else {
+    std::cout << "Using index " << indexname << " with " << index.events() << " events." << std::endl;
+  }
+
+  file.setChannel(0, nrocs, 0, roctype);
+  timer t;
+  statistics stats = file.decode(index, nthreads);
+  uint64_t us = t.getMicroseconds();
+
+  std::cout << "Decoded " << file.eventsDecoded() << " events with " << file.pixelsDecoded() << " pixels in "
+	    << (us/1000) << "ms on " << nthreads << " threads";
+  if(us > 0) std::cout << ", " << std::fixed << std::setprecision(2) << (static_cast<double>(index.words())/us) << " Mwords/s";
+  std::cout << "." << std::endl;
+  stats.dump();
+  return 0;
+}
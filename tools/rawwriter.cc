@@ -0,0 +1,319 @@
+#include "rawwriter.h"
+#include "rawcompression.h"
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <algorithm>
+#include <fcntl.h>
+#ifndef WIN32
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#ifndef O_BINARY
+#define O_BINARY 0
+#endif
+
+// Alignment of buffers, file offsets and sizes required for O_DIRECT:
+#define RAWWRITER_ALIGNMENT 4096
+
+namespace pxar {
+
+  rawWriter::rawWriter(size_t buffersize, size_t nbuffers, bool direct, uint64_t rotate, bool compress) :
+    m_buffersize(((buffersize + RAWWRITER_ALIGNMENT - 1)/RAWWRITER_ALIGNMENT)*RAWWRITER_ALIGNMENT),
+    m_direct(direct && !compress),
+    // Raw files are split at the limit, which is kept aligned for O_DIRECT:
+    m_rotate(((rotate + RAWWRITER_ALIGNMENT - 1)/RAWWRITER_ALIGNMENT)*RAWWRITER_ALIGNMENT),
+    m_compress(compress),
+    m_packed(),
+    m_queue(),
+    m_free(),
+    m_pool(),
+    m_fd(-1),
+    m_cached(false),
+    m_filename(),
+    m_index(0),
+    m_filesize(0),
+    m_written(0),
+    m_words(0),
+    m_dropped(0),
+    m_files(0),
+    m_error(false),
+    m_stop(false),
+    m_busy(false) {
+
+    m_current.data = NULL;
+    m_current.size = 0;
+
+    for(size_t i = 0; i < (nbuffers > 0 ? nbuffers : 1); i++) {
+      void * mem = NULL;
+#ifndef WIN32
+      if(posix_memalign(&mem, RAWWRITER_ALIGNMENT, m_buffersize) != 0) mem = NULL;
+#else
+      mem = malloc(m_buffersize);
+#endif
+      if(!mem) break;
+      m_pool.push_back(reinterpret_cast<char*>(mem));
+    }
+    m_free = m_pool;
+
+#ifndef WIN32
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_cond, NULL);
+    pthread_create(&m_thread, NULL, &rawWriter::run, this);
+#endif
+  }
+
+  rawWriter::~rawWriter() {
+    close();
+#ifndef WIN32
+    pthread_mutex_lock(&m_mutex);
+    m_stop = true;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+    pthread_join(m_thread, NULL);
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_mutex);
+#endif
+    for(size_t i = 0; i < m_pool.size(); i++) free(m_pool.at(i));
+  }
+
+  void rawWriter::open(std::string filename) {
+    // Hand over the data of the previous file first:
+    if(m_current.data) { enqueue(m_current); m_current.data = NULL; }
+    block cmd;
+    cmd.data = NULL;
+    cmd.size = 0;
+    cmd.filename = filename;
+    enqueue(cmd);
+  }
+
+  size_t rawWriter::write(const std::vector<uint16_t> &data) {
+    const char * src = reinterpret_cast<const char*>(data.empty() ? NULL : &data[0]);
+    size_t left = data.size()*sizeof(uint16_t);
+
+    while(left > 0) {
+      if(!m_current.data) {
+	// Take a free buffer, drop the rest of the data if there is none:
+#ifndef WIN32
+	pthread_mutex_lock(&m_mutex);
+#endif
+	if(!m_free.empty()) {
+	  m_current.data = m_free.back();
+	  m_current.size = 0;
+	  m_free.pop_back();
+	}
+	else m_dropped += left/sizeof(uint16_t);
+#ifndef WIN32
+	pthread_mutex_unlock(&m_mutex);
+#endif
+	if(!m_current.data) return left/sizeof(uint16_t);
+      }
+
+      size_t n = std::min(left, m_buffersize - m_current.size);
+      memcpy(m_current.data + m_current.size, src, n);
+      m_current.size += n;
+      src += n;
+      left -= n;
+      if(m_current.size == m_buffersize) { enqueue(m_current); m_current.data = NULL; }
+    }
+    return 0;
+  }
+
+  void rawWriter::close() {
+    if(m_current.data) { enqueue(m_current); m_current.data = NULL; }
+    block cmd;
+    cmd.data = NULL;
+    cmd.size = 0;
+    enqueue(cmd);
+
+#ifndef WIN32
+    // Wait for the writer thread to finish everything queued:
+    pthread_mutex_lock(&m_mutex);
+    while(!m_queue.empty() || m_busy) pthread_cond_wait(&m_cond, &m_mutex);
+    pthread_mutex_unlock(&m_mutex);
+#endif
+  }
+
+  void rawWriter::enqueue(block b) {
+#ifndef WIN32
+    pthread_mutex_lock(&m_mutex);
+    m_queue.push_back(b);
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+#else
+    // Without threads the data is written right away:
+    process(b);
+    if(b.data) m_free.push_back(b.data);
+#endif
+  }
+
+#ifndef WIN32
+  void * rawWriter::run(void * arg) {
+    rawWriter * w = reinterpret_cast<rawWriter*>(arg);
+    pthread_mutex_lock(&w->m_mutex);
+    while(true) {
+      while(w->m_queue.empty() && !w->m_stop) pthread_cond_wait(&w->m_cond, &w->m_mutex);
+      if(w->m_queue.empty()) break;
+      block b = w->m_queue.front();
+      w->m_queue.pop_front();
+      w->m_busy = true;
+
+      // The disk is only accessed without holding the lock:
+      pthread_mutex_unlock(&w->m_mutex);
+      w->process(b);
+      pthread_mutex_lock(&w->m_mutex);
+
+      if(b.data) w->m_free.push_back(b.data);
+      w->m_busy = false;
+      pthread_cond_broadcast(&w->m_cond);
+    }
+    pthread_mutex_unlock(&w->m_mutex);
+    return NULL;
+  }
+#endif
+
+  void rawWriter::process(block &b) {
+    if(b.data) {
+      const char * data = b.data;
+      size_t size = b.size;
+      if(m_compress) {
+	m_packed.clear();
+	rawCompressor::compress(reinterpret_cast<const uint16_t*>(b.data), b.size/sizeof(uint16_t), m_packed);
+	data = reinterpret_cast<const char*>(&m_packed[0]);
+	size = m_packed.size();
+      }
+      size_t written = writeFile(data, size);
+      if(written == size) m_words += b.size/sizeof(uint16_t);
+      else {
+	// Raw data written to the previous file before a failed rotation is
+	// kept, compressed blocks are never split between files:
+	size_t kept = (m_compress ? 0 : written);
+	m_words += kept/sizeof(uint16_t);
+	drop(b.size - kept);
+      }
+    }
+    else if(b.filename.empty()) closeFile();
+    else {
+      m_filename = b.filename;
+      m_index = 0;
+      openFile(m_filename);
+    }
+  }
+
+  void rawWriter::openFile(std::string filename) {
+    closeFile();
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_BINARY;
+#ifdef O_DIRECT
+    if(m_direct) {
+      m_fd = ::open(filename.c_str(), flags | O_DIRECT, 0644);
+      // Not all file systems support direct access:
+      if(m_fd < 0 && errno == EINVAL) {
+	std::cerr << "Direct I/O not supported for " << filename << ", using buffered writes." << std::endl;
+	m_direct = false;
+      }
+    }
+#endif
+    if(m_fd < 0) m_fd = ::open(filename.c_str(), flags, 0644);
+    m_cached = false;
+
+    if(m_fd < 0) {
+      std::cerr << "Could not open " << filename << ": " << strerror(errno) << std::endl;
+      m_error = true;
+      return;
+    }
+    m_filesize = 0;
+    m_files++;
+
+    // Every compressed file can be read on its own:
+    if(m_compress) writeFile(RAWZ_MAGIC, RAWZ_MAGIC_SIZE);
+  }
+
+  void rawWriter::drop(size_t size) {
+#ifndef WIN32
+    pthread_mutex_lock(&m_mutex);
+#endif
+    m_dropped += size/sizeof(uint16_t);
+#ifndef WIN32
+    pthread_mutex_unlock(&m_mutex);
+#endif
+  }
+
+  void rawWriter::closeFile() {
+    if(m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+  }
+
+  void rawWriter::nextFile() {
+    std::ostringstream name;
+    size_t dot = m_filename.find_last_of('.');
+    size_t slash = m_filename.find_last_of("/\\");
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = m_filename.size();
+    name << m_filename.substr(0, dot) << "_" << (++m_index) << m_filename.substr(dot);
+    openFile(name.str());
+  }
+
+  size_t rawWriter::writeFile(const char * data, size_t size) {
+
+    // Continue in the next file if this one is full. Raw data is split at
+    // the limit, compressed data can only be rotated between buffers:
+    size_t written = 0;
+    while(m_fd >= 0 && m_rotate > 0 && m_filesize + size > m_rotate) {
+      if(!m_compress) {
+	size_t room = m_rotate - m_filesize;
+	if(!writeData(data, room)) return written;
+	data += room;
+	size -= room;
+	written += room;
+      }
+      else if(m_filesize <= RAWZ_MAGIC_SIZE) break;
+      nextFile();
+    }
+    if(!writeData(data, size)) return written;
+    return written + size;
+  }
+
+  bool rawWriter::writeData(const char * data, size_t size) {
+
+    if(m_fd < 0) return false;
+
+#ifdef O_DIRECT
+    // Direct writes need aligned sizes and file offsets. The unaligned rest
+    // of a block is written through the page cache, direct access is taken
+    // up again once the file offset is aligned:
+    if(m_direct && m_cached && m_filesize%RAWWRITER_ALIGNMENT == 0) {
+      fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_DIRECT);
+      m_cached = false;
+    }
+    if(m_direct && !m_cached && size%RAWWRITER_ALIGNMENT != 0) {
+      size_t aligned = size - size%RAWWRITER_ALIGNMENT;
+      if(!writeData(data, aligned)) return false;
+      fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+      m_cached = true;
+      data += aligned;
+      size -= aligned;
+    }
+#endif
+
+    while(size > 0) {
+      long n = ::write(m_fd, data, size);
+      if(n < 0 && errno == EINTR) continue;
+      if(n <= 0) {
+	std::cerr << "Could not write to " << m_filename << ": " << strerror(errno) << std::endl;
+	m_error = true;
+	closeFile();
+	return false;
+      }
+      data += n;
+      size -= n;
+      m_filesize += n;
+      m_written += n;
+    }
+    return true;
+  }
+
+}
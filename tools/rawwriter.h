@@ -0,0 +1,113 @@
+/* Streaming writer for raw DTB data: incoming words are copied into a
+   fixed pool of buffers which a background thread writes to disk. The
+   caller never waits on the disk, if the pool is exhausted the data is
+   dropped and counted instead. Files can be rotated by size or switched
+   explicitly, e.g. once per spill. Optionally the writer thread compresses
+   the data (see rawcompression.h) before writing it. */
+
+#ifndef PXAR_RAWWRITER_H
+#define PXAR_RAWWRITER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#ifndef WIN32
+#include <pthread.h>
+#endif
+
+namespace pxar {
+
+  class rawWriter {
+  public:
+    /** Sets up the buffer pool of nbuffers buffers of buffersize bytes,
+     *  direct selects O_DIRECT file access where available and rotate
+     *  starts a new file after that many bytes (0: never), rounded up to
+     *  4kB. Raw data is split exactly at this size. Compressed files are
+     *  only rotated between buffers, a file holds at least one compressed
+     *  buffer and can only exceed the size if that one does. Compressed
+     *  files are always written through the page cache.
+     */
+    rawWriter(size_t buffersize = 4*1024*1024, size_t nbuffers = 16, bool direct = false, uint64_t rotate = 0, bool compress = false);
+    ~rawWriter();
+
+    /** Starts writing to a new file once all data so far is written
+     */
+    void open(std::string filename);
+
+    /** Queues the data for writing, returns the number of words dropped
+     *  because no free buffer was available
+     */
+    size_t write(const std::vector<uint16_t> &data);
+
+    /** Writes all pending data and closes the file, waiting for the disk
+     */
+    void close();
+
+    uint64_t wordsWritten() { return m_words; }
+    uint64_t bytesWritten() { return m_written; }
+    uint64_t wordsDropped() { return m_dropped; }
+    uint32_t filesWritten() { return m_files; }
+    bool error() { return m_error; }
+
+  private:
+    /** A pool buffer, or a command to the writer thread if data is NULL
+     */
+    struct block {
+      char * data;
+      size_t size;
+      std::string filename;
+    };
+
+    size_t m_buffersize;
+    bool m_direct;
+    uint64_t m_rotate;
+    bool m_compress;
+    std::vector<uint8_t> m_packed;
+
+    // Buffer currently filled by the caller:
+    block m_current;
+
+    // Blocks queued for the writer thread and the free buffers:
+    std::deque<block> m_queue;
+    std::vector<char*> m_free;
+    std::vector<char*> m_pool;
+
+    // Writer thread state:
+    int m_fd;
+    // O_DIRECT has been cleared on m_fd to write an unaligned block:
+    bool m_cached;
+    std::string m_filename;
+    uint32_t m_index;
+    uint64_t m_filesize;
+
+    uint64_t m_written;
+    uint64_t m_words;
+    uint64_t m_dropped;
+    uint32_t m_files;
+    bool m_error;
+    bool m_stop;
+    bool m_busy;
+
+    void enqueue(block b);
+    void process(block &b);
+    void openFile(std::string filename);
+    void closeFile();
+    void nextFile();
+    size_t writeFile(const char * data, size_t size);
+    bool writeData(const char * data, size_t size);
+    void drop(size_t size);
+
+#ifndef WIN32
+    pthread_t m_thread;
+    pthread_mutex_t m_mutex;
+    pthread_cond_t m_cond;
+    static void * run(void * arg);
+#endif
+
+    rawWriter(const rawWriter&);
+    rawWriter& operator=(const rawWriter&);
+  };
+
+}
+#endif // PXAR_RAWWRITER_H
@@ -0,0 +1,341 @@
+/* pxar_scanbench: end-to-end benchmark of the pxarCore test functions
+   against the DTB emulator. Every test runs through the public API with a
+   fixed DUT setup, the wall time is split into the phases reported by
+   pxarCore::getTiming() and the growth of the resident memory during the
+   test is recorded.
+   The emulator timing and hit generation can be tuned via the
+   PXAR_EMULATOR_TIMING and PXAR_EMULATOR_GENERATOR environment variables. */
+
+#include "api.h"
+#include "timer.h"
+#include "log.h"
+#include "config.h"
+#include "rsstools.hh"
+#include <iomanip>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <stdlib.h>
+
+using namespace pxar;
+
+struct result {
+  std::string name;
+  std::string dut;
+  uint64_t wall;
+  timingStatistics timing;
+  size_t rss;
+  bool cumulative;
+  size_t pixels;
+};
+
+std::vector<result> results;
+
+// Memory use of a single test: on Linux the high-water mark of the resident
+// set is reset when the probe is created, and the growth of the peak over the
+// resident set at that time is reported. Where the mark cannot be reset, the
+// peak of the whole process is reported instead and flagged as cumulative.
+class memoryProbe {
+  size_t m_base;
+  bool m_reset;
+
+  // Peak resident set in bytes since the last reset:
+  size_t peak() {
+    FILE * status = fopen("/proc/self/status", "r");
+    if(status) {
+      char line[128];
+      unsigned long kb;
+      while(fgets(line, sizeof(line), status)) {
+	if(sscanf(line, "VmHWM: %lu kB", &kb) == 1) {
+	  fclose(status);
+	  return kb*1024;
+	}
+      }
+      fclose(status);
+    }
+    rsstools rss;
+    return rss.getPeakRSS();
+  }
+
+public:
+  memoryProbe() : m_base(0), m_reset(false) {
+    FILE * refs = fopen("/proc/self/clear_refs", "w");
+    if(refs) {
+      m_reset = (fputs("5", refs) >= 0);
+      m_reset = (fclose(refs) == 0) && m_reset;
+    }
+    rsstools rss;
+    m_base = rss.getCurrentRSS();
+  }
+
+  bool cumulative() { return !m_reset; }
+
+  size_t get() {
+    if(!m_reset) return peak();
+    size_t p = peak();
+    return p > m_base ? p - m_base : 0;
+  }
+};
+
+void report(std::string name, std::string dut, uint64_t wall, timingStatistics timing, memoryProbe &m, size_t pixels) {
+  result r;
+  r.name = name; r.dut = dut; r.wall = wall; r.timing = timing;
+  r.rss = m.get(); r.cumulative = m.cumulative(); r.pixels = pixels;
+  results.push_back(r);
+  std::cerr << std::left << std::setw(24) << name << std::setw(14) << dut << std::right << std::fixed << std::setprecision(1)
+	    << std::setw(9) << wall/1e3 << " ms  program" << std::setw(9) << timing.program()/1e3
+	    << "  loop" << std::setw(9) << timing.loop()/1e3
+	    << "  readout" << std::setw(9) << timing.readout()/1e3
+	    << "  decode" << std::setw(9) << timing.decode()/1e3
+	    << "  condense" << std::setw(8) << timing.condense()/1e3
+	    << "  repack" << std::setw(8) << timing.repack()/1e3
+	    << (r.cumulative ? "  peak RSS (cumulative)" : "  RSS +") << std::setw(7) << r.rss/1048576.0 << " MB" << std::endl;
+}
+
+// Set up the API with n psi46digv2 ROCs, read out directly or via a TBM08.
+// With TBM the ROCs are split over the token chains of both cores, the
+// first core takes the odd one:
+pxarCore * setupDUT(size_t nrocs, bool tbm) {
+
+  std::vector<std::pair<std::string,uint8_t> > sig_delays;
+  sig_delays.push_back(std::make_pair("clk",2));
+  sig_delays.push_back(std::make_pair("ctr",2));
+  sig_delays.push_back(std::make_pair("sda",17));
+  sig_delays.push_back(std::make_pair("tin",7));
+  sig_delays.push_back(std::make_pair("deser160phase",4));
+
+  std::vector<std::pair<std::string,double> > power_settings;
+  power_settings.push_back(std::make_pair("va",1.9));
+  power_settings.push_back(std::make_pair("vd",2.6));
+  power_settings.push_back(std::make_pair("ia",1.190));
+  power_settings.push_back(std::make_pair("id",1.10));
+
+  // Without TBM registers the DUT is read out directly:
+  std::vector<std::pair<std::string,uint8_t> > pg_setup;
+  std::vector<std::vector<std::pair<std::string,uint8_t> > > tbmDACs;
+  if(tbm) {
+    pg_setup.push_back(std::make_pair("resettbm",15));
+    pg_setup.push_back(std::make_pair("calibrate",106));
+    pg_setup.push_back(std::make_pair("trigger;sync",0));
+
+    std::vector<std::pair<std::string,uint8_t> > regs;
+    regs.push_back(std::make_pair("clear",0xF0));
+    regs.push_back(std::make_pair("counters",0x01));
+    regs.push_back(std::make_pair("mode",0xC0));
+    regs.push_back(std::make_pair("pkam_set",0x10));
+    regs.push_back(std::make_pair("delays",0x00));
+    regs.push_back(std::make_pair("temperature",0x00));
+    tbmDACs.push_back(regs);
+    tbmDACs.push_back(regs);
+    tbmDACs.at(0).push_back(std::make_pair("nrocs",static_cast<uint8_t>((nrocs + 1)/2)));
+    tbmDACs.at(1).push_back(std::make_pair("nrocs",static_cast<uint8_t>(nrocs/2)));
+  }
+  else {
+    pg_setup.push_back(std::make_pair("resetroc",25));
+    pg_setup.push_back(std::make_pair("calibrate",106));
+    pg_setup.push_back(std::make_pair("trigger",16));
+    pg_setup.push_back(std::make_pair("token;sync",0));
+  }
+
+  std::vector<std::pair<std::string,uint8_t> > dacs;
+  dacs.push_back(std::make_pair("Vdig",8));
+  dacs.push_back(std::make_pair("Vana",120));
+  dacs.push_back(std::make_pair("Vsf",40));
+  dacs.push_back(std::make_pair("Vcomp",12));
+  dacs.push_back(std::make_pair("VwllPr",30));
+  dacs.push_back(std::make_pair("VwllSh",30));
+  dacs.push_back(std::make_pair("VhldDel",117));
+  dacs.push_back(std::make_pair("Vtrim",1));
+  dacs.push_back(std::make_pair("VthrComp",40));
+  dacs.push_back(std::make_pair("VIBias_Bus",30));
+  dacs.push_back(std::make_pair("Vbias_sf",6));
+  dacs.push_back(std::make_pair("VoffsetOp",60));
+  dacs.push_back(std::make_pair("VOffsetRO",150));
+  dacs.push_back(std::make_pair("VIon",45));
+  dacs.push_back(std::make_pair("Vcomp_ADC",50));
+  dacs.push_back(std::make_pair("VIref_ADC",70));
+  dacs.push_back(std::make_pair("VIbias_roc",150));
+  dacs.push_back(std::make_pair("VIColOr",99));
+  dacs.push_back(std::make_pair("Vcal",220));
+  dacs.push_back(std::make_pair("CalDel",122));
+  dacs.push_back(std::make_pair("CtrlReg",4));
+  dacs.push_back(std::make_pair("WBC",100));
+
+  std::vector<pixelConfig> pixels;
+  for(uint8_t col = 0; col < 52; col++) {
+    for(uint8_t row = 0; row < 80; row++) { pixels.push_back(pixelConfig(col,row,15)); }
+  }
+
+  std::vector<std::vector<std::pair<std::string,uint8_t> > > rocDACs(nrocs, dacs);
+  std::vector<std::vector<pixelConfig> > rocPixels(nrocs, pixels);
+
+  pxarCore * api = new pxarCore("*", "QUIET");
+  if(!api->initTestboard(sig_delays, power_settings, pg_setup)
+     || !api->initDUT(31, "tbm08", tbmDACs, "psi46digv2", rocDACs, rocPixels)) {
+    delete api;
+    return NULL;
+  }
+  api->HVon();
+  return api;
+}
+
+// Number of pixels in the results of the different test functions:
+size_t count(const std::vector<pixel> &data) { return data.size(); }
+template <typename T> size_t count(const std::pair<uint8_t, T> &data) { return count(data.second); }
+template <typename T> size_t count(const std::vector<std::pair<uint8_t, T> > &data) {
+  size_t n = 0;
+  for(size_t i = 0; i < data.size(); i++) n += count(data.at(i));
+  return n;
+}
+size_t count(const std::vector<Event> &data) {
+  size_t n = 0;
+  for(size_t i = 0; i < data.size(); i++) n += data.at(i).pixels.size();
+  return n;
+}
+
+// Records the result of a test if it returned pixels and the data was decoded
+// without errors, a broken setup would otherwise show up as a fast one:
+bool finish(pxarCore * api, std::string name, std::string dut, timer &t, memoryProbe &m, size_t pixels) {
+  uint64_t wall = t.getMicroseconds();
+  timingStatistics timing = api->getTiming();
+  statistics errors = api->getStatistics();
+  if(pixels == 0 || errors.errors() > 0) {
+    std::cerr << name << " " << dut << " failed: " << pixels << " pixels, "
+	      << errors.errors() << " decoding errors." << std::endl;
+    return false;
+  }
+  report(name, dut, wall, timing, m, pixels);
+  return true;
+}
+
+bool benchDUT(size_t nrocs, bool tbm, uint16_t nTriggers, uint32_t daqTriggers, std::string filter) {
+
+  std::ostringstream name;
+  name << nrocs << (nrocs > 1 ? " ROCs" : " ROC") << (tbm ? " TBM" : "");
+  pxarCore * api = setupDUT(nrocs, tbm);
+  if(!api) {
+    std::cerr << "Could not set up " << name.str() << "." << std::endl;
+    return false;
+  }
+  api->_dut->testAllPixels(true);
+  api->_dut->maskAllPixels(false);
+  api->getTiming();
+  api->getStatistics();
+
+  // The remaining tests of a configuration are skipped after a failure:
+  bool ok = true;
+  if(ok && (filter.empty() || filter == "getEfficiencyMap")) {
+    memoryProbe m;
+    timer t;
+    size_t n = count(api->getEfficiencyMap(0, nTriggers));
+    ok = finish(api, "getEfficiencyMap", name.str(), t, m, n);
+  }
+  if(ok && (filter.empty() || filter == "getPulseheightVsDAC")) {
+    memoryProbe m;
+    timer t;
+    size_t n = count(api->getPulseheightVsDAC("vcal", 5, 0, 255, 0, nTriggers));
+    ok = finish(api, "getPulseheightVsDAC", name.str(), t, m, n);
+  }
+  if(ok && (filter.empty() || filter == "getThresholdMap")) {
+    memoryProbe m;
+    timer t;
+    size_t n = count(api->getThresholdMap("vcal", 5, 0, 255, 0, nTriggers));
+    ok = finish(api, "getThresholdMap", name.str(), t, m, n);
+  }
+  if(ok && (filter.empty() || filter == "getEfficiencyVsDACDAC")) {
+    // A single pixel per ROC, as the DAC-DAC scans are run in practice:
+    api->_dut->testAllPixels(false);
+    api->_dut->maskAllPixels(true);
+    api->_dut->testPixel(12, 34, true);
+    api->_dut->maskPixel(12, 34, false);
+    memoryProbe m;
+    timer t;
+    size_t n = count(api->getEfficiencyVsDACDAC("caldel", 5, 0, 255, "vthrcomp", 5, 0, 255, 0, nTriggers));
+    ok = finish(api, "getEfficiencyVsDACDAC", name.str(), t, m, n);
+    api->_dut->testAllPixels(true);
+    api->_dut->maskAllPixels(false);
+  }
+  if(ok && (filter.empty() || filter == "daqGetEventBuffer")) {
+    memoryProbe m;
+    timer t;
+    api->daqStart();
+    api->daqTrigger(daqTriggers, 1000);
+    size_t n = 0;
+    try { n = count(api->daqGetEventBuffer()); }
+    catch(DataNoEvent &) {}
+    api->daqStop();
+    ok = finish(api, "daqGetEventBuffer", name.str(), t, m, n);
+  }
+
+  delete api;
+  return ok;
+}
+
+void writeJSON(std::ostream &out, uint16_t nTriggers, uint32_t daqTriggers) {
+  out << "{" << std::endl;
+  out << "  \"version\": \"" << PACKAGE_STRING << "\"," << std::endl;
+  out << "  \"triggers\": " << nTriggers << "," << std::endl;
+  out << "  \"daq_triggers\": " << daqTriggers << "," << std::endl;
+  out << "  \"benchmarks\": [" << std::endl;
+  for(size_t i = 0; i < results.size(); i++) {
+    result r = results.at(i);
+    out << "    { \"name\": \"" << r.name << "\", \"dut\": \"" << r.dut << "\""
+	<< ", \"wall_us\": " << r.wall << ", \"program_us\": " << r.timing.program()
+	<< ", \"loop_us\": " << r.timing.loop() << ", \"readout_us\": " << r.timing.readout()
+	<< ", \"decode_us\": " << r.timing.decode() << ", \"condense_us\": " << r.timing.condense()
+	<< ", \"repack_us\": " << r.timing.repack()
+	<< (r.cumulative ? ", \"peak_rss_cumulative\": " : ", \"rss_delta\": ") << r.rss << ", \"pixels\": " << r.pixels << " }"
+	<< (i + 1 < results.size() ? "," : "") << std::endl;
+  }
+  out << "  ]" << std::endl;
+  out << "}" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+
+  std::string filename, filter;
+  uint16_t nTriggers = 10;
+  uint32_t daqTriggers = 10000;
+  std::vector<size_t> nrocs;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i],"-h")) {
+      std::cout << "Help:" << std::endl;
+      std::cout << "-o filename    write results as JSON to this file, default stdout" << std::endl;
+      std::cout << "-n triggers    triggers per pixel and DAC setting (default 10)" << std::endl;
+      std::cout << "-d triggers    triggers sent for the DAQ readout (default 10000)" << std::endl;
+      std::cout << "-r rocs        only run this number of ROCs, can be repeated (default 1, 4, 16)" << std::endl;
+      std::cout << "-b name        only run this API function" << std::endl;
+      return 0;
+    }
+    else if (!strcmp(argv[i],"-o") && i+1 < argc) { filename = std::string(argv[++i]); }
+    else if (!strcmp(argv[i],"-n") && i+1 < argc) { nTriggers = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-d") && i+1 < argc) { daqTriggers = atoi(argv[++i]); }
+    else if (!strcmp(argv[i],"-r") && i+1 < argc) { nrocs.push_back(atoi(argv[++i])); }
+    else if (!strcmp(argv[i],"-b") && i+1 < argc) { filter = std::string(argv[++i]); }
+  }
+  if(nrocs.empty()) {
+    nrocs.push_back(1);
+    nrocs.push_back(4);
+    nrocs.push_back(16);
+  }
+
+  // Failed configurations are left out of the results:
+  bool ok = true;
+  for(size_t i = 0; i < nrocs.size(); i++) {
+    if(!benchDUT(nrocs.at(i), false, nTriggers, daqTriggers, filter)) ok = false;
+    if(!benchDUT(nrocs.at(i), true, nTriggers, daqTriggers, filter)) ok = false;
+  }
+
+  if(filename.empty()) writeJSON(std::cout, nTriggers, daqTriggers);
+  else {
+    std::ofstream out(filename.c_str());
+    writeJSON(out, nTriggers, daqTriggers);
+    std::cout << "Wrote results to " << filename << std::endl;
+  }
+  return (ok ? 0 : 1);
+}
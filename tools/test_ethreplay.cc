@@ -0,0 +1,130 @@
+/* Replays a capture of DTB Ethernet frames through CEthernetRxBuffer, the
+   receive side of CEthernet: the data frames for this host carry a word
+   stream split at arbitrary byte boundaries, mixed with frames of other
+   hosts and processes, control frames, padded, runt and truncated frames.
+   Read back in chunks of varying size, the buffer has to deliver exactly
+   the original word stream. Returns 0 on success. */
+
+#include "EthernetRxBuffer.h"
+#include <stdint.h>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+  int failures = 0;
+
+  void check(bool ok, const char * what) {
+    if(!ok) {
+      std::cout << "FAILED: " << what << std::endl;
+      failures++;
+    }
+  }
+
+  typedef std::vector<unsigned char> frame;
+
+  const unsigned char host_mac[6] = { 0x00, 0x1b, 0x21, 0x3c, 0x4d, 0x5e };
+  const unsigned char other_mac[6] = { 0x00, 0x1b, 0x21, 0x3c, 0x4d, 0x5f };
+  const unsigned char dtb_mac[6] = { 0x40, 0xd8, 0x55, 0x11, 0x80, 0x01 };
+  const unsigned char host_pid[2] = { 0x12, 0x34 };
+  const unsigned char other_pid[2] = { 0x12, 0x35 };
+
+  // Frame as the DTB sends it, padded to the Ethernet minimum of 60 bytes
+  frame makeFrame(const unsigned char * dst, const unsigned char * pid, unsigned char type,
+                  const unsigned char * payload, size_t size) {
+    frame f(ETH_HEADER_SIZE + size);
+    for(int i = 0; i < 6; i++) {
+      f[i] = dst[i];
+      f[i+6] = dtb_mac[i];
+    }
+    f[12] = 0x08;
+    f[13] = 0x09;
+    f[14] = pid[0];
+    f[15] = pid[1];
+    f[16] = type;
+    f[17] = static_cast<unsigned char>(size >> 8);
+    f[18] = static_cast<unsigned char>(size);
+    if(size) memcpy(&f[ETH_HEADER_SIZE], payload, size);
+    if(f.size() < 60) f.resize(60, 0xee);
+    return f;
+  }
+
+  // Capture of the word stream in frames of 1 to 1500 bytes payload, with
+  // frames which have to be ignored in between
+  std::vector<frame> makeCapture(const std::vector<uint16_t> & words) {
+    const unsigned char * bytes = reinterpret_cast<const unsigned char *>(&words[0]);
+    size_t total = 2*words.size(), pos = 0;
+    std::vector<frame> capture;
+    while(pos < total) {
+      size_t size = 1 + rand()%1500;
+      if(size > total - pos) size = total - pos;
+
+      switch(rand()%8) {
+      case 0: capture.push_back(makeFrame(other_mac, host_pid, 0, bytes + pos, size)); break;
+      case 1: capture.push_back(makeFrame(host_mac, other_pid, 0, bytes + pos, size)); break;
+      case 2: capture.push_back(makeFrame(host_mac, host_pid, 1, bytes + pos, size)); break;
+      case 3: {
+	// truncated by the capture: payload size exceeds the captured length
+	frame f = makeFrame(host_mac, host_pid, 0, bytes + pos, size);
+	f.resize(ETH_HEADER_SIZE + size - 1);
+	capture.push_back(f);
+	break;
+      }
+      case 4: capture.push_back(frame(host_mac, host_mac + 6)); break;
+      default: break;
+      }
+      capture.push_back(makeFrame(host_mac, host_pid, 0, bytes + pos, size));
+      pos += size;
+    }
+    return capture;
+  }
+
+  // Replays the capture, reading chunks of up to maxread words whenever
+  // enough data has arrived
+  void testReplay(size_t nwords, size_t maxread) {
+    std::vector<uint16_t> words(nwords);
+    for(size_t i = 0; i < nwords; i++) words[i] = static_cast<uint16_t>(rand());
+    std::vector<frame> capture = makeCapture(words);
+
+    CEthernetRxBuffer rx;
+    std::vector<uint16_t> out;
+    size_t accepted = 0, want = 1 + rand()%maxread;
+    for(size_t i = 0; i < capture.size(); i++) {
+      if(rx.Collect(&capture[i][0], capture[i].size(), host_mac, host_pid)) accepted++;
+      while(rx.Available() >= 2*want) {
+	out.resize(out.size() + want);
+	rx.Read(&out[out.size() - want], 2*want);
+	want = 1 + rand()%maxread;
+      }
+    }
+    // the rest of the stream in one read:
+    size_t rest = rx.Available()/2;
+    out.resize(out.size() + rest);
+    if(rest) rx.Read(&out[out.size() - rest], 2*rest);
+
+    check(rx.Available() == 0, "all data read");
+    check(out == words, "word stream reassembled");
+    check(accepted > 0 && accepted < capture.size(), "foreign and broken frames rejected");
+  }
+}
+
+int main() {
+  srand(1);
+  testReplay(1, 1);
+  testReplay(100000, 1);
+  testReplay(100000, 3000);
+  // reads larger than the initial buffer force it to grow:
+  testReplay(1 << 20, RX_BUFFER_SIZE);
+
+  // Clear discards pending data:
+  CEthernetRxBuffer rx;
+  unsigned char payload[4] = { 1, 2, 3, 4 };
+  frame f = makeFrame(host_mac, host_pid, 0, payload, 4);
+  check(rx.Collect(&f[0], f.size(), host_mac, host_pid) && rx.Available() == 4, "padded frame");
+  rx.Clear();
+  check(rx.Available() == 0, "clear empties the buffer");
+
+  std::cout << (failures == 0 ? "All Ethernet replay checks passed." : "Ethernet replay checks failed.") << std::endl;
+  return failures == 0 ? 0 : 1;
+}
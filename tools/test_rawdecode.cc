@@ -0,0 +1,101 @@
+/* Checks the parallel decoding of indexed raw data files: a file with
+   events lacking the end marker, some of them at the end of a decode
+   range, has to give the same events and decoder statistics as a
+   sequential decode of the whole stream, with any number of threads.
+   Returns 0 on success. */
+
+#include "rawfiledecoder.h"
+#include "datasource_evt.h"
+#include "datapipe.h"
+#include "constants.h"
+#include "log.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace pxar;
+
+namespace {
+
+  int failures = 0;
+
+  void check(bool ok, const char * what) {
+    if(!ok) {
+      std::cout << "FAILED: " << what << std::endl;
+      failures++;
+    }
+  }
+
+  // Single ROC data stream with one to three pixels per event, every
+  // seventh event has no end marker (event 4095, the last one of the
+  // fourth range, among them):
+  std::vector<uint16_t> makeData(uint32_t nevents) {
+    std::vector<uint16_t> words;
+    for(uint32_t evt = 0; evt < nevents; evt++) {
+      words.push_back(0x87f8);
+      int npixels = 1 + rand()%3;
+      for(int i = 0; i < npixels; i++) {
+	pixel px(static_cast<uint8_t>(0), static_cast<uint8_t>(rand()%52), static_cast<uint8_t>(rand()%80), 100);
+	uint32_t raw = px.encode();
+	words.push_back((raw >> 12) & 0x0fff);
+	words.push_back(raw & 0x0fff);
+      }
+      if(evt % 7 != 0) words.back() |= 0x4000;
+    }
+    return words;
+  }
+
+  statistics decodeSequential(const std::vector<uint16_t> & words, uint64_t & events) {
+    evtSource src(0, 1, 0, TBM_NONE, ROC_PSI46DIGV21);
+    src.AddData(words);
+    dtbEventSplitter splitter;
+    dtbEventDecoder decoder;
+    dataSink<Event*> pump;
+    src >> splitter >> decoder >> pump;
+    events = 0;
+    try { while(true) { pump.Get(); events++; } }
+    catch(dsBufferEmpty &) {}
+    catch(dataPipeException &) {}
+    return decoder.getStatistics();
+  }
+
+  bool equal(const statistics & a, const statistics & b) {
+    statistics x = a, y = b;
+    return x.info_words_read() == y.info_words_read() && x.info_events_valid() == y.info_events_valid()
+      && x.info_pixels_valid() == y.info_pixels_valid() && x.errors() == y.errors()
+      && x.errors_event_stop() == y.errors_event_stop();
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  Log::ReportingLevel() = Log::FromString("QUIET");
+  std::string filename = std::string(argc > 1 ? argv[1] : ".") + "/pxar-test-rawdecode.dat";
+
+  srand(1);
+  std::vector<uint16_t> words = makeData(10000);
+  FILE * file = fopen(filename.c_str(), "wb");
+  check(file != NULL && fwrite(&words[0], sizeof(uint16_t), words.size(), file) == words.size(), "file written");
+  if(file) fclose(file);
+
+  uint64_t events;
+  statistics sequential = decodeSequential(words, events);
+  check(events == 10000 && sequential.errors() > 0, "sequential decode");
+
+  for(uint32_t nthreads = 1; nthreads <= 4; nthreads *= 2) {
+    rawFileDecoder decoder(filename);
+    rawIndex index(TBM_NONE);
+    index.add(decoder.data(), decoder.words());
+    index.finish();
+    decoder.setChannel(0, 1, 0, ROC_PSI46DIGV21);
+    statistics parallel = decoder.decode(index, nthreads);
+    check(decoder.eventsDecoded() == events, "events of the parallel decode");
+    check(equal(parallel, sequential), "statistics of the parallel decode");
+  }
+  remove(filename.c_str());
+
+  std::cout << (failures == 0 ? "All raw decoding checks passed." : "Raw decoding checks failed.") << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,109 @@
+/* Round trip check of the raw data compression: a digital DESER160 data
+   stream is written plain and compressed, both files are decoded through
+   dtbEventSplitter and dtbEventDecoder and the decoded events have to be
+   identical. Returns 0 on success. */
+
+#include "rawcompression.h"
+#include "datasource_evt.h"
+#include "datasource_rawz.h"
+#include "datapipe.h"
+#include "constants.h"
+#include "log.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace pxar;
+
+namespace {
+
+  // Events with a varying number of hits per ROC, framed as the DTB
+  // delivers them without TBM:
+  std::vector<uint16_t> makeData(uint32_t nevents, uint8_t nrocs) {
+    std::vector<uint16_t> data;
+    srand(42);
+    for(uint32_t evt = 0; evt < nevents; evt++) {
+      size_t pos = data.size();
+      for(uint8_t roc = 0; roc < nrocs; roc++) {
+	data.push_back(0x07f8);
+	int nhits = rand()%4;
+	for(int i = 0; i < nhits; i++) {
+	  pixel px(roc, rand()%52, rand()%80, 20 + rand()%200);
+	  uint32_t raw = px.encode();
+	  data.push_back(0x0000 | ((raw >> 12) & 0x0fff));
+	  data.push_back(0x2000 | (raw & 0x0fff));
+	}
+      }
+      data.at(pos) = 0x8000 | (data.at(pos) & 0x0fff);
+      data.back() = 0x4000 | (data.back() & 0x8fff);
+    }
+    return data;
+  }
+
+  // Decodes all events the source delivers:
+  std::vector<Event> decode(dataSource<uint16_t> & src, statistics & stats) {
+    std::vector<Event> events;
+    dtbEventSplitter splitter;
+    dtbEventDecoder decoder;
+    dataSink<Event*> pump;
+    src >> splitter >> decoder >> pump;
+    try {
+      while(true) { events.push_back(*pump.Get()); }
+    }
+    catch(dsBufferEmpty &) {}
+    catch(dataPipeException &e) { std::cout << e.what() << std::endl; }
+    stats = decoder.getStatistics();
+    return events;
+  }
+
+  bool writeFile(std::string name, const void * data, size_t size) {
+    FILE * file = fopen(name.c_str(), "wb");
+    if(!file) return false;
+    bool ok = (size == 0 || fwrite(data, 1, size, file) == size);
+    return (fclose(file) == 0) && ok;
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  Log::ReportingLevel() = Log::FromString("WARNING");
+  std::string dir = (argc > 1 ? argv[1] : ".");
+  const uint8_t nrocs = 4;
+  std::vector<uint16_t> data = makeData(100000, nrocs);
+
+  // Compressed file as written by pxardaq -z, in several blocks:
+  std::vector<uint8_t> packed(RAWZ_MAGIC, RAWZ_MAGIC + RAWZ_MAGIC_SIZE);
+  rawCompressor::compress(&data[0], data.size(), packed);
+  std::string rawzname = dir + "/test_rawz.rawz";
+  if(!writeFile(rawzname, &packed[0], packed.size())) {
+    std::cout << "Could not write " << rawzname << std::endl;
+    return 1;
+  }
+  std::cout << data.size() << " words compressed to " << packed.size() << " bytes." << std::endl;
+
+  statistics plainstats, rawzstats;
+  evtSource plain(0, nrocs, 0, TBM_NONE, ROC_PSI46DIGV21);
+  plain.AddData(data);
+  std::vector<Event> expected = decode(plain, plainstats);
+
+  rawzSource rawz(rawzname, 0, nrocs, 0, TBM_NONE, ROC_PSI46DIGV21);
+  std::vector<Event> events = decode(rawz, rawzstats);
+  remove(rawzname.c_str());
+
+  bool ok = (events.size() == expected.size() && !expected.empty());
+  size_t npixels = 0;
+  for(size_t i = 0; ok && i < events.size(); i++) {
+    ok = (events[i].pixels.size() == expected[i].pixels.size());
+    for(size_t j = 0; ok && j < events[i].pixels.size(); j++) {
+      ok = (events[i].pixels[j] == expected[i].pixels[j] && events[i].pixels[j].value() == expected[i].pixels[j].value());
+    }
+    npixels += events[i].pixels.size();
+  }
+  ok = ok && (rawzstats.errors() == plainstats.errors()) && (rawzstats.info_pixels_valid() == plainstats.info_pixels_valid());
+
+  std::cout << "Decoded " << events.size() << " of " << expected.size() << " events, " << npixels << " pixels, "
+	    << rawzstats.errors() << " errors: " << (ok ? "identical" : "MISMATCH") << "." << std::endl;
+  return ok ? 0 : 1;
+}
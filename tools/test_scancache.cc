@@ -0,0 +1,174 @@
+/* Checks the scan result cache of pxarCore: least recently used entries
+   are moved from memory to disk and dropped from disk when the budgets
+   are exceeded, entries read back from disk are identical to the stored
+   data and statistics, and clear() removes all files. Returns 0 on
+   success. */
+
+#include "scancache.h"
+#include "datasource_evt.h"
+#include "datapipe.h"
+#include "constants.h"
+#include "log.h"
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace pxar;
+
+namespace {
+
+  int failures = 0;
+
+  void check(bool ok, const char * what) {
+    if(!ok) {
+      std::cout << "FAILED: " << what << std::endl;
+      failures++;
+    }
+  }
+
+  // Scan data with a TBM header and trailer and two pixels per event:
+  std::vector<Event> makeData(uint32_t nevents, int seed) {
+    srand(seed);
+    std::vector<Event> data(nevents);
+    for(uint32_t i = 0; i < nevents; i++) {
+      data[i].addHeader(static_cast<uint16_t>(0xa000 | (i & 0xff)));
+      data[i].addTrailer(static_cast<uint16_t>(0xe000 | (rand() & 0xff)));
+      for(int j = 0; j < 2; j++) data[i].pixels.push_back(pixel(static_cast<uint8_t>(rand()%4), rand()%52, rand()%80, rand()%256));
+    }
+    return data;
+  }
+
+  // Decoding statistics of a short data stream, the last pixel has an
+  // invalid address:
+  statistics makeStatistics() {
+    std::vector<uint16_t> words;
+    for(int evt = 0; evt < 10; evt++) {
+      words.push_back(0x87f8);
+      pixel px(0, static_cast<uint8_t>(evt), static_cast<uint8_t>(evt < 9 ? evt : 85), 100);
+      uint32_t raw = px.encode();
+      words.push_back(0x0000 | ((raw >> 12) & 0x0fff));
+      words.push_back(0x6000 | (raw & 0x0fff));
+    }
+    evtSource src(0, 1, 0, TBM_NONE, ROC_PSI46DIGV21);
+    src.AddData(words);
+    dtbEventSplitter splitter;
+    dtbEventDecoder decoder;
+    dataSink<Event*> pump;
+    src >> splitter >> decoder >> pump;
+    try { while(true) pump.Get(); }
+    catch(dsBufferEmpty &) {}
+    catch(dataPipeException &) {}
+    return decoder.getStatistics();
+  }
+
+  bool equal(const std::vector<Event> & a, const std::vector<Event> & b) {
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); i++) {
+      Event x = a[i], y = b[i];
+      if(x.getHeaders() != y.getHeaders() || x.getTrailers() != y.getTrailers()) return false;
+      if(x.pixels.size() != y.pixels.size()) return false;
+      for(size_t j = 0; j < x.pixels.size(); j++) {
+	if(!(x.pixels[j] == y.pixels[j]) || x.pixels[j].value() != y.pixels[j].value()) return false;
+      }
+    }
+    return true;
+  }
+
+  bool equal(const statistics & a, const statistics & b) {
+    statistics x = a, y = b;
+    return x.info_words_read() == y.info_words_read() && x.info_events_valid() == y.info_events_valid()
+      && x.info_pixels_valid() == y.info_pixels_valid() && x.errors() == y.errors();
+  }
+
+  std::string fileName(const std::string & dir, uint64_t key) {
+    std::ostringstream name;
+    name << dir << "/pxar-scan-" << std::hex << std::setw(16) << std::setfill('0') << key << ".cache";
+    return name.str();
+  }
+
+  bool exists(const std::string & name) {
+    FILE * file = fopen(name.c_str(), "rb");
+    if(file) fclose(file);
+    return file != NULL;
+  }
+}
+
+int main(int argc, char* argv[]) {
+
+  Log::ReportingLevel() = Log::FromString("WARNING");
+  std::string dir = (argc > 1 ? argv[1] : ".");
+
+  const uint64_t A = 0xa, B = 0xb, C = 0xc, D = 0xd;
+  std::vector<Event> data[4];
+  for(int i = 0; i < 4; i++) data[i] = makeData(1000, i + 1);
+  statistics stats = makeStatistics();
+  statistics none;
+  check(stats.errors() > 0 && stats.info_pixels_valid() > 0, "test statistics");
+
+  scanCache cache;
+  std::vector<Event> out;
+  statistics outstats;
+  check(!cache.enabled() && !cache.get(A, out, outstats), "disabled by default");
+  cache.put(A, data[0], stats);
+  check(cache.memoryUsed() == 0, "nothing stored while disabled");
+
+  // Measure the size of one data set, all of them are equally large:
+  cache.setBudget(1 << 30);
+  cache.put(A, data[0], stats);
+  size_t size = cache.memoryUsed();
+  cache.clear();
+  check(size > 0 && cache.memoryUsed() == 0, "clear empties the memory");
+
+  // Memory for two data sets, disk for one:
+  cache.setBudget(2*size + size/2, dir, size + size/2);
+  cache.put(A, data[0], stats);
+  cache.put(B, data[1], none);
+  check(cache.get(A, out, outstats) && equal(out, data[0]) && equal(outstats, stats), "memory hit");
+
+  // B is the least recently used entry and goes to disk:
+  cache.put(C, data[2], none);
+  check(cache.memoryUsed() == 2*size && cache.diskUsed() == size, "LRU entry moved to disk");
+  check(exists(fileName(dir, B)) && !exists(fileName(dir, A)), "file of the LRU entry");
+
+  // A is next, B is dropped from the disk to make room:
+  cache.put(D, data[3], none);
+  check(exists(fileName(dir, A)) && !exists(fileName(dir, B)), "LRU file dropped from disk");
+  check(!cache.get(B, out, outstats), "dropped entry misses");
+
+  // Reading A back from disk moves it to memory, C goes to disk instead:
+  out.clear();
+  outstats = none;
+  check(cache.get(A, out, outstats), "disk hit");
+  check(equal(out, data[0]), "data read back from disk");
+  check(equal(outstats, stats), "statistics read back from disk");
+  check(!exists(fileName(dir, A)) && exists(fileName(dir, C)), "entries swapped between memory and disk");
+  check(cache.get(D, out, outstats) && equal(out, data[3]), "most recent entry in memory");
+  check(cache.hits() == 3 && cache.misses() == 1, "hit and miss counters");
+
+  // Data larger than the memory budget is not cached:
+  std::vector<Event> large = makeData(3000, 5);
+  cache.put(0xe, large, none);
+  check(!cache.get(0xe, out, outstats), "oversized data not cached");
+
+  // Clearing removes all files:
+  cache.clear();
+  check(cache.memoryUsed() == 0 && cache.diskUsed() == 0 && !exists(fileName(dir, C)), "clear removes the files");
+  check(!cache.get(A, out, outstats) && !cache.get(D, out, outstats), "cleared entries miss");
+
+  // Files are removed on destruction:
+  {
+    scanCache other;
+    other.setBudget(size + size/2, dir, 4*size);
+    other.put(A, data[0], stats);
+    other.put(B, data[1], stats);
+    check(exists(fileName(dir, A)), "file written");
+  }
+  check(!exists(fileName(dir, A)), "files removed on destruction");
+
+  std::cout << (failures == 0 ? "All scan cache checks passed." : "Scan cache checks failed.") << std::endl;
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,141 @@
+/* Checks the queueing of CUSBAsyncReader against a mock transfer layer:
+   the data of the completed transfers has to arrive in the ring buffer in
+   submission order, the configured number of transfers has to stay
+   queued, and errors, cancellation and stop requests have to reap all
+   outstanding transfers. Returns 0 on success. */
+
+#include "USBAsyncReader.h"
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+  int failures = 0;
+
+  void check(bool ok, const char * what) {
+    if(!ok) {
+      std::cout << "FAILED: " << what << std::endl;
+      failures++;
+    }
+  }
+
+  // Transfer layer delivering a prepared byte stream in chunks of varying
+  // size (including empty transfers), recording how it is driven
+  class mockLayer : public CUSBTransferLayer {
+  public:
+    std::vector<unsigned char> stream;
+    size_t pos;
+    std::vector<unsigned char *> buffers;
+    std::vector<uint32_t> sizes;
+    std::vector<bool> pending, cancelled;
+    uint32_t outstanding, maxOutstanding;
+    uint32_t waits, failAt;
+    int32_t lastWaited;
+    bool interrupted, ordered, valid;
+
+    mockLayer(size_t bytes, uint32_t depth) : stream(bytes), pos(0), buffers(depth, (unsigned char *)0), sizes(depth, 0),
+      pending(depth, false), cancelled(depth, false), outstanding(0), maxOutstanding(0), waits(0), failAt(0xffffffff),
+      lastWaited(-1), interrupted(false), ordered(true), valid(true) {
+      for(size_t i = 0; i < bytes; i++) stream[i] = static_cast<unsigned char>(rand());
+    }
+
+    bool Submit(uint32_t slot, unsigned char *buffer, uint32_t size) {
+      if(interrupted) return false;
+      if(slot >= pending.size() || pending[slot]) { valid = false; return false; }
+      buffers[slot] = buffer;
+      sizes[slot] = size;
+      pending[slot] = true;
+      cancelled[slot] = false;
+      if(++outstanding > maxOutstanding) maxOutstanding = outstanding;
+      return true;
+    }
+
+    int32_t Wait(uint32_t slot) {
+      if(slot >= pending.size() || !pending[slot]) { valid = false; return -99; }
+      if(lastWaited >= 0 && slot != (static_cast<uint32_t>(lastWaited) + 1) % pending.size()) ordered = false;
+      lastWaited = slot;
+      pending[slot] = false;
+      outstanding--;
+      if(cancelled[slot] || interrupted) return 0;
+      if(waits++ == failAt) return -7;
+      uint32_t n = (waits % 5 == 0) ? 0 : 1 + (waits*37) % sizes[slot];
+      if(n > stream.size() - pos) n = static_cast<uint32_t>(stream.size() - pos);
+      for(uint32_t i = 0; i < n; i++) buffers[slot][i] = stream[pos++];
+      return n;
+    }
+
+    void Cancel(uint32_t slot) { cancelled[slot] = true; }
+    void Interrupt() { interrupted = true; }
+  };
+
+  // All data arrives complete and in order, the queue stays full
+  void testStream(uint32_t depth) {
+    mockLayer layer(1 << 20, depth);
+    CUSBRingBuffer ring(1 << 21);
+    CUSBAsyncReader reader(layer, ring, 512, depth);
+    check(reader.Start(), "start");
+    check(layer.outstanding == depth, "queue filled on start");
+    while(layer.pos < layer.stream.size()) {
+      if(reader.Step() < 0) { check(false, "step"); break; }
+      check(layer.outstanding == depth, "queue kept full");
+    }
+    reader.Stop();
+    check(layer.outstanding == 0, "all transfers reaped on stop");
+
+    std::vector<unsigned char> data(ring.Available());
+    if(!data.empty()) ring.Read(&data[0], static_cast<uint32_t>(data.size()), 0);
+    check(data == layer.stream, "data complete and in order");
+    check(layer.ordered, "transfers handled in submission order");
+    check(layer.maxOutstanding == depth, "queue depth");
+    check(layer.valid, "no double submit or wait");
+  }
+
+  // A failing transfer is reported, the others are still reaped
+  void testError() {
+    mockLayer layer(1 << 16, 4);
+    layer.failAt = 10;
+    CUSBRingBuffer ring(1 << 17);
+    CUSBAsyncReader reader(layer, ring, 512, 4);
+    check(reader.Start(), "start");
+    int32_t br = 0;
+    for(int i = 0; i < 100 && br >= 0; i++) br = reader.Step();
+    check(br == -7, "transfer error reported");
+    reader.Stop();
+    check(layer.outstanding == 0, "transfers reaped after error");
+    check(layer.valid, "no double submit or wait after error");
+  }
+
+  // A stop request interrupts the layer, the next step fails and Stop reaps the rest
+  void testRequestStop() {
+    mockLayer layer(1 << 16, 3);
+    CUSBRingBuffer ring(1 << 17);
+    CUSBAsyncReader reader(layer, ring, 512, 3);
+    check(reader.Start(), "start");
+    reader.Step();
+    reader.RequestStop();
+    check(reader.Stopping() && layer.interrupted, "stop request forwarded");
+    check(reader.Step() < 0, "step fails after stop request");
+    reader.Stop();
+    check(layer.outstanding == 0, "transfers reaped after stop request");
+    check(layer.valid, "no double submit or wait after stop request");
+  }
+}
+
+int main() {
+  srand(1);
+  testStream(1);
+  testStream(4);
+  testStream(8);
+  testError();
+  testRequestStop();
+
+  // A depth of zero is treated as one transfer:
+  mockLayer layer(0, 1);
+  CUSBRingBuffer ring(1024);
+  CUSBAsyncReader reader(layer, ring, 512, 0);
+  check(reader.Depth() == 1, "depth zero selects one transfer");
+
+  std::cout << (failures == 0 ? "All USB reader checks passed." : "USB reader checks failed.") << std::endl;
+  return failures == 0 ? 0 : 1;
+}
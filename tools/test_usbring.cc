@@ -0,0 +1,127 @@
+/* Checks CUSBRingBuffer with a fake reader thread standing in for the USB
+   device: wrap-around of the ring indices, reads from an empty buffer
+   (timeout), a producer blocking on a full buffer, and a long concurrent
+   transfer which has to arrive unchanged. Returns 0 on success. */
+
+#include "USBRingBuffer.h"
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+  int failures = 0;
+
+  void check(bool ok, const char * what) {
+    if(!ok) {
+      std::cout << "FAILED: " << what << std::endl;
+      failures++;
+    }
+  }
+
+  // Fake USB reader: writes the stream in chunks of varying size
+  struct fakeReader {
+    CUSBRingBuffer * ring;
+    const std::vector<unsigned char> * stream;
+    uint32_t chunk;
+  };
+
+  void * produce(void * arg) {
+    fakeReader * reader = reinterpret_cast<fakeReader*>(arg);
+    const std::vector<unsigned char> & stream = *reader->stream;
+    size_t pos = 0;
+    uint32_t n = 0;
+    while(pos < stream.size()) {
+      uint32_t size = 1 + (n++*reader->chunk) % (2*reader->chunk);
+      if(size > stream.size() - pos) size = static_cast<uint32_t>(stream.size() - pos);
+      reader->ring->Write(&stream[pos], size);
+      pos += size;
+    }
+    return NULL;
+  }
+
+  // Writes and reads around the end of the buffer several times
+  void testWrapAround() {
+    CUSBRingBuffer ring(64);
+    unsigned char in[48], out[48];
+    bool ok = true;
+    for(int round = 0; round < 20; round++) {
+      for(int i = 0; i < 48; i++) in[i] = static_cast<unsigned char>(round*48 + i);
+      ring.Write(in, 48);
+      ok = ok && (ring.Available() == 48);
+      // Read in two parts, the second one crossing the end of the ring most of the time:
+      ok = ok && (ring.Read(out, 17, 0) == 17) && (ring.Read(out + 17, 31, 0) == 31);
+      ok = ok && (memcmp(in, out, 48) == 0) && (ring.Available() == 0);
+    }
+    check(ok, "wrap-around");
+  }
+
+  // Reading from an empty buffer returns what is there after the timeout
+  void testEmpty() {
+    CUSBRingBuffer ring(64);
+    unsigned char data[16] = { 1, 2, 3 };
+    check(ring.Read(data, 16, 10) == 0, "empty read times out");
+    ring.Write(data, 3);
+    check(ring.Read(data, 16, 10) == 3, "partial read after timeout");
+    ring.Write(data, 5);
+    ring.Discard();
+    check(ring.Available() == 0 && ring.Read(data, 16, 0) == 0, "discard empties the buffer");
+  }
+
+  // A producer filling the buffer has to wait until the consumer made room
+  void testFull() {
+    CUSBRingBuffer ring(256);
+    std::vector<unsigned char> stream(1024);
+    for(size_t i = 0; i < stream.size(); i++) stream[i] = static_cast<unsigned char>(i*7);
+    fakeReader reader = { &ring, &stream, 256 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, produce, &reader);
+
+    // Wait until the producer is blocked on the full buffer:
+    for(int i = 0; i < 1000 && ring.Available() < ring.Size(); i++) usleep(1000);
+    check(ring.Available() == ring.Size(), "buffer full");
+    usleep(10000);
+    check(ring.Available() == ring.Size(), "producer waits on full buffer");
+
+    std::vector<unsigned char> out(stream.size());
+    check(ring.Read(&out[0], static_cast<uint32_t>(out.size()), 1000) == out.size(), "producer resumes");
+    pthread_join(thread, NULL);
+    check(out == stream, "data after full buffer");
+  }
+
+  // Long transfer with producer and consumer running concurrently
+  void testConcurrent(uint32_t size, uint32_t chunk, uint32_t readsize) {
+    CUSBRingBuffer ring(size);
+    std::vector<unsigned char> stream(8 << 20);
+    for(size_t i = 0; i < stream.size(); i++) stream[i] = static_cast<unsigned char>(rand());
+    fakeReader reader = { &ring, &stream, chunk };
+    pthread_t thread;
+    pthread_create(&thread, NULL, produce, &reader);
+
+    std::vector<unsigned char> out(stream.size());
+    size_t pos = 0;
+    while(pos < out.size()) {
+      uint32_t n = readsize;
+      if(n > out.size() - pos) n = static_cast<uint32_t>(out.size() - pos);
+      uint32_t got = ring.Read(&out[pos], n, 1000);
+      if(got == 0) break;
+      pos += got;
+    }
+    pthread_join(thread, NULL);
+    check(pos == out.size() && out == stream, "concurrent transfer");
+  }
+}
+
+int main() {
+  srand(1);
+  testWrapAround();
+  testEmpty();
+  testFull();
+  testConcurrent(4096, 700, 333);
+  testConcurrent(1 << 16, 16384, 4096);
+  testConcurrent(512, 3, 512);
+
+  std::cout << (failures == 0 ? "All ring buffer checks passed." : "Ring buffer checks failed.") << std::endl;
+  return failures == 0 ? 0 : 1;
+}
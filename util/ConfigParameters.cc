@@ -88,6 +88,9 @@ void ConfigParameters::initialize() {
 
   fGuiX = fGuiY = 0;
 
+  fScanCacheMB = fScanCacheDiskMB = 0;
+  fScanCacheDir = "";
+
   fMaskedPixels.clear(); 
 }
 
@@ -194,6 +197,10 @@ bool ConfigParameters::readConfigParameterFile(string file) {
       else if (0 == _name.compare("guiX")) { fGuiX = _ivalue; }
       else if (0 == _name.compare("guiY")) { fGuiY = _ivalue; }
 
+      else if (0 == _name.compare("scanCacheMB")) { fScanCacheMB = _ivalue; }
+      else if (0 == _name.compare("scanCacheDir")) { fScanCacheDir = _value; }
+      else if (0 == _name.compare("scanCacheDiskMB")) { fScanCacheDiskMB = _ivalue; }
+
 
       else { LOG(logINFO) << "Did not understand '" << _name << "'."; }
     }
@@ -821,6 +828,12 @@ bool ConfigParameters::writeConfigParameterFile() {
     fprintf(file, "guiY %i\n", fGuiY);
   }
 
+  if (fScanCacheMB > 0) {
+    fprintf(file, "scanCacheMB %i\n", fScanCacheMB);
+    if (fScanCacheDir != "") fprintf(file, "scanCacheDir %s\n", fScanCacheDir.c_str());
+    if (fScanCacheDiskMB > 0) fprintf(file, "scanCacheDiskMB %i\n", fScanCacheDiskMB);
+  }
+
   fprintf(file, "\n");
 
   fprintf(file, "-- voltages and current limits\n\n");
@@ -157,6 +157,11 @@ public:
   int getGuiX() {return fGuiX;}
   int getGuiY() {return fGuiY;}
 
+  /// scan result cache of pxarCore, disabled with a memory budget of 0 MB
+  int getScanCacheMB() {return fScanCacheMB;}
+  int getScanCacheDiskMB() {return fScanCacheDiskMB;}
+  std::string getScanCacheDir() {return fScanCacheDir;}
+
   void setGuiX(int x) {fGuiX = x;}
   void setGuiY(int x) {fGuiY = x;}
 
@@ -201,6 +206,8 @@ private:
   std::string fReadbackCalFileName;
 
   int fGuiX, fGuiY;
+  int fScanCacheMB, fScanCacheDiskMB;
+  std::string fScanCacheDir;
 
   static ConfigParameters* fInstance;
 
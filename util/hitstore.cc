@@ -0,0 +1,209 @@
+#include "hitstore.hh"
+
+#include <algorithm>
+#include <cmath>
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include <TH1.h>
+#include <TH2D.h>
+#include <TProfile2D.h>
+
+using namespace std;
+
+// ----------------------------------------------------------------------
+hitStore::hitStore(): fNrocs(0), fSkipped(0) {
+  std::fill(fRocIdx, fRocIdx + 256, -1);
+}
+
+// ----------------------------------------------------------------------
+hitStore::~hitStore() {
+}
+
+// ----------------------------------------------------------------------
+void hitStore::book(const vector<uint8_t> &rocIds) {
+  std::fill(fRocIdx, fRocIdx + 256, -1);
+  for (unsigned int i = 0; i < rocIds.size(); ++i) fRocIdx[rocIds[i]] = i;
+  fNrocs = rocIds.size();
+  fHists.clear();
+  fBins.clear();
+
+  size_t n = static_cast<size_t>(fNrocs)*4160;
+  fHits.assign(n, 0);
+  fPh.assign(n, 0.);
+  fPh2.assign(n, 0.);
+  fQ.assign(n, 0.);
+  fQ2.assign(n, 0.);
+  fSkipped = 0;
+}
+
+// ----------------------------------------------------------------------
+int hitStore::book(int nx, double xmin, double xmax, int ny, double ymin, double ymax) {
+  hist h;
+  h.nx = nx;
+  h.ny = ny;
+  h.xmin = xmin;
+  h.xmax = xmax;
+  h.ymin = ymin;
+  h.ymax = ymax;
+  h.size = static_cast<size_t>(nx + 2)*(ny > 0 ? ny + 2 : 1);
+  fHists.push_back(h);
+  fBins.push_back(vector<double>(fNrocs*h.size, 0.));
+  return static_cast<int>(fHists.size()) - 1;
+}
+
+// ----------------------------------------------------------------------
+int hitStore::book(const TH1 *h) {
+  const TAxis *ax = h->GetXaxis();
+  if (h->GetDimension() < 2) return book(ax->GetNbins(), ax->GetXmin(), ax->GetXmax());
+  const TAxis *ay = h->GetYaxis();
+  return book(ax->GetNbins(), ax->GetXmin(), ax->GetXmax(), ay->GetNbins(), ay->GetXmin(), ay->GetXmax());
+}
+
+// ----------------------------------------------------------------------
+void hitStore::reset() {
+  std::fill(fHits.begin(), fHits.end(), 0);
+  std::fill(fPh.begin(), fPh.end(), 0.);
+  std::fill(fPh2.begin(), fPh2.end(), 0.);
+  std::fill(fQ.begin(), fQ.end(), 0.);
+  std::fill(fQ2.begin(), fQ2.end(), 0.);
+  for (unsigned int i = 0; i < fBins.size(); ++i) std::fill(fBins[i].begin(), fBins[i].end(), 0.);
+  fSkipped = 0;
+}
+
+// ----------------------------------------------------------------------
+void hitStore::fillRocs(const vector<pxar::Event> &events, const vector<vector<double> > &q,
+                        int phId, int qId, int first, int step) {
+  for (unsigned int ievt = 0; ievt < events.size(); ++ievt) {
+    const vector<pxar::pixel> &pixels = events[ievt].pixels;
+    const double *qs = (ievt < q.size() && q[ievt].size() >= pixels.size() && !pixels.empty() ? &q[ievt][0] : 0);
+    for (unsigned int ipix = 0; ipix < pixels.size(); ++ipix) {
+      pxar::pixel px(pixels[ipix]);
+      int iroc = fRocIdx[px.roc()];
+      if (iroc < 0) {
+        if (0 == first) ++fSkipped;
+        continue;
+      }
+      if (iroc%step != first) continue;
+      double ph = px.value();
+      double qv = (qs ? qs[ipix] : 0.);
+      fill(iroc, px.column(), px.row(), ph, qv);
+      if (phId > -1) fill(phId, iroc, ph);
+      if (qId > -1) fill(qId, iroc, qv);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+void* hitStore::runFillJob(void *arg) {
+  fillJob *job = reinterpret_cast<fillJob*>(arg);
+  job->store->fillRocs(*job->events, *job->q, job->phId, job->qId, job->first, job->step);
+  return 0;
+}
+
+// ----------------------------------------------------------------------
+void hitStore::fill(const vector<pxar::Event> &events, const vector<vector<double> > &q,
+                    int phId, int qId, int nthreads) {
+  // -- every thread fills the arrays of its own ROCs, no locking needed
+#ifndef WIN32
+  if (nthreads < 1) nthreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+#else
+  nthreads = 1;
+#endif
+  nthreads = min(nthreads, fNrocs);
+  if (nthreads <= 1) {
+    fillRocs(events, q, phId, qId, 0, 1);
+    return;
+  }
+
+#ifndef WIN32
+  vector<fillJob> jobs(nthreads);
+  vector<pthread_t> threads(nthreads);
+  for (int t = 0; t < nthreads; ++t) {
+    jobs[t].store = this;
+    jobs[t].events = &events;
+    jobs[t].q = &q;
+    jobs[t].phId = phId;
+    jobs[t].qId = qId;
+    jobs[t].first = t;
+    jobs[t].step = nthreads;
+    pthread_create(&threads[t], 0, hitStore::runFillJob, &jobs[t]);
+  }
+  for (int t = 0; t < nthreads; ++t) pthread_join(threads[t], 0);
+#endif
+}
+
+// ----------------------------------------------------------------------
+void hitStore::flushHits(int iroc, TH2D *h, bool add) const {
+  if (!h || iroc < 0 || iroc >= fNrocs) return;
+  double entries(add ? h->GetEntries() : 0.);
+  for (int ic = 0; ic < 52; ++ic) {
+    for (int ir = 0; ir < 80; ++ir) {
+      int ibin = h->GetBin(ic+1, ir+1);
+      double n = fHits[static_cast<size_t>(iroc)*4160 + ic*80 + ir];
+      if (add) n += h->GetBinContent(ibin);
+      h->SetBinContent(ibin, n);
+      if (h->GetSumw2N() > 0) h->GetSumw2()->SetAt(n, ibin);
+      entries += fHits[static_cast<size_t>(iroc)*4160 + ic*80 + ir];
+    }
+  }
+  h->ResetStats();
+  h->SetEntries(entries);
+}
+
+// ----------------------------------------------------------------------
+void hitStore::flushProfile(int iroc, TProfile2D *p, const vector<double> &sum, const vector<double> &sum2, bool add) const {
+  if (!p || iroc < 0 || iroc >= fNrocs) return;
+  // -- a profile bin holds the sum of the values, its "sumw2" the sum of the squares
+  double entries(add ? p->GetEntries() : 0.);
+  bool binSumw2(p->GetBinSumw2()->GetSize() > 0);
+  for (int ic = 0; ic < 52; ++ic) {
+    for (int ir = 0; ir < 80; ++ir) {
+      size_t i = static_cast<size_t>(iroc)*4160 + ic*80 + ir;
+      int ibin = p->GetBin(ic+1, ir+1);
+      double n(fHits[i]), s(sum[i]), s2(sum2[i]);
+      if (add) {
+        n  += p->GetBinEntries(ibin);
+        s  += p->GetArray()[ibin];
+        s2 += p->GetSumw2()->At(ibin);
+      }
+      p->SetBinEntries(ibin, n);
+      p->SetBinContent(ibin, s);
+      p->GetSumw2()->SetAt(s2, ibin);
+      if (binSumw2) p->GetBinSumw2()->SetAt(n, ibin);
+      entries += fHits[i];
+    }
+  }
+  p->ResetStats();
+  p->SetEntries(entries);
+}
+
+// ----------------------------------------------------------------------
+void hitStore::flushPh(int iroc, TProfile2D *p, bool add) const {
+  flushProfile(iroc, p, fPh, fPh2, add);
+}
+
+// ----------------------------------------------------------------------
+void hitStore::flushQ(int iroc, TProfile2D *p, bool add) const {
+  flushProfile(iroc, p, fQ, fQ2, add);
+}
+
+// ----------------------------------------------------------------------
+void hitStore::flush(int id, int iroc, TH1 *h, bool add) const {
+  if (!h || id < 0 || id >= static_cast<int>(fHists.size()) || iroc < 0 || iroc >= fNrocs) return;
+  const hist &hs = fHists[id];
+  const double *b = &fBins[id][static_cast<size_t>(iroc)*hs.size];
+  double entries(add ? h->GetEntries() : 0.);
+  // -- the global bin numbers of TH1D and TH2D are those of the store
+  for (size_t ibin = 0; ibin < hs.size; ++ibin) {
+    double n = b[ibin];
+    entries += n;
+    if (add) n += h->GetBinContent(ibin);
+    h->SetBinContent(ibin, n);
+    if (h->GetSumw2N() > 0) h->GetSumw2()->SetAt(n, ibin);
+  }
+  h->ResetStats();
+  h->SetEntries(entries);
+}
@@ -0,0 +1,102 @@
+#ifndef HITSTORE_H
+#define HITSTORE_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "pxardllexport.h"
+#include "datatypes.h"
+
+class TH1;
+class TH2D;
+class TProfile2D;
+
+// ----------------------------------------------------------------------
+// Accumulates the hits of DAQ-style tests in plain arrays: per ROC and
+// pixel the number of hits and the sums (and sums of squares) of pulse
+// height and charge, plus any number of fixed-binning 1D/2D histograms
+// per ROC. Filling is a few array increments per hit; the ROOT histograms
+// are only set (with SetBinContent) when they are displayed or written.
+// ----------------------------------------------------------------------
+class DLLEXPORT hitStore {
+public:
+  hitStore();
+  ~hitStore();
+
+  /// pixel maps for the ROCs with these IDs, removes all histograms
+  void book(const std::vector<uint8_t> &rocIds);
+  /// histogram per ROC with the binning of TH1D (ny == 0) or TH2D, returns the id for fill() and flush()
+  int  book(int nx, double xmin, double xmax, int ny = 0, double ymin = 0., double ymax = 1.);
+  /// histogram per ROC with the (fixed) binning of h
+  int  book(const TH1 *h);
+  /// clear all contents, keep the booking
+  void reset();
+
+  /// ROC index of a ROC ID, -1 if not booked
+  int  index(uint8_t rocId) const {return fRocIdx[rocId];}
+  int  nRocs() const {return fNrocs;}
+  /// hits of ROCs which are not booked, they are ignored
+  uint64_t skipped() const {return fSkipped;}
+
+  /// one hit of pixel col/row with pulse height ph and charge q
+  void fill(int iroc, int col, int row, double ph, double q) {
+    if (col < 0 || col > 51 || row < 0 || row > 79) return;
+    size_t i = static_cast<size_t>(iroc)*4160 + col*80 + row;
+    ++fHits[i];
+    fPh[i] += ph;
+    fPh2[i] += ph*ph;
+    fQ[i] += q;
+    fQ2[i] += q*q;
+  }
+  /// one entry in histogram id of ROC iroc
+  void fill(int id, int iroc, double x, double y = 0.) {
+    hist &h = fHists[id];
+    fBins[id][static_cast<size_t>(iroc)*h.size + bin(h.nx, h.xmin, h.xmax, x)
+              + (h.ny > 0 ? (h.nx + 2)*bin(h.ny, h.ymin, h.ymax, y) : 0)] += 1.;
+  }
+  /// all hits of the events. q[ievt][ipix] is the charge of the hit (0 if q[ievt] is short); pulse height
+  /// and charge are also filled into the 1D histograms phId and qId (-1: none). The ROCs are distributed
+  /// over nthreads threads (0: one per CPU)
+  void fill(const std::vector<pxar::Event> &events, const std::vector<std::vector<double> > &q,
+            int phId = -1, int qId = -1, int nthreads = 1);
+
+  /// set the ROOT histograms of ROC iroc to the accumulated content, or add it to their content
+  void flushHits(int iroc, TH2D *h, bool add = false) const;
+  void flushPh(int iroc, TProfile2D *p, bool add = false) const;
+  void flushQ(int iroc, TProfile2D *p, bool add = false) const;
+  void flush(int id, int iroc, TH1 *h, bool add = false) const;
+
+private:
+  struct hist {
+    int nx, ny;
+    double xmin, xmax, ymin, ymax;
+    size_t size;
+  };
+  /// bin number as TAxis::FindBin (0: underflow, n+1: overflow)
+  static int bin(int n, double min, double max, double x) {
+    if (x < min) return 0;
+    if (!(x < max)) return n + 1;
+    return 1 + static_cast<int>(n*(x - min)/(max - min));
+  }
+  void fillRocs(const std::vector<pxar::Event> &events, const std::vector<std::vector<double> > &q,
+                int phId, int qId, int first, int step);
+  void flushProfile(int iroc, TProfile2D *p, const std::vector<double> &sum, const std::vector<double> &sum2, bool add) const;
+
+  int fNrocs;
+  int fRocIdx[256];
+  uint64_t fSkipped;
+  std::vector<uint32_t> fHits;
+  std::vector<double> fPh, fPh2, fQ, fQ2;
+  std::vector<hist> fHists;
+  std::vector<std::vector<double> > fBins;
+
+  struct fillJob {
+    hitStore *store;
+    const std::vector<pxar::Event> *events;
+    const std::vector<std::vector<double> > *q;
+    int phId, qId, first, step;
+  };
+  static void* runFillJob(void *arg);
+};
+
+#endif
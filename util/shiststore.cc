@@ -0,0 +1,232 @@
+#include "shiststore.hh"
+
+#include <algorithm>
+#include <cmath>
+#ifndef WIN32
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+  struct shistStoreJob {
+    shistStore *store;
+    const vector<pair<uint8_t, vector<pxar::pixel> > > *results;
+    const vector<int> *rocIdx;
+    int first, step;
+  };
+
+  // -- pixels per tile of the s-curve estimator: one or two SIMD registers wide,
+  //    and with 256 DAC values still small enough to stay in the L1 cache
+  const int SCURVE_TILE = 16;
+
+  // -- quality cuts of the s-curve estimator (fractions of the plateau)
+  const float SCURVE_MAXFLOOR   = 0.1f;  // first DAC value must be below
+  const float SCURVE_MINPLATEAU = 0.9f;  // last DAC value must be above
+  const float SCURVE_MAXNEGVAR  = 0.3f;  // summed decrease of the s-curve
+  const float SCURVE_MINSIGMA   = 0.2f;  // step functions are left to the fit
+}
+
+// ----------------------------------------------------------------------
+shistStore::shistStore(): fNpix(0), fDacMin(0), fDacMax(-1), fNbins(0), fSmall(true) {
+}
+
+// ----------------------------------------------------------------------
+shistStore::~shistStore() {
+}
+
+// ----------------------------------------------------------------------
+void shistStore::book(int nrocs, int dacmin, int dacmax, bool counts, double maxcount) {
+  fNpix   = nrocs*52*80;
+  fDacMin = dacmin;
+  fDacMax = dacmax;
+  fNbins  = dacmax - dacmin + 3;
+  fSmall  = counts && (maxcount <= 65535.);
+
+  // -- release the memory of a previous (possibly larger) booking
+  vector<uint16_t>().swap(fCounts);
+  vector<float>().swap(fWeights);
+  if (fSmall) {
+    fCounts.resize(static_cast<size_t>(fNpix)*fNbins, 0);
+  } else {
+    fWeights.resize(static_cast<size_t>(fNpix)*fNbins, 0.);
+  }
+}
+
+// ----------------------------------------------------------------------
+void shistStore::clear() {
+  std::fill(fCounts.begin(), fCounts.end(), 0);
+  std::fill(fWeights.begin(), fWeights.end(), 0.f);
+}
+
+// ----------------------------------------------------------------------
+void shistStore::fill(int idx, int dac, float w) {
+  if (idx < 0 || idx >= fNpix) return;
+  size_t i = static_cast<size_t>(idx)*fNbins + bin(dac);
+  if (fSmall) {
+    int c = fCounts[i] + static_cast<int>(w + 0.5);
+    fCounts[i] = static_cast<uint16_t>(c > 65535 ? 65535 : (c < 0 ? 0 : c));
+  } else {
+    fWeights[i] += w;
+  }
+}
+
+// ----------------------------------------------------------------------
+void shistStore::fillRocs(const vector<pair<uint8_t, vector<pxar::pixel> > > &results,
+                          const vector<int> &rocIdx, int first, int step) {
+  for (unsigned int idac = 0; idac < results.size(); ++idac) {
+    int dac = results[idac].first;
+    const vector<pxar::pixel> &pixels = results[idac].second;
+    for (unsigned int ipix = 0; ipix < pixels.size(); ++ipix) {
+      pxar::pixel px(pixels[ipix]);
+      if (px.roc() >= rocIdx.size()) continue;
+      int iroc = rocIdx[px.roc()];
+      if (iroc < 0 || iroc%step != first) continue;
+      int ic = px.column();
+      int ir = px.row();
+      if (ic > 51 || ir > 79) continue;
+      fill(iroc*4160 + ic*80 + ir, dac, static_cast<float>(px.value()));
+    }
+  }
+}
+
+// ----------------------------------------------------------------------
+void* shistStore::fillJob(void *arg) {
+  shistStoreJob *job = reinterpret_cast<shistStoreJob*>(arg);
+  job->store->fillRocs(*job->results, *job->rocIdx, job->first, job->step);
+  return 0;
+}
+
+// ----------------------------------------------------------------------
+void shistStore::fill(const vector<pair<uint8_t, vector<pxar::pixel> > > &results, const vector<int> &rocIdx, int nthreads) {
+  // -- every thread fills the histograms of its own ROCs, no locking needed
+  int nrocs = fNpix/4160;
+#ifndef WIN32
+  if (nthreads < 1) nthreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+#else
+  nthreads = 1;
+#endif
+  nthreads = min(nthreads, nrocs);
+  if (nthreads <= 1) {
+    fillRocs(results, rocIdx, 0, 1);
+    return;
+  }
+
+#ifndef WIN32
+  vector<shistStoreJob> jobs(nthreads);
+  vector<pthread_t> threads(nthreads);
+  for (int t = 0; t < nthreads; ++t) {
+    jobs[t].store = this;
+    jobs[t].results = &results;
+    jobs[t].rocIdx = &rocIdx;
+    jobs[t].first = t;
+    jobs[t].step = nthreads;
+    pthread_create(&threads[t], 0, shistStore::fillJob, &jobs[t]);
+  }
+  for (int t = 0; t < nthreads; ++t) pthread_join(threads[t], 0);
+#endif
+}
+
+// ----------------------------------------------------------------------
+float shistStore::get(int idx, int x) const {
+  if (idx < 0 || idx >= fNpix || x < fDacMin || x > fDacMax) return 0.;
+  size_t i = static_cast<size_t>(idx)*fNbins + bin(x);
+  return fSmall ? fCounts[i] : fWeights[i];
+}
+
+// ----------------------------------------------------------------------
+float shistStore::getSumOfWeights(int idx) const {
+  if (idx < 0 || idx >= fNpix) return 0.;
+  float sum(0.);
+  size_t i0 = static_cast<size_t>(idx)*fNbins;
+  for (int i = 0; i < fNbins; ++i) sum += (fSmall ? fCounts[i0+i] : fWeights[i0+i]);
+  return sum;
+}
+
+// ----------------------------------------------------------------------
+void shistStore::scurves(vector<scurve> &result, int xmin) const {
+  scurve none = {-1.f, -1.f, -1.f, 0.f, false};
+  result.assign(fNpix, none);
+
+  int b0 = bin(max(xmin, fDacMin));
+  int nb = fNbins - 1 - b0;
+  if (nb < 2) return;
+  float x0 = static_cast<float>(max(xmin, fDacMin));
+
+  // -- tile[ib*SCURVE_TILE + ip]: DAC value x0+ib of pixel ip of the tile
+  vector<float> tile(static_cast<size_t>(nb)*SCURVE_TILE);
+  float mx[SCURVE_TILE], half[SCURVE_TILE], thr[SCURVE_TILE], thrN[SCURVE_TILE];
+  float negvar[SCURVE_TILE], mom[SCURVE_TILE], sum[SCURVE_TILE];
+
+  for (int p0 = 0; p0 < fNpix; p0 += SCURVE_TILE) {
+    int np = min(SCURVE_TILE, fNpix - p0);
+    for (int ip = 0; ip < SCURVE_TILE; ++ip) {
+      size_t i0 = static_cast<size_t>(p0 + ip)*fNbins + b0;
+      for (int ib = 0; ib < nb; ++ib) {
+        tile[ib*SCURVE_TILE + ip] = (ip >= np ? 0.f : (fSmall ? fCounts[i0+ib] : fWeights[i0+ib]));
+      }
+    }
+
+    // -- plateau
+    for (int ip = 0; ip < SCURVE_TILE; ++ip) mx[ip] = 0.f;
+    for (int ib = 0; ib < nb; ++ib) {
+      const float *y = &tile[ib*SCURVE_TILE];
+      for (int ip = 0; ip < SCURVE_TILE; ++ip) mx[ip] = (y[ip] > mx[ip] ? y[ip] : mx[ip]);
+    }
+
+    // -- first crossing of half the plateau from below, last DAC value above it
+    //    and the summed decrease (which an ideal s-curve does not have)
+    const float *y0 = &tile[0];
+    for (int ip = 0; ip < SCURVE_TILE; ++ip) {
+      half[ip]   = 0.5f*mx[ip];
+      thr[ip]    = -1.f;
+      thrN[ip]   = (y0[ip] > half[ip] ? x0 : -1.f);
+      negvar[ip] = 0.f;
+    }
+    for (int ib = 1; ib < nb; ++ib) {
+      const float *yp = &tile[(ib-1)*SCURVE_TILE];
+      const float *y  = &tile[ib*SCURVE_TILE];
+      float x = x0 + ib;
+      for (int ip = 0; ip < SCURVE_TILE; ++ip) {
+        float d = y[ip] - yp[ip];
+        bool up = (thr[ip] < 0.f) & (yp[ip] < half[ip]) & (y[ip] >= half[ip]);
+        float xc = x - 1.f + (half[ip] - yp[ip])/(d > 0.f ? d : 1.f);
+        thr[ip]    = (up ? xc : thr[ip]);
+        thrN[ip]   = (y[ip] > half[ip] ? x : thrN[ip]);
+        negvar[ip] += (d < 0.f ? -d : 0.f);
+      }
+    }
+
+    // -- noise: for a Gaussian derivative E|x - thr| = sigma*sqrt(2/pi). The
+    //    difference of neighbouring DAC values belongs to the middle between them
+    for (int ip = 0; ip < SCURVE_TILE; ++ip) {
+      mom[ip] = 0.f;
+      sum[ip] = 0.f;
+    }
+    for (int ib = 1; ib < nb; ++ib) {
+      const float *yp = &tile[(ib-1)*SCURVE_TILE];
+      const float *y  = &tile[ib*SCURVE_TILE];
+      float x = x0 + ib - 0.5f;
+      for (int ip = 0; ip < SCURVE_TILE; ++ip) {
+        float d = y[ip] - yp[ip];
+        mom[ip] += d*fabs(x - thr[ip]);
+        sum[ip] += d;
+      }
+    }
+
+    const float *yl = &tile[(nb-1)*SCURVE_TILE];
+    for (int ip = 0; ip < np; ++ip) {
+      scurve &s = result[p0 + ip];
+      s.thr     = thr[ip];
+      s.thrN    = thrN[ip];
+      s.plateau = mx[ip];
+      s.sig     = (sum[ip] > 0.f ? static_cast<float>(sqrt(0.5*M_PI))*mom[ip]/sum[ip] : -1.f);
+      s.ok      = (mx[ip] > 0.f) && (thr[ip] >= 0.f)
+        && (y0[ip] <= SCURVE_MAXFLOOR*mx[ip])
+        && (yl[ip] >= SCURVE_MINPLATEAU*mx[ip])
+        && (negvar[ip] <= SCURVE_MAXNEGVAR*mx[ip])
+        && (s.sig >= SCURVE_MINSIGMA);
+    }
+  }
+}
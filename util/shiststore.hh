@@ -0,0 +1,72 @@
+#ifndef SHISTSTORE_H
+#define SHISTSTORE_H
+
+#include <vector>
+#include <stdint.h>
+
+#include "pxardllexport.h"
+#include "datatypes.h"
+
+// ----------------------------------------------------------------------
+// Compact replacement for a block of shist256, one scan histogram per
+// pixel. Only the booked ROCs and the DAC range of the scan are stored,
+// with the DAC bins of a pixel next to each other (plus under- and
+// overflow). Hit counts are kept as uint16_t if they cannot exceed 65535,
+// everything else (e.g. summed pulse heights) as float.
+// ----------------------------------------------------------------------
+class DLLEXPORT shistStore {
+public:
+  /// closed-form s-curve parameters of one pixel, in DAC units
+  struct scurve {
+    float thr;     ///< 50% crossing of the plateau, linearly interpolated
+    float sig;     ///< Gaussian width from the first absolute moment of the derivative
+    float thrN;    ///< last DAC value above half of the plateau (noise edge)
+    float plateau; ///< maximum content
+    bool  ok;      ///< passed the quality cuts, otherwise the s-curve should be fitted
+  };
+
+  shistStore();
+  ~shistStore();
+
+  /// book 4160 histograms per ROC for DAC values dacmin .. dacmax. Integer
+  /// counts up to maxcount per bin are stored in 16 bit if counts is set
+  void  book(int nrocs, int dacmin, int dacmax, bool counts, double maxcount);
+  void  clear();
+
+  /// pixel index as from PixUtil::rcr2idx
+  void  fill(int idx, int dac, float w = 1.);
+  /// fill the results of one scan, rocIdx maps the ROC ID to the ROC index (-1: not booked).
+  /// The ROCs are distributed over nthreads threads (0: one per CPU)
+  void  fill(const std::vector<std::pair<uint8_t, std::vector<pxar::pixel> > > &results,
+             const std::vector<int> &rocIdx, int nthreads = 0);
+
+  /// content for DAC value x like shist256::get(int), 0 outside of the booked range
+  float get(int idx, int x) const;
+  float getSumOfWeights(int idx) const;
+
+  /// estimate the s-curves of all pixels without fitting, using DAC values xmin .. dacMax().
+  /// Pixels are processed in small tiles so that the loops run across pixels and vectorize
+  void  scurves(std::vector<scurve> &result, int xmin) const;
+
+  int   nPixels() const {return fNpix;}
+  int   dacMin() const {return fDacMin;}
+  int   dacMax() const {return fDacMax;}
+  size_t bytes() const {return fCounts.size()*sizeof(uint16_t) + fWeights.size()*sizeof(float);}
+
+private:
+  int bin(int x) const {
+    if (x < fDacMin) return 0;
+    if (x > fDacMax) return fNbins - 1;
+    return x - fDacMin + 1;
+  }
+  void fillRocs(const std::vector<std::pair<uint8_t, std::vector<pxar::pixel> > > &results,
+                const std::vector<int> &rocIdx, int first, int step);
+
+  int fNpix, fDacMin, fDacMax, fNbins;
+  bool fSmall;
+  std::vector<uint16_t> fCounts;
+  std::vector<float> fWeights;
+  static void* fillJob(void *arg);
+};
+
+#endif